@@ -0,0 +1,303 @@
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sensors.h"
+#include "telemetry.h"
+#include "aera_power.h"
+#include "aera_dlog.h"
+#include "control.h"
+
+#define TICK_US             (1000000 / CONTROL_RATE_HZ)
+#define TICKS_PER_S         CONTROL_RATE_HZ
+#define WINDOW_TICKS        (CONTROL_HEATER_WINDOW_MS * CONTROL_RATE_HZ / 1000)
+#define TELEM_EVERY         (CONTROL_RATE_HZ * AERA_TELEM_PERIOD_MS / 1000)
+// Exponential averages over about this many ticks (power of two)
+#define AVG_SHIFT           6
+
+_Static_assert(1000000 % CONTROL_RATE_HZ == 0, "Tick must be a whole number of microseconds");
+_Static_assert(CONTROL_RATE_HZ * AERA_TELEM_PERIOD_MS % 1000 == 0 && TELEM_EVERY >= 1,
+               "Telemetry must be sampled on a whole number of control ticks");
+_Static_assert(WINDOW_TICKS >= 10, "Heater window too short for the tick rate");
+
+static const char *TAG = "CONTROL";
+
+// --- SETPOINT MAILBOX ---
+//
+// Triple buffer. The writer fills its back slot and swaps it with the
+// middle one; the reader swaps the middle one with its front slot when the
+// FRESH bit says there is something new. Each side only ever touches its
+// own slot, so there are no locks and the loop never waits on a command.
+
+typedef struct {
+    bool run;
+    uint8_t target_c;
+    uint16_t dry_min;
+    uint32_t start_gen;     // Bumped on every start request
+} setpoints_t;
+
+#define MBOX_FRESH  0x4u
+#define MBOX_INDEX  0x3u
+
+static setpoints_t s_mbox[3];
+static atomic_uint s_mbox_mid = 1;
+static unsigned s_mbox_back = 2;    // Writer only
+static unsigned s_mbox_front = 0;   // Reader only
+static setpoints_t s_pending = {    // Writer only: the set being edited
+    .target_c = CONTROL_DEFAULT_TARGET_C,
+    .dry_min = CONTROL_DEFAULT_DRY_MIN,
+};
+
+static void mbox_publish(void) {
+    s_mbox[s_mbox_back] = s_pending;
+    unsigned prev = atomic_exchange_explicit(&s_mbox_mid, s_mbox_back | MBOX_FRESH, memory_order_acq_rel);
+    s_mbox_back = prev & MBOX_INDEX;
+}
+
+static const setpoints_t *mbox_latest(void) {
+    if (atomic_load_explicit(&s_mbox_mid, memory_order_relaxed) & MBOX_FRESH) {
+        unsigned prev = atomic_exchange_explicit(&s_mbox_mid, s_mbox_front, memory_order_acq_rel);
+        s_mbox_front = prev & MBOX_INDEX;
+    }
+    return &s_mbox[s_mbox_front];
+}
+
+void control_request_run(bool run) {
+    s_pending.run = run;
+    if (run) {
+        s_pending.start_gen++;
+    }
+    mbox_publish();
+}
+
+void control_set_target(uint8_t celsius) {
+    if (celsius < CONTROL_TARGET_MIN_C) celsius = CONTROL_TARGET_MIN_C;
+    if (celsius > CONTROL_TARGET_MAX_C) celsius = CONTROL_TARGET_MAX_C;
+    s_pending.target_c = celsius;
+    mbox_publish();
+}
+
+void control_set_dry_minutes(uint16_t minutes) {
+    if (minutes < 1) minutes = 1;
+    if (minutes > CONTROL_DRY_MAX_MIN) minutes = CONTROL_DRY_MAX_MIN;
+    s_pending.dry_min = minutes;
+    mbox_publish();
+}
+
+// --- LOOP STATE ---
+// Only touched by the control task, except s_stats which others read
+
+static TaskHandle_t s_task;
+static esp_timer_handle_t s_timer;
+static int64_t s_first_due_us;  // When the timer's first tick is due
+static control_stats_t s_stats;
+
+static struct {
+    float integral;
+    float prev_c;
+    bool primed;
+} s_pid;
+
+static uint8_t s_phase = CONTROL_IDLE;
+static uint32_t s_phase_ticks;  // Ticks spent in the current phase
+static uint32_t s_seen_gen;
+static uint32_t s_window_tick;
+static uint32_t s_window_on;    // Heater-on ticks in the current window
+
+static const char *const s_phase_names[] = {"IDLE", "PREHEAT", "DRY", "COOL", "DONE"};
+
+const char *control_phase_name(uint8_t phase) {
+    return phase <= CONTROL_DONE ? s_phase_names[phase] : "?";
+}
+
+static void enter_phase(uint8_t phase, float temp_c) {
+    // Tenths by hand: a dryer is never below 0 C
+    int deci = (int)(temp_c * 10 + 0.5f);
+    AERA_DLOG(PHASE, AERA_DLOG_STR(s_phase_names[s_phase], 8), AERA_DLOG_STR(s_phase_names[phase], 8), deci / 10,
+              deci % 10);
+    s_phase = phase;
+    s_phase_ticks = 0;
+    s_stats.phase = phase;
+    if (phase == CONTROL_PREHEAT) {
+        s_pid.integral = 0;
+        s_pid.primed = false;
+    }
+}
+
+// --- PID ---
+// Derivative on measurement so a setpoint change doesn't kick the output.
+// The integral is clamped to the output range (anti-windup).
+
+static float pid_step(float target_c, float temp_c) {
+    const float dt = 1.0f / CONTROL_RATE_HZ;
+    float error = target_c - temp_c;
+
+    s_pid.integral += CONTROL_PID_KI * error * dt;
+    if (s_pid.integral < 0.0f) s_pid.integral = 0.0f;
+    if (s_pid.integral > 1.0f) s_pid.integral = 1.0f;
+
+    float deriv = s_pid.primed ? (temp_c - s_pid.prev_c) / dt : 0.0f;
+    s_pid.prev_c = temp_c;
+    s_pid.primed = true;
+
+    float out = CONTROL_PID_KP * error + s_pid.integral - CONTROL_PID_KD * deriv;
+    if (out < 0.0f) out = 0.0f;
+    if (out > 1.0f) out = 1.0f;
+    return out;
+}
+
+// --- CYCLE ---
+// Returns the heater duty for this tick and whether the fan runs
+
+static float cycle_step(const setpoints_t *sp, float temp_c, bool *fan) {
+    // Stop wins over everything; a new start restarts a finished cycle
+    if (!sp->run && (s_phase == CONTROL_PREHEAT || s_phase == CONTROL_DRY)) {
+        enter_phase(CONTROL_COOL, temp_c);
+    } else if (sp->run && sp->start_gen != s_seen_gen
+               && (s_phase == CONTROL_IDLE || s_phase == CONTROL_DONE || s_phase == CONTROL_COOL)) {
+        enter_phase(CONTROL_PREHEAT, temp_c);
+    }
+    s_seen_gen = sp->start_gen;
+    s_phase_ticks++;
+
+    switch (s_phase) {
+        case CONTROL_PREHEAT:
+            if (temp_c >= sp->target_c - CONTROL_PREHEAT_BAND_C) {
+                enter_phase(CONTROL_DRY, temp_c);
+            } else if (s_phase_ticks > CONTROL_PREHEAT_TIMEOUT_S * TICKS_PER_S) {
+                AERA_DLOG(PREHEAT_FAILED, sp->target_c);
+                enter_phase(CONTROL_COOL, temp_c);
+                break;
+            }
+            *fan = true;
+            return pid_step(sp->target_c, temp_c);
+
+        case CONTROL_DRY:
+            if (s_phase_ticks > (uint32_t)sp->dry_min * 60 * TICKS_PER_S) {
+                enter_phase(CONTROL_COOL, temp_c);
+                break;
+            }
+            *fan = true;
+            return pid_step(sp->target_c, temp_c);
+
+        default:
+            break;
+    }
+
+    if (s_phase == CONTROL_COOL) {
+        if (temp_c <= CONTROL_COOL_DONE_C || s_phase_ticks > CONTROL_COOL_TIMEOUT_S * TICKS_PER_S) {
+            enter_phase(CONTROL_DONE, temp_c);
+        } else {
+            *fan = true;
+        }
+    }
+    return 0.0f;
+}
+
+// Time-proportioning: the duty is latched at the start of each window so the
+// SSR switches at most twice per window
+static bool heater_step(float duty) {
+    if (s_window_tick == 0) {
+        s_window_on = (uint32_t)(duty * WINDOW_TICKS + 0.5f);
+        s_stats.heater_pct = (uint8_t)(s_window_on * 100 / WINDOW_TICKS);
+    }
+    bool on = s_window_tick < s_window_on;
+    if (++s_window_tick == WINDOW_TICKS) {
+        s_window_tick = 0;
+    }
+    return on;
+}
+
+// --- TASK: THE LOOP ---
+
+static void control_tick(void *arg) {
+    xTaskNotifyGive(s_task);
+}
+
+static void control_task(void *arg) {
+    aera_telem_sample_t sample;
+    int64_t due_us = 0;
+
+    while (1) {
+        // Each notification is one timer tick. More than one pending means
+        // the last step ran past a whole period.
+        uint32_t fired = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t wake_us = esp_timer_get_time();
+        if (fired == 0) {
+            continue;
+        }
+        aera_power_acquire(AERA_POWER_CONTROL);
+
+        // Deadlines count from when the timer was armed, not from our first
+        // wake-up, so a late first tick shows up as jitter too
+        if (due_us == 0) {
+            due_us = s_first_due_us;
+        }
+        due_us += (int64_t)(fired - 1) * TICK_US;
+        s_stats.missed += fired - 1;
+        uint32_t jitter = (uint32_t)(wake_us > due_us ? wake_us - due_us : due_us - wake_us);
+
+        const setpoints_t *sp = mbox_latest();
+        sensors_read(&sample);
+        float temp_c = sample.ch[AERA_TELEM_TEMP] / 100.0f;
+
+        bool fan = false;
+        float duty = cycle_step(sp, temp_c, &fan);
+        bool heat = heater_step(duty);
+        gpio_set_level(CONTROL_HEATER_PIN, heat);
+        gpio_set_level(CONTROL_FAN_PIN, fan);
+
+        int64_t done_us = esp_timer_get_time();
+        uint32_t step = (uint32_t)(done_us - wake_us);
+
+        if (s_stats.ticks % TELEM_EVERY == 0) {
+            telemetry_post(&sample);
+        }
+
+        s_stats.ticks++;
+        if (done_us > due_us + TICK_US) s_stats.overruns++;
+        if (jitter > s_stats.jitter_max_us) s_stats.jitter_max_us = jitter;
+        if (step > s_stats.step_max_us) s_stats.step_max_us = step;
+        s_stats.jitter_avg_us += ((int32_t)jitter - (int32_t)s_stats.jitter_avg_us) >> AVG_SHIFT;
+        s_stats.step_avg_us += ((int32_t)step - (int32_t)s_stats.step_avg_us) >> AVG_SHIFT;
+        due_us += TICK_US;
+        aera_power_release(AERA_POWER_CONTROL);
+    }
+}
+
+void control_get_stats(control_stats_t *out) {
+    *out = s_stats;
+}
+
+static void init_outputs(void) {
+    const gpio_num_t pins[] = {CONTROL_HEATER_PIN, CONTROL_FAN_PIN};
+    for (int i = 0; i < 2; i++) {
+        gpio_reset_pin(pins[i]);
+        gpio_set_direction(pins[i], GPIO_MODE_OUTPUT);
+        gpio_set_level(pins[i], 0);
+    }
+}
+
+void control_start(void) {
+    init_outputs();
+    sensors_init();
+    mbox_publish();
+
+    xTaskCreatePinnedToCore(control_task, "control_task", CONTROL_TASK_STACK, NULL, CONTROL_TASK_PRIO,
+                            &s_task, CONTROL_TASK_CORE);
+
+    // Task dispatch keeps the callback out of the ISR; all it does is wake
+    // the loop, so the timer task's own latency is the only jitter added
+    const esp_timer_create_args_t args = {
+        .callback = control_tick,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "control",
+        .skip_unhandled_events = false,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &s_timer));
+    s_first_due_us = esp_timer_get_time() + TICK_US;
+    ESP_ERROR_CHECK(esp_timer_start_periodic(s_timer, TICK_US));
+    ESP_LOGI(TAG, "Control loop at %d Hz on core %d", CONTROL_RATE_HZ, CONTROL_TASK_CORE);
+}
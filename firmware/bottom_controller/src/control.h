@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- DRYING CONTROL LOOP ---
+//
+// A periodic esp_timer wakes the control task on core 1 every
+// 1 / CONTROL_RATE_HZ seconds. Each tick samples the sensors, steps the
+// drying cycle and the heater PID, and drives the outputs. UART parsing
+// and telemetry run on core 0, so nothing they do can delay a tick.
+//
+// The cycle: IDLE -> PREHEAT -> DRY -> COOL -> DONE. PREHEAT runs the
+// heater under PID until the air is within CONTROL_PREHEAT_BAND_C of the
+// target, DRY holds it there for the dry time, COOL runs the fan alone
+// until the air is below CONTROL_COOL_DONE_C. A stop request, or a preheat
+// that never gets there, goes straight to COOL.
+//
+// The heater is an SSR driven by time-proportioning: the PID output is the
+// fraction of each CONTROL_HEATER_WINDOW_MS it is switched on.
+//
+// Commands never touch the loop's state. They post new setpoints to a
+// lock-free triple-buffered mailbox; the loop picks up the latest set at the
+// start of its next tick and neither side ever waits for the other.
+
+#define CONTROL_RATE_HZ             50
+#define CONTROL_TASK_CORE           1
+#define CONTROL_TASK_PRIO           10
+#define CONTROL_TASK_STACK          3072
+
+#define CONTROL_HEATER_PIN          25
+#define CONTROL_FAN_PIN             26
+#define CONTROL_HEATER_WINDOW_MS    2000
+
+// PID on air temperature (degC in, heater duty 0..1 out)
+#define CONTROL_PID_KP              0.08f
+#define CONTROL_PID_KI              0.004f
+#define CONTROL_PID_KD              0.0f
+
+#define CONTROL_DEFAULT_TARGET_C    60
+#define CONTROL_TARGET_MIN_C        30
+#define CONTROL_TARGET_MAX_C        80
+#define CONTROL_DEFAULT_DRY_MIN     45
+#define CONTROL_DRY_MAX_MIN         600
+#define CONTROL_PREHEAT_BAND_C      2
+#define CONTROL_PREHEAT_TIMEOUT_S   900
+#define CONTROL_COOL_DONE_C         35
+#define CONTROL_COOL_TIMEOUT_S      900
+
+typedef enum
+{
+    CONTROL_IDLE = 0,
+    CONTROL_PREHEAT,
+    CONTROL_DRY,
+    CONTROL_COOL,
+    CONTROL_DONE,
+} control_phase_t;
+
+typedef struct
+{
+    uint32_t ticks;
+    uint32_t missed;        // Ticks that fired while the previous step still ran
+    uint32_t overruns;      // Steps that ended after the next tick was due
+    uint32_t jitter_avg_us; // Wake-up vs. the ideal tick time
+    uint32_t jitter_max_us;
+    uint32_t step_avg_us;   // Wake-up to outputs driven
+    uint32_t step_max_us;
+    uint8_t phase;
+    uint8_t heater_pct;
+} control_stats_t;
+
+void control_start(void);
+
+// Mailbox writers. Call from one task only (the UART listener).
+void control_request_run(bool run);
+void control_set_target(uint8_t celsius);
+void control_set_dry_minutes(uint16_t minutes);
+
+// Counters are updated by the loop without a lock; each field is consistent
+// on its own.
+void control_get_stats(control_stats_t *out);
+
+const char *control_phase_name(uint8_t phase);
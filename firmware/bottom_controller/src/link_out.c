@@ -0,0 +1,110 @@
+#include <stdatomic.h>
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "aera_cmd.h"
+#include "aera_dlog.h"
+#include "link_out.h"
+
+#define QUEUE_MASK  (LINK_OUT_QUEUE_BYTES - 1)
+
+_Static_assert((LINK_OUT_QUEUE_BYTES & QUEUE_MASK) == 0, "LINK_OUT_QUEUE_BYTES must be a power of two");
+
+static uart_port_t s_port;
+static uint8_t s_addr;
+static atomic_uint s_bytes;
+
+// The outbox, whole frames back to back. Guarded by s_lock.
+static SemaphoreHandle_t s_lock;
+static uint8_t s_queue[LINK_OUT_QUEUE_BYTES];
+static uint32_t s_head;     // Free-running write index
+static uint32_t s_tail;     // Free-running read index
+static uint32_t s_dropped;
+
+// RX task only
+static uint32_t s_dropped_seen;
+
+void link_out_init(uart_port_t port, uint8_t addr) {
+    s_port = port;
+    s_addr = addr;
+    s_lock = xSemaphoreCreateMutex();
+}
+
+uint8_t link_out_addr(void) {
+    return s_addr;
+}
+
+void link_out_write(const uint8_t *frame, size_t len) {
+    if (s_addr == AERA_LINK_ADDR_P2P) {
+        uart_write_bytes(s_port, frame, len);
+        atomic_fetch_add_explicit(&s_bytes, len, memory_order_relaxed);
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (LINK_OUT_QUEUE_BYTES - (s_head - s_tail) < len) {
+        s_dropped++;
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            s_queue[(s_head + i) & QUEUE_MASK] = frame[i];
+        }
+        s_head += len;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void link_out_turn(const aera_frame_t *poll) {
+    // Only ever runs on the RX task; keeps it off the stack
+    static uint8_t out[AERA_BUS_SLOT_BYTES + AERA_LINK_OVERHEAD + AERA_BUS_REPLY_LEN];
+    size_t n = 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    while (s_head != s_tail) {
+        size_t len = AERA_LINK_OVERHEAD + s_queue[(s_tail + 1) & QUEUE_MASK];
+        if (n + len > AERA_BUS_SLOT_BYTES) {
+            break;
+        }
+        for (size_t i = 0; i < len; i++) {
+            out[n + i] = s_queue[(s_tail + i) & QUEUE_MASK];
+        }
+        n += len;
+        s_tail += len;
+    }
+    uint32_t backlog = s_head - s_tail;
+    uint32_t dropped = s_dropped;
+    xSemaphoreGive(s_lock);
+
+    aera_bus_reply_t reply = {
+        .sent = (uint16_t)n,
+        .backlog = (uint16_t)backlog,
+    };
+    uint8_t payload[AERA_BUS_REPLY_LEN];
+    aera_bus_pack_reply(payload, &reply);
+    n += aera_cmd_encode_BUS_REPLY(out + n, sizeof(out) - n, s_addr, poll->seq, payload);
+    uart_write_bytes(s_port, out, n);
+    atomic_fetch_add_explicit(&s_bytes, n, memory_order_relaxed);
+
+    if (dropped != s_dropped_seen) {
+        AERA_DLOG(BUS_OUTBOX_FULL, dropped - s_dropped_seen);
+        s_dropped_seen = dropped;
+    }
+}
+
+bool link_out_drain(TickType_t wait) {
+    TickType_t start = xTaskGetTickCount();
+    while (1) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        bool empty = s_head == s_tail;
+        xSemaphoreGive(s_lock);
+        if (empty) {
+            return true;
+        }
+        if (xTaskGetTickCount() - start >= wait) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+}
+
+uint32_t link_out_bytes_sent(void) {
+    return atomic_load_explicit(&s_bytes, memory_order_relaxed);
+}
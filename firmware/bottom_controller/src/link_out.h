@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/uart.h"
+#include "aera_link.h"
+
+// --- LINK OUT ---
+//
+// Every frame we send goes through here. On a point-to-point link it goes
+// straight to the UART, as it always has. On a bus (aera_bus.h) we may only
+// speak when the top controller hands us the bus, so frames wait in an
+// outbox until its BUS_POLL, and then go out oldest first, up to
+// AERA_BUS_SLOT_BYTES a turn, ahead of our BUS_REPLY. A frame that doesn't
+// fit in the outbox is dropped.
+//
+// link_out_write() and link_out_drain() are safe from any task;
+// link_out_turn() runs on the UART RX task.
+
+#define LINK_OUT_QUEUE_BYTES    4096    // A whole TRACE dump and then some
+
+// addr is ours: AERA_LINK_ADDR_P2P, or our address on the bus
+void link_out_init(uart_port_t port, uint8_t addr);
+uint8_t link_out_addr(void);
+
+// Sends, or queues, one whole frame
+void link_out_write(const uint8_t *frame, size_t len);
+
+// Our turn on the bus: whatever fits, then the BUS_REPLY to poll
+void link_out_turn(const aera_frame_t *poll);
+
+// Waits until the outbox is empty, for at most wait; false if it wasn't
+bool link_out_drain(TickType_t wait);
+
+// Bytes written to the UART so far, for STATS
+uint32_t link_out_bytes_sent(void);
@@ -0,0 +1,152 @@
+#include "esp_timer.h"
+#include "aera_cmd.h"
+#include "aera_dlog.h"
+#include "link_out.h"
+#include "link_rate.h"
+
+#define TRY_US      ((int64_t)AERA_BAUD_TRY_MS * 1000)
+#define CHECK_US    ((int64_t)AERA_BAUD_CHECK_MS * 1000)
+#define SILENT_US   ((int64_t)AERA_BAUD_SILENT_MS * 1000)
+// Bytes in the 128-byte RX FIFO before RTS goes up
+#define RTS_THRESHOLD   100
+
+static uart_port_t s_port;
+static bool s_rts_cts;
+
+// RX task only
+static uint32_t s_rate = AERA_BAUD_BASE;
+static bool s_flow;
+static aera_baud_req_t s_pending;
+static bool s_has_pending;
+static uint32_t s_prev_rate;    // To go back to if no COMMIT comes
+static bool s_prev_flow;
+static int64_t s_revert_us;     // 0: nothing on trial
+static int64_t s_window_us;     // Start of the CRC error window
+static int64_t s_last_frame_us;
+static uint32_t s_frames_seen;
+static uint32_t s_crc_seen;     // At the start of the window
+static uint32_t s_crc_now;
+
+// The TX buffer drains at the old rate first. APB stays at 80 MHz through
+// frequency scaling (aera_power.h), so the divider holds.
+static void apply(uint32_t rate, bool flow) {
+    flow = flow && s_rts_cts;
+    uart_wait_tx_done(s_port, pdMS_TO_TICKS(20));
+    uart_set_baudrate(s_port, rate);
+    uart_set_hw_flow_ctrl(s_port, flow ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE, RTS_THRESHOLD);
+    s_rate = rate;
+    s_flow = flow;
+
+    int64_t now = esp_timer_get_time();
+    s_window_us = now;
+    s_last_frame_us = now;
+    s_crc_seen = s_crc_now;
+}
+
+void link_rate_init(uart_port_t port, bool rts_cts) {
+    s_port = port;
+    s_rts_cts = rts_cts;
+}
+
+void link_rate_on_baud(const aera_frame_t *frame) {
+    aera_baud_req_t req;
+    aera_baud_unpack(frame->payload, &req);
+    if (aera_baud_rung(req.rate) < 0) {
+        return; // Not one of ours; ACKed, and nothing happens
+    }
+
+    switch (req.phase) {
+        case AERA_BAUD_TRY:
+        case AERA_BAUD_DROP:
+            s_pending = req;
+            s_has_pending = true;
+            break;
+        case AERA_BAUD_COMMIT:
+            if (s_revert_us != 0 && req.rate == s_rate) {
+                s_revert_us = 0;
+                AERA_DLOG(LINK_RATE, s_rate, s_flow);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void link_rate_on_probe(const aera_frame_t *frame) {
+    uint8_t buf[AERA_LINK_OVERHEAD + AERA_BAUD_PROBE_LEN];
+
+    if (!aera_baud_probe_check(frame->payload)) {
+        return; // Damaged; not coming back is the answer
+    }
+    size_t len = aera_cmd_encode_LINK_PROBE(buf, sizeof(buf), link_out_addr(), frame->seq, frame->payload);
+    link_out_write(buf, len);
+}
+
+void link_rate_after_ack(void) {
+    if (!s_has_pending) {
+        return;
+    }
+    s_has_pending = false;
+
+    if (s_pending.phase == AERA_BAUD_DROP) {
+        s_revert_us = 0;
+        apply(AERA_BAUD_BASE, false);
+        AERA_DLOG(LINK_RATE, s_rate, s_flow);
+        return;
+    }
+    // A TRY while another is on trial goes back to the agreed rate
+    if (s_revert_us == 0) {
+        s_prev_rate = s_rate;
+        s_prev_flow = s_flow;
+    }
+    apply(s_pending.rate, (s_pending.flags & AERA_BAUD_FLAG_FLOW) != 0);
+    s_revert_us = esp_timer_get_time() + TRY_US;
+}
+
+TickType_t link_rate_wait(void) {
+    int64_t next;
+    if (s_revert_us != 0) {
+        next = s_revert_us;
+    } else if (s_rate != AERA_BAUD_BASE) {
+        next = s_window_us + CHECK_US;
+    } else {
+        return portMAX_DELAY;
+    }
+
+    int64_t wait_ms = (next - esp_timer_get_time() + 999) / 1000;
+    TickType_t ticks = pdMS_TO_TICKS(wait_ms > 0 ? wait_ms : 0);
+    return ticks > 0 ? ticks : 1;
+}
+
+void link_rate_poll(int64_t now, uint32_t frames, uint32_t crc_errors) {
+    s_crc_now = crc_errors;
+    if (frames != s_frames_seen) {
+        s_frames_seen = frames;
+        s_last_frame_us = now;
+    }
+
+    // On trial, errors are what the probes are for: just the deadline
+    if (s_revert_us != 0) {
+        if (now >= s_revert_us) {
+            AERA_DLOG(LINK_RATE_REVERTED, s_rate, s_prev_rate);
+            s_revert_us = 0;
+            apply(s_prev_rate, s_prev_flow);
+        }
+        return;
+    }
+    if (s_rate == AERA_BAUD_BASE) {
+        return;
+    }
+
+    int64_t silent_us = now - s_last_frame_us;
+    uint32_t errors = crc_errors - s_crc_seen;
+    if (silent_us >= SILENT_US || errors >= AERA_BAUD_MAX_ERRORS) {
+        AERA_DLOG(LINK_RATE_FALLBACK, s_rate, errors, (uint32_t)(silent_us / 1000));
+        apply(AERA_BAUD_BASE, false);
+        return;
+    }
+    if (now - s_window_us >= CHECK_US) {
+        s_window_us = now;
+        s_crc_seen = crc_errors;
+    }
+}
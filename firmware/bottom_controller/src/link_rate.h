@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/uart.h"
+#include "aera_link.h"
+
+// --- LINK RATE ---
+//
+// Our side of the UART rate negotiation (aera_baud.h). The top controller
+// leads: LINK_BAUD TRY and DROP take effect once their ACK is out, and a TRY
+// goes back to the old rate by itself unless the COMMIT comes within
+// AERA_BAUD_TRY_MS. LINK_PROBE frames are checked and echoed, never ACKed.
+//
+// Above the base rate we also keep watch ourselves, in case the top
+// controller can't reach us to ask: AERA_BAUD_MAX_ERRORS CRC errors in an
+// AERA_BAUD_CHECK_MS window, or AERA_BAUD_SILENT_MS without a frame, and we
+// go back to the base rate, where the top controller will look for us.
+//
+// Everything runs on the UART RX task.
+
+void link_rate_init(uart_port_t port, bool rts_cts);
+
+// Handlers for the link frames. LINK_BAUD only notes what to do; the ACK
+// must go out at the old rate first.
+void link_rate_on_baud(const aera_frame_t *frame);
+void link_rate_on_probe(const aera_frame_t *frame);
+
+// After every ACK: carries out a LINK_BAUD
+void link_rate_after_ack(void);
+
+// How long the RX task may sleep before link_rate_poll() has work to do
+TickType_t link_rate_wait(void);
+
+// Deadlines and the health checks, with the reassembler's counters
+void link_rate_poll(int64_t now, uint32_t frames, uint32_t crc_errors);
@@ -2,20 +2,93 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "aera_link.h"
+#include "aera_cmd.h"
+#include "aera_power.h"
+#include "aera_dlog.h"
+#include "aera_stats.h"
+#include "control.h"
+#include "telemetry.h"
+#include "ota_update.h"
+#include "link_rate.h"
+#include "link_out.h"
 
 // --- PINS & CONFIGURATION ---
 #define RXD2_PIN        4
 #define TXD2_PIN        5
+// RTS/CTS for the faster link rates: wire them across to the top board's
+// and set both here, and on the top board
+#define RTS2_PIN        UART_PIN_NO_CHANGE
+#define CTS2_PIN        UART_PIN_NO_CHANGE
+// On a shared bus (aera_bus.h) instead: a jumper to 3V3 on BUS_PIN, our
+// address less one in binary on the ADDR pins (also to 3V3, LSB first), and
+// the RS-485 transceiver's driver enable on BUS_DE_PIN
+#define BUS_PIN         18
+#define ADDR_PINS       { 13, 14, 32, 33 }
+#define BUS_DE_PIN      19
 #define LED_PIN         2
 #define UART_PORT_NUM   UART_NUM_2
-#define BAUD_RATE       115200
+#define BAUD_RATE       AERA_BAUD_BASE  // Until the top controller moves it (link_rate.h)
 #define BUF_SIZE        1024
+#define RX_CHUNK_SIZE   256
+#define UART_EVENT_QUEUE_LEN    20
+// RX timeout in symbol times (~87us each at 115200, less once the link is
+// faster). The driver posts a UART_DATA event once the line has been idle
+// this long, so a frame is handed to us right after its last byte instead
+// of on the next poll.
+#define UART_RX_TIMEOUT_SYMBOLS 2
+// Also post an event once this many bytes sit in the hardware FIFO, so long
+// bursts are drained before the 128-byte FIFO can overflow
+#define UART_RX_FULL_THRESHOLD  64
+// Print wake-to-actuation latency stats after this many commands
+#define LATENCY_REPORT_EVERY    100
+// The command listener and telemetry share core 0; the control loop has core 1
+#define UART_RX_TASK_CORE       0
+// Power saving: the CPU drops to AERA_POWER_MIN_MHZ between commands and
+// control ticks (aera_power.h). Off by default: the clock ramping back up
+// adds to every command's wake-to-actuation time.
+#define POWER_SAVE              0
 
 // Tag for logging (looks professional in terminal)
 static const char *TAG = "BOTTOM_CONTROLLER";
+static QueueHandle_t s_uart_queue;
+
+// Wake-to-actuation latency: from the UART event waking the RX task to the
+// GPIO being driven. Only touched by the RX task.
+static struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} s_latency = { .min_us = UINT32_MAX };
+
+// Actuator state and when it was last driven, for the ACK. Only touched by
+// the RX task.
+static uint8_t s_led_state;
+static int64_t s_gpio_us;
+
+// Path counters for STATS, counted by the RX task; the reassembler keeps
+// the frame and CRC counts, link_out.h the bytes out
+static struct {
+    uint32_t uart_in;
+    uint32_t unknown;
+    uint32_t seq_gaps;
+    uint32_t overflows;
+} s_path;
+static bool s_sys_wanted;   // STATS came in: answer with SYS after the ACK
+static bool s_trace_wanted; // TRACE came in: answer with TRACE_DUMP after the ACK
+
+// Frame reassembler. Lives outside the task stack and keeps partial frames
+// between reads, so a command split across two reads is still picked up.
+static aera_link_rx_t s_link_rx;
+_Static_assert(RX_CHUNK_SIZE <= AERA_LINK_RX_MAX_PUSH, "RX chunk must fit in the reassembler");
+_Static_assert(AERA_OTA_WINDOW_CHUNKS * (AERA_LINK_OVERHEAD + AERA_OTA_DATA_PAYLOAD_LEN) < BUF_SIZE * 2,
+               "The UART RX buffer must hold a whole window of OTA_DATA");
 
 // --- INITIALIZATION FUNCTIONS ---
 
@@ -28,7 +101,28 @@ void init_led(void) {
     gpio_set_level(LED_PIN, 0);
 }
 
-void init_uart(void) {
+// Our address: AERA_LINK_ADDR_P2P unless strapped onto a bus
+static uint8_t read_node_addr(void) {
+    static const int addr_pins[] = ADDR_PINS;
+    _Static_assert(1 << (sizeof(addr_pins) / sizeof(addr_pins[0])) == AERA_BUS_MAX_NODES,
+                   "The ADDR pins must cover every bus address");
+
+    gpio_set_direction(BUS_PIN, GPIO_MODE_INPUT);
+    gpio_set_pull_mode(BUS_PIN, GPIO_PULLDOWN_ONLY);
+    if (!gpio_get_level(BUS_PIN)) {
+        return AERA_LINK_ADDR_P2P;
+    }
+
+    uint8_t addr = 0;
+    for (int i = 0; i < (int)(sizeof(addr_pins) / sizeof(addr_pins[0])); i++) {
+        gpio_set_direction(addr_pins[i], GPIO_MODE_INPUT);
+        gpio_set_pull_mode(addr_pins[i], GPIO_PULLDOWN_ONLY);
+        addr |= (uint8_t)(gpio_get_level(addr_pins[i]) << i);
+    }
+    return addr + 1;
+}
+
+void init_uart(uint8_t addr) {
     const uart_config_t uart_config = {
         .baud_rate = BAUD_RATE,
         .data_bits = UART_DATA_8_BITS,
@@ -42,57 +136,411 @@ void init_uart(void) {
     uart_param_config(UART_PORT_NUM, &uart_config);
 
     // 2. Set the pins (TX, RX, RTS, CTS)
-    // We don't use flow control (RTS/CTS), so we pass UART_PIN_NO_CHANGE
-    uart_set_pin(UART_PORT_NUM, TXD2_PIN, RXD2_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    // Flow control stays off until the link rate negotiation turns it on,
+    // and only if RTS/CTS are wired. On a bus RTS drives the transceiver
+    // instead, on only while we send.
+    if (addr == AERA_LINK_ADDR_P2P) {
+        uart_set_pin(UART_PORT_NUM, TXD2_PIN, RXD2_PIN, RTS2_PIN, CTS2_PIN);
+    } else {
+        uart_set_pin(UART_PORT_NUM, TXD2_PIN, RXD2_PIN, BUS_DE_PIN, UART_PIN_NO_CHANGE);
+    }
 
     // 3. Install the driver
-    // We need an RX buffer (BUF_SIZE * 2), but no TX buffer is strictly needed here.
-    // 0 = queue size (we don't use event queue here), NULL = no queue handle, 0 = interrupt alloc flags
-    uart_driver_install(UART_PORT_NUM, BUF_SIZE * 2, 0, 0, NULL, 0);
-    
+    // We need an RX buffer (BUF_SIZE * 2), and a TX buffer so sending an ACK
+    // never stalls the RX task while the bytes shift out.
+    // The event queue lets the RX task sleep until the driver has data for it.
+    uart_driver_install(UART_PORT_NUM, BUF_SIZE * 2, BUF_SIZE, UART_EVENT_QUEUE_LEN, &s_uart_queue, 0);
+
+    // 4. Tune when the driver wakes us up
+    // Frames are binary and any byte can show up in a payload, so there is no
+    // safe delimiter for pattern detection. Line-idle (RX timeout) is the
+    // natural end-of-frame marker instead.
+    uart_set_rx_timeout(UART_PORT_NUM, UART_RX_TIMEOUT_SYMBOLS);
+    uart_set_rx_full_threshold(UART_PORT_NUM, UART_RX_FULL_THRESHOLD);
+    if (addr != AERA_LINK_ADDR_P2P) {
+        uart_set_mode(UART_PORT_NUM, UART_MODE_RS485_HALF_DUPLEX);
+    }
+
     ESP_LOGI(TAG, "UART initialized on pins RX:%d TX:%d", RXD2_PIN, TXD2_PIN);
+    AERA_DLOG(BUS_ADDR, addr);
+}
+
+// --- LATENCY STATS ---
+
+static void record_actuation(int64_t wake_us) {
+    s_gpio_us = esp_timer_get_time();
+    uint32_t dt = (uint32_t)(s_gpio_us - wake_us);
+
+    s_latency.count++;
+    s_latency.total_us += dt;
+    if (dt < s_latency.min_us) s_latency.min_us = dt;
+    if (dt > s_latency.max_us) s_latency.max_us = dt;
+
+    if (s_latency.count % LATENCY_REPORT_EVERY == 0) {
+        AERA_DLOG(GPIO_LATENCY, s_latency.count, s_latency.min_us, s_latency.total_us / s_latency.count,
+                  s_latency.max_us);
+    }
+}
+
+// --- COMMAND HANDLING ---
+
+// One handler per entry in the shared registry (aera_cmd.h). ctx is the time
+// the RX task woke up, for the latency stats.
+// Handlers only drive outputs or post setpoints to the control loop's
+// mailbox. The ACK and the log line come after, so neither the console nor
+// the reply sits between the wire and the GPIO.
+#define AERA_CMD_CTX int64_t
+AERA_CMD_DEFINE_DISPATCH(dispatch_command)
+
+// ON/OFF start and stop a drying cycle; the LED shows it was asked for
+static void cmd_LED_ON(int64_t wake_us, const aera_frame_t *frame) {
+    gpio_set_level(LED_PIN, 1);
+    s_led_state = 1;
+    record_actuation(wake_us);
+    control_request_run(true);
+}
+
+static void cmd_LED_OFF(int64_t wake_us, const aera_frame_t *frame) {
+    gpio_set_level(LED_PIN, 0);
+    s_led_state = 0;
+    record_actuation(wake_us);
+    control_request_run(false);
+}
+
+static void cmd_DRY_TEMP(int64_t wake_us, const aera_frame_t *frame) {
+    control_set_target(frame->payload[0]);
+}
+
+static void cmd_DRY_TIME(int64_t wake_us, const aera_frame_t *frame) {
+    control_set_dry_minutes((uint16_t)(frame->payload[0] << 8 | frame->payload[1]));
+}
+
+// The top controller applies it first, then passes it on
+static void cmd_LOG(int64_t wake_us, const aera_frame_t *frame) {
+    uint8_t arg = frame->payload[0];
+    aera_dlog_set((esp_log_level_t)(arg & AERA_DLOG_ARG_LEVEL), (arg & AERA_DLOG_ARG_RAW) != 0);
+}
+
+// The SYS frames go out after the ACK, so they don't hold it up
+static void cmd_STATS(int64_t wake_us, const aera_frame_t *frame) {
+    s_sys_wanted = true;
+}
+
+// Our ring goes out after the ACK, like the SYS frames
+static void cmd_TRACE(int64_t wake_us, const aera_frame_t *frame) {
+    s_trace_wanted = true;
+}
+
+// Only here to be ACKed: its tracepoints give the top controller a clock
+// offset sample while nothing else is going on
+static void cmd_SYNC(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+// Firmware updates (ota_update.h). OTA_DATA isn't ACKed: the OTA_STATUS
+// that answers it does that job.
+static void cmd_OTA_BEGIN(int64_t wake_us, const aera_frame_t *frame) {
+    ota_update_begin(frame);
+}
+
+static void cmd_OTA_DATA(int64_t wake_us, const aera_frame_t *frame) {
+    ota_update_data(frame);
+}
+
+static void cmd_OTA_END(int64_t wake_us, const aera_frame_t *frame) {
+    ota_update_end(frame);
+}
+
+// The link rate (link_rate.h). LINK_BAUD is carried out after its ACK;
+// LINK_PROBE is echoed instead of ACKed.
+static void cmd_LINK_BAUD(int64_t wake_us, const aera_frame_t *frame) {
+    link_rate_on_baud(frame);
+}
+
+static void cmd_LINK_PROBE(int64_t wake_us, const aera_frame_t *frame) {
+    link_rate_on_probe(frame);
+}
+
+// Our turn on the bus (link_out.h): everything queued for the top
+// controller, the ACKs for what came before this in the same turn included.
+// The BUS_REPLY does for an ACK.
+static void cmd_BUS_POLL(int64_t wake_us, const aera_frame_t *frame) {
+    link_out_turn(frame);
+}
+
+// PING, LATENCY, BOOT and POWER are answered by the top controller itself
+// and are not forwarded today; they are still ACKed if they ever are.
+static void cmd_PING(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+static void cmd_LATENCY(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+static void cmd_BOOT(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+static void cmd_POWER(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+static void cmd_BUS(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+// Subscriptions are kept by the top controller; we always stream
+static void cmd_TELEM(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+// We only ever send these
+static void cmd_ACK(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+static void cmd_TELEMETRY(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+static void cmd_SYS(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+static void cmd_TRACE_DUMP(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+static void cmd_OTA_STATUS(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+static void cmd_BUS_REPLY(int64_t wake_us, const aera_frame_t *frame) {
+}
+
+static void put_u16_sat(uint8_t *p, int64_t us) {
+    uint16_t v = us < 0 ? 0 : (us > 0xFFFF ? 0xFFFF : (uint16_t)us);
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)(v & 0xFF);
+}
+
+static void send_ack(const aera_frame_t *frame, int64_t wake_us) {
+    uint8_t payload[AERA_ACK_PAYLOAD_LEN];
+    uint8_t buf[AERA_LINK_OVERHEAD + AERA_ACK_PAYLOAD_LEN];
+
+    payload[0] = frame->opcode;
+    payload[1] = s_led_state;
+    put_u16_sat(&payload[2], s_gpio_us ? s_gpio_us - wake_us : 0);
+    put_u16_sat(&payload[4], esp_timer_get_time() - wake_us);
+
+    size_t len = aera_cmd_encode_ACK(buf, sizeof(buf), link_out_addr(), frame->seq, payload);
+    AERA_TRACE(B_ACK, frame->seq, frame->opcode, esp_timer_get_time());
+    link_out_write(buf, len);
+}
+
+// --- STATS ---
+
+// One SYS summary, then one SYS frame per task (aera_sys.h)
+static void send_sys_stats(void) {
+    static aera_task_stats_t tasks[AERA_STATS_MAX_TASKS];
+    uint8_t payload[AERA_SYS_PAYLOAD_LEN];
+    uint8_t buf[AERA_LINK_OVERHEAD + AERA_SYS_PAYLOAD_LEN];
+
+    int count = aera_stats_tasks(tasks, AERA_STATS_MAX_TASKS);
+    aera_heap_stats_t heap;
+    aera_stats_heap(&heap);
+
+    aera_sys_summary_t sum = {
+        .heap_free = heap.free,
+        .heap_min = heap.min_free,
+        .heap_largest = heap.largest,
+        .uart_in = s_path.uart_in,
+        .uart_out = link_out_bytes_sent(),
+        .frames_in = s_link_rx.frames,
+        .unknown = (uint16_t)s_path.unknown,
+        .seq_gaps = (uint16_t)s_path.seq_gaps,
+        .crc_errors = (uint16_t)s_link_rx.crc_errors,
+        .overflows = (uint16_t)s_path.overflows,
+        .tasks = (uint8_t)count,
+    };
+    aera_sys_pack_summary(payload, &sum);
+    size_t len = aera_cmd_encode_SYS(buf, sizeof(buf), link_out_addr(), 0, payload);
+    link_out_write(buf, len);
+
+    for (int i = 0; i < count; i++) {
+        aera_sys_task_t t = {
+            .index = (uint8_t)i,
+            .cpu_permille = tasks[i].cpu_permille,
+            .stack_free = tasks[i].stack_free > UINT16_MAX ? UINT16_MAX : (uint16_t)tasks[i].stack_free,
+            .prio = tasks[i].prio,
+        };
+        memcpy(t.name, tasks[i].name, AERA_SYS_NAME_LEN); // Longer names are cut; t.name stays terminated
+        aera_sys_pack_task(payload, &t);
+        len = aera_cmd_encode_SYS(buf, sizeof(buf), link_out_addr(), (uint8_t)(i + 1), payload);
+        link_out_write(buf, len);
+    }
+}
+
+// --- TRACE ---
+
+// The whole ring in TRACE_DUMP frames (aera_trace.h). At 115200 baud a full
+// one keeps this task writing for ~190 ms, or on a bus takes ten turns; it's
+// a debugging aid.
+static void send_trace_dump(void) {
+    static aera_trace_event_t events[AERA_TRACE_LEN];
+    uint8_t payload[AERA_TRACE_DUMP_PAYLOAD_LEN];
+    uint8_t buf[AERA_LINK_OVERHEAD + AERA_TRACE_DUMP_PAYLOAD_LEN];
+
+    int count = aera_trace_snapshot(events, AERA_TRACE_LEN);
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    int parts = count == 0 ? 1 : (count + AERA_TRACE_DUMP_EVENTS - 1) / AERA_TRACE_DUMP_EVENTS;
+
+    for (int i = 0; i < parts; i++) {
+        int first = i * AERA_TRACE_DUMP_EVENTS;
+        int n = count - first < AERA_TRACE_DUMP_EVENTS ? count - first : AERA_TRACE_DUMP_EVENTS;
+        aera_trace_pack_dump(payload, (uint8_t)i, (uint8_t)parts, now, &events[first], n);
+        size_t len = aera_cmd_encode_TRACE_DUMP(buf, sizeof(buf), link_out_addr(), (uint8_t)i, payload);
+        link_out_write(buf, len);
+    }
+}
+
+// OTA_DATA is acknowledged by OTA_STATUS, LINK_PROBE by its echo and
+// BUS_POLL by BUS_REPLY; everything else gets an ACK
+static bool frame_acked(uint8_t opcode) {
+    return opcode != AERA_OP_OTA_DATA && opcode != AERA_OP_LINK_PROBE && opcode != AERA_OP_BUS_POLL;
+}
+
+// --- RESENDS ---
+// The top controller resends a frame with the same sequence number when our
+// ACK was lost, and with AERA_LINK_MAX_INFLIGHT of them outstanding, newer
+// frames can have arrived in between. The last that many ACKed frames are
+// remembered so a resend of any of them is ACKed again but not run twice.
+// Only the listener touches these.
+static struct {
+    uint8_t seq;
+    uint8_t opcode;
+    bool used;
+} s_recent[AERA_LINK_MAX_INFLIGHT];
+static unsigned s_recent_next;
+
+static bool recent_seen(const aera_frame_t *frame) {
+    for (int i = 0; i < AERA_LINK_MAX_INFLIGHT; i++) {
+        if (s_recent[i].used && s_recent[i].seq == frame->seq && s_recent[i].opcode == frame->opcode) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void recent_add(const aera_frame_t *frame) {
+    unsigned i = s_recent_next++ % AERA_LINK_MAX_INFLIGHT;
+    s_recent[i].seq = frame->seq;
+    s_recent[i].opcode = frame->opcode;
+    s_recent[i].used = true;
+}
+
+static void handle_frame(const aera_frame_t *frame, int64_t wake_us) {
+    s_gpio_us = 0;
+    if (!dispatch_command(wake_us, frame)) {
+        s_path.unknown++;
+        AERA_DLOG(CMD_UNKNOWN, frame->opcode, frame->len, frame->seq);
+        return;
+    }
+    if (s_gpio_us != 0) {
+        AERA_TRACE(B_GPIO, frame->seq, frame->opcode, s_gpio_us);
+    }
+    if (!frame_acked(frame->opcode)) {
+        return;
+    }
+    send_ack(frame, wake_us);
+    recent_add(frame);
+    link_rate_after_ack();
+    AERA_DLOG(CMD_RX, AERA_DLOG_STR(aera_cmd_by_opcode(frame->opcode)->name, 12), frame->seq);
+    if (s_sys_wanted) {
+        s_sys_wanted = false;
+        send_sys_stats();
+    }
+    if (s_trace_wanted) {
+        s_trace_wanted = false;
+        send_trace_dump();
+    }
 }
 
 // --- TASK: THE LISTENER ---
 
 void uart_rx_task(void *arg) {
-    // Allocate a buffer on the heap for incoming data
-    uint8_t *data = (uint8_t *) malloc(BUF_SIZE);
+    // Read chunk. Kept at or below AERA_LINK_RX_MAX_PUSH so every read fits
+    // in the reassembler after it has been drained.
+    uint8_t *data = (uint8_t *) malloc(RX_CHUNK_SIZE);
+    int expected_seq = -1;
+    uart_event_t event;
 
+    aera_link_rx_init(&s_link_rx);
     ESP_LOGI(TAG, "Task started. Waiting for commands...");
 
     while (1) {
-        // Read data from the UART
-        // This blocks for up to 100ms (portTICK_PERIOD_MS) waiting for data
-        int len = uart_read_bytes(UART_PORT_NUM, data, BUF_SIZE - 1, 20 / portTICK_PERIOD_MS);
-
-        // If we received bytes
-        if (len > 0) {
-            // Null-terminate the data to make it a valid C-string
-            data[len] = '\0';
-
-            // Remove newline/carriage return characters (Manual "trim")
-            // This modifies the 'data' buffer directly.
-            char *pos;
-            if ((pos = strchr((char *)data, '\n')) != NULL) *pos = '\0';
-            if ((pos = strchr((char *)data, '\r')) != NULL) *pos = '\0';
-
-            // LOGIC: Compare strings
-            if (strcmp((char *)data, "turn_ON_led") == 0) {
-                ESP_LOGI(TAG, "Command Received: LED ON");
-                gpio_set_level(LED_PIN, 1);
-            } 
-            else if (strcmp((char *)data, "turn_OFF_led") == 0) {
-                ESP_LOGI(TAG, "Command Received: LED OFF");
-                gpio_set_level(LED_PIN, 0);
+        // Sleep until the driver has something for us. No polling while
+        // idle, only the link rate's deadlines while it is above the base.
+        if (xQueueReceive(s_uart_queue, &event, link_rate_wait()) != pdTRUE) {
+            link_rate_poll(esp_timer_get_time(), s_link_rx.frames, s_link_rx.crc_errors);
+            continue;
+        }
+        int64_t wake_us = esp_timer_get_time();
+
+        switch (event.type) {
+            case UART_DATA:
+                break;
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                // We fell behind. Whatever is buffered is already torn, so
+                // start clean and let the reassembler resync on the next frame.
+                AERA_DLOG(UART_OVERFLOW, event.type);
+                s_path.overflows++;
+                uart_flush_input(UART_PORT_NUM);
+                xQueueReset(s_uart_queue);
+                aera_link_rx_flush(&s_link_rx);
+                continue;
+            default:
+                AERA_DLOG(UART_EVENT, event.type);
+                continue;
+        }
+
+        // Read exactly what the event announced; it is already buffered
+        aera_power_acquire(AERA_POWER_LINK);
+        size_t pending = event.size;
+        while (pending > 0) {
+            int want = pending > RX_CHUNK_SIZE ? RX_CHUNK_SIZE : (int)pending;
+            int len = uart_read_bytes(UART_PORT_NUM, data, want, 0);
+            if (len <= 0) {
+                break;
             }
-            else {
-                // If len > 1 just to avoid printing empty noises
-                if(strlen((char*)data) > 0) {
-                    ESP_LOGW(TAG, "Unknown Command: %s", data);
+            pending -= len;
+            s_path.uart_in += len;
+
+            aera_link_rx_push(&s_link_rx, data, len);
+
+            // Pull out every complete frame. Whatever is left is the start of
+            // the next frame and waits for the next event.
+            aera_frame_t frame;
+            while (aera_link_rx_next(&s_link_rx, &frame)) {
+                // On a bus, most of what goes by is for the other nodes
+                if (frame.addr != link_out_addr()) {
+                    continue;
                 }
+
+                // This task is the trace ring's only writer (aera_trace.h)
+                AERA_TRACE(B_RX, frame.seq, frame.opcode, wake_us);
+                AERA_TRACE(B_PARSED, frame.seq, frame.opcode, esp_timer_get_time());
+
+                // The top controller got this far, so this image works: keep it
+                ota_update_confirm_boot();
+
+                // A resend whose ACK was lost: just ACK it again (RESENDS)
+                if (recent_seen(&frame)) {
+                    s_gpio_us = 0;
+                    send_ack(&frame, wake_us);
+                    continue;
+                }
+                if (expected_seq >= 0 && frame.seq != (uint8_t)expected_seq) {
+                    s_path.seq_gaps++;
+                    AERA_DLOG(SEQ_GAP, expected_seq, frame.seq);
+                }
+                expected_seq = (uint8_t)(frame.seq + 1);
+
+                handle_frame(&frame, wake_us);
             }
         }
+        link_rate_poll(esp_timer_get_time(), s_link_rx.frames, s_link_rx.crc_errors);
+        aera_power_release(AERA_POWER_LINK);
     }
     // (Optional) free(data) if you ever break the loop
     free(data);
@@ -103,10 +551,22 @@ void uart_rx_task(void *arg) {
 
 void app_main(void) {
     // 1. Initialize Hardware
+    aera_power_init(POWER_SAVE);
+    aera_dlog_init();
     init_led();
-    init_uart();
+    uint8_t addr = read_node_addr();
+    init_uart(addr);
+    link_out_init(UART_PORT_NUM, addr);
+
+    // 2. Start the drying loop and the telemetry it feeds. Before the
+    // listener, which is the only writer of the loop's setpoints.
+    telemetry_start();
+    control_start();
+    ota_update_start();
+    link_rate_init(UART_PORT_NUM, addr == AERA_LINK_ADDR_P2P && RTS2_PIN != UART_PIN_NO_CHANGE &&
+                                  CTS2_PIN != UART_PIN_NO_CHANGE);
 
-    // 2. Create the Task
-    // Stack size 4096 bytes, Priority 5 (standard)
-    xTaskCreate(uart_rx_task, "uart_rx_task", 4096, NULL, 5, NULL);
+    // 3. Create the Task
+    // Stack size 4096 bytes, Priority 5 (standard), off the control core
+    xTaskCreatePinnedToCore(uart_rx_task, "uart_rx_task", 4096, NULL, 5, NULL, UART_RX_TASK_CORE);
 }
\ No newline at end of file
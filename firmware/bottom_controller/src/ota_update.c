@@ -0,0 +1,371 @@
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_ota_ops.h"
+#include "aera_cmd.h"
+#include "aera_power.h"
+#include "link_out.h"
+#include "ota_update.h"
+
+// The most one chunk can unpack to: every byte half of a longest
+// back-reference, counting the half left over from the chunk before
+#define CHUNK_MAX_OUT   ((AERA_OTA_CHUNK + 1) / 2 * AERA_OTA_LZ_MAX_MATCH)
+
+_Static_assert(CHUNK_MAX_OUT <= OTA_BUF_SIZE, "A chunk must unpack into at most two buffers");
+
+static const char *TAG = "OTA_UPDATE";
+
+typedef enum {
+    JOB_BEGIN,
+    JOB_WRITE,
+    JOB_FINISH,
+} job_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t buf;                    // JOB_WRITE
+    uint8_t reboot;                 // JOB_FINISH
+    uint16_t len;                   // JOB_WRITE
+    uint32_t gen;                   // Session it belongs to
+    uint32_t offset;                // JOB_FINISH: stream length, for the status
+    const esp_partition_t *part;    // JOB_BEGIN
+} ota_job_t;
+
+static QueueHandle_t s_jobs;
+static SemaphoreHandle_t s_free;    // Given back by the writer for each buffer written
+static uint8_t s_buf[2][OTA_BUF_SIZE];
+static bool s_confirmed;
+
+// Written by both tasks
+static atomic_uint s_state;         // aera_ota_state_t
+static atomic_uint s_error;         // aera_ota_error_t, while FAILED
+static atomic_uint s_failed_gen;    // Session the writer gave up on; 0 if none
+static atomic_uint s_flash_error;   // And why
+
+// The session. Only touched by the UART RX task.
+static struct {
+    uint32_t gen;
+    aera_ota_header_t hdr;
+    uint32_t offset;        // Stream bytes taken
+    uint32_t crc;           // Of those
+    bool gap_reported;      // Chunks past offset are dropped quietly
+} s_sess;
+
+// The unpacker and the buffers it fills. Only touched by the UART RX task.
+static aera_ota_decoder_t s_dec;
+static struct {
+    uint8_t cur;            // Buffer being filled
+    uint16_t fill;
+    bool have_next;         // The other buffer is ours too
+} s_out;
+
+// --- STATUS ---
+
+static void send_status(uint8_t opcode, uint8_t state, uint8_t error, uint32_t offset) {
+    aera_ota_status_t st = { .opcode = opcode, .state = state, .error = error, .offset = offset };
+    uint8_t payload[AERA_OTA_STATUS_PAYLOAD_LEN];
+    uint8_t buf[AERA_LINK_OVERHEAD + AERA_OTA_STATUS_PAYLOAD_LEN];
+
+    aera_ota_pack_status(payload, &st);
+    size_t len = aera_cmd_encode_OTA_STATUS(buf, sizeof(buf), link_out_addr(), 0, payload);
+    link_out_write(buf, len);
+}
+
+static void reply(uint8_t opcode, aera_ota_error_t error) {
+    send_status(opcode, atomic_load(&s_state), error, s_sess.offset);
+}
+
+static void fail(uint8_t opcode, aera_ota_error_t error) {
+    atomic_store(&s_error, error);
+    atomic_store(&s_state, AERA_OTA_FAILED);
+    ESP_LOGW(TAG, "Update failed at %lu of %lu: %s", (unsigned long)s_sess.offset,
+             (unsigned long)s_sess.hdr.stream_len, aera_ota_error_name(error));
+    reply(opcode, error);
+}
+
+// Answer to anything but BEGIN outside a session
+static void refuse(uint8_t opcode) {
+    aera_ota_state_t state = atomic_load(&s_state);
+    reply(opcode, state == AERA_OTA_IDLE ? AERA_OTA_ERR_SESSION
+                  : state == AERA_OTA_FAILED ? atomic_load(&s_error) : AERA_OTA_ERR_NONE);
+}
+
+// --- UNPACKING ---
+
+// Hands the buffer being filled to the writer and moves on to the other one
+static void flush_buffer(void) {
+    ota_job_t job = { .type = JOB_WRITE, .buf = s_out.cur, .len = s_out.fill, .gen = s_sess.gen };
+    xQueueSend(s_jobs, &job, portMAX_DELAY);
+    if (!s_out.have_next) {
+        // Only from ota_update_end(): mid-stream have_room() took it
+        // already, as a chunk can't fill this buffer without it. This waits
+        // out at most the write before.
+        xSemaphoreTake(s_free, portMAX_DELAY);
+    }
+    s_out.have_next = false;
+    s_out.cur ^= 1;
+    s_out.fill = 0;
+}
+
+static void emit(uint8_t b, void *arg) {
+    s_buf[s_out.cur][s_out.fill++] = b;
+    if (s_out.fill == OTA_BUF_SIZE) {
+        flush_buffer();
+    }
+}
+
+// Whether the next chunk is sure to fit, in this buffer or this one and the
+// next. False means the writer is behind. Exactly filling this buffer
+// flushes it, so that needs the next one too.
+static bool have_room(void) {
+    size_t need = s_sess.hdr.format == AERA_OTA_STORED ? AERA_OTA_CHUNK : CHUNK_MAX_OUT;
+    if (OTA_BUF_SIZE - s_out.fill > need || s_out.have_next) {
+        return true;
+    }
+    s_out.have_next = xSemaphoreTake(s_free, 0) == pdTRUE;
+    return s_out.have_next;
+}
+
+// --- LINK FRAMES ---
+
+void ota_update_begin(const aera_frame_t *frame) {
+    aera_ota_header_t h;
+    aera_ota_unpack_begin(frame->payload, &h);
+    aera_ota_state_t state = atomic_load(&s_state);
+
+    if (state == AERA_OTA_FINISHING) {
+        reply(AERA_OP_OTA_BEGIN, AERA_OTA_ERR_NONE);
+        return;
+    }
+    // The same stream again: carry on from where it got to
+    if ((state == AERA_OTA_RECEIVING || state == AERA_OTA_DONE) && h.format == s_sess.hdr.format &&
+        h.image_len == s_sess.hdr.image_len && h.stream_len == s_sess.hdr.stream_len &&
+        h.stream_crc == s_sess.hdr.stream_crc) {
+        ESP_LOGI(TAG, "Resuming at %lu of %lu", (unsigned long)s_sess.offset, (unsigned long)h.stream_len);
+        s_sess.gap_reported = false;
+        reply(AERA_OP_OTA_BEGIN, AERA_OTA_ERR_NONE);
+        return;
+    }
+
+    // Anything else starts over. Buffers still queued for the old session
+    // are given back unwritten, and the writer drops its handle.
+    s_sess.gen++;
+    s_sess.hdr = h;
+    s_sess.offset = 0;
+    s_sess.crc = 0;
+    s_sess.gap_reported = false;
+    aera_ota_decode_init(&s_dec, &h);
+    s_out.fill = 0;
+    atomic_store(&s_state, AERA_OTA_RECEIVING);
+
+    const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+    if (h.format != AERA_OTA_STORED && h.format != AERA_OTA_LZSS) {
+        fail(AERA_OP_OTA_BEGIN, AERA_OTA_ERR_STREAM);
+        return;
+    }
+    if (part == NULL || h.image_len > part->size) {
+        fail(AERA_OP_OTA_BEGIN, part == NULL ? AERA_OTA_ERR_PARTITION : AERA_OTA_ERR_SIZE);
+        return;
+    }
+
+    ota_job_t job = { .type = JOB_BEGIN, .gen = s_sess.gen, .part = part };
+    xQueueSend(s_jobs, &job, portMAX_DELAY);
+    ESP_LOGI(TAG, "Update to %s: %lu byte image in %lu bytes", part->label,
+             (unsigned long)h.image_len, (unsigned long)h.stream_len);
+    reply(AERA_OP_OTA_BEGIN, AERA_OTA_ERR_NONE);
+}
+
+// Takes a chunk only at the offset it expects (aera_ota.h)
+void ota_update_data(const aera_frame_t *frame) {
+    aera_ota_chunk_t c;
+    if (atomic_load(&s_state) != AERA_OTA_RECEIVING) {
+        refuse(AERA_OP_OTA_DATA);
+        return;
+    }
+    if (atomic_load(&s_failed_gen) == s_sess.gen) {
+        fail(AERA_OP_OTA_DATA, atomic_load(&s_flash_error));
+        return;
+    }
+    if (!aera_ota_unpack_data(frame->payload, &c)) {
+        fail(AERA_OP_OTA_DATA, AERA_OTA_ERR_STREAM);
+        return;
+    }
+
+    if (c.offset != s_sess.offset) {
+        // Ahead: one was lost, and the rest of the window with it. Say so
+        // once; the top controller goes back. Behind: a resend we already
+        // have; say where we are.
+        if (c.offset < s_sess.offset) {
+            reply(AERA_OP_OTA_DATA, AERA_OTA_ERR_NONE);
+        } else if (!s_sess.gap_reported) {
+            s_sess.gap_reported = true;
+            reply(AERA_OP_OTA_DATA, AERA_OTA_ERR_GAP);
+        }
+        return;
+    }
+    if (c.len > s_sess.hdr.stream_len - c.offset) {
+        fail(AERA_OP_OTA_DATA, AERA_OTA_ERR_SIZE);
+        return;
+    }
+    if (!have_room()) {
+        // The rest of the window is in flight: drop it quietly too
+        s_sess.gap_reported = true;
+        reply(AERA_OP_OTA_DATA, AERA_OTA_ERR_BUSY);
+        return;
+    }
+
+    aera_ota_error_t err = aera_ota_decode(&s_dec, c.data, c.len, emit, NULL);
+    if (err != AERA_OTA_ERR_NONE) {
+        fail(AERA_OP_OTA_DATA, err);
+        return;
+    }
+    s_sess.crc = aera_crc32(s_sess.crc, c.data, c.len);
+    s_sess.offset += c.len;
+    s_sess.gap_reported = false;
+    reply(AERA_OP_OTA_DATA, AERA_OTA_ERR_NONE);
+}
+
+// Checks the stream, then leaves the rest to the writer, which answers
+void ota_update_end(const aera_frame_t *frame) {
+    ota_job_t job = { .type = JOB_FINISH, .reboot = frame->payload[0], .gen = s_sess.gen,
+                      .offset = s_sess.offset };
+    aera_ota_state_t state = atomic_load(&s_state);
+
+    if (state == AERA_OTA_DONE) {
+        xQueueSend(s_jobs, &job, portMAX_DELAY);
+        return;
+    }
+    if (state != AERA_OTA_RECEIVING) {
+        refuse(AERA_OP_OTA_END);
+        return;
+    }
+    if (atomic_load(&s_failed_gen) == s_sess.gen) {
+        fail(AERA_OP_OTA_END, atomic_load(&s_flash_error));
+        return;
+    }
+    if (s_sess.offset != s_sess.hdr.stream_len || s_dec.out != s_sess.hdr.image_len) {
+        fail(AERA_OP_OTA_END, AERA_OTA_ERR_SIZE);
+        return;
+    }
+    if (s_dec.half) {
+        fail(AERA_OP_OTA_END, AERA_OTA_ERR_STREAM);
+        return;
+    }
+    if (s_sess.crc != s_sess.hdr.stream_crc) {
+        fail(AERA_OP_OTA_END, AERA_OTA_ERR_CRC);
+        return;
+    }
+
+    if (s_out.fill > 0) {
+        flush_buffer();
+    }
+    atomic_store(&s_state, AERA_OTA_FINISHING);
+    xQueueSend(s_jobs, &job, portMAX_DELAY);
+}
+
+void ota_update_confirm_boot(void) {
+    if (s_confirmed) {
+        return;
+    }
+    s_confirmed = true;
+    if (esp_ota_mark_app_valid_cancel_rollback() != ESP_OK) {
+        ESP_LOGW(TAG, "Couldn't mark the running image valid");
+    }
+}
+
+// --- TASK: THE FLASH WRITER ---
+
+static void writer_fail(uint32_t gen, aera_ota_error_t error) {
+    atomic_store(&s_flash_error, error);
+    atomic_store(&s_failed_gen, gen);
+}
+
+static void ota_task(void *arg) {
+    esp_ota_handle_t handle = 0;
+    const esp_partition_t *part = NULL;
+    bool open = false;
+    uint32_t gen = 0;           // Session the handle is for
+    uint32_t done_gen = 0;      // Session whose image is now the boot slot
+    ota_job_t job;
+
+    while (1) {
+        xQueueReceive(s_jobs, &job, portMAX_DELAY);
+        aera_power_acquire(AERA_POWER_LINK);
+
+        switch (job.type) {
+            case JOB_BEGIN:
+                if (open) {
+                    esp_ota_abort(handle);
+                }
+                gen = job.gen;
+                part = job.part;
+                // Sequential writes: each sector is erased as it is reached,
+                // not the whole slot up front
+                open = esp_ota_begin(part, OTA_WITH_SEQUENTIAL_WRITES, &handle) == ESP_OK;
+                if (!open) {
+                    writer_fail(gen, AERA_OTA_ERR_PARTITION);
+                }
+                break;
+
+            case JOB_WRITE:
+                if (open && job.gen == gen && esp_ota_write(handle, s_buf[job.buf], job.len) != ESP_OK) {
+                    esp_ota_abort(handle);
+                    open = false;
+                    writer_fail(gen, AERA_OTA_ERR_FLASH);
+                }
+                xSemaphoreGive(s_free);
+                break;
+
+            case JOB_FINISH: {
+                aera_ota_error_t error = AERA_OTA_ERR_NONE;
+                if (job.gen == done_gen) {
+                    // Already done; only the answer was lost
+                } else if (!open || job.gen != gen) {
+                    error = atomic_load(&s_failed_gen) == job.gen ? atomic_load(&s_flash_error)
+                                                                  : AERA_OTA_ERR_SESSION;
+                } else {
+                    open = false;
+                    if (esp_ota_end(handle) != ESP_OK || esp_ota_set_boot_partition(part) != ESP_OK) {
+                        error = AERA_OTA_ERR_IMAGE;
+                    } else {
+                        done_gen = gen;
+                    }
+                }
+
+                unsigned finishing = AERA_OTA_FINISHING;
+                if (error != AERA_OTA_ERR_NONE) {
+                    atomic_store(&s_error, error);
+                }
+                atomic_compare_exchange_strong(&s_state, &finishing,
+                                               error == AERA_OTA_ERR_NONE ? AERA_OTA_DONE : AERA_OTA_FAILED);
+                send_status(AERA_OP_OTA_END, error == AERA_OTA_ERR_NONE ? AERA_OTA_DONE : AERA_OTA_FAILED,
+                            error, job.offset);
+
+                if (error != AERA_OTA_ERR_NONE) {
+                    ESP_LOGW(TAG, "Update not applied: %s", aera_ota_error_name(error));
+                } else if (job.reboot) {
+                    ESP_LOGI(TAG, "Update applied, restarting into %s", part->label);
+                    // On a bus the status waits for our next turn first
+                    link_out_drain(pdMS_TO_TICKS(OTA_REBOOT_DRAIN_MS));
+                    vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));
+                    esp_restart();
+                } else {
+                    ESP_LOGI(TAG, "Update applied; %s boots on the next reset", part->label);
+                }
+                break;
+            }
+        }
+        aera_power_release(AERA_POWER_LINK);
+    }
+}
+
+void ota_update_start(void) {
+    s_jobs = xQueueCreate(OTA_JOB_QUEUE_LEN, sizeof(ota_job_t));
+    // The listener holds the buffer it fills; this counts the other one
+    s_free = xSemaphoreCreateCounting(1, 1);
+    xTaskCreatePinnedToCore(ota_task, "ota_flash", OTA_TASK_STACK, NULL, OTA_TASK_PRIO, NULL, OTA_TASK_CORE);
+}
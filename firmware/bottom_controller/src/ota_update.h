@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include "aera_link.h"
+
+// --- FIRMWARE UPDATES ---
+//
+// Takes an .aota stream from the top controller (aera_ota.h) and writes the
+// image it unpacks to into the inactive OTA slot. The UART RX task unpacks
+// each chunk as it comes into one of two OTA_BUF_SIZE buffers; a writer task
+// on the same core takes full ones to flash, so a sector erase never holds
+// up the listener. While both buffers are taken, chunks are answered BUSY.
+//
+// After OTA_END the image is checked (stream length and CRC32 here, the
+// image's own SHA-256 in esp_ota_end()) and made the boot slot. The new
+// image boots pending verification: ota_update_confirm_boot() marks it good
+// once the link works, and if it never gets that far the bootloader rolls
+// back to the old one on the next reset.
+
+#define OTA_BUF_SIZE            4096    // One flash sector
+#define OTA_TASK_PRIO           3       // Below the listener and telemetry
+#define OTA_TASK_STACK          3072
+#define OTA_TASK_CORE           0
+#define OTA_JOB_QUEUE_LEN       8
+// Time for the status and the ACK to go out before OTA_END's reboot
+#define OTA_REBOOT_DELAY_MS     100
+// ... and on a bus, the longest to wait for the turn they go out in
+#define OTA_REBOOT_DRAIN_MS     1000
+
+void ota_update_start(void);
+
+// Handlers for the link frames; called from the UART RX task
+void ota_update_begin(const aera_frame_t *frame);
+void ota_update_data(const aera_frame_t *frame);
+void ota_update_end(const aera_frame_t *frame);
+
+// Marks the running image good, cancelling a pending rollback. Called from
+// the UART RX task on the first frame from the top controller.
+void ota_update_confirm_boot(void);
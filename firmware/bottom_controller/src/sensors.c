@@ -0,0 +1,123 @@
+#include <stdint.h>
+#include "driver/gpio.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sensors.h"
+
+static const char *TAG = "SENSORS";
+
+static const adc_channel_t s_adc_channel[] = {
+    [AERA_TELEM_TEMP] = ADC_CHANNEL_0,
+    [AERA_TELEM_HUMIDITY] = ADC_CHANNEL_3,
+    [AERA_TELEM_HEATER] = ADC_CHANNEL_6,
+};
+#define ADC_CHANNELS (sizeof(s_adc_channel) / sizeof(s_adc_channel[0]))
+
+static adc_oneshot_unit_handle_t s_adc;
+static adc_cali_handle_t s_cali; // NULL if the chip has no calibration eFuses
+
+// Written by the tach ISR only. Both are 32-bit, so the task reads them
+// without a lock.
+static volatile uint32_t s_tach_edges;
+static volatile uint32_t s_tach_period_us;
+static uint32_t s_tach_last_edge_us;
+
+// Task side: when the edge count last moved
+static uint32_t s_seen_edges;
+static int64_t s_seen_us;
+
+static void IRAM_ATTR tach_isr(void *arg) {
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    s_tach_period_us = now - s_tach_last_edge_us;
+    s_tach_last_edge_us = now;
+    s_tach_edges++;
+}
+
+void sensors_init(void) {
+    adc_oneshot_unit_init_cfg_t unit_cfg = {
+        .unit_id = ADC_UNIT_1,
+    };
+    ESP_ERROR_CHECK(adc_oneshot_new_unit(&unit_cfg, &s_adc));
+
+    // 12 dB attenuation: full scale is about 3.1 V
+    adc_oneshot_chan_cfg_t chan_cfg = {
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_12,
+    };
+    for (size_t i = 0; i < ADC_CHANNELS; i++) {
+        ESP_ERROR_CHECK(adc_oneshot_config_channel(s_adc, s_adc_channel[i], &chan_cfg));
+    }
+
+    adc_cali_line_fitting_config_t cali_cfg = {
+        .unit_id = ADC_UNIT_1,
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_12,
+    };
+    if (adc_cali_create_scheme_line_fitting(&cali_cfg, &s_cali) != ESP_OK) {
+        ESP_LOGW(TAG, "No ADC calibration, using nominal scale");
+        s_cali = NULL;
+    }
+
+    gpio_reset_pin(SENSORS_FAN_PIN);
+    gpio_set_direction(SENSORS_FAN_PIN, GPIO_MODE_INPUT);
+    gpio_set_pull_mode(SENSORS_FAN_PIN, GPIO_PULLUP_ONLY);
+    gpio_set_intr_type(SENSORS_FAN_PIN, GPIO_INTR_NEGEDGE);
+    gpio_install_isr_service(0);
+    gpio_isr_handler_add(SENSORS_FAN_PIN, tach_isr, NULL);
+
+    ESP_LOGI(TAG, "Sensors initialized (%u analog channels, tach on GPIO%d)",
+             (unsigned)ADC_CHANNELS, SENSORS_FAN_PIN);
+}
+
+static int read_mv(adc_channel_t channel) {
+    int sum = 0;
+    for (int i = 0; i < SENSORS_OVERSAMPLE; i++) {
+        int raw = 0;
+        adc_oneshot_read(s_adc, channel, &raw);
+        sum += raw;
+    }
+    int raw = sum / SENSORS_OVERSAMPLE;
+
+    int mv;
+    if (s_cali == NULL || adc_cali_raw_to_voltage(s_cali, raw, &mv) != ESP_OK) {
+        mv = raw * 3100 / 4095;
+    }
+    return mv;
+}
+
+static int16_t clamp16(int32_t v) {
+    return v < INT16_MIN ? INT16_MIN : (v > INT16_MAX ? INT16_MAX : (int16_t)v);
+}
+
+static int16_t read_fan_rpm(void) {
+    int64_t now = esp_timer_get_time();
+    uint32_t edges = s_tach_edges;
+    uint32_t period = s_tach_period_us;
+
+    if (edges != s_seen_edges) {
+        s_seen_edges = edges;
+        s_seen_us = now;
+    }
+    if (period == 0 || now - s_seen_us > SENSORS_FAN_STALL_MS * 1000) {
+        return 0;
+    }
+    return clamp16((int32_t)(60000000u / ((uint64_t)period * SENSORS_FAN_PULSES_REV)));
+}
+
+void sensors_read(aera_telem_sample_t *out) {
+    int temp_mv = read_mv(s_adc_channel[AERA_TELEM_TEMP]);
+    int rh_mv = read_mv(s_adc_channel[AERA_TELEM_HUMIDITY]);
+    int heater_mv = read_mv(s_adc_channel[AERA_TELEM_HEATER]);
+
+    int32_t rh = (int32_t)rh_mv * 10000 / 3000;
+    if (rh > 10000) rh = 10000;
+
+    out->ch[AERA_TELEM_TEMP] = clamp16((int32_t)temp_mv * 10);
+    out->ch[AERA_TELEM_HUMIDITY] = clamp16(rh);
+    out->ch[AERA_TELEM_HEATER] = clamp16((int32_t)heater_mv * 10);
+    out->ch[AERA_TELEM_FAN] = read_fan_rpm();
+}
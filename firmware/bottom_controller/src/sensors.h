@@ -0,0 +1,28 @@
+#pragma once
+
+#include "aera_telem.h"
+
+// --- SENSORS ---
+//
+// Analog front ends, all on ADC1 so they keep working if the radio is ever
+// turned on:
+//
+//   GPIO36 / ADC1_CH0   air temperature, LM35-style, 10 mV/degC
+//   GPIO39 / ADC1_CH3   relative humidity, linear 0-3000 mV = 0-100 %RH
+//   GPIO34 / ADC1_CH6   heater current, CT + rectifier, 100 mV/A
+//   GPIO27              fan tachometer, open collector, 2 pulses per rev
+//
+// Each analog channel is averaged over SENSORS_OVERSAMPLE conversions per
+// reading. Fan speed comes from the period between the last two tach edges,
+// so it is exact at any speed without a counting window.
+
+#define SENSORS_OVERSAMPLE      4
+#define SENSORS_FAN_PIN         27
+#define SENSORS_FAN_PULSES_REV  2
+// No tach edge for this long means the fan has stopped
+#define SENSORS_FAN_STALL_MS    500
+
+void sensors_init(void);
+
+// Takes one sample of every channel, in aera_telem.h units
+void sensors_read(aera_telem_sample_t *out);
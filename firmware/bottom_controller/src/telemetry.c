@@ -0,0 +1,105 @@
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "aera_cmd.h"
+#include "aera_power.h"
+#include "aera_dlog.h"
+#include "control.h"
+#include "link_out.h"
+#include "telemetry.h"
+
+#define CONTROL_LOG_EVERY   (TELEMETRY_CONTROL_LOG_S * 1000 / AERA_TELEM_PERIOD_MS)
+
+static const char *TAG = "TELEMETRY";
+static QueueHandle_t s_queue;
+static atomic_uint s_dropped;
+
+static void send_batch(const aera_telem_batch_t *batch, uint8_t seq) {
+    uint8_t buf[AERA_LINK_OVERHEAD + AERA_TELEM_PAYLOAD_LEN];
+    size_t len = aera_cmd_encode_TELEMETRY(buf, sizeof(buf), link_out_addr(), seq, batch->payload);
+    link_out_write(buf, len);
+}
+
+void telemetry_post(const aera_telem_sample_t *sample) {
+    if (xQueueSend(s_queue, sample, 0) != pdTRUE) {
+        atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+    }
+}
+
+static void log_control_stats(void) {
+    control_stats_t st;
+    control_get_stats(&st);
+    ESP_LOGI(TAG, "Control: %s, heater %u%%, %lu ticks, %lu missed, %lu overruns, "
+             "jitter avg %lu us max %lu us, step avg %lu us max %lu us",
+             control_phase_name(st.phase), st.heater_pct, (unsigned long)st.ticks,
+             (unsigned long)st.missed, (unsigned long)st.overruns,
+             (unsigned long)st.jitter_avg_us, (unsigned long)st.jitter_max_us,
+             (unsigned long)st.step_avg_us, (unsigned long)st.step_max_us);
+
+    aera_power_stats_t pw;
+    aera_power_get_stats(&pw);
+    ESP_LOGI(TAG, "Power: %u-%u MHz, at full speed %lu.%02lu%% of the time",
+             pw.min_mhz, pw.max_mhz, (unsigned long)(pw.busy_us * 100 / pw.up_us),
+             (unsigned long)(pw.busy_us * 10000 / pw.up_us % 100));
+}
+
+// --- TASK: THE SENDER ---
+
+static void telemetry_task(void *arg) {
+    aera_telem_batch_t batch;
+    aera_telem_sample_t sample;
+    uint16_t index = 0;
+    uint8_t seq = 0;
+    uint32_t early = 0;
+    unsigned dropped_seen = 0;
+    uint32_t since_log = 0;
+
+    aera_telem_batch_start(&batch, index);
+
+    while (1) {
+        xQueueReceive(s_queue, &sample, portMAX_DELAY);
+
+        // Dropped samples still take up their index, so the top controller
+        // sees the hole instead of time silently closing up
+        unsigned dropped = atomic_load_explicit(&s_dropped, memory_order_relaxed);
+        if (dropped != dropped_seen) {
+            if (batch.count > 0) {
+                send_batch(&batch, seq++);
+            }
+            index += (uint16_t)(dropped - dropped_seen);
+            dropped_seen = dropped;
+            aera_telem_batch_start(&batch, index);
+            AERA_DLOG(TM_DROPPED, dropped);
+        }
+
+        // Too big a jump for a delta: ship what we have and start over
+        if (!aera_telem_batch_add(&batch, &sample)) {
+            send_batch(&batch, seq++);
+            aera_telem_batch_start(&batch, index);
+            aera_telem_batch_add(&batch, &sample);
+            if (++early % 100 == 0) {
+                ESP_LOGI(TAG, "%lu batches closed early by a step change", (unsigned long)early);
+            }
+        }
+        index++;
+
+        if (batch.count == AERA_TELEM_BATCH) {
+            send_batch(&batch, seq++);
+            aera_telem_batch_start(&batch, index);
+        }
+
+        // The control loop can't afford the console; report for it
+        if (++since_log == CONTROL_LOG_EVERY) {
+            since_log = 0;
+            log_control_stats();
+        }
+    }
+}
+
+void telemetry_start(void) {
+    s_queue = xQueueCreate(TELEMETRY_QUEUE_LEN, sizeof(aera_telem_sample_t));
+    xTaskCreatePinnedToCore(telemetry_task, "telemetry_task", TELEMETRY_TASK_STACK, NULL,
+                            TELEMETRY_TASK_PRIO, NULL, TELEMETRY_TASK_CORE);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "aera_telem.h"
+
+// --- TELEMETRY ---
+//
+// Ships the control loop's sensor samples (one every AERA_TELEM_PERIOD_MS,
+// see control.h) to the top controller in delta-encoded batches
+// (aera_telem.h). The loop hands samples over through a queue and never
+// waits on it; encoding and sending happen here, on core 0 with the command
+// listener. Batches go out through link_out.h, which keeps the two tasks'
+// frames whole.
+
+#define TELEMETRY_TASK_PRIO     4
+#define TELEMETRY_TASK_STACK    3072
+#define TELEMETRY_TASK_CORE     0
+// Samples the loop can get ahead of us by before they are dropped
+#define TELEMETRY_QUEUE_LEN     (2 * AERA_TELEM_BATCH)
+// Log the control loop's timing this often
+#define TELEMETRY_CONTROL_LOG_S 60
+
+void telemetry_start(void);
+
+// Hands one sample over from the control loop. Never blocks; if the queue is
+// full the sample is dropped and the top controller sees a gap.
+void telemetry_post(const aera_telem_sample_t *sample);
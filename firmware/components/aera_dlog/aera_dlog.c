@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "aera_dlog.h"
+
+static const char *TAG = "DLOG";
+
+#define RING_MASK       (AERA_DLOG_RING_LEN - 1)
+
+typedef struct
+{
+    esp_log_level_t level;
+    const char *tag;
+    const char *fmt;
+} msg_t;
+
+static const msg_t s_msgs[AERA_DLOG_COUNT] = {
+#define AERA_DLOG_X(name, lvl, tag, nargs, fmt) [AERA_DLOG_##name] = {AERA_DLOG_LVL_##lvl, tag, fmt},
+    AERA_DLOG_MESSAGES(AERA_DLOG_X)
+#undef AERA_DLOG_X
+};
+
+// --- RINGS ---
+// One bounded multi-producer ring per core (Vyukov's): a writer claims a
+// position by moving head, fills the slot, then publishes it through the
+// slot's seq. Tasks on the same core can still preempt each other mid-write,
+// and a task can move cores between picking a ring and claiming a slot;
+// both are fine, the ring doesn't depend on who its writers are.
+//
+// seq == pos: free for the writer at pos. seq == pos + 1: written, for the
+// drain task. The drain task hands it back as pos + AERA_DLOG_RING_LEN.
+
+typedef struct
+{
+    atomic_uint seq;
+    uint16_t id;
+    uint8_t nargs;
+    int64_t us;
+    uint32_t args[AERA_DLOG_MAX_ARGS];
+} entry_t;
+
+typedef struct
+{
+    atomic_uint head;           // Next position a writer claims
+    atomic_uint tail;           // Next position the drain task reads
+    entry_t slots[AERA_DLOG_RING_LEN];
+} ring_t;
+
+atomic_uchar aera_dlog_threshold = ESP_LOG_NONE;
+
+static ring_t s_rings[portNUM_PROCESSORS];
+static atomic_bool s_raw;
+static atomic_uint s_written;
+static atomic_uint s_lost;
+static TaskHandle_t s_task;
+
+void aera_dlog_write(aera_dlog_id_t id, uint8_t nargs, const uint32_t *args)
+{
+    ring_t *r = &s_rings[xPortGetCoreID()];
+    entry_t *e;
+    unsigned pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    while (1)
+    {
+        e = &r->slots[pos & RING_MASK];
+        int diff = (int)(atomic_load_explicit(&e->seq, memory_order_acquire) - pos);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // Still holds an entry from a lap ago: full
+            atomic_fetch_add_explicit(&s_lost, 1, memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+        }
+    }
+
+    e->id = (uint16_t)id;
+    e->nargs = nargs;
+    e->us = esp_timer_get_time();
+    memcpy(e->args, args, nargs * sizeof(uint32_t));
+    atomic_store_explicit(&e->seq, pos + 1, memory_order_release);
+    atomic_fetch_add_explicit(&s_written, 1, memory_order_relaxed);
+
+    // Only the entry the drain task is waiting on wakes it; behind that it
+    // is already busy, or polling past an unfinished write
+    if (atomic_load_explicit(&r->tail, memory_order_acquire) == pos)
+        xTaskNotifyGive(s_task);
+}
+
+uint32_t aera_dlog_pack(const char *s, size_t off)
+{
+    for (size_t i = 0; i < off; i++)
+    {
+        if (s[i] == '\0')
+            return 0;
+    }
+    uint32_t v = 0;
+    for (int i = 0; i < 4 && s[off + i] != '\0'; i++)
+        v |= (uint32_t)(uint8_t)s[off + i] << (8 * i);
+    return v;
+}
+
+// --- FORMATTING ---
+// The message's format one conversion at a time, each with its own slot(s)
+
+static void format_entry(char *out, size_t size, const char *fmt, const uint32_t *args, unsigned nargs)
+{
+    size_t n = 0;
+    unsigned a = 0;
+
+    while (*fmt && n < size - 1)
+    {
+        if (*fmt != '%')
+        {
+            out[n++] = *fmt++;
+            continue;
+        }
+
+        char spec[12];
+        size_t k = 0;
+        spec[k++] = *fmt++;
+        while (*fmt && strchr("diuxXcs%", *fmt) == NULL && k < sizeof(spec) - 2)
+            spec[k++] = *fmt++;
+        if (*fmt == '\0')
+            break;
+        char conv = *fmt++;
+        spec[k++] = conv;
+        spec[k] = '\0';
+
+        uint32_t arg = a < nargs ? args[a] : 0;
+        int w;
+        if (conv == '%')
+        {
+            w = snprintf(out + n, size - n, "%%");
+        }
+        else if (conv == 's')
+        {
+            // "%.Ns": up to N characters from the next (N + 3) / 4 slots
+            const char *dot = strchr(spec, '.');
+            unsigned len = dot ? (unsigned)strtoul(dot + 1, NULL, 10) : 4;
+            char str[4 * AERA_DLOG_MAX_ARGS + 1];
+            if (len > sizeof(str) - 1)
+                len = sizeof(str) - 1;
+            unsigned i;
+            for (i = 0; i < len && a + i / 4 < nargs; i++)
+            {
+                str[i] = (char)(args[a + i / 4] >> (8 * (i % 4)));
+                if (str[i] == '\0')
+                    break;
+            }
+            str[i] = '\0';
+            a += (len + 3) / 4;
+            w = snprintf(out + n, size - n, spec, str);
+        }
+        else if (conv == 'd' || conv == 'i')
+        {
+            w = snprintf(out + n, size - n, spec, (int)(int32_t)arg);
+            a++;
+        }
+        else
+        {
+            w = snprintf(out + n, size - n, spec, (unsigned)arg);
+            a++;
+        }
+        if (w < 0)
+            break;
+        n += (size_t)w < size - n ? (size_t)w : size - n - 1;
+    }
+    out[n] = '\0';
+}
+
+static void emit(const entry_t *e)
+{
+    static const char letters[] = "NEWIDV";
+    const msg_t *m = &s_msgs[e->id];
+
+    if (atomic_load_explicit(&s_raw, memory_order_relaxed))
+    {
+        char line[AERA_DLOG_LINE_MAX];
+        int n = snprintf(line, sizeof(line), "#D %x %llx", e->id, (unsigned long long)e->us);
+        for (unsigned i = 0; i < e->nargs && n > 0 && (size_t)n < sizeof(line); i++)
+            n += snprintf(line + n, sizeof(line) - n, " %lx", (unsigned long)e->args[i]);
+        esp_log_write(m->level, m->tag, "%s\n", line);
+        return;
+    }
+
+    char text[AERA_DLOG_LINE_MAX];
+    format_entry(text, sizeof(text), m->fmt, e->args, e->nargs);
+    esp_log_write(m->level, m->tag, "%c (%lu) %s: %s\n", letters[m->level], (unsigned long)(e->us / 1000),
+                  m->tag, text);
+}
+
+// --- TASK: THE DRAIN ---
+
+static void dlog_task(void *arg)
+{
+    unsigned lost_seen = 0;
+
+    while (1)
+    {
+        // Oldest ready entry across the rings, until none is ready
+        while (1)
+        {
+            ring_t *best = NULL;
+            entry_t *be = NULL;
+            for (int c = 0; c < portNUM_PROCESSORS; c++)
+            {
+                ring_t *r = &s_rings[c];
+                unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+                entry_t *e = &r->slots[tail & RING_MASK];
+                if (atomic_load_explicit(&e->seq, memory_order_acquire) != tail + 1)
+                    continue;
+                if (be == NULL || e->us < be->us)
+                {
+                    best = r;
+                    be = e;
+                }
+            }
+            if (be == NULL)
+                break;
+
+            entry_t copy = *be;
+            unsigned tail = atomic_load_explicit(&best->tail, memory_order_relaxed);
+            atomic_store_explicit(&be->seq, tail + AERA_DLOG_RING_LEN, memory_order_release);
+            atomic_store_explicit(&best->tail, tail + 1, memory_order_release);
+            if (copy.id < AERA_DLOG_COUNT)
+                emit(&copy);
+        }
+
+        unsigned lost = atomic_load_explicit(&s_lost, memory_order_relaxed);
+        if (lost != lost_seen)
+        {
+            ESP_LOGW(TAG, "%u log entries lost (ring full)", lost - lost_seen);
+            lost_seen = lost;
+        }
+
+        // A claimed slot still being written: look again next tick.
+        // Otherwise sleep until a writer finds us waiting on its slot.
+        bool pending = false;
+        for (int c = 0; c < portNUM_PROCESSORS; c++)
+        {
+            if (atomic_load_explicit(&s_rings[c].head, memory_order_relaxed) !=
+                atomic_load_explicit(&s_rings[c].tail, memory_order_relaxed))
+                pending = true;
+        }
+        ulTaskNotifyTake(pdTRUE, pending ? 1 : portMAX_DELAY);
+    }
+}
+
+// --- CONTROL ---
+
+void aera_dlog_init(void)
+{
+    for (int c = 0; c < portNUM_PROCESSORS; c++)
+    {
+        for (unsigned i = 0; i < AERA_DLOG_RING_LEN; i++)
+            atomic_init(&s_rings[c].slots[i].seq, i);
+    }
+    xTaskCreate(dlog_task, "dlog_task", AERA_DLOG_TASK_STACK, NULL, AERA_DLOG_TASK_PRIO, &s_task);
+    atomic_store(&aera_dlog_threshold, esp_log_level_get("*"));
+}
+
+void aera_dlog_set(esp_log_level_t level, bool raw)
+{
+    if (level > ESP_LOG_VERBOSE)
+        level = ESP_LOG_VERBOSE;
+    esp_log_level_set("*", level);
+    atomic_store(&s_raw, raw);
+    atomic_store(&aera_dlog_threshold, level);
+    ESP_LOGI(TAG, "Level %d%s", level, raw ? ", raw" : "");
+}
+
+void aera_dlog_get_stats(aera_dlog_stats_t *out)
+{
+    out->level = atomic_load(&aera_dlog_threshold);
+    out->raw = atomic_load(&s_raw);
+    out->written = atomic_load_explicit(&s_written, memory_order_relaxed);
+    out->lost = atomic_load_explicit(&s_lost, memory_order_relaxed);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "aera_dlog_msgs.h"
+
+// --- DEFERRED LOGGING ---
+//
+// ESP_LOGx formats on the calling task and then waits for the console: at
+// 115200 baud a 60-character line holds the caller for about 5 ms. That is
+// fine at startup and not fine in a UART RX task, a WebSocket handler or a
+// 20 ms control tick.
+//
+// AERA_DLOG(NAME, args...) records the message id, a timestamp and up to
+// AERA_DLOG_MAX_ARGS 32-bit arguments into a ring for the core it runs on,
+// with no lock and no formatting: a couple of atomics and a copy. A
+// low-priority task drains the rings, merges them by timestamp and prints
+// each entry in the ESP_LOG format, stamped with when it was recorded, not
+// when it was printed. In raw mode it prints "#D <id> <us> <args>" in hex
+// instead and tools/dlog_decode.py formats on the host.
+//
+// A full ring drops the new entry and counts it; the drain task reports the
+// count when it changes. The messages themselves are in aera_dlog_msgs.h.
+//
+// Arguments are 32-bit integers. Strings are packed four characters to a
+// slot by AERA_DLOG_STR(s, n), which expands to the (n + 3) / 4 slots a
+// "%.<n>s" in the format takes.
+
+#define AERA_DLOG_MAX_ARGS      6
+#define AERA_DLOG_RING_LEN      64      // Entries per core, a power of two
+#define AERA_DLOG_TASK_PRIO     1
+#define AERA_DLOG_TASK_STACK    3072
+#define AERA_DLOG_LINE_MAX      160
+
+// The LOG command's argument: level in the low bits, plus the raw flag
+#define AERA_DLOG_ARG_LEVEL     0x0F
+#define AERA_DLOG_ARG_RAW       0x10
+
+_Static_assert((AERA_DLOG_RING_LEN & (AERA_DLOG_RING_LEN - 1)) == 0, "AERA_DLOG_RING_LEN must be a power of two");
+
+typedef enum
+{
+#define AERA_DLOG_X(name, lvl, tag, nargs, fmt) AERA_DLOG_##name,
+    AERA_DLOG_MESSAGES(AERA_DLOG_X)
+#undef AERA_DLOG_X
+    AERA_DLOG_COUNT,
+} aera_dlog_id_t;
+
+typedef struct
+{
+    esp_log_level_t level;
+    bool raw;
+    uint32_t written;           // Entries recorded since boot
+    uint32_t lost;              // Dropped on a full ring
+} aera_dlog_stats_t;
+
+// Records below this level cost one load and a compare
+extern atomic_uchar aera_dlog_threshold;
+
+// Call once from app_main, before the first AERA_DLOG. Starts at the
+// ESP_LOG default level; nothing is recorded before this.
+void aera_dlog_init(void);
+
+// Runtime switch, from any task. Sets the ESP_LOG level for every tag to
+// match, so the console shows the same things either way.
+void aera_dlog_set(esp_log_level_t level, bool raw);
+void aera_dlog_get_stats(aera_dlog_stats_t *out);
+
+// Use through AERA_DLOG(), which checks the level and the argument count
+void aera_dlog_write(aera_dlog_id_t id, uint8_t nargs, const uint32_t *args);
+
+// Characters [off, off + 4) of s, stopping at a NUL, first one lowest
+uint32_t aera_dlog_pack(const char *s, size_t off);
+
+// --- MACROS ---
+
+#define AERA_DLOG_LVL_E     ESP_LOG_ERROR
+#define AERA_DLOG_LVL_W     ESP_LOG_WARN
+#define AERA_DLOG_LVL_I     ESP_LOG_INFO
+#define AERA_DLOG_LVL_D     ESP_LOG_DEBUG
+#define AERA_DLOG_LVL_V     ESP_LOG_VERBOSE
+
+// Per-message constants for the call site
+#define AERA_DLOG_X(name, lvl, tag, nargs, fmt)                                                         \
+    enum { AERA_DLOG_LEVEL_##name = AERA_DLOG_LVL_##lvl, AERA_DLOG_NARGS_##name = nargs };             \
+    _Static_assert(nargs <= AERA_DLOG_MAX_ARGS, #name ": too many arguments");
+AERA_DLOG_MESSAGES(AERA_DLOG_X)
+#undef AERA_DLOG_X
+
+#define AERA_DLOG_COUNT_ARGS(...)   AERA_DLOG_COUNT_ARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define AERA_DLOG_COUNT_ARGS_(z, a, b, c, d, e, f, n, ...) n
+
+#define AERA_DLOG(name, ...)                                                                            \
+    do                                                                                                  \
+    {                                                                                                   \
+        _Static_assert(AERA_DLOG_COUNT_ARGS(__VA_ARGS__) == AERA_DLOG_NARGS_##name,                     \
+                       "AERA_DLOG(" #name "): argument count does not match aera_dlog_msgs.h");         \
+        if (AERA_DLOG_LEVEL_##name <= atomic_load_explicit(&aera_dlog_threshold, memory_order_relaxed)) \
+            aera_dlog_write(AERA_DLOG_##name, AERA_DLOG_NARGS_##name,                                   \
+                            (const uint32_t[AERA_DLOG_NARGS_##name + 1]){__VA_ARGS__});                 \
+    } while (0)
+
+// String arguments: AERA_DLOG_STR(s, 8) fills the two slots of a "%.8s"
+#define AERA_DLOG_STR(s, n)         AERA_DLOG_STR_##n(s)
+#define AERA_DLOG_STR_4(s)          aera_dlog_pack((s), 0)
+#define AERA_DLOG_STR_8(s)          aera_dlog_pack((s), 0), aera_dlog_pack((s), 4)
+#define AERA_DLOG_STR_12(s)         AERA_DLOG_STR_8(s), aera_dlog_pack((s), 8)
+#define AERA_DLOG_STR_16(s)         AERA_DLOG_STR_12(s), aera_dlog_pack((s), 12)
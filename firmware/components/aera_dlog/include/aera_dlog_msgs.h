@@ -0,0 +1,56 @@
+#pragma once
+
+// --- DEFERRED LOG MESSAGES ---
+//
+// Every message either firmware logs through AERA_DLOG(), in one list so
+// both boards and tools/dlog_decode.py agree on the ids (their position
+// here). Append new messages at the end; reordering changes the ids, and
+// dumps taken before then no longer decode.
+//
+// Columns: X(NAME, level E/W/I/D/V, "TAG", argument slots, "format").
+// Formats take %d %i %u %x %X %c with the usual flags and width, and %.Ns
+// for a string of at most N characters, which takes (N + 3) / 4 slots
+// (see AERA_DLOG_STR()). No more than AERA_DLOG_MAX_ARGS slots.
+
+#define AERA_DLOG_MESSAGES(X)                                                                           \
+    /* Top controller */                                                                                \
+    X(WS_RX,           D, "TOP_CONTROLLER", 5, "WS Received: %.16s (%u bytes)")                         \
+    X(WS_BAD_CMD,      W, "TOP_CONTROLLER", 5, "Unknown or malformed WS command: %.16s (%u bytes)")     \
+    X(WS_TOO_BIG,      W, "TOP_CONTROLLER", 2, "WS frame of %u bytes dropped (limit %u)")               \
+    X(TX_QUEUE_FULL,   W, "TOP_CONTROLLER", 1, "UART TX queue full, dropped op=0x%02X")                 \
+    X(LINK_UNEXPECTED, W, "TOP_CONTROLLER", 2, "Unexpected link frame: op=0x%02X len=%u")               \
+    X(TX_ACK_DROPPED,  W, "UART_TX",        1, "ACK queue full, dropped ACK for seq %u")                \
+    X(TX_BATCH,        D, "UART_TX",        2, "Wrote %u frame(s), %u bytes")                           \
+    X(TX_NO_ACK,       W, "UART_TX",        3, "No ACK for op=0x%02X seq=%u after %u tries")            \
+    X(RX_OVERFLOW,     W, "UART_RX",        1, "UART overflow (event %d), flushing")                    \
+    X(BCAST_FAILED,    W, "WS_BCAST",       2, "Send to fd %d failed (0x%x), closing it")               \
+    X(TM_MALFORMED,    W, "TELEMETRY",      1, "Malformed TELEMETRY frame (seq %u)")                    \
+    /* Bottom controller */                                                                             \
+    X(CMD_RX,          I, "BOTTOM_CONTROLLER", 4, "Command Received: %.12s (seq %u)")                   \
+    X(CMD_UNKNOWN,     W, "BOTTOM_CONTROLLER", 3, "Unknown Command: op=0x%02X len=%u seq=%u")           \
+    X(SEQ_GAP,         W, "BOTTOM_CONTROLLER", 2, "Sequence gap: expected %d, got %u")                  \
+    X(UART_OVERFLOW,   W, "BOTTOM_CONTROLLER", 1, "UART overflow (event %d), flushing")                 \
+    X(UART_EVENT,      W, "BOTTOM_CONTROLLER", 1, "UART event %d")                                      \
+    X(GPIO_LATENCY,    I, "BOTTOM_CONTROLLER", 4,                                                       \
+      "Wake->GPIO latency over %u cmds: min %u us, avg %u us, max %u us")                               \
+    X(PHASE,           I, "CONTROL",        6, "%.8s -> %.8s at %d.%u C")                               \
+    X(PREHEAT_FAILED,  W, "CONTROL",        1, "Preheat never reached %u C")                            \
+    X(TM_DROPPED,      W, "TELEMETRY",      1, "%u samples dropped so far")                             \
+    /* Top controller */                                                                                \
+    X(TX_OTA_STALLED,  W, "UART_TX",        1, "OTA stream stalled at offset %u")                       \
+    X(TX_RATE,         I, "UART_TX",        2, "Link at %u baud, flow control %u")                      \
+    X(TX_RATE_PROBE_FAILED, W, "UART_TX",   3, "%u baud failed: %u probes back, flow control %u")       \
+    X(TX_RATE_FALLBACK, W, "UART_TX",       3, "Dropping from %u baud: %u errors, %u silent windows")   \
+    /* Bottom controller */                                                                             \
+    X(LINK_RATE,       I, "LINK_RATE",      2, "Link at %u baud, flow control %u")                      \
+    X(LINK_RATE_REVERTED, W, "LINK_RATE",   2, "No COMMIT for %u baud, back to %u")                     \
+    X(LINK_RATE_FALLBACK, W, "LINK_RATE",   3, "Dropping from %u baud: %u CRC errors, %u ms silent")   \
+    /* Top controller */                                                                                \
+    X(TX_BUS_NODE_FOUND, I, "UART_TX",      1, "Bus node %u answered")                                  \
+    X(TX_BUS_NODE_LOST, W, "UART_TX",       2, "Bus node %u gone after %u missed polls")                \
+    /* Bottom controller */                                                                             \
+    X(BUS_ADDR,        I, "BOTTOM_CONTROLLER", 1, "Link address %u (0: point to point)")                \
+    X(BUS_OUTBOX_FULL, W, "LINK_OUT",       1, "Bus outbox full, %u frame(s) dropped")                  \
+    /* Top controller */                                                                                \
+    X(BCAST_REAPED,    I, "WS_BCAST",       2, "Closing fd %d, silent for %u s")                        \
+    X(UDP_BAD,         W, "UDP_CTRL",       2, "Dropped %u-byte datagram from %08x: bad format or MAC")
@@ -0,0 +1,66 @@
+#include <string.h>
+#include "aera_link.h"
+#include "aera_baud.h"
+
+_Static_assert(AERA_BAUD_PROBE_LEN <= AERA_LINK_MAX_PAYLOAD, "LINK_PROBE must fit in a link frame");
+_Static_assert(AERA_BAUD_SILENT_MS > 2 * AERA_BAUD_CHECK_MS, "A probe every window must keep the link from going silent");
+
+const uint32_t aera_baud_rates[AERA_BAUD_RUNGS] = AERA_BAUD_RATES;
+
+int aera_baud_rung(uint32_t rate)
+{
+    for (int i = 0; i < AERA_BAUD_RUNGS; i++)
+    {
+        if (aera_baud_rates[i] == rate)
+            return i;
+    }
+    return -1;
+}
+
+void aera_baud_pack(uint8_t payload[AERA_BAUD_PAYLOAD_LEN], const aera_baud_req_t *req)
+{
+    payload[0] = (uint8_t)(req->rate >> 24);
+    payload[1] = (uint8_t)(req->rate >> 16);
+    payload[2] = (uint8_t)(req->rate >> 8);
+    payload[3] = (uint8_t)req->rate;
+    payload[4] = req->flags;
+    payload[5] = req->phase;
+}
+
+void aera_baud_unpack(const uint8_t payload[AERA_BAUD_PAYLOAD_LEN], aera_baud_req_t *req)
+{
+    req->rate = (uint32_t)payload[0] << 24 | (uint32_t)payload[1] << 16 | (uint32_t)payload[2] << 8 | payload[3];
+    req->flags = payload[4];
+    req->phase = payload[5];
+}
+
+// --- PROBES ---
+// Each probe opens with the patterns a marginal line gets wrong first: the
+// most edges (0x55, 0xAA), the longest runs (0x00, 0xFF), and the frame
+// start byte. The rest is pseudo-random, different for every index.
+
+static const uint8_t s_head[] = {0x55, 0x55, 0xAA, 0xAA, 0x00, 0x00, 0xFF, 0xFF,
+                                 0xF0, 0x0F, AERA_LINK_SYNC, AERA_LINK_SYNC};
+
+void aera_baud_probe_fill(uint8_t payload[AERA_BAUD_PROBE_LEN], uint8_t index)
+{
+    uint8_t x = (uint8_t)(index * 29 + 1) | 1;
+
+    payload[0] = index;
+    memcpy(payload + 1, s_head, sizeof(s_head));
+    for (int i = 1 + sizeof(s_head); i < AERA_BAUD_PROBE_LEN; i++)
+    {
+        // xorshift8: never 0 from a non-zero seed
+        x ^= x << 3;
+        x ^= x >> 5;
+        x ^= x << 4;
+        payload[i] = x;
+    }
+}
+
+bool aera_baud_probe_check(const uint8_t payload[AERA_BAUD_PROBE_LEN])
+{
+    uint8_t want[AERA_BAUD_PROBE_LEN];
+    aera_baud_probe_fill(want, payload[0]);
+    return memcmp(want, payload, AERA_BAUD_PROBE_LEN) == 0;
+}
@@ -0,0 +1,19 @@
+#include "aera_link.h"
+#include "aera_bus.h"
+
+_Static_assert(AERA_BUS_SLOT_BYTES >= AERA_LINK_MAX_FRAME, "A turn must carry at least one full frame");
+_Static_assert(AERA_BUS_MAX_NODES < 0xFF, "Addresses must fit in the frame's ADDR byte");
+
+void aera_bus_pack_reply(uint8_t payload[AERA_BUS_REPLY_LEN], const aera_bus_reply_t *r)
+{
+    payload[0] = (uint8_t)(r->sent >> 8);
+    payload[1] = (uint8_t)r->sent;
+    payload[2] = (uint8_t)(r->backlog >> 8);
+    payload[3] = (uint8_t)r->backlog;
+}
+
+void aera_bus_unpack_reply(const uint8_t payload[AERA_BUS_REPLY_LEN], aera_bus_reply_t *r)
+{
+    r->sent = (uint16_t)(payload[0] << 8 | payload[1]);
+    r->backlog = (uint16_t)(payload[2] << 8 | payload[3]);
+}
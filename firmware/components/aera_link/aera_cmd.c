@@ -0,0 +1,84 @@
+#include <string.h>
+#include "aera_cmd.h"
+
+#define ALIAS_SLOTS 64 // Power of two, at least twice the command count
+#define ALIAS_MASK  (ALIAS_SLOTS - 1)
+
+// Registry position of each command, so the opcode switch can index s_cmds
+enum
+{
+#define AERA_CMD_INDEX(name, op, alias, plen) CMD_INDEX_##name,
+    AERA_COMMANDS(AERA_CMD_INDEX)
+#undef AERA_CMD_INDEX
+};
+
+static const aera_cmd_info_t s_cmds[] = {
+#define AERA_CMD_INFO(name, op, alias, plen) { (op), (plen), #name, alias },
+    AERA_COMMANDS(AERA_CMD_INFO)
+#undef AERA_CMD_INFO
+};
+
+#define CMD_COUNT (sizeof(s_cmds) / sizeof(s_cmds[0]))
+
+_Static_assert((ALIAS_SLOTS & ALIAS_MASK) == 0, "ALIAS_SLOTS must be a power of two");
+_Static_assert(CMD_COUNT * 2 <= ALIAS_SLOTS, "Grow ALIAS_SLOTS with the command set");
+
+// Open-addressed alias table. At half load or less a lookup is almost
+// always one probe, however many commands there are.
+static const aera_cmd_info_t *s_alias_table[ALIAS_SLOTS];
+
+// FNV-1a, 32-bit
+static uint32_t alias_hash(const char *text, size_t len)
+{
+    uint32_t h = 2166136261u;
+    while (len--)
+    {
+        h ^= (uint8_t)*text++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void aera_cmd_init(void)
+{
+    memset(s_alias_table, 0, sizeof(s_alias_table));
+
+    for (size_t i = 0; i < CMD_COUNT; i++)
+    {
+        if (s_cmds[i].alias == NULL)
+            continue;
+
+        uint32_t slot = alias_hash(s_cmds[i].alias, strlen(s_cmds[i].alias)) & ALIAS_MASK;
+        while (s_alias_table[slot] != NULL)
+            slot = (slot + 1) & ALIAS_MASK;
+        s_alias_table[slot] = &s_cmds[i];
+    }
+}
+
+const aera_cmd_info_t *aera_cmd_by_opcode(uint8_t opcode)
+{
+    switch (opcode)
+    {
+#define AERA_CMD_LOOKUP(name, op, alias, plen) \
+    case (op):                                 \
+        return &s_cmds[CMD_INDEX_##name];
+        AERA_COMMANDS(AERA_CMD_LOOKUP)
+#undef AERA_CMD_LOOKUP
+    default:
+        return NULL;
+    }
+}
+
+const aera_cmd_info_t *aera_cmd_by_alias(const char *text, size_t len)
+{
+    uint32_t slot = alias_hash(text, len) & ALIAS_MASK;
+
+    while (s_alias_table[slot] != NULL)
+    {
+        const aera_cmd_info_t *cmd = s_alias_table[slot];
+        if (strncmp(cmd->alias, text, len) == 0 && cmd->alias[len] == '\0')
+            return cmd;
+        slot = (slot + 1) & ALIAS_MASK;
+    }
+    return NULL;
+}
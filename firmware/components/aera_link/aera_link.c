@@ -0,0 +1,181 @@
+#include <string.h>
+#include "aera_link.h"
+
+// Nibble table for CRC-16/CCITT-FALSE (poly 0x1021). 32 bytes of table
+// instead of 512, and still only two lookups per byte.
+static const uint16_t crc16_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+static uint16_t crc16_update(uint16_t crc, const uint8_t *data, size_t len)
+{
+    while (len--)
+    {
+        uint8_t b = *data++;
+        crc = (uint16_t)((crc << 4) ^ crc16_nibble[(crc >> 12) ^ (b >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ crc16_nibble[(crc >> 12) ^ (b & 0x0F)]);
+    }
+    return crc;
+}
+
+uint16_t aera_crc16(const uint8_t *data, size_t len)
+{
+    return crc16_update(0xFFFF, data, len);
+}
+
+uint8_t *aera_link_begin(uint8_t *buf, uint8_t addr, uint8_t opcode, uint8_t seq)
+{
+    buf[0] = AERA_LINK_SYNC;
+    buf[1] = 0;
+    buf[2] = addr;
+    buf[3] = opcode;
+    buf[4] = seq;
+    return buf + AERA_LINK_HEADER_LEN;
+}
+
+size_t aera_link_finish(uint8_t *buf, uint8_t payload_len)
+{
+    if (payload_len > AERA_LINK_MAX_PAYLOAD)
+        return 0;
+
+    buf[1] = payload_len;
+    uint16_t crc = aera_crc16(buf + 1, AERA_LINK_HEADER_LEN - 1 + payload_len);
+    uint8_t *tail = buf + AERA_LINK_HEADER_LEN + payload_len;
+    tail[0] = (uint8_t)(crc >> 8);
+    tail[1] = (uint8_t)(crc & 0xFF);
+    return AERA_LINK_OVERHEAD + payload_len;
+}
+
+size_t aera_link_encode(uint8_t *buf, size_t cap, uint8_t addr, uint8_t opcode, uint8_t seq,
+                        const uint8_t *payload, uint8_t payload_len)
+{
+    if (payload_len > AERA_LINK_MAX_PAYLOAD || cap < (size_t)AERA_LINK_OVERHEAD + payload_len)
+        return 0;
+
+    uint8_t *body = aera_link_begin(buf, addr, opcode, seq);
+    if (payload_len > 0)
+        memcpy(body, payload, payload_len);
+    return aera_link_finish(buf, payload_len);
+}
+
+int aera_link_decode(const uint8_t *buf, size_t len, aera_frame_t *frame)
+{
+    if (len < 1)
+        return AERA_LINK_INCOMPLETE;
+    if (buf[0] != AERA_LINK_SYNC)
+        return AERA_LINK_ERR_SYNC;
+    if (len < 2)
+        return AERA_LINK_INCOMPLETE;
+
+    uint8_t payload_len = buf[1];
+    if (payload_len > AERA_LINK_MAX_PAYLOAD)
+        return AERA_LINK_ERR_LEN;
+
+    size_t frame_len = AERA_LINK_OVERHEAD + payload_len;
+    if (len < frame_len)
+        return AERA_LINK_INCOMPLETE;
+
+    const uint8_t *tail = buf + AERA_LINK_HEADER_LEN + payload_len;
+    uint16_t rx_crc = (uint16_t)((tail[0] << 8) | tail[1]);
+    if (aera_crc16(buf + 1, AERA_LINK_HEADER_LEN - 1 + payload_len) != rx_crc)
+        return AERA_LINK_ERR_CRC;
+
+    frame->len = payload_len;
+    frame->addr = buf[2];
+    frame->opcode = buf[3];
+    frame->seq = buf[4];
+    frame->payload = buf + AERA_LINK_HEADER_LEN;
+    return (int)frame_len;
+}
+
+// --- STREAMING REASSEMBLER ---
+
+#define RX_MASK (AERA_LINK_RX_RING - 1)
+
+_Static_assert((AERA_LINK_RX_RING & RX_MASK) == 0, "AERA_LINK_RX_RING must be a power of two");
+
+void aera_link_rx_init(aera_link_rx_t *rx)
+{
+    memset(rx, 0, sizeof(*rx));
+}
+
+void aera_link_rx_flush(aera_link_rx_t *rx)
+{
+    rx->tail = rx->head;
+}
+
+static inline uint16_t rx_used(const aera_link_rx_t *rx)
+{
+    return (uint16_t)(rx->head - rx->tail);
+}
+
+static inline uint8_t rx_peek(const aera_link_rx_t *rx, uint16_t offset)
+{
+    return rx->ring[(uint16_t)(rx->tail + offset) & RX_MASK];
+}
+
+size_t aera_link_rx_push(aera_link_rx_t *rx, const uint8_t *data, size_t len)
+{
+    size_t space = AERA_LINK_RX_RING - rx_used(rx);
+    if (len > space)
+    {
+        rx->overflow_bytes += len - space;
+        len = space;
+    }
+
+    // At most two memcpy's: up to the end of the ring, then from the start
+    uint16_t at = rx->head & RX_MASK;
+    size_t first = AERA_LINK_RX_RING - at;
+    if (first > len)
+        first = len;
+    memcpy(&rx->ring[at], data, first);
+    memcpy(&rx->ring[0], data + first, len - first);
+
+    rx->head = (uint16_t)(rx->head + len);
+    return len;
+}
+
+bool aera_link_rx_next(aera_link_rx_t *rx, aera_frame_t *frame)
+{
+    while (rx_used(rx) > 0)
+    {
+        if (rx_peek(rx, 0) != AERA_LINK_SYNC)
+        {
+            rx->tail++;
+            rx->skipped_bytes++;
+            continue;
+        }
+        if (rx_used(rx) < 2)
+            return false;
+
+        uint8_t payload_len = rx_peek(rx, 1);
+        if (payload_len > AERA_LINK_MAX_PAYLOAD)
+        {
+            // Not a real sync byte, skip it and hunt for the next one
+            rx->tail++;
+            rx->skipped_bytes++;
+            continue;
+        }
+
+        uint16_t frame_len = AERA_LINK_OVERHEAD + payload_len;
+        if (rx_used(rx) < frame_len)
+            return false;
+
+        for (uint16_t i = 0; i < frame_len; i++)
+            rx->frame[i] = rx_peek(rx, i);
+
+        if (aera_link_decode(rx->frame, frame_len, frame) < 0)
+        {
+            rx->crc_errors++;
+            rx->tail++;
+            rx->skipped_bytes++;
+            continue;
+        }
+
+        rx->tail = (uint16_t)(rx->tail + frame_len);
+        rx->frames++;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,175 @@
+#include <string.h>
+#include "aera_ota.h"
+#include "aera_be.h"
+
+_Static_assert(AERA_OTA_DATA_PAYLOAD_LEN <= 64, "OTA_DATA must fit in a link frame");
+_Static_assert(AERA_OTA_CHUNK <= 255, "a chunk's length must fit in a byte");
+_Static_assert(AERA_OTA_LZ_WINDOW == 1 << 12 && AERA_OTA_LZ_MAX_MATCH - AERA_OTA_LZ_MIN_MATCH == 15,
+               "back-references are 12 bits of distance and 4 of length");
+
+static const char *const s_error_names[AERA_OTA_ERR_COUNT] = {
+#define AERA_OTA_X(name, text) [AERA_OTA_ERR_##name] = text,
+    AERA_OTA_ERRORS(AERA_OTA_X)
+#undef AERA_OTA_X
+};
+
+// --- .AOTA FILES ---
+
+bool aera_ota_parse_header(const uint8_t buf[AERA_OTA_HEADER_LEN], aera_ota_header_t *out)
+{
+    if (memcmp(buf, AERA_OTA_MAGIC, 4) != 0)
+        return false;
+    out->format = buf[4];
+    out->image_len = get_u32(buf + 8);
+    out->stream_len = get_u32(buf + 12);
+    out->stream_crc = get_u32(buf + 16);
+    return out->format == AERA_OTA_STORED || out->format == AERA_OTA_LZSS;
+}
+
+// Half a byte at a time: 16 words of table instead of 256, and fast enough
+// to keep up with the link many times over
+uint32_t aera_crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+// --- UNPACKING ---
+
+#define WINDOW_MASK (AERA_OTA_LZ_WINDOW - 1)
+
+void aera_ota_decode_init(aera_ota_decoder_t *d, const aera_ota_header_t *h)
+{
+    d->hdr = *h;
+    d->out = 0;
+    d->items = 0;
+    d->half = false;
+}
+
+static void decode_emit(aera_ota_decoder_t *d, uint8_t b, aera_ota_emit_t emit, void *arg)
+{
+    d->window[d->out++ & WINDOW_MASK] = b;
+    emit(b, arg);
+}
+
+aera_ota_error_t aera_ota_decode(aera_ota_decoder_t *d, const uint8_t *p, size_t len, aera_ota_emit_t emit,
+                                 void *arg)
+{
+    uint32_t image_len = d->hdr.image_len;
+
+    if (d->hdr.format == AERA_OTA_STORED)
+    {
+        if (len > image_len - d->out)
+            return AERA_OTA_ERR_SIZE;
+        for (size_t i = 0; i < len; i++)
+            decode_emit(d, p[i], emit, arg);
+        return AERA_OTA_ERR_NONE;
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t b = p[i];
+        if (d->items == 0)
+        {
+            d->flags = b;
+            d->items = 8;
+            continue;
+        }
+        if (d->flags & 0x80)
+        {
+            if (d->out == image_len)
+                return AERA_OTA_ERR_SIZE;
+            decode_emit(d, b, emit, arg);
+        }
+        else if (!d->half)
+        {
+            d->high = b;
+            d->half = true;
+            continue;
+        }
+        else
+        {
+            uint32_t dist = ((uint32_t)d->high << 4 | b >> 4) + 1;
+            uint32_t n = (b & 0x0F) + AERA_OTA_LZ_MIN_MATCH;
+            d->half = false;
+            if (dist > d->out)
+                return AERA_OTA_ERR_STREAM;
+            if (n > image_len - d->out)
+                return AERA_OTA_ERR_SIZE;
+            while (n--)
+                decode_emit(d, d->window[(d->out - dist) & WINDOW_MASK], emit, arg);
+        }
+        d->flags <<= 1;
+        d->items--;
+    }
+    return AERA_OTA_ERR_NONE;
+}
+
+// --- LINK FRAMES ---
+
+const char *aera_ota_error_name(uint8_t error)
+{
+    return error < AERA_OTA_ERR_COUNT ? s_error_names[error] : "?";
+}
+
+void aera_ota_pack_begin(uint8_t payload[AERA_OTA_BEGIN_PAYLOAD_LEN], const aera_ota_header_t *h)
+{
+    memset(payload, 0, AERA_OTA_BEGIN_PAYLOAD_LEN);
+    payload[0] = h->format;
+    uint8_t *p = put_u32(payload + 4, h->image_len);
+    p = put_u32(p, h->stream_len);
+    put_u32(p, h->stream_crc);
+}
+
+void aera_ota_unpack_begin(const uint8_t payload[AERA_OTA_BEGIN_PAYLOAD_LEN], aera_ota_header_t *h)
+{
+    h->format = payload[0];
+    h->image_len = get_u32(payload + 4);
+    h->stream_len = get_u32(payload + 8);
+    h->stream_crc = get_u32(payload + 12);
+}
+
+void aera_ota_pack_data(uint8_t payload[AERA_OTA_DATA_PAYLOAD_LEN], uint32_t offset,
+                        const uint8_t *data, uint8_t len)
+{
+    uint8_t *p = put_u32(payload, offset);
+    *p++ = len;
+    memcpy(p, data, len);
+    memset(p + len, 0, AERA_OTA_CHUNK - len);
+}
+
+bool aera_ota_unpack_data(const uint8_t payload[AERA_OTA_DATA_PAYLOAD_LEN], aera_ota_chunk_t *out)
+{
+    out->offset = get_u32(payload);
+    out->len = payload[4];
+    out->data = payload + 5;
+    return out->len <= AERA_OTA_CHUNK;
+}
+
+void aera_ota_pack_status(uint8_t payload[AERA_OTA_STATUS_PAYLOAD_LEN], const aera_ota_status_t *s)
+{
+    payload[0] = s->opcode;
+    payload[1] = s->state;
+    payload[2] = s->error;
+    payload[3] = 0;
+    put_u32(payload + 4, s->offset);
+}
+
+void aera_ota_unpack_status(const uint8_t payload[AERA_OTA_STATUS_PAYLOAD_LEN], aera_ota_status_t *s)
+{
+    s->opcode = payload[0];
+    s->state = payload[1];
+    s->error = payload[2];
+    s->offset = get_u32(payload + 4);
+}
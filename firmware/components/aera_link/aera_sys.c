@@ -0,0 +1,66 @@
+#include <string.h>
+#include "aera_sys.h"
+#include "aera_be.h"
+
+_Static_assert(1 + 6 * 4 + 4 * 2 + 1 == AERA_SYS_PAYLOAD_LEN, "summary fills the payload");
+_Static_assert(1 + 1 + 2 + 2 + 1 + AERA_SYS_NAME_LEN <= AERA_SYS_PAYLOAD_LEN, "task record fits");
+
+void aera_sys_pack_summary(uint8_t payload[AERA_SYS_PAYLOAD_LEN], const aera_sys_summary_t *s)
+{
+    uint8_t *p = payload;
+    *p++ = AERA_SYS_SUMMARY;
+    p = put_u32(p, s->heap_free);
+    p = put_u32(p, s->heap_min);
+    p = put_u32(p, s->heap_largest);
+    p = put_u32(p, s->uart_in);
+    p = put_u32(p, s->uart_out);
+    p = put_u32(p, s->frames_in);
+    p = put_u16(p, s->unknown);
+    p = put_u16(p, s->seq_gaps);
+    p = put_u16(p, s->crc_errors);
+    p = put_u16(p, s->overflows);
+    *p = s->tasks;
+}
+
+void aera_sys_pack_task(uint8_t payload[AERA_SYS_PAYLOAD_LEN], const aera_sys_task_t *t)
+{
+    memset(payload, 0, AERA_SYS_PAYLOAD_LEN);
+    uint8_t *p = payload;
+    *p++ = AERA_SYS_TASK;
+    *p++ = t->index;
+    p = put_u16(p, t->cpu_permille);
+    p = put_u16(p, t->stack_free);
+    *p++ = t->prio;
+    memcpy(p, t->name, strnlen(t->name, AERA_SYS_NAME_LEN));
+}
+
+int aera_sys_unpack(const uint8_t payload[AERA_SYS_PAYLOAD_LEN], aera_sys_summary_t *s, aera_sys_task_t *t)
+{
+    const uint8_t *p = payload + 1;
+    switch (payload[0])
+    {
+    case AERA_SYS_SUMMARY:
+        s->heap_free = get_u32(p);
+        s->heap_min = get_u32(p + 4);
+        s->heap_largest = get_u32(p + 8);
+        s->uart_in = get_u32(p + 12);
+        s->uart_out = get_u32(p + 16);
+        s->frames_in = get_u32(p + 20);
+        s->unknown = get_u16(p + 24);
+        s->seq_gaps = get_u16(p + 26);
+        s->crc_errors = get_u16(p + 28);
+        s->overflows = get_u16(p + 30);
+        s->tasks = p[32];
+        return AERA_SYS_SUMMARY;
+    case AERA_SYS_TASK:
+        t->index = p[0];
+        t->cpu_permille = get_u16(p + 1);
+        t->stack_free = get_u16(p + 3);
+        t->prio = p[5];
+        memcpy(t->name, p + 6, AERA_SYS_NAME_LEN);
+        t->name[AERA_SYS_NAME_LEN] = '\0';
+        return AERA_SYS_TASK;
+    default:
+        return -1;
+    }
+}
@@ -0,0 +1,72 @@
+#include <string.h>
+#include "aera_telem.h"
+
+#define HDR_LEN     3
+#define BASE_LEN    (2 * AERA_TELEM_CHANNELS)
+
+_Static_assert(AERA_TELEM_BATCH >= 1 && AERA_TELEM_BATCH <= 255, "count is one byte");
+
+void aera_telem_batch_start(aera_telem_batch_t *b, uint16_t first_index)
+{
+    memset(b->payload, 0, sizeof(b->payload));
+    b->payload[0] = (uint8_t)(first_index >> 8);
+    b->payload[1] = (uint8_t)(first_index & 0xFF);
+    b->count = 0;
+}
+
+bool aera_telem_batch_add(aera_telem_batch_t *b, const aera_telem_sample_t *s)
+{
+    if (b->count == AERA_TELEM_BATCH)
+        return false;
+
+    if (b->count == 0)
+    {
+        uint8_t *p = b->payload + HDR_LEN;
+        for (int c = 0; c < AERA_TELEM_CHANNELS; c++)
+        {
+            p[2 * c] = (uint8_t)((uint16_t)s->ch[c] >> 8);
+            p[2 * c + 1] = (uint8_t)((uint16_t)s->ch[c] & 0xFF);
+        }
+    }
+    else
+    {
+        // Check every channel before writing any, so a refused sample leaves
+        // the batch as it was
+        int8_t d[AERA_TELEM_CHANNELS];
+        for (int c = 0; c < AERA_TELEM_CHANNELS; c++)
+        {
+            int32_t delta = (int32_t)s->ch[c] - b->last.ch[c];
+            if (delta < INT8_MIN || delta > INT8_MAX)
+                return false;
+            d[c] = (int8_t)delta;
+        }
+        memcpy(b->payload + HDR_LEN + BASE_LEN + (b->count - 1) * AERA_TELEM_CHANNELS, d, sizeof(d));
+    }
+
+    b->last = *s;
+    b->count++;
+    b->payload[2] = b->count;
+    return true;
+}
+
+uint8_t aera_telem_unpack(const uint8_t *payload, uint16_t *first_index,
+                          aera_telem_sample_t out[AERA_TELEM_BATCH])
+{
+    uint8_t count = payload[2];
+    if (count == 0 || count > AERA_TELEM_BATCH)
+        return 0;
+
+    *first_index = (uint16_t)((payload[0] << 8) | payload[1]);
+
+    const uint8_t *p = payload + HDR_LEN;
+    for (int c = 0; c < AERA_TELEM_CHANNELS; c++)
+        out[0].ch[c] = (int16_t)((p[2 * c] << 8) | p[2 * c + 1]);
+
+    const int8_t *d = (const int8_t *)(payload + HDR_LEN + BASE_LEN);
+    for (uint8_t i = 1; i < count; i++)
+    {
+        for (int c = 0; c < AERA_TELEM_CHANNELS; c++)
+            out[i].ch[c] = (int16_t)(out[i - 1].ch[c] + *d++);
+    }
+    return count;
+}
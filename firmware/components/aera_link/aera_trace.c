@@ -0,0 +1,107 @@
+#include <string.h>
+#include <stdatomic.h>
+#include "aera_trace.h"
+#include "aera_be.h"
+
+#define RING_MASK   (AERA_TRACE_LEN - 1)
+
+_Static_assert(AERA_TRACE_DUMP_PAYLOAD_LEN <= 64, "TRACE_DUMP must fit in a link frame");
+_Static_assert(AERA_TRACE_LEN / AERA_TRACE_DUMP_EVENTS <= 255, "a dump's part count must fit in a byte");
+
+static const char *const s_stage_names[AERA_TRACE_STAGE_COUNT] = {
+#define AERA_TRACE_X(name, text) [AERA_TRACE_##name] = text,
+    AERA_TRACE_STAGES(AERA_TRACE_X)
+#undef AERA_TRACE_X
+};
+
+// --- RING ---
+// One writer publishes each event by moving head past it. A reader copies
+// what is there and then drops whatever the writer may have overwritten in
+// the meantime, judging by where head got to.
+
+static aera_trace_event_t s_ring[AERA_TRACE_LEN];
+static atomic_uint s_head;
+
+void aera_trace_record(aera_trace_stage_t stage, uint8_t seq, uint8_t opcode, int64_t us)
+{
+    unsigned head = atomic_load_explicit(&s_head, memory_order_relaxed);
+    s_ring[head & RING_MASK] = (aera_trace_event_t){
+        .us = (uint32_t)us,
+        .stage = (uint8_t)stage,
+        .seq = seq,
+        .opcode = opcode,
+    };
+    atomic_store_explicit(&s_head, head + 1, memory_order_release);
+}
+
+int aera_trace_snapshot(aera_trace_event_t *out, int max)
+{
+    unsigned head = atomic_load_explicit(&s_head, memory_order_acquire);
+    unsigned first = head > AERA_TRACE_LEN ? head - AERA_TRACE_LEN : 0;
+    if (head - first > (unsigned)max)
+        first = head - (unsigned)max;
+
+    for (unsigned i = first; i != head; i++)
+        out[i - first] = s_ring[i & RING_MASK];
+
+    // The slot the writer is on now (head2) is the one after the last it
+    // finished; anything at or before head2 - LEN may be torn
+    unsigned head2 = atomic_load_explicit(&s_head, memory_order_acquire);
+    unsigned valid = head2 + 1 > AERA_TRACE_LEN ? head2 + 1 - AERA_TRACE_LEN : 0;
+    if (valid <= first)
+        return (int)(head - first);
+    if (valid >= head)
+        return 0;
+    memmove(out, out + (valid - first), (head - valid) * sizeof(*out));
+    return (int)(head - valid);
+}
+
+const char *aera_trace_stage_name(uint8_t stage)
+{
+    return stage < AERA_TRACE_STAGE_COUNT ? s_stage_names[stage] : "?";
+}
+
+// --- TRACE_DUMP FRAMES ---
+
+void aera_trace_pack_dump(uint8_t payload[AERA_TRACE_DUMP_PAYLOAD_LEN], uint8_t part, uint8_t parts,
+                          uint32_t now, const aera_trace_event_t *events, int count)
+{
+    memset(payload, 0, AERA_TRACE_DUMP_PAYLOAD_LEN);
+    if (count > AERA_TRACE_DUMP_EVENTS)
+        count = AERA_TRACE_DUMP_EVENTS;
+
+    uint8_t *p = payload;
+    *p++ = part;
+    *p++ = parts;
+    *p++ = (uint8_t)count;
+    *p++ = 0;
+    p = put_u32(p, now);
+    for (int i = 0; i < count; i++)
+    {
+        p = put_u32(p, events[i].us);
+        *p++ = events[i].stage;
+        *p++ = events[i].seq;
+        *p++ = events[i].opcode;
+    }
+}
+
+int aera_trace_unpack_dump(const uint8_t payload[AERA_TRACE_DUMP_PAYLOAD_LEN], uint8_t *part, uint8_t *parts,
+                           uint32_t *now, aera_trace_event_t *events)
+{
+    *part = payload[0];
+    *parts = payload[1];
+    int count = payload[2];
+    if (*part >= *parts || count > AERA_TRACE_DUMP_EVENTS)
+        return -1;
+    *now = get_u32(payload + 4);
+
+    const uint8_t *p = payload + 8;
+    for (int i = 0; i < count; i++, p += 7)
+    {
+        events[i].us = get_u32(p);
+        events[i].stage = p[4];
+        events[i].seq = p[5];
+        events[i].opcode = p[6];
+    }
+    return count;
+}
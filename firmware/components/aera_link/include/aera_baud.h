@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- AERA LINK RATE: NEGOTIATING THE UART SPEED ---
+//
+// Both boards come up at AERA_BAUD_BASE with flow control off, and that is
+// where they meet again whenever anything goes wrong. The top controller
+// then steps the link up the ladder one rate at a time (link_rate_tx.h):
+//
+//   1. LINK_BAUD TRY at the current rate, ACKed. Both sides switch once the
+//      ACK is out. The bottom controller goes back by itself unless a
+//      COMMIT comes within AERA_BAUD_TRY_MS.
+//   2. AERA_BAUD_PROBES LINK_PROBE frames at the new rate, a test pattern
+//      the bottom controller checks and echoes. All must come back intact.
+//   3. LINK_BAUD COMMIT at the new rate, ACKed. Any probe lost or damaged
+//      and the top controller goes back instead, and the rate is off the
+//      ladder until the next reset: the link settles on the fastest rate
+//      that passed.
+//
+// With RTS/CTS wired on both boards, each rate is first tried with flow
+// control on; if that fails, without.
+//
+// Above the base rate both sides keep count in AERA_BAUD_CHECK_MS windows
+// and drop back to AERA_BAUD_BASE after AERA_BAUD_MAX_ERRORS errors. The top
+// controller counts CRC errors, lost commands and lost probes; it sends a
+// probe every window, and asks the bottom controller to drop (LINK_BAUD
+// DROP) before it does. A lost command drops it at once, since that is
+// what a bottom controller restarting at the base rate looks like. The
+// bottom controller counts CRC errors, and drops by itself after
+// AERA_BAUD_SILENT_MS without a frame.
+//
+//   LINK_BAUD  top -> bottom: [rate u32][flags u8][phase u8], big-endian
+//   LINK_PROBE both ways:     [index u8][test pattern, AERA_BAUD_PROBE_LEN - 1]
+
+#define AERA_BAUD_BASE          115200
+#define AERA_BAUD_TRY_MS        250
+#define AERA_BAUD_CHECK_MS      2000
+#define AERA_BAUD_MAX_ERRORS    4
+#define AERA_BAUD_SILENT_MS     5000
+#define AERA_BAUD_PROBES        16
+#define AERA_BAUD_PAYLOAD_LEN   6
+#define AERA_BAUD_PROBE_LEN     60
+
+// Every rate divides the 80 MHz APB clock to within 1%, which the UART
+// keeps through frequency scaling (aera_power.h)
+#define AERA_BAUD_RATES { 115200, 230400, 460800, 921600, 1500000, 2000000, 2500000, 4000000, 5000000 }
+#define AERA_BAUD_RUNGS 9
+
+enum
+{
+    AERA_BAUD_TRY = 0,
+    AERA_BAUD_COMMIT = 1,
+    AERA_BAUD_DROP = 2,     // Back to AERA_BAUD_BASE, flow control off
+};
+
+#define AERA_BAUD_FLAG_FLOW     0x01    // RTS/CTS on
+
+typedef struct
+{
+    uint32_t rate;
+    uint8_t flags;
+    uint8_t phase;
+} aera_baud_req_t;
+
+extern const uint32_t aera_baud_rates[AERA_BAUD_RUNGS];
+
+// Index of rate on the ladder, or -1
+int aera_baud_rung(uint32_t rate);
+
+void aera_baud_pack(uint8_t payload[AERA_BAUD_PAYLOAD_LEN], const aera_baud_req_t *req);
+void aera_baud_unpack(const uint8_t payload[AERA_BAUD_PAYLOAD_LEN], aera_baud_req_t *req);
+
+// Probe index's test pattern, and whether a payload is one intact
+void aera_baud_probe_fill(uint8_t payload[AERA_BAUD_PROBE_LEN], uint8_t index);
+bool aera_baud_probe_check(const uint8_t payload[AERA_BAUD_PROBE_LEN]);
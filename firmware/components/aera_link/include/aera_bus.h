@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+// --- AERA BUS: ONE TOP CONTROLLER, MANY BOTTOM CONTROLLERS ---
+//
+// Instead of the point-to-point UART, up to AERA_BUS_MAX_NODES bottom
+// controllers can share one half-duplex RS-485 pair with the top controller.
+// Each reads its address, 1 .. AERA_BUS_MAX_NODES, from strap pins at boot
+// and only takes frames carrying it (aera_link.h). On the WebSocket a
+// command goes to a node as ALIAS[:<decimal>]@<address>, e.g. "TEMP:60@3";
+// without one it goes to AERA_BUS_DEFAULT_NODE.
+//
+// The top controller owns the bus, and a node only ever speaks when handed
+// it:
+//
+//   1. The top controller sends what it has for one node (commands,
+//      resends, OTA chunks) and ends with BUS_POLL.
+//   2. The node sends up to AERA_BUS_SLOT_BYTES of what it queued since its
+//      last turn (ACKs, TELEMETRY, SYS, ...), whole frames, oldest first,
+//      and ends with BUS_REPLY, which hands the bus back.
+//   3. No BUS_REPLY within both sides' time on the wire plus
+//      AERA_BUS_TURNAROUND_MS, and the top controller takes it back anyway.
+//
+// Who gets the next turn is up to the top controller (bus_sched.h): a node
+// with commands waiting, then one with a backlog, then each node every
+// AERA_BUS_POLL_MS so its telemetry keeps flowing. Addresses nobody answers
+// at are polled again every AERA_BUS_DISCOVER_MS, one at a time, and a node
+// that misses AERA_BUS_MAX_MISSES turns in a row counts as gone.
+//
+// The bus stays at AERA_BAUD_BASE: every node has to hear every frame to
+// know it isn't theirs, so the rate isn't any one node's to negotiate.
+//
+//   BUS_POLL   top -> node: no payload
+//   BUS_REPLY  node -> top: [bytes sent this turn u16][bytes still queued u16], big-endian
+
+#define AERA_BUS_MAX_NODES      16
+#define AERA_BUS_DEFAULT_NODE   1
+#define AERA_BUS_SLOT_BYTES     256
+#define AERA_BUS_TURNAROUND_MS  5
+#define AERA_BUS_POLL_MS        100
+#define AERA_BUS_DISCOVER_MS    1000
+#define AERA_BUS_MAX_MISSES     3
+#define AERA_BUS_REPLY_LEN      4
+
+typedef struct
+{
+    uint16_t sent;          // Before the BUS_REPLY, this turn
+    uint16_t backlog;       // Left for the next one
+} aera_bus_reply_t;
+
+void aera_bus_pack_reply(uint8_t payload[AERA_BUS_REPLY_LEN], const aera_bus_reply_t *r);
+void aera_bus_unpack_reply(const uint8_t payload[AERA_BUS_REPLY_LEN], aera_bus_reply_t *r);
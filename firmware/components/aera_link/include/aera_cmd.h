@@ -0,0 +1,182 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "aera_link.h"
+#include "aera_telem.h"
+#include "aera_sys.h"
+#include "aera_trace.h"
+#include "aera_ota.h"
+#include "aera_baud.h"
+#include "aera_bus.h"
+
+// --- AERA COMMAND REGISTRY ---
+//
+// The one list of commands both controllers understand. Everything else is
+// generated from it: the AERA_OP_* opcodes, the opcode -> info switch, the
+// text alias table the top controller uses for WebSocket commands, the
+// per-command encoders and each firmware's dispatcher.
+//
+// Columns: X(NAME, opcode, "text alias", payload bytes). Commands that only
+// ever travel over the inter-board link have a NULL alias. On the WebSocket a
+// command with a payload is written ALIAS:<decimal>, e.g. "TELEM:10"; the
+// number goes into the payload big-endian. With bottom controllers on a bus,
+// "@<address>" after that picks the one (aera_bus.h).
+//
+// Adding a command here without giving both firmwares a cmd_<NAME> handler
+// is a compile error, so the two sides can't drift apart.
+
+#define AERA_COMMANDS(X)                                \
+    X(LED_OFF,   0x01, "OFF",     0)                    \
+    X(LED_ON,    0x02, "ON",      0)                    \
+    X(PING,      0x03, "PING",    0)                    \
+    X(STATS,     0x04, "STATS",   0)                    \
+    X(LATENCY,   0x05, "LATENCY", 0)                    \
+    X(TELEM,     0x06, "TELEM",   1)                    \
+    X(DRY_TEMP,  0x07, "TEMP",    1)                    \
+    X(DRY_TIME,  0x08, "DRYTIME", 2)                    \
+    X(BOOT,      0x09, "BOOT",    0)                    \
+    X(POWER,     0x0A, "POWER",   0)                    \
+    X(LOG,       0x0B, "LOG",     1)                    \
+    X(TRACE,     0x0C, "TRACE",   0)                    \
+    X(SYNC,      0x0D, NULL,      0)                    \
+    X(OTA_BEGIN, 0x0E, NULL,      AERA_OTA_BEGIN_PAYLOAD_LEN) \
+    X(OTA_DATA,  0x0F, NULL,      AERA_OTA_DATA_PAYLOAD_LEN) \
+    X(OTA_END,   0x10, NULL,      AERA_OTA_END_PAYLOAD_LEN) \
+    X(LINK_BAUD, 0x11, NULL,      AERA_BAUD_PAYLOAD_LEN) \
+    X(LINK_PROBE, 0x12, NULL,     AERA_BAUD_PROBE_LEN) \
+    X(BUS,       0x13, "BUS",     0)                    \
+    X(BUS_POLL,  0x14, NULL,      0)                    \
+    X(ACK,       0x80, NULL,      AERA_ACK_PAYLOAD_LEN) \
+    X(TELEMETRY, 0x81, NULL,      AERA_TELEM_PAYLOAD_LEN) \
+    X(SYS,       0x82, NULL,      AERA_SYS_PAYLOAD_LEN) \
+    X(TRACE_DUMP, 0x83, NULL,     AERA_TRACE_DUMP_PAYLOAD_LEN) \
+    X(OTA_STATUS, 0x84, NULL,     AERA_OTA_STATUS_PAYLOAD_LEN) \
+    X(BUS_REPLY, 0x85, NULL,      AERA_BUS_REPLY_LEN)
+
+// --- ACK ---
+// The bottom controller answers every command it runs with an ACK whose
+// frame sequence number is the one being acknowledged. Payload:
+//
+//   [acked opcode][actuator state][wake->GPIO us, u16 BE][wake->ACK out us, u16 BE]
+//
+// Times are measured on the bottom board from the UART event that carried
+// the command, and saturate at 0xFFFF.
+#define AERA_ACK_PAYLOAD_LEN    6
+
+// --- TELEM / TELEMETRY ---
+// TELEM:<hz> subscribes a WebSocket client to the sensor stream at that rate
+// (0 unsubscribes); the top controller handles it alone. TELEMETRY frames
+// flow unprompted from the bottom controller and are never ACKed. Payload
+// layout in aera_telem.h.
+
+// --- STATS / SYS ---
+// STATS is answered by the top controller, which also forwards it: the
+// bottom controller ACKs it and then reports its own tasks, heap and link
+// counters in SYS frames (aera_sys.h), never ACKed.
+
+// --- TRACE / SYNC / TRACE_DUMP ---
+// TRACE dumps both boards' tracepoints (aera_trace.h). Like STATS it is
+// answered by the top controller and forwarded; the bottom controller ACKs
+// it and sends its ring back in TRACE_DUMP frames, never ACKed. SYNC goes
+// the other way on its own, does nothing and is ACKed: its timestamps keep
+// the boards' clock offset fresh while there is no other traffic.
+
+// --- OTA_BEGIN / OTA_DATA / OTA_END / OTA_STATUS ---
+// A bottom controller firmware update, relayed by the top controller from
+// an HTTP upload (aera_ota.h). BEGIN and END are ACKed like any command and
+// then answered by an OTA_STATUS; the stream's OTA_DATA chunks are answered
+// by OTA_STATUS alone.
+
+// --- LINK_BAUD / LINK_PROBE ---
+// The top controller moves the link to a faster UART rate and back
+// (aera_baud.h). LINK_BAUD is ACKed at the old rate and takes effect once
+// the ACK is out. LINK_PROBE travels both ways and is never ACKed: the
+// bottom controller checks it and sends it back with the same sequence
+// number.
+
+// --- BUS / BUS_POLL / BUS_REPLY ---
+// With the bottom controllers on a shared bus (aera_bus.h), BUS_POLL hands
+// a node the bus and its BUS_REPLY hands it back; neither is ACKed. BUS is
+// answered by the top controller alone, with how busy the bus is and how
+// each node is doing.
+
+// --- DRYING CYCLE ---
+// ON starts a drying cycle and OFF stops it (the LED follows, as before).
+// TEMP:<degC> and DRYTIME:<minutes> set the target for the next tick of the
+// bottom controller's control loop, which clamps them to its limits
+// (control.h). They are forwarded and ACKed like ON/OFF.
+
+// --- OPCODES ---
+enum
+{
+#define AERA_CMD_OPCODE(name, op, alias, plen) AERA_OP_##name = (op),
+    AERA_COMMANDS(AERA_CMD_OPCODE)
+#undef AERA_CMD_OPCODE
+};
+
+typedef struct
+{
+    uint8_t opcode;
+    uint8_t payload_len;
+    const char *name;
+    const char *alias;
+} aera_cmd_info_t;
+
+// Builds the alias hash table. Call once at boot, before the first lookup.
+void aera_cmd_init(void);
+
+// Both are constant time: a switch on the opcode, and a single hash probe
+// (rarely two) on the alias. NULL if the command is unknown.
+const aera_cmd_info_t *aera_cmd_by_opcode(uint8_t opcode);
+const aera_cmd_info_t *aera_cmd_by_alias(const char *text, size_t len);
+
+// --- ENCODERS ---
+// aera_cmd_encode_<NAME>(buf, cap, addr, seq, payload) with the payload
+// length fixed by the registry. Returns the frame length, or 0 if it doesn't
+// fit.
+#define AERA_CMD_ENCODER(name, op, alias, plen)                                        \
+    static inline size_t aera_cmd_encode_##name(uint8_t *buf, size_t cap, uint8_t addr,  \
+                                                uint8_t seq, const uint8_t *payload)     \
+    {                                                                                  \
+        return aera_link_encode(buf, cap, addr, (op), seq, payload, (plen));           \
+    }
+AERA_COMMANDS(AERA_CMD_ENCODER)
+#undef AERA_CMD_ENCODER
+
+// --- DISPATCHER ---
+//
+// Each firmware defines AERA_CMD_CTX (whatever its handlers need, e.g. the
+// httpd request) and then AERA_CMD_DEFINE_DISPATCH(fn), which defines
+//
+//   static bool fn(AERA_CMD_CTX ctx, const aera_frame_t *frame);
+//
+// It switches on the opcode and calls the firmware's
+//
+//   static void cmd_<NAME>(AERA_CMD_CTX ctx, const aera_frame_t *frame);
+//
+// It returns false, without calling anything, for an unknown opcode or a
+// payload of the wrong length.
+
+#define AERA_CMD_HANDLER_PROTO(name, op, alias, plen) \
+    static void cmd_##name(AERA_CMD_CTX ctx, const aera_frame_t *frame);
+
+#define AERA_CMD_CASE(name, op, alias, plen)    \
+    case (op):                                  \
+        if (frame->len != (plen))               \
+            return false;                       \
+        cmd_##name(ctx, frame);                 \
+        return true;
+
+#define AERA_CMD_DEFINE_DISPATCH(fn)                            \
+    AERA_COMMANDS(AERA_CMD_HANDLER_PROTO)                       \
+    static bool fn(AERA_CMD_CTX ctx, const aera_frame_t *frame) \
+    {                                                           \
+        switch (frame->opcode)                                  \
+        {                                                       \
+            AERA_COMMANDS(AERA_CMD_CASE)                        \
+        default:                                                \
+            return false;                                       \
+        }                                                       \
+    }
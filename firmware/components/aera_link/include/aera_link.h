@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// --- AERA LINK: BINARY FRAMES BETWEEN TOP AND BOTTOM CONTROLLER ---
+//
+// Wire layout (all single bytes unless noted):
+//
+//   [SYNC 0xA5][LEN][ADDR][OPCODE][SEQ][PAYLOAD x LEN][CRC16 hi][CRC16 lo]
+//
+// LEN counts payload bytes only. The CRC16 (CCITT-FALSE, init 0xFFFF) covers
+// LEN, ADDR, OPCODE, SEQ and the payload, so a corrupted length can never
+// make the decoder read past the frame. A bare command is 7 bytes on the
+// wire.
+//
+// ADDR is the bottom controller the frame is for or from. A point-to-point
+// link has just the one, at AERA_LINK_ADDR_P2P; on a bus (aera_bus.h) each
+// node has its own and ignores frames for the others.
+
+#define AERA_LINK_SYNC          0xA5
+#define AERA_LINK_ADDR_P2P      0
+#define AERA_LINK_HEADER_LEN    5
+#define AERA_LINK_CRC_LEN       2
+#define AERA_LINK_OVERHEAD      (AERA_LINK_HEADER_LEN + AERA_LINK_CRC_LEN)
+#define AERA_LINK_MAX_PAYLOAD   64
+#define AERA_LINK_MAX_FRAME     (AERA_LINK_OVERHEAD + AERA_LINK_MAX_PAYLOAD)
+// Frames the top controller keeps waiting for their ACK at once. A resend
+// of any of them can come in after newer frames.
+#define AERA_LINK_MAX_INFLIGHT  8
+
+// Opcodes live in the command registry, aera_cmd.h
+
+// Decoder results. Positive values are the number of bytes the frame used.
+#define AERA_LINK_INCOMPLETE    0
+#define AERA_LINK_ERR_SYNC      (-1)
+#define AERA_LINK_ERR_LEN       (-2)
+#define AERA_LINK_ERR_CRC       (-3)
+
+typedef struct
+{
+    uint8_t addr;
+    uint8_t opcode;
+    uint8_t seq;
+    uint8_t len;
+    const uint8_t *payload; // Points into the caller's buffer, not copied
+} aera_frame_t;
+
+uint16_t aera_crc16(const uint8_t *data, size_t len);
+
+// Zero-copy encode: aera_link_begin() writes the header and returns where the
+// payload goes, the caller fills it in place, aera_link_finish() seals it.
+// buf must hold at least AERA_LINK_MAX_FRAME bytes.
+uint8_t *aera_link_begin(uint8_t *buf, uint8_t addr, uint8_t opcode, uint8_t seq);
+size_t aera_link_finish(uint8_t *buf, uint8_t payload_len);
+
+// One-shot encode. Returns the frame length, or 0 if it does not fit in cap.
+size_t aera_link_encode(uint8_t *buf, size_t cap, uint8_t addr, uint8_t opcode, uint8_t seq,
+                        const uint8_t *payload, uint8_t payload_len);
+
+// Decode one frame from the start of buf. On success frame->payload points
+// into buf and the frame length is returned. On an error the caller should
+// drop one byte and try again to resync.
+int aera_link_decode(const uint8_t *buf, size_t len, aera_frame_t *frame);
+
+// --- STREAMING REASSEMBLER ---
+//
+// UART reads don't line up with frames: one read can carry several frames,
+// and one frame can straddle two reads. The reassembler keeps the unparsed
+// tail in a ring between reads so nothing is lost either way.
+//
+// Usage: push whatever the UART gave you, then call aera_link_rx_next()
+// until it returns false. As long as the ring is drained after every push,
+// at most AERA_LINK_MAX_FRAME - 1 bytes are carried over, so any single push
+// of up to AERA_LINK_RX_RING - AERA_LINK_MAX_FRAME bytes always fits.
+
+#define AERA_LINK_RX_RING       512 // Must be a power of two
+#define AERA_LINK_RX_MAX_PUSH   (AERA_LINK_RX_RING - AERA_LINK_MAX_FRAME)
+
+typedef struct
+{
+    uint8_t ring[AERA_LINK_RX_RING];
+    uint16_t head; // Free-running write index
+    uint16_t tail; // Free-running read index
+    uint8_t frame[AERA_LINK_MAX_FRAME]; // Current frame, linearised
+
+    // Counters (never reset)
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t skipped_bytes;
+    uint32_t overflow_bytes;
+} aera_link_rx_t;
+
+void aera_link_rx_init(aera_link_rx_t *rx);
+
+// Drops whatever is buffered, e.g. after the UART overflowed. Unlike
+// aera_link_rx_init() it keeps the counters.
+void aera_link_rx_flush(aera_link_rx_t *rx);
+
+// Returns how many bytes were accepted. Anything beyond the free space is
+// dropped and counted in overflow_bytes.
+size_t aera_link_rx_push(aera_link_rx_t *rx, const uint8_t *data, size_t len);
+
+// Pulls the next complete, CRC-valid frame. frame->payload points into rx
+// and stays valid until the next call.
+bool aera_link_rx_next(aera_link_rx_t *rx, aera_frame_t *frame);
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// --- AERA OTA: UPDATING THE BOTTOM CONTROLLER THROUGH THE TOP ONE ---
+//
+// tools/ota_pack.py turns a bottom_controller firmware.bin into an .aota
+// file, which is POSTed to the top controller (ota_relay.h). The top
+// controller streams it over the link a window at a time, never holding the
+// whole file, and the bottom controller unpacks it straight into its
+// inactive OTA slot (ota_update.h). File layout, integers big-endian:
+//
+//   [magic "AOTA"][format u8][0][0][0][image bytes u32][stream bytes u32]
+//   [stream CRC32 u32][stream x stream bytes]
+//
+// The stream is the image itself (AERA_OTA_STORED) or LZSS-packed
+// (AERA_OTA_LZSS): a flag byte, MSB first, then eight items, each either a
+// literal byte (flag 1) or a 2-byte back-reference (flag 0)
+//
+//   [distance - 1, high 8 of 12 bits][distance - 1, low 4 | length - 3, 4 bits]
+//
+// into the last AERA_OTA_LZ_WINDOW bytes of output. A 4 KB window keeps the
+// unpacker's RAM small and still comes within a few points of zlib on
+// machine code (~44% off, to its ~47%), which at 115200 baud is the
+// difference that matters. The CRC32 (as zlib's) covers
+// the stream; esp_ota_end() then checks the image's own SHA-256.
+
+#define AERA_OTA_MAGIC          "AOTA"
+#define AERA_OTA_HEADER_LEN     20
+#define AERA_OTA_LZ_WINDOW      4096
+#define AERA_OTA_LZ_MIN_MATCH   3
+#define AERA_OTA_LZ_MAX_MATCH   18
+
+enum
+{
+    AERA_OTA_STORED = 0,
+    AERA_OTA_LZSS = 1,
+};
+
+typedef struct
+{
+    uint8_t format;
+    uint32_t image_len;
+    uint32_t stream_len;
+    uint32_t stream_crc;
+} aera_ota_header_t;
+
+// False if it isn't an .aota header or the format is unknown
+bool aera_ota_parse_header(const uint8_t buf[AERA_OTA_HEADER_LEN], aera_ota_header_t *out);
+
+// Running CRC32, zlib's: start from 0
+uint32_t aera_crc32(uint32_t crc, const uint8_t *data, size_t len);
+
+// --- LINK PROTOCOL ---
+//
+// OTA_BEGIN  top -> bottom, ACKed, answered by OTA_STATUS
+//            [format u8][0][0][0][image bytes u32][stream bytes u32][stream CRC32 u32]
+// OTA_DATA   top -> bottom, never ACKed: answered by OTA_STATUS
+//            [stream offset u32][bytes used u8][AERA_OTA_CHUNK bytes of stream, zero-padded]
+// OTA_END    top -> bottom, ACKed, answered by OTA_STATUS once the image is
+//            checked and made the boot slot: [reboot after u8]
+// OTA_STATUS bottom -> top, never ACKed
+//            [opcode answered u8][state u8][error u8][0][stream offset u32]
+//
+// A BEGIN for the image the bottom controller is already receiving (same
+// stream length and CRC) resumes it: the status says from where. Any other
+// BEGIN starts over. The session lives in RAM, so a bottom controller reset
+// starts over too.
+//
+// OTA_DATA is go-back-N. Each chunk's frame has its own CRC16 like any link
+// frame; the bottom controller takes a chunk only at the offset it expects
+// and answers each with how far it got. The first chunk past a gap gets
+// AERA_OTA_ERR_GAP, so the top controller resends from the offset at once,
+// rather than on its timeout. AERA_OTA_ERR_BUSY means the flash writer is
+// behind: resend from the offset after a pause. At most
+// AERA_OTA_WINDOW_CHUNKS chunks are unanswered at a time, which the bottom
+// controller's UART buffer must hold.
+
+#define AERA_OTA_CHUNK              59
+#define AERA_OTA_WINDOW_CHUNKS      16
+#define AERA_OTA_BEGIN_PAYLOAD_LEN  16
+#define AERA_OTA_DATA_PAYLOAD_LEN   (5 + AERA_OTA_CHUNK)
+#define AERA_OTA_END_PAYLOAD_LEN    1
+#define AERA_OTA_STATUS_PAYLOAD_LEN 8
+
+typedef enum
+{
+    AERA_OTA_IDLE = 0,
+    AERA_OTA_RECEIVING,
+    AERA_OTA_FINISHING,     // OTA_END taken, image being checked
+    AERA_OTA_DONE,          // New image is the boot slot
+    AERA_OTA_FAILED,        // Until the next BEGIN
+} aera_ota_state_t;
+
+// Columns: X(NAME, "name in replies")
+#define AERA_OTA_ERRORS(X)                                                              \
+    X(NONE,      "none")                                                                \
+    X(GAP,       "gap")         /* OTA_DATA past the expected offset */                 \
+    X(BUSY,      "busy")        /* Flash writer behind; chunk not taken */              \
+    X(SESSION,   "no_session")  /* OTA_DATA/OTA_END without a matching BEGIN */         \
+    X(PARTITION, "partition")   /* No slot to write, or esp_ota_begin() failed */       \
+    X(STREAM,    "stream")      /* Stream doesn't unpack */                             \
+    X(SIZE,      "size")        /* Image or stream not the length announced */          \
+    X(CRC,       "crc")         /* Stream CRC32 mismatch */                             \
+    X(FLASH,     "flash")       /* esp_ota_write() failed */                            \
+    X(IMAGE,     "image")       /* esp_ota_end() refused it, or it can't be booted */
+
+typedef enum
+{
+#define AERA_OTA_X(name, text) AERA_OTA_ERR_##name,
+    AERA_OTA_ERRORS(AERA_OTA_X)
+#undef AERA_OTA_X
+    AERA_OTA_ERR_COUNT,
+} aera_ota_error_t;
+
+typedef struct
+{
+    uint8_t opcode;         // What it answers
+    uint8_t state;          // aera_ota_state_t
+    uint8_t error;          // aera_ota_error_t
+    uint32_t offset;        // Stream bytes taken so far
+} aera_ota_status_t;
+
+// --- UNPACKING ---
+// The stream, fed in as it arrives, any number of bytes at a time, comes out
+// of emit an image byte at a time. Image byte i is also
+// window[i % AERA_OTA_LZ_WINDOW], for the back-references.
+
+typedef void (*aera_ota_emit_t)(uint8_t b, void *arg);
+
+typedef struct
+{
+    aera_ota_header_t hdr;
+    uint32_t out;           // Image bytes so far
+    uint8_t flags;          // Flag bits left, MSB next
+    uint8_t items;          // Items left under the flag byte
+    bool half;              // First byte of a back-reference read
+    uint8_t high;           // That byte
+    uint8_t window[AERA_OTA_LZ_WINDOW];
+} aera_ota_decoder_t;
+
+void aera_ota_decode_init(aera_ota_decoder_t *d, const aera_ota_header_t *h);
+// AERA_OTA_ERR_STREAM or _SIZE as soon as the stream can't be the image the
+// header announced; the image is whole once out is its length and !half
+aera_ota_error_t aera_ota_decode(aera_ota_decoder_t *d, const uint8_t *p, size_t len, aera_ota_emit_t emit,
+                                 void *arg);
+
+typedef struct
+{
+    uint32_t offset;
+    uint8_t len;
+    const uint8_t *data;    // Points into the payload
+} aera_ota_chunk_t;
+
+const char *aera_ota_error_name(uint8_t error);
+
+void aera_ota_pack_begin(uint8_t payload[AERA_OTA_BEGIN_PAYLOAD_LEN], const aera_ota_header_t *h);
+void aera_ota_unpack_begin(const uint8_t payload[AERA_OTA_BEGIN_PAYLOAD_LEN], aera_ota_header_t *h);
+
+void aera_ota_pack_data(uint8_t payload[AERA_OTA_DATA_PAYLOAD_LEN], uint32_t offset,
+                        const uint8_t *data, uint8_t len);
+// False if the chunk claims more than AERA_OTA_CHUNK bytes
+bool aera_ota_unpack_data(const uint8_t payload[AERA_OTA_DATA_PAYLOAD_LEN], aera_ota_chunk_t *out);
+
+void aera_ota_pack_status(uint8_t payload[AERA_OTA_STATUS_PAYLOAD_LEN], const aera_ota_status_t *s);
+void aera_ota_unpack_status(const uint8_t payload[AERA_OTA_STATUS_PAYLOAD_LEN], aera_ota_status_t *s);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+// --- AERA SYSTEM STATS: BOTTOM -> TOP ---
+//
+// A STATS forwarded to the bottom controller is answered, after its ACK, by
+// one SYS summary frame and then one SYS frame per task. The summary says
+// how many task frames follow. Integers are big-endian; the payload is
+// fixed length like every registry entry, so task frames are zero-padded.
+//
+//   Summary: [0][heap free u32][heap min u32][largest free block u32]
+//            [UART bytes in u32][UART bytes out u32][frames in u32]
+//            [unknown commands u16][sequence gaps u16][CRC errors u16]
+//            [UART overflows u16][task frames u8]
+//   Task:    [1][index u8][CPU permille u16][stack never used, bytes u16]
+//            [priority u8][name, AERA_SYS_NAME_LEN bytes, NUL-padded]
+//
+// CPU is per mille of both cores since the previous STATS; counters are
+// since boot and wrap.
+
+#define AERA_SYS_NAME_LEN       15
+#define AERA_SYS_PAYLOAD_LEN    34
+
+enum
+{
+    AERA_SYS_SUMMARY = 0,
+    AERA_SYS_TASK = 1,
+};
+
+typedef struct
+{
+    uint32_t heap_free;
+    uint32_t heap_min;
+    uint32_t heap_largest;
+    uint32_t uart_in;
+    uint32_t uart_out;
+    uint32_t frames_in;
+    uint16_t unknown;
+    uint16_t seq_gaps;
+    uint16_t crc_errors;
+    uint16_t overflows;
+    uint8_t tasks;
+} aera_sys_summary_t;
+
+typedef struct
+{
+    uint8_t index;
+    uint16_t cpu_permille;
+    uint16_t stack_free;
+    uint8_t prio;
+    char name[AERA_SYS_NAME_LEN + 1];
+} aera_sys_task_t;
+
+void aera_sys_pack_summary(uint8_t payload[AERA_SYS_PAYLOAD_LEN], const aera_sys_summary_t *s);
+void aera_sys_pack_task(uint8_t payload[AERA_SYS_PAYLOAD_LEN], const aera_sys_task_t *t);
+
+// Fills whichever of *s or *t the frame carries and returns its kind
+// (AERA_SYS_SUMMARY or AERA_SYS_TASK), or -1 for anything else
+int aera_sys_unpack(const uint8_t payload[AERA_SYS_PAYLOAD_LEN], aera_sys_summary_t *s, aera_sys_task_t *t);
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- AERA TELEMETRY: BATCHED SENSOR SAMPLES, BOTTOM -> TOP ---
+//
+// The bottom controller samples every channel on a fixed cadence and packs
+// up to AERA_TELEM_BATCH samples into one TELEMETRY frame (aera_cmd.h).
+// One frame per sample would spend most of the line on headers and CRCs and
+// crowd out commands; batched, the stream is a few percent of 115200 baud.
+//
+// Payload (fixed length, so the link budget is fixed too):
+//
+//   [first sample index, u16 BE][count]
+//   [first sample: one i16 BE per channel]
+//   [(AERA_TELEM_BATCH - 1) x one i8 delta per channel]
+//
+// Each delta is against the previous sample. A sample whose delta doesn't
+// fit in an i8 closes the batch early and starts the next one, so the
+// encoding is lossless and a step change costs one short frame. Unused delta
+// slots are zero. The sample index counts every sample taken, so the
+// receiver can tell how many were lost with a dropped frame.
+
+#define AERA_TELEM_CHANNELS     4
+#define AERA_TELEM_BATCH        10
+#define AERA_TELEM_PERIOD_MS    20 // Sampling cadence, 50 Hz
+#define AERA_TELEM_PAYLOAD_LEN  (3 + 2 * AERA_TELEM_CHANNELS + (AERA_TELEM_BATCH - 1) * AERA_TELEM_CHANNELS)
+
+// Channel order and units
+enum
+{
+    AERA_TELEM_TEMP = 0,    // Air temperature, 0.01 degC
+    AERA_TELEM_HUMIDITY,    // Relative humidity, 0.01 %RH
+    AERA_TELEM_HEATER,      // Heater current, mA
+    AERA_TELEM_FAN,         // Fan speed, RPM
+};
+
+typedef struct
+{
+    int16_t ch[AERA_TELEM_CHANNELS];
+} aera_telem_sample_t;
+
+typedef struct
+{
+    uint8_t payload[AERA_TELEM_PAYLOAD_LEN];
+    aera_telem_sample_t last;
+    uint8_t count;
+} aera_telem_batch_t;
+
+// Starts an empty batch whose first sample will have this index
+void aera_telem_batch_start(aera_telem_batch_t *b, uint16_t first_index);
+
+// Appends a sample. Returns false, leaving the batch untouched, if it is
+// full or the sample can't be delta-encoded; send it and start the next
+// batch with this sample.
+bool aera_telem_batch_add(aera_telem_batch_t *b, const aera_telem_sample_t *s);
+
+// Unpacks a TELEMETRY payload into out[]. Returns the sample count, 0 if the
+// payload is malformed.
+uint8_t aera_telem_unpack(const uint8_t *payload, uint16_t *first_index,
+                          aera_telem_sample_t out[AERA_TELEM_BATCH]);
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+
+// --- AERA TRACE: WHERE A COMMAND'S TIME GOES, ON BOTH BOARDS ---
+//
+// Tracepoints stamp each stage of a forwarded command's life into a ring on
+// the board it happens on, keyed by the link sequence number and opcode so
+// the two boards' rings can be lined up afterwards. TRACE dumps both rings
+// over the WebSocket and tools/trace_report.py turns them into a per-stage
+// latency breakdown: Wi-Fi and httpd, the TX queue, the wire, the bottom
+// board's wake-up and handling, and the way back.
+//
+// Times are esp_timer microseconds, not CPU cycles: the cycle counter is per
+// core and runs at whatever speed power management picked (aera_power.h),
+// and two boards' cycle counts can't be compared anyway. Events keep the low
+// 32 bits, which wrap every ~71 minutes; a dump carries the board's time at
+// the dump so the host can unwrap them.
+//
+// Each board's ring has a single writer: the UART TX task on the top
+// controller, the UART RX task on the bottom one. Reading a snapshot is
+// safe from any task.
+//
+// --- CLOCK OFFSET ---
+// uart_tx, b_rx, b_ack and ack_rx of one command are an NTP exchange (both
+// sends stamped before the write, both receives when the RX task wakes): the
+// host takes the offset between the boards' clocks from the commands with
+// the shortest round trip. So there is a recent one when nobody is sending
+// commands, the top controller sends SYNC (a no-op link command) after
+// AERA_TRACE_SYNC_MS without traffic.
+//
+// AERA_TRACE_ENABLED 0 compiles every tracepoint and the SYNC out; TRACE
+// then answers with empty rings.
+
+#ifndef AERA_TRACE_ENABLED
+#define AERA_TRACE_ENABLED      1
+#endif
+#define AERA_TRACE_LEN          256     // Events per board, a power of two
+#define AERA_TRACE_SYNC_MS      10000
+
+_Static_assert((AERA_TRACE_LEN & (AERA_TRACE_LEN - 1)) == 0, "AERA_TRACE_LEN must be a power of two");
+
+// Columns: X(NAME, "name in dumps"). Stage ids are positions in this list.
+#define AERA_TRACE_STAGES(X)                                                                        \
+    X(WS_RX,    "ws_rx")    /* top: WebSocket frame read in ws_handler */                           \
+    X(QUEUED,   "queued")   /* top: into the UART TX ring */                                        \
+    X(UART_TX,  "uart_tx")  /* top: frame about to go to the UART driver, on every try */           \
+    X(B_RX,     "b_rx")     /* bottom: RX task woken for it, once the line went idle */             \
+    X(B_PARSED, "b_parsed") /* bottom: frame out of the reassembler */                              \
+    X(B_GPIO,   "b_gpio")   /* bottom: output driven (ON/OFF) */                                    \
+    X(B_ACK,    "b_ack")    /* bottom: ACK about to go to the UART driver */                        \
+    X(ACK_RX,   "ack_rx")   /* top: ACK read by the RX task */
+
+typedef enum
+{
+#define AERA_TRACE_X(name, text) AERA_TRACE_##name,
+    AERA_TRACE_STAGES(AERA_TRACE_X)
+#undef AERA_TRACE_X
+    AERA_TRACE_STAGE_COUNT,
+} aera_trace_stage_t;
+
+typedef struct
+{
+    uint32_t us;            // esp_timer time, low 32 bits
+    uint8_t stage;
+    uint8_t seq;
+    uint8_t opcode;
+} aera_trace_event_t;
+
+// Use through AERA_TRACE(); only the board's one writer task may call it
+void aera_trace_record(aera_trace_stage_t stage, uint8_t seq, uint8_t opcode, int64_t us);
+
+// Copies out the ring, oldest first, and returns how many events it holds
+int aera_trace_snapshot(aera_trace_event_t *out, int max);
+
+const char *aera_trace_stage_name(uint8_t stage);
+
+#if AERA_TRACE_ENABLED
+#define AERA_TRACE(stage, seq, opcode, us)  aera_trace_record(AERA_TRACE_##stage, (seq), (opcode), (us))
+#else
+#define AERA_TRACE(stage, seq, opcode, us)  ((void)0)
+#endif
+
+// --- TRACE_DUMP: BOTTOM -> TOP ---
+// A TRACE forwarded to the bottom controller is answered, after its ACK, by
+// its ring in TRACE_DUMP frames, never ACKed. Big-endian, fixed length:
+//
+//   [part u8][parts u8][events in this part u8][0][bottom time at the dump, u32]
+//   AERA_TRACE_DUMP_EVENTS x [time u32][stage u8][seq u8][opcode u8]
+//
+// Unused event slots are zero. An empty ring is one part with no events.
+
+#define AERA_TRACE_DUMP_EVENTS      8
+#define AERA_TRACE_DUMP_PAYLOAD_LEN (8 + 7 * AERA_TRACE_DUMP_EVENTS)
+
+void aera_trace_pack_dump(uint8_t payload[AERA_TRACE_DUMP_PAYLOAD_LEN], uint8_t part, uint8_t parts,
+                          uint32_t now, const aera_trace_event_t *events, int count);
+
+// Fills the header fields and events[AERA_TRACE_DUMP_EVENTS]; returns the
+// number of events, or -1 if the header doesn't add up
+int aera_trace_unpack_dump(const uint8_t payload[AERA_TRACE_DUMP_PAYLOAD_LEN], uint8_t *part, uint8_t *parts,
+                           uint32_t *now, aera_trace_event_t *events);
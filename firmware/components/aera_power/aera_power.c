@@ -0,0 +1,90 @@
+#include <stdatomic.h>
+#include "sdkconfig.h"
+#include "esp_pm.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "aera_power.h"
+
+static const char *TAG = "POWER";
+
+static const char *const s_lock_names[AERA_POWER_LOCKS] = {"ws", "link", "control"};
+
+static esp_pm_lock_handle_t s_locks[AERA_POWER_LOCKS];
+static bool s_save;
+static uint16_t s_min_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+static int64_t s_init_us;
+
+// Busy time: s_held counts locks held of every kind. Whoever takes it from
+// 0 stamps s_busy_since; whoever brings it back to 0 adds the span. A task
+// taking over in the instant between those two can lose one burst; it is a
+// statistic, not a meter.
+static atomic_uint s_held;
+static atomic_llong s_busy_since;
+static atomic_ullong s_busy_us;
+static atomic_uint s_acquired[AERA_POWER_LOCKS];
+
+void aera_power_init(bool save)
+{
+    s_init_us = esp_timer_get_time();
+
+    if (save)
+    {
+        const esp_pm_config_t cfg = {
+            .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+            .min_freq_mhz = AERA_POWER_MIN_MHZ,
+            .light_sleep_enable = false,
+        };
+        esp_err_t err = esp_pm_configure(&cfg);
+        if (err == ESP_OK)
+        {
+            s_save = true;
+            s_min_mhz = AERA_POWER_MIN_MHZ;
+        }
+        else
+        {
+            ESP_LOGW(TAG, "No frequency scaling (%s), staying at %d MHz", esp_err_to_name(err),
+                     CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+        }
+    }
+
+    // Without esp_pm_configure() the locks change nothing, but they are
+    // still how busy time gets counted
+    for (int i = 0; i < AERA_POWER_LOCKS; i++)
+    {
+        if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, s_lock_names[i], &s_locks[i]) != ESP_OK)
+            s_locks[i] = NULL;
+    }
+    ESP_LOGI(TAG, "CPU %d-%d MHz", s_min_mhz, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+}
+
+void aera_power_acquire(aera_power_lock_t lock)
+{
+    // Clock up first, so the work that follows all runs at full speed
+    if (s_locks[lock])
+        esp_pm_lock_acquire(s_locks[lock]);
+    atomic_fetch_add_explicit(&s_acquired[lock], 1, memory_order_relaxed);
+    if (atomic_fetch_add(&s_held, 1) == 0)
+        atomic_store(&s_busy_since, esp_timer_get_time());
+}
+
+void aera_power_release(aera_power_lock_t lock)
+{
+    if (atomic_fetch_sub(&s_held, 1) == 1)
+        atomic_fetch_add(&s_busy_us, (unsigned long long)(esp_timer_get_time() - atomic_load(&s_busy_since)));
+    if (s_locks[lock])
+        esp_pm_lock_release(s_locks[lock]);
+}
+
+void aera_power_get_stats(aera_power_stats_t *out)
+{
+    int64_t now = esp_timer_get_time();
+    out->save = s_save;
+    out->max_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    out->min_mhz = s_min_mhz;
+    out->up_us = (uint64_t)(now - s_init_us);
+    out->busy_us = atomic_load(&s_busy_us);
+    if (atomic_load(&s_held) > 0)
+        out->busy_us += (uint64_t)(now - atomic_load(&s_busy_since));
+    for (int i = 0; i < AERA_POWER_LOCKS; i++)
+        out->acquired[i] = atomic_load_explicit(&s_acquired[i], memory_order_relaxed);
+}
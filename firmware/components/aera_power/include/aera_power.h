@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- POWER MANAGEMENT ---
+//
+// Dynamic frequency scaling through esp_pm. With power saving on, the CPU
+// idles at AERA_POWER_MIN_MHZ and runs at the configured CPU frequency only
+// while one of the locks below is held. A task takes its lock when it wakes
+// for a burst of work (a WebSocket frame, a UART event, a control tick) and
+// gives it back before it blocks again, so the work itself runs at full
+// speed and the gaps between bursts don't.
+//
+// AERA_POWER_MIN_MHZ is the lowest setting that keeps APB at 80 MHz: the
+// UART baud rate and the timers don't move when the CPU clock does.
+//
+// Light sleep stays off. The UART link can only wake the chip by losing the
+// first bytes of a frame, and neither board goes long without one.
+//
+// For scale, from the ESP32 datasheet (both cores, radio in modem sleep):
+// 160 MHz 27-44 mA, 80 MHz 20-31 mA; with the radio listening 95-100 mA.
+// On the top board, Wi-Fi modem sleep is where most of the saving is;
+// see wifi_conn.h.
+//
+// Busy time (any lock held) is counted with saving on or off, so the two
+// modes can be compared.
+
+#define AERA_POWER_MIN_MHZ      80
+
+typedef enum
+{
+    AERA_POWER_WS,          // WebSocket frames and control datagrams in and out
+    AERA_POWER_LINK,        // UART frames in and out
+    AERA_POWER_CONTROL,     // Control loop ticks
+    AERA_POWER_LOCKS,
+} aera_power_lock_t;
+
+typedef struct
+{
+    bool save;
+    uint16_t max_mhz;
+    uint16_t min_mhz;           // max_mhz when saving is off
+    uint64_t up_us;             // Since aera_power_init()
+    uint64_t busy_us;           // Of that, with at least one lock held
+    uint32_t acquired[AERA_POWER_LOCKS];
+} aera_power_stats_t;
+
+// Call once, before any task that takes a lock starts. save = false leaves
+// the CPU at full speed but keeps the accounting.
+void aera_power_init(bool save);
+
+// Recursive, like the esp_pm locks underneath; cheap enough to take per
+// frame. Any task, not from an ISR.
+void aera_power_acquire(aera_power_lock_t lock);
+void aera_power_release(aera_power_lock_t lock);
+
+// Each field is consistent on its own
+void aera_power_get_stats(aera_power_stats_t *out);
@@ -0,0 +1,82 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "aera_stats.h"
+
+#if !configUSE_TRACE_FACILITY || !configGENERATE_RUN_TIME_STATS
+#error "aera_stats needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS"
+#endif
+
+// Run time each task had at the previous call, to take the difference
+typedef struct
+{
+    TaskHandle_t task;
+    configRUN_TIME_COUNTER_TYPE run_time;
+} prev_t;
+
+static TaskStatus_t s_status[AERA_STATS_MAX_TASKS];
+static prev_t s_prev[AERA_STATS_MAX_TASKS];
+static int s_prev_count;
+static configRUN_TIME_COUNTER_TYPE s_prev_total;
+
+static configRUN_TIME_COUNTER_TYPE prev_run_time(TaskHandle_t task)
+{
+    for (int i = 0; i < s_prev_count; i++)
+    {
+        if (s_prev[i].task == task)
+            return s_prev[i].run_time;
+    }
+    return 0; // New since the last call: all its run time is in this window
+}
+
+int aera_stats_tasks(aera_task_stats_t *out, int max)
+{
+    configRUN_TIME_COUNTER_TYPE total;
+    UBaseType_t n = uxTaskGetSystemState(s_status, AERA_STATS_MAX_TASKS, &total);
+
+    // Elapsed time on each core, so the shares add up to 1000 for the chip
+    uint64_t span = (uint64_t)(total - s_prev_total) * portNUM_PROCESSORS;
+    s_prev_total = total;
+
+    int count = 0;
+    for (UBaseType_t i = 0; i < n; i++)
+    {
+        const TaskStatus_t *st = &s_status[i];
+        uint64_t ran = st->ulRunTimeCounter - prev_run_time(st->xHandle);
+        uint32_t permille = span ? (uint32_t)(ran * 1000 / span) : 0;
+
+        if (count < max)
+        {
+            // Insertion by CPU share, busiest first
+            int at = count++;
+            while (at > 0 && out[at - 1].cpu_permille < permille)
+            {
+                out[at] = out[at - 1];
+                at--;
+            }
+            aera_task_stats_t *t = &out[at];
+            strncpy(t->name, st->pcTaskName, sizeof(t->name) - 1);
+            t->name[sizeof(t->name) - 1] = '\0';
+            t->prio = (uint8_t)st->uxCurrentPriority;
+            t->cpu_permille = (uint16_t)(permille > 1000 ? 1000 : permille);
+            t->stack_free = st->usStackHighWaterMark;
+        }
+    }
+
+    // Tasks that are gone drop out here
+    for (UBaseType_t i = 0; i < n; i++)
+    {
+        s_prev[i].task = s_status[i].xHandle;
+        s_prev[i].run_time = s_status[i].ulRunTimeCounter;
+    }
+    s_prev_count = (int)n;
+    return count;
+}
+
+void aera_stats_heap(aera_heap_stats_t *out)
+{
+    out->free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    out->min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    out->largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// --- RUNTIME STATS ---
+//
+// What each board reports for STATS: every task's share of the CPU and how
+// much of its stack it has never touched, and the heap. Stack sizes are
+// guesses until a board has run for a while; the high-water marks say how
+// far off they are, and the heap minimum catches leaks.
+//
+// Needs CONFIG_FREERTOS_USE_TRACE_FACILITY and
+// CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS (in every sdkconfig here).
+
+#define AERA_STATS_MAX_TASKS    24      // More than either board runs
+
+typedef struct
+{
+    char name[configMAX_TASK_NAME_LEN];
+    uint8_t prio;
+    uint16_t cpu_permille;      // Of both cores, since the previous call
+    uint32_t stack_free;        // Bytes never used since the task started
+} aera_task_stats_t;
+
+typedef struct
+{
+    uint32_t free;
+    uint32_t min_free;          // Lowest since boot
+    uint32_t largest;           // Largest block one malloc() can get
+} aera_heap_stats_t;
+
+// Fills out[] with up to max tasks, busiest first, and returns how many.
+// The CPU shares cover the time since the previous call (since boot for the
+// first), so call it from one place: STATS. Not from an ISR.
+int aera_stats_tasks(aera_task_stats_t *out, int max);
+
+void aera_stats_heap(aera_heap_stats_t *out);
@@ -7,40 +7,53 @@ export default function App() {
   const [isLedOn, setIsLedOn] = useState(false);
   const [isConnected, setIsConnected] = useState(false);
   const [statusText, setStatusText] = useState("Connecting...");
+  const [telemetry, setTelemetry] = useState(null);
 
   // --- REFS ---
   const ws = useRef(null);
   const reconnectTimeout = useRef(null);
   const watchdogTimer = useRef(null); // Timer to check for death
-  const lastPongTime = useRef(Date.now()); // Timestamp of last message
-
-  // --- HEARTBEAT FUNCTION ---
-  // This keeps the connection alive and detects death
+  const lastHeardTime = useRef(Date.now()); // Timestamp of last message
+  const probeSent = useRef(false); // PING sent since we last heard anything
+  const streaming = useRef(false); // Telemetry should be arriving
+  // The server's keepalive, from its HELLO; the firmware defaults until then
+  const keepalive = useRef({ pingMs: 15000, timeoutMs: 45000 });
+
+  // --- WATCHDOG FUNCTION ---
+  // The server keeps the session alive with WebSocket pings, which the
+  // platform answers for us, so there is nothing to send while all is well.
+  // Those pings never reach JS though, so when the server goes quiet we ask
+  // once with a PING and reconnect if that goes unanswered too. While
+  // telemetry streams, quiet means a few seconds; otherwise the server may
+  // say nothing for its whole ping interval, and we give it as long as it
+  // gives us before it drops the session.
+  const STREAM_QUIET_MS = 4000;
   const startWatchdog = () => {
     // Clear existing timer if any
     if (watchdogTimer.current) clearInterval(watchdogTimer.current);
 
     // Reset the "last heard from server" time
-    lastPongTime.current = Date.now();
+    lastHeardTime.current = Date.now();
+    probeSent.current = false;
 
     watchdogTimer.current = setInterval(() => {
-      if (ws.current && ws.current.readyState === WebSocket.OPEN) {
-
-        // 1. Send PING to ESP32
+      if (!ws.current || ws.current.readyState !== WebSocket.OPEN) return;
+
+      const quietMs = streaming.current ? STREAM_QUIET_MS : keepalive.current.pingMs;
+      const deadMs = streaming.current ? 2 * STREAM_QUIET_MS : keepalive.current.timeoutMs;
+      const timeSinceHeard = Date.now() - lastHeardTime.current;
+      if (timeSinceHeard > deadMs) {
+        console.log("💀 DEAD CONNECTION DETECTED! (Timeout)");
+        ws.current.close(); // This triggers onclose -> reconnect
+      } else if (timeSinceHeard > quietMs && !probeSent.current) {
+        probeSent.current = true;
         try {
           ws.current.send("PING");
         } catch (e) {
           console.log("Ping failed");
         }
-
-        // 2. Check if ESP32 is dead (No reply for 4 seconds)
-        const timeSinceLastPong = Date.now() - lastPongTime.current;
-        if (timeSinceLastPong > 4000) {
-          console.log("💀 DEAD CONNECTION DETECTED! (Timeout)");
-          ws.current.close(); // This triggers onclose -> reconnect
-        }
       }
-    }, 1500); // Check every 1.5 seconds
+    }, 1000); // A local check; nothing goes on the air
   };
 
   // --- CONNECT FUNCTION ---
@@ -53,6 +66,7 @@ export default function App() {
 
     // CHANGE IP IF NEEDED
     ws.current = new WebSocket('ws://192.168.18.200:81');
+    ws.current.binaryType = 'arraybuffer';
 
     ws.current.onopen = () => {
       console.log('WebSocket Connected');
@@ -63,6 +77,10 @@ export default function App() {
 
       // Start the heartbeat when we connect
       startWatchdog();
+
+      // Sensor stream, twice a second is plenty for a display
+      ws.current.send("TELEM:2");
+      streaming.current = true;
     };
 
     ws.current.onclose = () => {
@@ -70,8 +88,9 @@ export default function App() {
       setIsConnected(false);
       setStatusText("Disconnected. Retrying...");
 
-      // Stop the watchdog so we don't keep pinging a dead socket
+      // Stop the watchdog so we don't keep probing a dead socket
       if (watchdogTimer.current) clearInterval(watchdogTimer.current);
+      streaming.current = false;
 
       // Try to reconnect in 3 seconds
       reconnectTimeout.current = setTimeout(() => {
@@ -84,12 +103,37 @@ export default function App() {
     };
 
     ws.current.onmessage = (e) => {
-      // 3. We heard from the Server! Reset the death timer.
-      lastPongTime.current = Date.now();
+      // We heard from the Server! Reset the death timer.
+      lastHeardTime.current = Date.now();
+      probeSent.current = false;
+
+      // Binary frames are telemetry: ['T'][count][interval ms][index] + samples
+      if (typeof e.data !== 'string') {
+        const view = new DataView(e.data);
+        if (view.byteLength < 14 || view.getUint8(0) !== 0x54) return;
+        const last = 6 + (view.getUint8(1) - 1) * 8;
+        setTelemetry({
+          tempC: view.getInt16(last) / 100,
+          humidity: view.getInt16(last + 2) / 100,
+          heaterA: view.getInt16(last + 4) / 1000,
+          fanRpm: view.getInt16(last + 6),
+        });
+        return;
+      }
+
+      // HELLO:ping_ms=<n>,timeout_ms=<n> comes first, with the keepalive
+      if (e.data.startsWith("HELLO:")) {
+        const kv = Object.fromEntries(e.data.slice(6).split(",").map((p) => p.split("=")));
+        keepalive.current = {
+          pingMs: Number(kv.ping_ms) || keepalive.current.pingMs,
+          timeoutMs: Number(kv.timeout_ms) || keepalive.current.timeoutMs,
+        };
+        return;
+      }
 
       if (e.data === "STATUS:ON") setIsLedOn(true);
       if (e.data === "STATUS:OFF") setIsLedOn(false);
-      // We ignore "PONG" messages here, they just update lastPongTime above
+      // We ignore "PONG" messages here, they just update lastHeardTime above
     };
   };
 
@@ -125,6 +169,12 @@ export default function App() {
               {isLedOn ? "RUNNING" : "STOPPED"}
             </Text>
 
+            {telemetry && (
+              <Paragraph style={{ marginBottom: 16 }}>
+                {telemetry.tempC.toFixed(1)} °C · {telemetry.humidity.toFixed(0)} %RH · {telemetry.heaterA.toFixed(1)} A · {telemetry.fanRpm} rpm
+              </Paragraph>
+            )}
+
             <Button
               icon={isLedOn ? "fan" : "fan-off"}
               mode="contained"
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "esp_err.h"
+
+typedef struct sim_adc_cali *adc_cali_handle_t;
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t cali, int raw, int *mv);
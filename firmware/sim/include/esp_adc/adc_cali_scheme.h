@@ -0,0 +1,13 @@
+#pragma once
+
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+
+typedef struct
+{
+    adc_unit_t unit_id;
+    adc_atten_t atten;
+    adc_bitwidth_t bitwidth;
+} adc_cali_line_fitting_config_t;
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *cfg, adc_cali_handle_t *out);
@@ -0,0 +1,15 @@
+#pragma once
+
+// Host shim: the version is `git describe` at configure time, as IDF's
+// PROJECT_VER defaults to (see CMakeLists.txt)
+
+typedef struct
+{
+    char version[32];
+    char project_name[32];
+    char time[16];
+    char date[16];
+    char idf_ver[32];
+} esp_app_desc_t;
+
+const esp_app_desc_t *esp_app_get_description(void);
@@ -0,0 +1,8 @@
+#pragma once
+
+// Host shim: placement attributes mean nothing off-chip
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Host shim: from the OS's generator
+uint32_t esp_random(void);
+void esp_fill_random(void *buf, size_t len);
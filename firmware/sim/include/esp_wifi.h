@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+
+// Host shim: "Wi-Fi" is the loopback interface. Starting the station posts
+// WIFI_EVENT_STA_START; connecting posts STA_CONNECTED and then
+// IP_EVENT_STA_GOT_IP with the configured static IP, or STA_DISCONNECTED.
+//
+// There is one simulated access point, and connecting takes as long as it
+// would over the air: a probe dwell per channel scanned, then association.
+// A connect pinned to the AP's channel and BSSID skips the scan; one pinned
+// to the wrong channel fails after a single dwell. sim_wifi_drop() (and
+// --wifi-blip) takes the AP away for a moment, the way a router blip does.
+//
+// Modem sleep: with esp_wifi_set_ps() on and the station associated, the
+// radio only wakes for the AP's beacons (each DTIM for MIN_MODEM, every
+// listen_interval beacons for MAX_MODEM) and stays up for a while after any
+// traffic. Packets for the board wait at the AP until the next wake.
+
+extern esp_event_base_t const WIFI_EVENT;
+extern esp_event_base_t const IP_EVENT;
+
+typedef enum
+{
+    WIFI_EVENT_STA_START = 2,
+    WIFI_EVENT_STA_STOP,
+    WIFI_EVENT_STA_CONNECTED,
+    WIFI_EVENT_STA_DISCONNECTED,
+} wifi_event_t;
+
+typedef enum
+{
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+} ip_event_t;
+
+typedef struct
+{
+    esp_netif_ip_info_t ip_info;
+} ip_event_got_ip_t;
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t authmode;
+    uint16_t aid;
+} wifi_event_sta_connected_t;
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t bssid[6];
+    uint8_t reason;
+    int8_t rssi;
+} wifi_event_sta_disconnected_t;
+
+typedef enum
+{
+    WIFI_REASON_ASSOC_LEAVE = 8,
+    WIFI_REASON_BEACON_TIMEOUT = 200,
+    WIFI_REASON_NO_AP_FOUND = 201,
+    WIFI_REASON_AUTH_FAIL = 202,
+    WIFI_REASON_ASSOC_FAIL = 203,
+    WIFI_REASON_HANDSHAKE_TIMEOUT = 204,
+    WIFI_REASON_CONNECTION_FAIL = 205,
+} wifi_err_reason_t;
+
+typedef enum
+{
+    WIFI_MODE_NULL,
+    WIFI_MODE_STA,
+    WIFI_MODE_AP,
+    WIFI_MODE_APSTA,
+} wifi_mode_t;
+
+typedef enum
+{
+    WIFI_IF_STA,
+    WIFI_IF_AP,
+} wifi_interface_t;
+
+typedef enum
+{
+    WIFI_PS_NONE,
+    WIFI_PS_MIN_MODEM,
+    WIFI_PS_MAX_MODEM,
+} wifi_ps_type_t;
+
+typedef enum
+{
+    WIFI_FAST_SCAN,         // Stop at the first channel the SSID answers on
+    WIFI_ALL_CHANNEL_SCAN,  // Scan every channel, then pick by sort_method
+} wifi_scan_method_t;
+
+typedef enum
+{
+    WIFI_CONNECT_AP_BY_SIGNAL,
+    WIFI_CONNECT_AP_BY_SECURITY,
+} wifi_sort_method_t;
+
+typedef enum
+{
+    WIFI_STORAGE_FLASH,
+    WIFI_STORAGE_RAM,
+} wifi_storage_t;
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t password[64];
+    wifi_scan_method_t scan_method;
+    uint8_t bssid_set;
+    uint8_t bssid[6];
+    uint8_t channel;        // 0 = any
+    uint16_t listen_interval;
+    wifi_sort_method_t sort_method;
+} wifi_sta_config_t;
+
+typedef union
+{
+    wifi_sta_config_t sta;
+} wifi_config_t;
+
+typedef struct
+{
+    int unused;
+} wifi_init_config_t;
+
+#define WIFI_INIT_CONFIG_DEFAULT() {0}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *cfg);
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode);
+esp_err_t esp_wifi_set_config(wifi_interface_t iface, wifi_config_t *cfg);
+esp_err_t esp_wifi_get_config(wifi_interface_t iface, wifi_config_t *cfg);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_connect(void);
+esp_err_t esp_wifi_disconnect(void);
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage);
+
+void sim_wifi_drop(void);
+
+// True while the station is associated. The httpd shim turns new
+// connections away otherwise, as nothing could reach the board.
+bool sim_wifi_link_up(void);
+
+// The httpd shim calls these around socket traffic. sim_wifi_rx() blocks
+// until the radio would be awake to take a packet; both keep it awake.
+void sim_wifi_rx(void);
+void sim_wifi_tx(void);
+
+// Time the radio has been on since esp_wifi_start(), for the power meter
+int64_t sim_wifi_radio_on_us(void);
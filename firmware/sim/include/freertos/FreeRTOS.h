@@ -0,0 +1,43 @@
+#pragma once
+
+// Host shim: just enough of the FreeRTOS API for the controller firmware,
+// on top of pthreads. One tick is one millisecond (CONFIG_FREERTOS_HZ=1000).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t EventBits_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              pdTRUE
+#define pdFAIL              pdFALSE
+#define portMAX_DELAY       ((TickType_t)0xFFFFFFFFu)
+#define portTICK_PERIOD_MS  1
+#define configTICK_RATE_HZ  1000
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define tskNO_AFFINITY      0x7FFFFFFF
+#define portNUM_PROCESSORS  2
+#define configMAX_TASK_NAME_LEN         16
+#define configUSE_TRACE_FACILITY        1
+#define configGENERATE_RUN_TIME_STATS   1
+#define configRUN_TIME_COUNTER_TYPE     uint64_t
+
+#define BIT0    0x00000001
+#define BIT1    0x00000002
+#define BIT2    0x00000004
+#define BIT3    0x00000008
+#define BIT4    0x00000010
+#define BIT5    0x00000020
+#define BIT6    0x00000040
+#define BIT7    0x00000080
+
+TickType_t xTaskGetTickCount(void);
+
+// The core a task was pinned to; 0 for the rest
+BaseType_t xPortGetCoreID(void);
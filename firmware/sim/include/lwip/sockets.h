@@ -0,0 +1,22 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+// Host shim: lwIP's BSD sockets are the host's, but for the datagram calls
+// the firmware makes, which go through lwip_shim.c. bind() moves a UDP
+// socket to loopback, on the --http-port if one was given; recvfrom()
+// drops what comes in while the station is down and holds the rest until
+// the radio would be awake for it; sendto() keeps the radio awake, as the
+// httpd shim does for its sockets.
+
+int sim_lwip_bind(int fd, const struct sockaddr *addr, socklen_t len);
+ssize_t sim_lwip_recvfrom(int fd, void *buf, size_t len, int flags, struct sockaddr *from, socklen_t *from_len);
+ssize_t sim_lwip_sendto(int fd, const void *buf, size_t len, int flags, const struct sockaddr *to, socklen_t to_len);
+
+#define bind sim_lwip_bind
+#define recvfrom sim_lwip_recvfrom
+#define sendto sim_lwip_sendto
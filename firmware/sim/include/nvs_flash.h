@@ -0,0 +1,9 @@
+#pragma once
+
+#include "esp_err.h"
+#include "nvs.h"
+
+// Host shim: there is no flash partition to format, these always succeed.
+// The store itself is in nvs.h.
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
@@ -0,0 +1,8 @@
+#pragma once
+
+// Host shim: the handful of project settings the firmware reads, as the
+// boards' sdkconfig.esp32dev sets them
+
+#define CONFIG_FREERTOS_HZ                  1000
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ     160
+#define CONFIG_PM_ENABLE                    1
@@ -0,0 +1,327 @@
+// Runs both controllers on one host, wired together by a socketpair that
+// stands in for the UART2 link. It keeps each write whole, so the far end
+// knows what rate it was sent at (uart_shim.c). Extra arguments go to both
+// processes. With --bottom-reset S the bottom controller alone is
+// restarted every S seconds, to see the top controller get over it.
+//
+// With --nodes N it runs N bottom controllers on a bus instead (aera_bus.h),
+// at addresses 1..N. Each board then has a socketpair to the launcher,
+// which plays the shared pair: every write reaches every other board. With
+// --baud it also takes the time on the wire into account: a write arrives
+// once its last byte would have, and one that starts while another board's
+// is still on the wire garbles both, like two transceivers driving the
+// line at once.
+//
+//   aera_sim [--http-port 8081] [--baud 115200] [--nvs /tmp/aera_nvs] [--ota /tmp/aera_ota]
+//            [--nvs-blob udp_ctrl:key:<32 hex>] [--wifi-blip 30] [--link-degrade 20]
+//            [--nodes 4 | --bottom-reset 20] [--verbose]
+
+#include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_HTTP_PORT "8081"
+#define MAX_NODES 16                    // AERA_BUS_MAX_NODES
+#define WIRE_MSG_MAX (4 + 4096)         // [sender's baud][bytes], as uart_shim.c writes them
+#define HUB_PENDING 64                  // Writes on the wire at once, all boards together
+
+static pid_t spawn(const char *dir, const char *exe, int fd, int argc, char **argv, bool with_http,
+                   const char *name, int node)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    // Don't outlive the launcher when it is killed rather than reaped
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+    char path[PATH_MAX];
+    char fd_str[16];
+    char node_str[16];
+    snprintf(path, sizeof(path), "%s/%s", dir, exe);
+    snprintf(fd_str, sizeof(fd_str), "%d", fd);
+    snprintf(node_str, sizeof(node_str), "%d", node);
+
+    char *args[64];
+    int n = 0;
+    args[n++] = path;
+    args[n++] = "--uart-fd";
+    args[n++] = fd_str;
+    args[n++] = "--name";
+    args[n++] = (char *)name;
+    if (node >= 0)
+    {
+        args[n++] = "--node";
+        args[n++] = node_str;
+    }
+
+    bool port_given = false;
+    for (int i = 1; i < argc && n < 60; i++)
+    {
+        if (strcmp(argv[i], "--nodes") == 0 || strcmp(argv[i], "--bottom-reset") == 0)
+        {
+            i++;
+            continue;
+        }
+        if (strcmp(argv[i], "--http-port") == 0)
+        {
+            port_given = true;
+            if (!with_http)
+            {
+                i++;
+                continue;
+            }
+        }
+        args[n++] = argv[i];
+    }
+    if (with_http && !port_given)
+    {
+        args[n++] = "--http-port";
+        args[n++] = DEFAULT_HTTP_PORT;
+    }
+    args[n] = NULL;
+
+    execv(path, args);
+    perror(path);
+    _exit(127);
+}
+
+static const char *arg_value(int argc, char **argv, const char *name)
+{
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], name) == 0)
+            return argv[i + 1];
+    }
+    return NULL;
+}
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// --- BUS HUB ---
+// Writes on the wire, oldest first. Without --baud they are passed on as
+// soon as they come in.
+static struct
+{
+    int fds[MAX_NODES + 1];
+    int count;
+    bool timed;
+    struct
+    {
+        uint8_t data[WIRE_MSG_MAX];
+        size_t len;
+        int from;
+        int64_t start_us;
+        int64_t end_us;
+    } pending[HUB_PENDING];
+    unsigned head, tail;
+    unsigned collisions;
+} s_hub;
+
+static void hub_garble(uint8_t *data, size_t len)
+{
+    static unsigned seed = 1;
+    for (size_t i = 4; i < len; i++)
+        data[i] ^= (uint8_t)(1 + rand_r(&seed) % 255);
+}
+
+static void hub_deliver(unsigned i)
+{
+    for (int k = 0; k < s_hub.count; k++)
+    {
+        if (k != s_hub.pending[i].from)
+            (void)!write(s_hub.fds[k], s_hub.pending[i].data, s_hub.pending[i].len);
+    }
+}
+
+static void hub_take(int from, const uint8_t *msg, size_t len)
+{
+    if (s_hub.tail - s_hub.head == HUB_PENDING)
+    {
+        fprintf(stderr, "aera_sim: bus hub full, write dropped\n");
+        return;
+    }
+
+    uint32_t baud;
+    memcpy(&baud, msg, sizeof(baud));
+    unsigned i = s_hub.tail++ % HUB_PENDING;
+    memcpy(s_hub.pending[i].data, msg, len);
+    s_hub.pending[i].len = len;
+    s_hub.pending[i].from = from;
+    s_hub.pending[i].start_us = now_us();
+    s_hub.pending[i].end_us = s_hub.pending[i].start_us;
+    if (s_hub.timed && baud > 0)
+        s_hub.pending[i].end_us += (int64_t)(len - sizeof(baud)) * 10 * 1000000 / baud;
+
+    // Anyone else still talking?
+    for (unsigned j = s_hub.head; j != s_hub.tail - 1; j++)
+    {
+        unsigned o = j % HUB_PENDING;
+        if (s_hub.pending[o].from != from && s_hub.pending[o].end_us > s_hub.pending[i].start_us)
+        {
+            hub_garble(s_hub.pending[o].data, s_hub.pending[o].len);
+            hub_garble(s_hub.pending[i].data, s_hub.pending[i].len);
+            s_hub.collisions++;
+            fprintf(stderr, "aera_sim: bus collision #%u, boards %d and %d\n", s_hub.collisions,
+                    s_hub.pending[o].from, from);
+        }
+    }
+}
+
+// Passes on what is off the wire by now; returns the poll() timeout until
+// the next one is
+static int hub_flush(void)
+{
+    int64_t now = now_us();
+    while (s_hub.head != s_hub.tail)
+    {
+        unsigned i = s_hub.head % HUB_PENDING;
+        if (s_hub.pending[i].end_us > now)
+            return (int)((s_hub.pending[i].end_us - now + 999) / 1000);
+        hub_deliver(i);
+        s_hub.head++;
+    }
+    return -1;
+}
+
+// Until a board goes away
+static void hub_run(void)
+{
+    static uint8_t msg[WIRE_MSG_MAX];
+    struct pollfd pfds[MAX_NODES + 1];
+    for (int k = 0; k < s_hub.count; k++)
+        pfds[k] = (struct pollfd){.fd = s_hub.fds[k], .events = POLLIN};
+
+    for (;;)
+    {
+        int timeout = hub_flush();
+        if (poll(pfds, s_hub.count, timeout) < 0)
+            continue;
+        for (int k = 0; k < s_hub.count; k++)
+        {
+            if (pfds[k].revents == 0)
+                continue;
+            ssize_t n = read(pfds[k].fd, msg, sizeof(msg));
+            if (n <= 0)
+                return;
+            if (n > (ssize_t)sizeof(uint32_t))
+                hub_take(k, msg, (size_t)n);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    char self[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len < 0)
+    {
+        perror("readlink");
+        return 1;
+    }
+    self[len] = '\0';
+    const char *dir = dirname(self);
+
+    const char *nodes_arg = arg_value(argc, argv, "--nodes");
+    int nodes = nodes_arg ? atoi(nodes_arg) : 0;
+    if (nodes < 0 || nodes > MAX_NODES)
+    {
+        fprintf(stderr, "aera_sim: --nodes is 1..%d\n", MAX_NODES);
+        return 2;
+    }
+    const char *reset_arg = arg_value(argc, argv, "--bottom-reset");
+    int reset_s = reset_arg ? atoi(reset_arg) : 0;
+    if (reset_s < 0 || (reset_s > 0 && nodes > 0))
+    {
+        fprintf(stderr, "aera_sim: --bottom-reset takes seconds, without --nodes\n");
+        return 2;
+    }
+
+    if (nodes == 0)
+    {
+        int link[2];
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, link) != 0)
+        {
+            perror("socketpair");
+            return 1;
+        }
+
+        pid_t bottom = spawn(dir, "sim_bottom", link[1], argc, argv, false, "bottom", -1);
+        pid_t top = spawn(dir, "sim_top", link[0], argc, argv, true, "top", -1);
+        close(link[0]);
+        if (reset_s == 0)
+            close(link[1]); // Otherwise kept for the next bottom controller
+
+        // With --bottom-reset the bottom controller is killed every S
+        // seconds and started again on the same link, like a watchdog or
+        // brown-out reset of that board alone. When either board goes down
+        // otherwise, take the other with it.
+        int64_t reset_us = now_us() + (int64_t)reset_s * 1000000;
+        int status = 0;
+        pid_t gone;
+        while ((gone = waitpid(-1, &status, reset_s ? WNOHANG : 0)) == 0)
+        {
+            if (now_us() >= reset_us)
+            {
+                kill(bottom, SIGKILL);
+                waitpid(bottom, NULL, 0);
+                printf("aera_sim: resetting the bottom controller\n");
+                fflush(stdout);
+                bottom = spawn(dir, "sim_bottom", link[1], argc, argv, false, "bottom", -1);
+                reset_us += (int64_t)reset_s * 1000000;
+            }
+            usleep(10000);
+        }
+        kill(gone == top ? bottom : top, SIGTERM);
+        wait(NULL);
+        return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    }
+
+    // One socketpair per board, the launcher's ends in s_hub.fds: the top
+    // controller first, then the bottom controllers by address
+    pid_t pids[MAX_NODES + 1];
+    s_hub.timed = arg_value(argc, argv, "--baud") != NULL;
+    s_hub.count = nodes + 1;
+    for (int k = 0; k < s_hub.count; k++)
+    {
+        int link[2];
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, link) != 0)
+        {
+            perror("socketpair");
+            return 1;
+        }
+        char name[16];
+        snprintf(name, sizeof(name), k == 0 ? "top" : "bottom%d", k);
+        pids[k] = spawn(dir, k == 0 ? "sim_top" : "sim_bottom", link[1], argc, argv, k == 0, name, k);
+        close(link[1]);
+        s_hub.fds[k] = link[0];
+    }
+
+    hub_run();
+
+    // A board went down: take the rest with it
+    for (int k = 0; k < s_hub.count; k++)
+        kill(pids[k], SIGTERM);
+    int status = 0;
+    wait(&status);
+    while (wait(NULL) > 0)
+    {
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
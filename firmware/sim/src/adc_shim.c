@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "plant.h"
+
+#define FULL_SCALE_MV   3100
+#define MAX_RAW         4095
+
+// Handles only need to be non-NULL and distinct
+struct sim_adc_unit
+{
+    adc_unit_t unit;
+};
+
+struct sim_adc_cali
+{
+    adc_unit_t unit;
+};
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *cfg, adc_oneshot_unit_handle_t *out)
+{
+    struct sim_adc_unit *u = calloc(1, sizeof(*u));
+    if (u == NULL)
+        return ESP_ERR_NO_MEM;
+    u->unit = cfg->unit_id;
+    *out = u;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t unit, adc_channel_t channel,
+                                     const adc_oneshot_chan_cfg_t *cfg)
+{
+    return unit != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t unit, adc_channel_t channel, int *raw)
+{
+    if (unit == NULL || raw == NULL)
+        return ESP_ERR_INVALID_ARG;
+    int v = sim_plant_adc_mv(channel) * MAX_RAW / FULL_SCALE_MV;
+    *raw = v > MAX_RAW ? MAX_RAW : v;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *cfg, adc_cali_handle_t *out)
+{
+    struct sim_adc_cali *c = calloc(1, sizeof(*c));
+    if (c == NULL)
+        return ESP_ERR_NO_MEM;
+    c->unit = cfg->unit_id;
+    *out = c;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t cali, int raw, int *mv)
+{
+    if (cali == NULL || mv == NULL)
+        return ESP_ERR_INVALID_ARG;
+    *mv = (raw * FULL_SCALE_MV + MAX_RAW / 2) / MAX_RAW;
+    return ESP_OK;
+}
@@ -0,0 +1,496 @@
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+// --- TIME ---
+
+static struct timespec deadline_after(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+// Waits on cond until woken or the tick budget runs out. Returns false on
+// timeout. portMAX_DELAY waits forever.
+static bool cond_wait_ticks(pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *deadline,
+                            TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    if (ticks == 0)
+        return false;
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+// Condition variables time out against CLOCK_MONOTONIC like the deadlines
+static pthread_condattr_t s_cond_attr;
+static pthread_once_t s_cond_attr_once = PTHREAD_ONCE_INIT;
+
+static void cond_attr_init(void)
+{
+    pthread_condattr_init(&s_cond_attr);
+    pthread_condattr_setclock(&s_cond_attr, CLOCK_MONOTONIC);
+}
+
+static pthread_condattr_t *monotonic_attr(void)
+{
+    pthread_once(&s_cond_attr_once, cond_attr_init);
+    return &s_cond_attr;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+// --- TASKS ---
+
+// Stacks are allocated, not left to glibc, and painted so the high-water
+// mark can be read back. Host frames are bigger than the ESP32's; the slack
+// keeps a task sized for the ESP32 from overflowing here. glibc's printf
+// alone takes more than most of the firmware's tasks are given, so the
+// high-water mark reported is the whole host stack's: good for comparing
+// tasks and spotting growth, not for sizing them.
+#define STACK_PAINT     0xA5
+#define STACK_SLACK     (64 * 1024)
+
+struct sim_task
+{
+    pthread_t thread;
+    char name[configMAX_TASK_NAME_LEN];
+    TaskFunction_t fn;
+    void *arg;
+    BaseType_t core;
+    UBaseType_t prio;
+    UBaseType_t number;
+
+    uint8_t *stack;         // NULL for threads the shim didn't start
+    size_t stack_size;      // Requested + STACK_SLACK
+    struct sim_task *next;  // In s_tasks while it runs
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+static __thread struct sim_task *t_self;
+
+static pthread_mutex_t s_tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sim_task *s_tasks;
+static UBaseType_t s_task_count;
+static UBaseType_t s_task_numbers;
+
+static struct sim_task *task_new(const char *name)
+{
+    struct sim_task *t = calloc(1, sizeof(*t));
+    strncpy(t->name, name, sizeof(t->name) - 1);
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->cond, monotonic_attr());
+    return t;
+}
+
+static void task_unlist(struct sim_task *t)
+{
+    pthread_mutex_lock(&s_tasks_lock);
+    for (struct sim_task **p = &s_tasks; *p; p = &(*p)->next)
+    {
+        if (*p == t)
+        {
+            *p = t->next;
+            s_task_count--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_tasks_lock);
+}
+
+static void *task_trampoline(void *p)
+{
+    struct sim_task *t = p;
+    t_self = t;
+    pthread_setname_np(pthread_self(), t->name);
+    t->fn(t->arg);
+    task_unlist(t);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *out, BaseType_t core)
+{
+    struct sim_task *t = task_new(name);
+    t->fn = fn;
+    t->arg = arg;
+    t->core = core == tskNO_AFFINITY ? 0 : core;
+    t->prio = prio;
+
+    t->stack_size = (stack_depth + STACK_SLACK + 4095) & ~(size_t)4095;
+    t->stack = mmap(NULL, t->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (t->stack == MAP_FAILED)
+        return pdFAIL;
+    memset(t->stack, STACK_PAINT, t->stack_size);
+
+    pthread_mutex_lock(&s_tasks_lock);
+    t->number = ++s_task_numbers;
+    t->next = s_tasks;
+    s_tasks = t;
+    s_task_count++;
+    pthread_mutex_unlock(&s_tasks_lock);
+
+    if (out)
+        *out = t;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, t->stack, t->stack_size);
+    int err = pthread_create(&t->thread, &attr, task_trampoline, t);
+    pthread_attr_destroy(&attr);
+    if (err != 0)
+    {
+        task_unlist(t);
+        return pdFAIL;
+    }
+    pthread_detach(t->thread);
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    // Threads the shim didn't start (main, httpd, ...) get a handle lazily
+    if (t_self == NULL)
+        t_self = task_new("ext");
+    return t_self;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return t_self ? t_self->core : 0;
+}
+
+const char *pcTaskGetName(TaskHandle_t task)
+{
+    return (task ? task : xTaskGetCurrentTaskHandle())->name;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == t_self)
+    {
+        if (t_self)
+            task_unlist(t_self);
+        pthread_exit(NULL);
+    }
+    task_unlist(task);
+    pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {.tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000L};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+// Sleeps until *prev + period and advances *prev by period, so a periodic
+// task keeps its cadence however long each iteration took
+void vTaskDelayUntil(TickType_t *prev, TickType_t period)
+{
+    *prev += period;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(*prev - now) > 0)
+        vTaskDelay(*prev - now);
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct sim_task *t = xTaskGetCurrentTaskHandle();
+    struct timespec deadline = deadline_after(ticks);
+
+    pthread_mutex_lock(&t->lock);
+    while (t->notify == 0)
+    {
+        if (!cond_wait_ticks(&t->cond, &t->lock, &deadline, ticks))
+            break;
+    }
+    uint32_t value = t->notify;
+    if (value > 0)
+        t->notify = clear_on_exit ? 0 : value - 1;
+    pthread_mutex_unlock(&t->lock);
+    return value;
+}
+
+// --- RUN-TIME STATS ---
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    return s_task_count;
+}
+
+// The stack grows down, so the untouched paint is at the low end
+static uint32_t stack_free(const struct sim_task *t)
+{
+    size_t untouched = 0;
+    while (untouched < t->stack_size && t->stack[untouched] == STACK_PAINT)
+        untouched++;
+    return (uint32_t)untouched;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    struct sim_task *t = task ? task : xTaskGetCurrentTaskHandle();
+    return t->stack ? stack_free(t) : 0;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *out, UBaseType_t max, configRUN_TIME_COUNTER_TYPE *total_run_time)
+{
+    UBaseType_t n = 0;
+    pthread_mutex_lock(&s_tasks_lock);
+    if (s_task_count <= max)
+    {
+        for (struct sim_task *t = s_tasks; t; t = t->next, n++)
+        {
+            clockid_t clock;
+            struct timespec ts = {0};
+            if (pthread_getcpuclockid(t->thread, &clock) == 0)
+                clock_gettime(clock, &ts);
+            out[n] = (TaskStatus_t){
+                .xHandle = t,
+                .pcTaskName = t->name,
+                .xTaskNumber = t->number,
+                .eCurrentState = t == t_self ? eRunning : eBlocked,
+                .uxCurrentPriority = t->prio,
+                .uxBasePriority = t->prio,
+                .ulRunTimeCounter = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000,
+                .usStackHighWaterMark = stack_free(t),
+            };
+        }
+    }
+    pthread_mutex_unlock(&s_tasks_lock);
+    if (total_run_time)
+        *total_run_time = (configRUN_TIME_COUNTER_TYPE)esp_timer_get_time();
+    return n;
+}
+
+// --- QUEUES ---
+
+struct sim_queue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length, item_size, head, count;
+    uint8_t *items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct sim_queue *q = calloc(1, sizeof(*q));
+    q->length = length;
+    q->item_size = item_size;
+    q->items = calloc(length, item_size);
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, monotonic_attr());
+    pthread_cond_init(&q->not_full, monotonic_attr());
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    struct timespec deadline = deadline_after(ticks);
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->length)
+    {
+        if (!cond_wait_ticks(&q->not_full, &q->lock, &deadline, ticks))
+        {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+    memcpy(q->items + ((q->head + q->count) % q->length) * q->item_size, item, q->item_size);
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    struct timespec deadline = deadline_after(ticks);
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0)
+    {
+        if (!cond_wait_ticks(&q->not_empty, &q->lock, &deadline, ticks))
+        {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+    memcpy(item, q->items + q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->head = 0;
+    q->count = 0;
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+// --- SEMAPHORES ---
+
+struct sim_sem
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t count, max;
+};
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    struct sim_sem *s = calloc(1, sizeof(*s));
+    s->max = max;
+    s->count = initial;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, monotonic_attr());
+    return s;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks)
+{
+    struct timespec deadline = deadline_after(ticks);
+
+    pthread_mutex_lock(&s->lock);
+    while (s->count == 0)
+    {
+        if (!cond_wait_ticks(&s->cond, &s->lock, &deadline, ticks))
+        {
+            pthread_mutex_unlock(&s->lock);
+            return pdFALSE;
+        }
+    }
+    s->count--;
+    pthread_mutex_unlock(&s->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    BaseType_t ok = pdFALSE;
+    pthread_mutex_lock(&s->lock);
+    if (s->count < s->max)
+    {
+        s->count++;
+        ok = pdTRUE;
+        pthread_cond_signal(&s->cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return ok;
+}
+
+// --- EVENT GROUPS ---
+
+struct sim_event_group
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct sim_event_group *eg = calloc(1, sizeof(*eg));
+    pthread_mutex_init(&eg->lock, NULL);
+    pthread_cond_init(&eg->cond, monotonic_attr());
+    return eg;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t eg, EventBits_t bits)
+{
+    pthread_mutex_lock(&eg->lock);
+    eg->bits |= bits;
+    EventBits_t now = eg->bits;
+    pthread_cond_broadcast(&eg->cond);
+    pthread_mutex_unlock(&eg->lock);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t eg, EventBits_t bits)
+{
+    pthread_mutex_lock(&eg->lock);
+    EventBits_t before = eg->bits;
+    eg->bits &= ~bits;
+    pthread_cond_broadcast(&eg->cond);
+    pthread_mutex_unlock(&eg->lock);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t eg)
+{
+    pthread_mutex_lock(&eg->lock);
+    EventBits_t now = eg->bits;
+    pthread_mutex_unlock(&eg->lock);
+    return now;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t eg, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks)
+{
+    struct timespec deadline = deadline_after(ticks);
+
+    pthread_mutex_lock(&eg->lock);
+    while (wait_for_all ? (eg->bits & bits) != bits : (eg->bits & bits) == 0)
+    {
+        if (!cond_wait_ticks(&eg->cond, &eg->lock, &deadline, ticks))
+            break;
+    }
+    EventBits_t now = eg->bits;
+    bool met = wait_for_all ? (now & bits) == bits : (now & bits) != 0;
+    if (met && clear_on_exit)
+        eg->bits &= ~bits;
+    pthread_mutex_unlock(&eg->lock);
+    return now;
+}
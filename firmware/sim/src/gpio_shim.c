@@ -0,0 +1,105 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "plant.h"
+
+static const char *TAG = "SIM_GPIO";
+
+static atomic_uint s_level[GPIO_NUM_MAX];
+static atomic_uint s_toggles[GPIO_NUM_MAX];
+
+esp_err_t gpio_reset_pin(gpio_num_t pin)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+    atomic_store(&s_level[pin], 0);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode)
+{
+    return pin >= 0 && pin < GPIO_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    unsigned v = level ? 1 : 0;
+    if (atomic_exchange(&s_level[pin], v) != v)
+    {
+        atomic_fetch_add(&s_toggles[pin], 1);
+        ESP_LOGD(TAG, "GPIO%d -> %u", pin, v);
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin)
+{
+    return pin >= 0 && pin < GPIO_NUM_MAX ? (int)atomic_load(&s_level[pin]) : 0;
+}
+
+uint32_t sim_gpio_toggles(gpio_num_t pin)
+{
+    return pin >= 0 && pin < GPIO_NUM_MAX ? atomic_load(&s_toggles[pin]) : 0;
+}
+
+void sim_gpio_strap(gpio_num_t pin, uint32_t level)
+{
+    if (pin >= 0 && pin < GPIO_NUM_MAX)
+        atomic_store(&s_level[pin], level ? 1 : 0);
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t pin, gpio_pull_mode_t mode)
+{
+    return pin >= 0 && pin < GPIO_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t type)
+{
+    return pin >= 0 && pin < GPIO_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+    return ESP_OK;
+}
+
+// --- TACHOMETER ---
+// One edge per half revolution of the plant's fan, delivered to the tach
+// pin's handler like an interrupt would be
+
+static gpio_isr_t s_tach_isr;
+static void *s_tach_arg;
+
+static void *tach_thread(void *arg)
+{
+    while (1)
+    {
+        uint32_t rpm = sim_plant_fan_rpm();
+        long period_us = rpm >= 30 ? (long)(60000000u / (rpm * 2)) : 50000;
+        struct timespec ts = {.tv_sec = period_us / 1000000, .tv_nsec = (period_us % 1000000) * 1000};
+        nanosleep(&ts, NULL);
+        if (rpm >= 30)
+            s_tach_isr(s_tach_arg);
+    }
+    return NULL;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t handler, void *arg)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX || handler == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (pin != SIM_PLANT_TACH_PIN || s_tach_isr != NULL)
+        return ESP_OK; // Nothing else in the plant ever toggles an input
+
+    s_tach_isr = handler;
+    s_tach_arg = arg;
+    pthread_t thread;
+    pthread_create(&thread, NULL, tach_thread, NULL);
+    pthread_detach(thread);
+    return ESP_OK;
+}
@@ -0,0 +1,959 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_http_server.h"
+#include "esp_wifi.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sim.h"
+
+static const char *TAG = "SIM_HTTPD";
+
+#define MAX_URIS        16
+#define REQ_BUF_SIZE    2048
+#define WORK_QUEUE_LEN  32
+
+typedef struct
+{
+    int fd;                 // -1 when free
+    bool ws;
+    const httpd_uri_t *uri;
+    int64_t last_us;        // For LRU purge
+    bool async;             // Handler handed the request to another task: not read here
+    void *ctx;
+    void (*free_ctx)(void *);
+
+    // HTTP request being read
+    char req[REQ_BUF_SIZE];
+    size_t req_len;
+
+    // Plain HTTP request body: what came in with the headers, then the socket
+    const char *body;       // Into req
+    size_t body_buffered;
+    size_t body_left;       // Content-Length not yet handed out
+
+    // Plain HTTP response being written
+    const char *query;      // Into req, NUL-terminated; NULL if none
+    const char *status;
+    const char *type;
+    char hdrs[256];
+    size_t hdrs_len;
+    bool resp_started;
+    bool resp_chunked;
+
+    // Current WebSocket frame: header parsed, payload still on the socket
+    uint8_t opcode;
+    bool fin;
+    bool masked;
+    uint8_t mask[4];
+    size_t len;
+    bool unread;
+} sess_t;
+
+typedef struct
+{
+    httpd_work_fn_t fn;
+    void *arg;
+    int close_fd;           // >= 0: a close request instead of work
+} work_t;
+
+typedef struct
+{
+    httpd_config_t cfg;
+    int listen_fd;
+    int ctrl[2];            // Self-pipe to wake select()
+    httpd_uri_t uris[MAX_URIS];
+    int nuris;
+
+    pthread_mutex_t lock;   // Sessions and the work queue
+    pthread_mutex_t send_lock;
+    sess_t *sess;
+    work_t work[WORK_QUEUE_LEN];
+    int work_head, work_count;
+} server_t;
+
+// --- SHA-1 / BASE64 (for Sec-WebSocket-Accept) ---
+
+static uint32_t rol(uint32_t v, int n)
+{
+    return (v << n) | (v >> (32 - n));
+}
+
+static void sha1(const uint8_t *msg, size_t len, uint8_t out[20])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    size_t total = ((len + 8) / 64 + 1) * 64;
+    uint8_t buf[256];
+    if (total > sizeof(buf))
+        return;
+
+    memset(buf, 0, total);
+    memcpy(buf, msg, len);
+    buf[len] = 0x80;
+    uint64_t bits = (uint64_t)len * 8;
+    for (int i = 0; i < 8; i++)
+        buf[total - 1 - i] = (uint8_t)(bits >> (8 * i));
+
+    for (size_t off = 0; off < total; off += 64)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++)
+            w[i] = (uint32_t)buf[off + 4 * i] << 24 | (uint32_t)buf[off + 4 * i + 1] << 16 |
+                   (uint32_t)buf[off + 4 * i + 2] << 8 | buf[off + 4 * i + 3];
+        for (int i = 16; i < 80; i++)
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++)
+        {
+            uint32_t f, k;
+            if (i < 20)
+                f = (b & c) | (~b & d), k = 0x5A827999;
+            else if (i < 40)
+                f = b ^ c ^ d, k = 0x6ED9EBA1;
+            else if (i < 60)
+                f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+            else
+                f = b ^ c ^ d, k = 0xCA62C1D6;
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d, d = c, c = rol(b, 30), b = a, a = t;
+        }
+        h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e;
+    }
+    for (int i = 0; i < 5; i++)
+        for (int j = 0; j < 4; j++)
+            out[4 * i + j] = (uint8_t)(h[i] >> (24 - 8 * j));
+}
+
+static void base64(const uint8_t *in, size_t len, char *out)
+{
+    static const char tbl[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < len; i += 3)
+    {
+        uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < len ? in[i + 1] << 8 : 0) | (i + 2 < len ? in[i + 2] : 0);
+        out[o++] = tbl[(v >> 18) & 63];
+        out[o++] = tbl[(v >> 12) & 63];
+        out[o++] = i + 1 < len ? tbl[(v >> 6) & 63] : '=';
+        out[o++] = i + 2 < len ? tbl[v & 63] : '=';
+    }
+    out[o] = '\0';
+}
+
+// --- SOCKET HELPERS ---
+
+static bool send_all(int fd, const void *data, size_t len)
+{
+    sim_wifi_tx();
+    const uint8_t *p = data;
+    while (len > 0)
+    {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool recv_all(int fd, void *data, size_t len)
+{
+    uint8_t *p = data;
+    while (len > 0)
+    {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static void wake(server_t *srv)
+{
+    char c = 0;
+    (void)!write(srv->ctrl[1], &c, 1);
+}
+
+// --- SESSIONS ---
+
+static sess_t *sess_find(server_t *srv, int fd)
+{
+    for (int i = 0; i < srv->cfg.max_open_sockets; i++)
+    {
+        if (srv->sess[i].fd == fd)
+            return &srv->sess[i];
+    }
+    return NULL;
+}
+
+// Server task only
+static void sess_close(server_t *srv, sess_t *s)
+{
+    int fd = s->fd;
+
+    pthread_mutex_lock(&srv->lock);
+    s->fd = -1;
+    pthread_mutex_unlock(&srv->lock);
+    s->async = false;
+
+    if (s->free_ctx && s->ctx)
+        s->free_ctx(s->ctx);
+    s->ctx = NULL;
+    s->free_ctx = NULL;
+
+    if (srv->cfg.close_fn)
+        srv->cfg.close_fn(srv, fd);
+    else
+        close(fd);
+    ESP_LOGD(TAG, "Closed fd %d", fd);
+}
+
+static void sess_accept(server_t *srv)
+{
+    int fd = accept(srv->listen_fd, NULL, NULL);
+    if (fd < 0)
+        return;
+    if (!sim_wifi_link_up())
+    {
+        // Off the air nobody can reach us; don't let loopback pretend otherwise
+        close(fd);
+        return;
+    }
+
+    sess_t *s = sess_find(srv, -1);
+    if (s == NULL && srv->cfg.lru_purge_enable)
+    {
+        sess_t *lru = NULL;
+        for (int i = 0; i < srv->cfg.max_open_sockets; i++)
+        {
+            if (!srv->sess[i].async && (lru == NULL || srv->sess[i].last_us < lru->last_us))
+                lru = &srv->sess[i];
+        }
+        ESP_LOGW(TAG, "Session table full, purging LRU fd %d", lru->fd);
+        sess_close(srv, lru);
+        s = lru;
+    }
+    if (s == NULL || s->async)
+    {
+        ESP_LOGW(TAG, "Session table full, refusing connection");
+        close(fd);
+        return;
+    }
+
+    struct timeval rcv = {.tv_sec = srv->cfg.recv_wait_timeout};
+    struct timeval snd = {.tv_sec = srv->cfg.send_wait_timeout};
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &rcv, sizeof(rcv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &snd, sizeof(snd));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    memset(s, 0, sizeof(*s));
+    s->last_us = esp_timer_get_time();
+    pthread_mutex_lock(&srv->lock);
+    s->fd = fd;
+    pthread_mutex_unlock(&srv->lock);
+
+    if (srv->cfg.open_fn && srv->cfg.open_fn(srv, fd) != ESP_OK)
+        sess_close(srv, s);
+}
+
+// --- HTTP ---
+
+static const char *header_value(const char *req, const char *name, size_t *len)
+{
+    size_t nlen = strlen(name);
+    for (const char *line = strstr(req, "\r\n"); line && line[2] != '\r'; line = strstr(line + 2, "\r\n"))
+    {
+        const char *h = line + 2;
+        if (strncasecmp(h, name, nlen) == 0 && h[nlen] == ':')
+        {
+            const char *v = h + nlen + 1;
+            while (*v == ' ')
+                v++;
+            const char *end = strstr(v, "\r\n");
+            *len = (size_t)(end - v);
+            return v;
+        }
+    }
+    return NULL;
+}
+
+static const httpd_uri_t *uri_match(server_t *srv, const char *path, size_t path_len, int method)
+{
+    for (int i = 0; i < srv->nuris; i++)
+    {
+        const httpd_uri_t *u = &srv->uris[i];
+        if ((int)u->method == method && strlen(u->uri) == path_len && strncmp(u->uri, path, path_len) == 0)
+            return u;
+    }
+    return NULL;
+}
+
+static bool call_handler(server_t *srv, sess_t *s, const httpd_uri_t *uri, int method)
+{
+    httpd_req_t req = {
+        .handle = srv,
+        .method = method,
+        .uri = uri->uri,
+        .content_len = s->ws ? 0 : s->body_left,
+        .user_ctx = uri->user_ctx,
+        .sess_ctx = s->ctx,
+        .aux = s,
+    };
+    esp_err_t err = uri->handler(&req);
+    s->ctx = req.sess_ctx;
+    return err == ESP_OK;
+}
+
+// --- PLAIN HTTP RESPONSES ---
+
+static bool resp_write(server_t *srv, sess_t *s, const char *data, size_t len)
+{
+    pthread_mutex_lock(&srv->send_lock);
+    bool ok = send_all(s->fd, data, len);
+    pthread_mutex_unlock(&srv->send_lock);
+    return ok;
+}
+
+// Status line and headers, with either a length or chunked encoding
+static bool resp_start(server_t *srv, sess_t *s, ssize_t content_len)
+{
+    char head[512];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: %s\r\n%.*sConnection: close\r\n",
+                     s->status, s->type, (int)s->hdrs_len, s->hdrs);
+    if (content_len >= 0)
+        n += snprintf(head + n, sizeof(head) - n, "Content-Length: %zd\r\n\r\n", content_len);
+    else
+        n += snprintf(head + n, sizeof(head) - n, "Transfer-Encoding: chunked\r\n\r\n");
+    s->resp_started = true;
+    s->resp_chunked = content_len < 0;
+    return resp_write(srv, s, head, (size_t)n);
+}
+
+// Runs a plain GET or POST handler; the connection is closed afterwards
+static bool handle_plain(server_t *srv, sess_t *s, const httpd_uri_t *uri, int method,
+                         char *query, size_t query_len)
+{
+    size_t len_len = 0;
+    const char *content_len = header_value(s->req, "Content-Length", &len_len);
+    const char *body = strstr(s->req, "\r\n\r\n") + 4;
+    s->body = body;
+    s->body_left = content_len ? strtoul(content_len, NULL, 10) : 0;
+    s->body_buffered = (size_t)(s->req + s->req_len - body);
+    if (s->body_buffered > s->body_left)
+        s->body_buffered = s->body_left;
+
+    if (query)
+        query[query_len] = '\0'; // Overwrites the space before "HTTP/1.1"
+    s->query = query;
+    s->status = "200 OK";
+    s->type = "text/html";
+    s->hdrs_len = 0;
+    s->resp_started = false;
+
+    bool ok = call_handler(srv, s, uri, method);
+    if (s->async)
+        return true; // httpd_req_async_handler_complete() closes it
+    if (!s->resp_started)
+    {
+        const char *resp = ok ? "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+                              : "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        resp_write(srv, s, resp, strlen(resp));
+    }
+    return false;
+}
+
+// Returns false if the session should be closed
+static bool handle_http(server_t *srv, sess_t *s)
+{
+    ssize_t n = recv(s->fd, s->req + s->req_len, sizeof(s->req) - 1 - s->req_len, 0);
+    if (n <= 0)
+        return false;
+    s->req_len += (size_t)n;
+    s->req[s->req_len] = '\0';
+
+    if (strstr(s->req, "\r\n\r\n") == NULL)
+        return s->req_len < sizeof(s->req) - 1;
+
+    // "GET /path HTTP/1.1"
+    const char *sp1 = strchr(s->req, ' ');
+    const char *sp2 = sp1 ? strchr(sp1 + 1, ' ') : NULL;
+    if (sp2 == NULL)
+        return false;
+    const char *path = sp1 + 1;
+    size_t path_len = (size_t)(sp2 - path);
+    char *q = memchr(path, '?', path_len);
+    if (q)
+        path_len = (size_t)(q - path);
+    int method = strncmp(s->req, "GET ", 4) == 0 ? HTTP_GET : (strncmp(s->req, "POST ", 5) == 0 ? HTTP_POST : -1);
+
+    size_t key_len = 0, up_len = 0;
+    const char *key = header_value(s->req, "Sec-WebSocket-Key", &key_len);
+    const char *upgrade = header_value(s->req, "Upgrade", &up_len);
+    const httpd_uri_t *uri = uri_match(srv, path, path_len, method);
+
+    if (uri != NULL && !uri->is_websocket)
+        return handle_plain(srv, s, uri, method, q ? q + 1 : NULL, q ? (size_t)(sp2 - q - 1) : 0);
+
+    if (uri == NULL || !uri->is_websocket || key == NULL || upgrade == NULL ||
+        strncasecmp(upgrade, "websocket", up_len) != 0 || key_len > 64)
+    {
+        const char *resp = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_all(s->fd, resp, strlen(resp));
+        return false;
+    }
+
+    char concat[128];
+    uint8_t digest[20];
+    char accept_key[32];
+    snprintf(concat, sizeof(concat), "%.*s258EAFA5-E914-47DA-95CA-C5AB0DC85B11", (int)key_len, key);
+    sha1((const uint8_t *)concat, strlen(concat), digest);
+    base64(digest, sizeof(digest), accept_key);
+
+    char resp[256];
+    int len = snprintf(resp, sizeof(resp),
+                       "HTTP/1.1 101 Switching Protocols\r\n"
+                       "Upgrade: websocket\r\n"
+                       "Connection: Upgrade\r\n"
+                       "Sec-WebSocket-Accept: %s\r\n\r\n",
+                       accept_key);
+    pthread_mutex_lock(&srv->send_lock);
+    bool ok = send_all(s->fd, resp, (size_t)len);
+    pthread_mutex_unlock(&srv->send_lock);
+    if (!ok)
+        return false;
+
+    s->ws = true;
+    s->uri = uri;
+    return call_handler(srv, s, uri, HTTP_GET);
+}
+
+// --- WEBSOCKET ---
+
+static esp_err_t ws_send(server_t *srv, int fd, const httpd_ws_frame_t *f)
+{
+    uint8_t hdr[10];
+    size_t hlen = 2;
+
+    // Unfragmented frames are always final, as in esp_http_server
+    bool fin = f->fragmented ? f->final : true;
+    hdr[0] = (uint8_t)((fin ? 0x80 : 0) | (f->type & 0x0F));
+    if (f->len < 126)
+    {
+        hdr[1] = (uint8_t)f->len;
+    }
+    else if (f->len <= 0xFFFF)
+    {
+        hdr[1] = 126;
+        hdr[2] = (uint8_t)(f->len >> 8);
+        hdr[3] = (uint8_t)f->len;
+        hlen = 4;
+    }
+    else
+    {
+        hdr[1] = 127;
+        for (int i = 0; i < 8; i++)
+            hdr[2 + i] = (uint8_t)((uint64_t)f->len >> (56 - 8 * i));
+        hlen = 10;
+    }
+
+    pthread_mutex_lock(&srv->send_lock);
+    bool ok = send_all(fd, hdr, hlen) && (f->len == 0 || send_all(fd, f->payload, f->len));
+    pthread_mutex_unlock(&srv->send_lock);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+static bool ws_read_header(sess_t *s)
+{
+    uint8_t h[2];
+    if (!recv_all(s->fd, h, 2))
+        return false;
+
+    s->fin = h[0] & 0x80;
+    s->opcode = h[0] & 0x0F;
+    s->masked = h[1] & 0x80;
+    s->len = h[1] & 0x7F;
+    if (s->len == 126)
+    {
+        uint8_t e[2];
+        if (!recv_all(s->fd, e, 2))
+            return false;
+        s->len = (size_t)e[0] << 8 | e[1];
+    }
+    else if (s->len == 127)
+    {
+        uint8_t e[8];
+        if (!recv_all(s->fd, e, 8))
+            return false;
+        s->len = 0;
+        for (int i = 0; i < 8; i++)
+            s->len = s->len << 8 | e[i];
+    }
+    if (s->masked && !recv_all(s->fd, s->mask, 4))
+        return false;
+    s->unread = true;
+    return true;
+}
+
+static bool ws_read_payload(sess_t *s, uint8_t *buf)
+{
+    if (s->len && !recv_all(s->fd, buf, s->len))
+        return false;
+    if (s->masked)
+    {
+        for (size_t i = 0; i < s->len; i++)
+            buf[i] ^= s->mask[i & 3];
+    }
+    s->unread = false;
+    return true;
+}
+
+static bool ws_discard_payload(sess_t *s)
+{
+    uint8_t junk[256];
+    size_t left = s->len;
+    while (left > 0)
+    {
+        size_t n = left < sizeof(junk) ? left : sizeof(junk);
+        if (!recv_all(s->fd, junk, n))
+            return false;
+        left -= n;
+    }
+    s->unread = false;
+    return true;
+}
+
+// Returns false if the session should be closed
+static bool handle_ws(server_t *srv, sess_t *s)
+{
+    if (!ws_read_header(s))
+        return false;
+
+    if (s->opcode >= HTTPD_WS_TYPE_CLOSE && !s->uri->handle_ws_control_frames)
+    {
+        uint8_t payload[125];
+        if (s->len > sizeof(payload) || !ws_read_payload(s, payload))
+            return false;
+
+        httpd_ws_frame_t reply = {.payload = payload, .len = s->len};
+        switch (s->opcode)
+        {
+        case HTTPD_WS_TYPE_PING:
+            reply.type = HTTPD_WS_TYPE_PONG;
+            return ws_send(srv, s->fd, &reply) == ESP_OK;
+        case HTTPD_WS_TYPE_CLOSE:
+            reply.type = HTTPD_WS_TYPE_CLOSE;
+            ws_send(srv, s->fd, &reply);
+            return false;
+        default:
+            return true;
+        }
+    }
+
+    bool ok = call_handler(srv, s, s->uri, -1);
+    if (ok && s->unread)
+        ok = ws_discard_payload(s);
+    return ok;
+}
+
+// --- SERVER TASK ---
+
+static void httpd_task(void *arg)
+{
+    server_t *srv = arg;
+
+    while (1)
+    {
+        fd_set rd;
+        FD_ZERO(&rd);
+        FD_SET(srv->listen_fd, &rd);
+        FD_SET(srv->ctrl[0], &rd);
+        int maxfd = srv->listen_fd > srv->ctrl[0] ? srv->listen_fd : srv->ctrl[0];
+        for (int i = 0; i < srv->cfg.max_open_sockets; i++)
+        {
+            if (srv->sess[i].fd >= 0 && !srv->sess[i].async)
+            {
+                FD_SET(srv->sess[i].fd, &rd);
+                if (srv->sess[i].fd > maxfd)
+                    maxfd = srv->sess[i].fd;
+            }
+        }
+
+        if (select(maxfd + 1, &rd, NULL, NULL, NULL) < 0)
+            continue;
+
+        // Whatever came in from a client waits for the radio to wake
+        bool inbound = FD_ISSET(srv->listen_fd, &rd);
+        for (int i = 0; i < srv->cfg.max_open_sockets && !inbound; i++)
+            inbound = srv->sess[i].fd >= 0 && !srv->sess[i].async && FD_ISSET(srv->sess[i].fd, &rd);
+        if (inbound)
+            sim_wifi_rx();
+
+        if (FD_ISSET(srv->ctrl[0], &rd))
+        {
+            char drain[64];
+            (void)!read(srv->ctrl[0], drain, sizeof(drain));
+
+            while (1)
+            {
+                pthread_mutex_lock(&srv->lock);
+                if (srv->work_count == 0)
+                {
+                    pthread_mutex_unlock(&srv->lock);
+                    break;
+                }
+                work_t w = srv->work[srv->work_head];
+                srv->work_head = (srv->work_head + 1) % WORK_QUEUE_LEN;
+                srv->work_count--;
+                pthread_mutex_unlock(&srv->lock);
+
+                if (w.close_fd >= 0)
+                {
+                    sess_t *s = sess_find(srv, w.close_fd);
+                    if (s)
+                        sess_close(srv, s);
+                }
+                else
+                {
+                    w.fn(w.arg);
+                }
+            }
+        }
+
+        if (FD_ISSET(srv->listen_fd, &rd))
+            sess_accept(srv);
+
+        for (int i = 0; i < srv->cfg.max_open_sockets; i++)
+        {
+            sess_t *s = &srv->sess[i];
+            if (s->fd < 0 || s->async || !FD_ISSET(s->fd, &rd))
+                continue;
+
+            s->last_us = esp_timer_get_time();
+            bool keep = s->ws ? handle_ws(srv, s) : handle_http(srv, s);
+            if (!keep && s->fd >= 0)
+                sess_close(srv, s);
+        }
+    }
+}
+
+// --- API ---
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+    server_t *srv = calloc(1, sizeof(*srv));
+    srv->cfg = *config;
+    if (g_sim.http_port)
+        srv->cfg.server_port = g_sim.http_port;
+
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(srv->cfg.server_port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(srv->listen_fd, srv->cfg.backlog_conn) != 0)
+    {
+        ESP_LOGE(TAG, "Can't listen on 127.0.0.1:%u: %s", srv->cfg.server_port, strerror(errno));
+        close(srv->listen_fd);
+        free(srv);
+        return ESP_FAIL;
+    }
+
+    srv->sess = calloc(srv->cfg.max_open_sockets, sizeof(sess_t));
+    for (int i = 0; i < srv->cfg.max_open_sockets; i++)
+        srv->sess[i].fd = -1;
+    pthread_mutex_init(&srv->lock, NULL);
+    pthread_mutex_init(&srv->send_lock, NULL);
+    if (pipe(srv->ctrl) != 0)
+        abort();
+
+    ESP_LOGI(TAG, "Serving on ws://127.0.0.1:%u", srv->cfg.server_port);
+    xTaskCreatePinnedToCore(httpd_task, "httpd", srv->cfg.stack_size, srv,
+                            srv->cfg.task_priority, NULL, srv->cfg.core_id);
+    *handle = srv;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    // The simulator never tears a server down; the process exits instead
+    return ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri)
+{
+    server_t *srv = handle;
+    if (srv->nuris == MAX_URIS)
+        return ESP_ERR_NO_MEM;
+    srv->uris[srv->nuris++] = *uri;
+    return ESP_OK;
+}
+
+static esp_err_t queue_work(server_t *srv, work_t w)
+{
+    pthread_mutex_lock(&srv->lock);
+    if (srv->work_count == WORK_QUEUE_LEN)
+    {
+        pthread_mutex_unlock(&srv->lock);
+        return ESP_FAIL;
+    }
+    srv->work[(srv->work_head + srv->work_count) % WORK_QUEUE_LEN] = w;
+    srv->work_count++;
+    pthread_mutex_unlock(&srv->lock);
+    wake(srv);
+    return ESP_OK;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg)
+{
+    return queue_work(handle, (work_t){.fn = work, .arg = arg, .close_fd = -1});
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd)
+{
+    return queue_work(handle, (work_t){.close_fd = sockfd});
+}
+
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t *fds, int *client_fds)
+{
+    server_t *srv = handle;
+    size_t n = 0;
+
+    pthread_mutex_lock(&srv->lock);
+    for (int i = 0; i < srv->cfg.max_open_sockets && n < *fds; i++)
+    {
+        if (srv->sess[i].fd >= 0)
+            client_fds[n++] = srv->sess[i].fd;
+    }
+    pthread_mutex_unlock(&srv->lock);
+    *fds = n;
+    return ESP_OK;
+}
+
+// The copy keeps the session: nothing more is read from it here until
+// complete, which closes it like any plain request
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out)
+{
+    httpd_req_t *copy = malloc(sizeof(*copy));
+    if (copy == NULL)
+        return ESP_ERR_NO_MEM;
+    *copy = *r;
+    ((sess_t *)r->aux)->async = true;
+    *out = copy;
+    return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r)
+{
+    sess_t *s = r->aux;
+    if (!s->resp_started)
+    {
+        const char *resp = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        resp_write(r->handle, s, resp, strlen(resp));
+    }
+    int fd = s->fd;
+    httpd_handle_t handle = r->handle;
+    free(r);
+    return httpd_sess_trigger_close(handle, fd);
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r)
+{
+    return ((sess_t *)r->aux)->fd;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *pkt, size_t max_len)
+{
+    sess_t *s = req->aux;
+
+    pkt->type = (httpd_ws_type_t)s->opcode;
+    pkt->final = s->fin;
+    pkt->fragmented = !s->fin || s->opcode == HTTPD_WS_TYPE_CONTINUE;
+    if (max_len == 0)
+    {
+        pkt->len = s->len;
+        return ESP_OK;
+    }
+    if (!s->unread)
+        return ESP_ERR_INVALID_STATE;
+    if (max_len < s->len)
+        return ESP_ERR_INVALID_SIZE;
+    if (!ws_read_payload(s, pkt->payload))
+        return ESP_FAIL;
+    pkt->len = s->len;
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *pkt)
+{
+    return ws_send(req->handle, httpd_req_to_sockfd(req), pkt);
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame)
+{
+    return ws_send(hd, fd, frame);
+}
+
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd)
+{
+    server_t *srv = hd;
+
+    pthread_mutex_lock(&srv->lock);
+    sess_t *s = sess_find(srv, fd);
+    httpd_ws_client_info_t info = s == NULL ? HTTPD_WS_CLIENT_INVALID
+                                            : (s->ws ? HTTPD_WS_CLIENT_WEBSOCKET : HTTPD_WS_CLIENT_HTTP);
+    pthread_mutex_unlock(&srv->lock);
+    return info;
+}
+
+// --- PLAIN HTTP API ---
+
+size_t httpd_req_get_url_query_len(httpd_req_t *r)
+{
+    sess_t *s = r->aux;
+    return s->query ? strlen(s->query) : 0;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t buf_len)
+{
+    sess_t *s = r->aux;
+    if (s->query == NULL)
+        return ESP_ERR_NOT_FOUND;
+    size_t len = strlen(s->query);
+    snprintf(buf, buf_len, "%s", s->query);
+    return len < buf_len ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size)
+{
+    size_t klen = strlen(key);
+    for (const char *p = qry; p && *p; p = strchr(p, '&') ? strchr(p, '&') + 1 : NULL)
+    {
+        if (strncmp(p, key, klen) != 0 || p[klen] != '=')
+            continue;
+        const char *v = p + klen + 1;
+        size_t vlen = strcspn(v, "&");
+        if (val_size == 0)
+            return ESP_ERR_HTTPD_RESULT_TRUNC;
+        size_t n = vlen < val_size - 1 ? vlen : val_size - 1;
+        memcpy(val, v, n);
+        val[n] = '\0';
+        return n == vlen ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len)
+{
+    sess_t *s = r->aux;
+    if (buf_len > s->body_left)
+        buf_len = s->body_left;
+    if (buf_len == 0)
+        return 0;
+
+    if (s->body_buffered > 0)
+    {
+        size_t n = buf_len < s->body_buffered ? buf_len : s->body_buffered;
+        memcpy(buf, s->body, n);
+        s->body += n;
+        s->body_buffered -= n;
+        s->body_left -= n;
+        return (int)n;
+    }
+
+    ssize_t n = recv(s->fd, buf, buf_len, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return HTTPD_SOCK_ERR_TIMEOUT;
+    if (n < 0)
+        return HTTPD_SOCK_ERR_FAIL;
+    s->body_left -= (size_t)n;
+    return (int)n;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    ((sess_t *)r->aux)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+    ((sess_t *)r->aux)->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+    sess_t *s = r->aux;
+    int n = snprintf(s->hdrs + s->hdrs_len, sizeof(s->hdrs) - s->hdrs_len, "%s: %s\r\n", field, value);
+    if (n < 0 || (size_t)n >= sizeof(s->hdrs) - s->hdrs_len)
+        return ESP_ERR_HTTPD_RESULT_TRUNC;
+    s->hdrs_len += (size_t)n;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    sess_t *s = r->aux;
+    if (buf_len == HTTPD_RESP_USE_STRLEN)
+        buf_len = buf ? (ssize_t)strlen(buf) : 0;
+    if (s->resp_started)
+        return ESP_ERR_INVALID_STATE;
+    bool ok = resp_start(r->handle, s, buf_len) && (buf_len == 0 || resp_write(r->handle, s, buf, (size_t)buf_len));
+    return ok ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    sess_t *s = r->aux;
+    if (buf_len == HTTPD_RESP_USE_STRLEN)
+        buf_len = buf ? (ssize_t)strlen(buf) : 0;
+    if (!s->resp_started && !resp_start(r->handle, s, -1))
+        return ESP_ERR_HTTPD_RESP_SEND;
+    if (!s->resp_chunked)
+        return ESP_ERR_INVALID_STATE;
+
+    // A NULL or empty chunk ends the response
+    char size[16];
+    int n = snprintf(size, sizeof(size), "%zx\r\n", buf_len);
+    bool ok = resp_write(r->handle, s, size, (size_t)n) &&
+              (buf_len == 0 || resp_write(r->handle, s, buf, (size_t)buf_len)) &&
+              resp_write(r->handle, s, "\r\n", 2);
+    return ok ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *r, httpd_err_code_t error, const char *msg)
+{
+    static const char *const status[] = {
+        [HTTPD_400_BAD_REQUEST] = "400 Bad Request",
+        [HTTPD_404_NOT_FOUND] = "404 Not Found",
+        [HTTPD_500_INTERNAL_SERVER_ERROR] = "500 Internal Server Error",
+    };
+    httpd_resp_set_status(r, status[error]);
+    httpd_resp_set_type(r, "text/plain");
+    httpd_resp_send(r, msg, HTTPD_RESP_USE_STRLEN);
+    // Like esp_http_server: the handler's error return closes the session
+    return ESP_FAIL;
+}
@@ -0,0 +1,51 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "esp_wifi.h"
+#include "esp_log.h"
+#include "sim.h"
+
+// Doesn't include lwip/sockets.h, so the calls below are the host's
+
+static const char *TAG = "SIM_LWIP";
+
+int sim_lwip_bind(int fd, const struct sockaddr *addr, socklen_t len)
+{
+    struct sockaddr_in in;
+    if (addr->sa_family != AF_INET || len < sizeof(in))
+        return bind(fd, addr, len);
+
+    memcpy(&in, addr, sizeof(in));
+    in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (g_sim.http_port)
+        in.sin_port = htons(g_sim.http_port);
+    ESP_LOGI(TAG, "UDP socket on 127.0.0.1:%u", ntohs(in.sin_port));
+    return bind(fd, (const struct sockaddr *)&in, sizeof(in));
+}
+
+ssize_t sim_lwip_recvfrom(int fd, void *buf, size_t len, int flags, struct sockaddr *from, socklen_t *from_len)
+{
+    for (;;)
+    {
+        ssize_t n = recvfrom(fd, buf, len, flags, from, from_len);
+        if (n < 0)
+            return n;
+        // Nothing gets to the board while it is off the network
+        if (!sim_wifi_link_up())
+            continue;
+        sim_wifi_rx();
+        return n;
+    }
+}
+
+ssize_t sim_lwip_sendto(int fd, const void *buf, size_t len, int flags, const struct sockaddr *to, socklen_t to_len)
+{
+    if (!sim_wifi_link_up())
+    {
+        errno = ENETUNREACH;
+        return -1;
+    }
+    sim_wifi_tx();
+    return sendto(fd, buf, len, flags, to, to_len);
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "sim.h"
+
+// --- NVS ---
+// A flat table of (namespace, key) -> blob. Handles are namespace slots.
+// The whole table is written out on every commit; it is tiny.
+
+#define MAX_NAMESPACES  8
+#define MAX_ENTRIES     32
+#define MAX_NAME        16      // Like NVS: 15 characters and the NUL
+#define MAX_VALUE       64
+
+typedef struct
+{
+    char ns[MAX_NAME];
+    char key[MAX_NAME];
+    uint16_t len;           // 0 when the slot is free
+    uint8_t value[MAX_VALUE];
+} entry_t;
+
+static const char *TAG = "SIM_NVS";
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static entry_t s_entries[MAX_ENTRIES];
+static char s_namespaces[MAX_NAMESPACES][MAX_NAME];
+static bool s_writable[MAX_NAMESPACES];
+static bool s_loaded;
+
+static void file_path(char *buf, size_t cap)
+{
+    snprintf(buf, cap, "%s.%s", g_sim.nvs_path, g_sim.name);
+}
+
+static entry_t *find(const char *ns, const char *key)
+{
+    for (int i = 0; i < MAX_ENTRIES; i++)
+    {
+        entry_t *e = &s_entries[i];
+        if (e->len && strcmp(e->ns, ns) == 0 && strcmp(e->key, key) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+// Called with s_lock held
+static esp_err_t store(const char *ns, const char *key, const void *value, size_t length)
+{
+    entry_t *e = find(ns, key);
+    for (int i = 0; i < MAX_ENTRIES && e == NULL; i++)
+    {
+        if (s_entries[i].len == 0)
+            e = &s_entries[i];
+    }
+    if (e == NULL)
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    strcpy(e->ns, ns);
+    strcpy(e->key, key);
+    memcpy(e->value, value, length);
+    e->len = (uint16_t)length;
+    return ESP_OK;
+}
+
+// --nvs-blob ns:key:hex, over whatever was loaded
+static void preload(const char *spec)
+{
+    char ns[MAX_NAME], key[MAX_NAME], hex[2 * MAX_VALUE + 1];
+    uint8_t value[MAX_VALUE];
+    size_t len = 0;
+    bool ok = sscanf(spec, "%15[^:]:%15[^:]:%128s", ns, key, hex) == 3 && strlen(hex) % 2 == 0;
+    for (; ok && hex[2 * len] != '\0'; len++)
+    {
+        unsigned byte;
+        ok = sscanf(hex + 2 * len, "%2x", &byte) == 1;
+        value[len] = (uint8_t)byte;
+    }
+    if (!ok || len == 0 || store(ns, key, value, len) != ESP_OK)
+        ESP_LOGE(TAG, "Bad --nvs-blob %s", spec);
+}
+
+// Called with s_lock held
+static void load_once(void)
+{
+    if (s_loaded)
+        return;
+    s_loaded = true;
+
+    char path[256];
+    FILE *f = NULL;
+    if (g_sim.nvs_path != NULL)
+    {
+        file_path(path, sizeof(path));
+        f = fopen(path, "rb");
+    }
+    if (f != NULL)
+    {
+        if (fread(s_entries, sizeof(s_entries), 1, f) != 1)
+            memset(s_entries, 0, sizeof(s_entries)); // Truncated or from another build
+        fclose(f);
+        ESP_LOGI(TAG, "Loaded %s", path);
+    }
+    for (int i = 0; i < g_sim.nvs_blob_count; i++)
+        preload(g_sim.nvs_blobs[i]);
+}
+
+esp_err_t nvs_open(const char *name_space, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    if (strlen(name_space) >= MAX_NAME)
+        return ESP_ERR_INVALID_ARG;
+
+    pthread_mutex_lock(&s_lock);
+    load_once();
+    int slot = -1;
+    for (int i = 0; i < MAX_NAMESPACES && slot < 0; i++)
+    {
+        if (s_namespaces[i][0] == '\0' || strcmp(s_namespaces[i], name_space) == 0)
+            slot = i;
+    }
+    if (slot >= 0)
+    {
+        strcpy(s_namespaces[slot], name_space);
+        s_writable[slot] = mode == NVS_READWRITE;
+    }
+    pthread_mutex_unlock(&s_lock);
+
+    if (slot < 0)
+        return ESP_ERR_NO_MEM;
+    *out = (nvs_handle_t)slot + 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+static const char *handle_ns(nvs_handle_t handle)
+{
+    return handle >= 1 && handle <= MAX_NAMESPACES ? s_namespaces[handle - 1] : NULL;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out, size_t *length)
+{
+    const char *ns = handle_ns(handle);
+    if (ns == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&s_lock);
+    entry_t *e = find(ns, key);
+    if (e == NULL)
+    {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    }
+    else if (out == NULL)
+    {
+        *length = e->len; // Size query, as on the chip
+    }
+    else if (*length < e->len)
+    {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    else
+    {
+        memcpy(out, e->value, e->len);
+        *length = e->len;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    const char *ns = handle_ns(handle);
+    if (ns == NULL || strlen(key) >= MAX_NAME || length == 0)
+        return ESP_ERR_INVALID_ARG;
+    if (length > MAX_VALUE)
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    if (!s_writable[handle - 1])
+        return ESP_ERR_NVS_READ_ONLY;
+
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = store(ns, key, value, length);
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    const char *ns = handle_ns(handle);
+    if (ns == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    pthread_mutex_lock(&s_lock);
+    entry_t *e = find(ns, key);
+    if (e != NULL)
+        memset(e, 0, sizeof(*e));
+    pthread_mutex_unlock(&s_lock);
+    return e != NULL ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    if (g_sim.nvs_path == NULL)
+        return ESP_OK;
+
+    char path[256];
+    file_path(path, sizeof(path));
+    pthread_mutex_lock(&s_lock);
+    FILE *f = fopen(path, "wb");
+    bool ok = f != NULL && fwrite(s_entries, sizeof(s_entries), 1, f) == 1;
+    if (f != NULL)
+        ok = fclose(f) == 0 && ok;
+    pthread_mutex_unlock(&s_lock);
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "Can't write %s", path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "sim.h"
+
+// --- OTA ---
+// Two slots the size of the ESP32 build's (partitions.csv), kept in RAM.
+// One image is open at a time, as the firmware uses it.
+
+#define SLOT_SIZE           0xF0000
+#define SECTOR_SIZE         4096
+// Flash timing with --baud: a 4 KB sector erase and page programming, as
+// typical for the ESP32 modules' SPI flash
+#define SECTOR_ERASE_US     45000
+#define WRITE_NS_PER_BYTE   2700
+
+static const char *TAG = "SIM_OTA";
+
+static const esp_partition_t s_slots[2] = {
+    {.label = "ota_0", .address = 0x10000, .size = SLOT_SIZE},
+    {.label = "ota_1", .address = 0x100000, .size = SLOT_SIZE},
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static const esp_partition_t *s_boot = &s_slots[0];
+static struct
+{
+    const esp_partition_t *slot;    // NULL when no image is open
+    esp_ota_handle_t handle;
+    uint8_t *data;
+    size_t len;
+} s_open;
+static esp_ota_handle_t s_next_handle = 1;
+
+static void flash_delay(size_t at, size_t len)
+{
+    if (!g_sim.baud)
+        return;
+    size_t erased = (at + len + SECTOR_SIZE - 1) / SECTOR_SIZE - (at + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    int64_t ns = (int64_t)erased * SECTOR_ERASE_US * 1000 + (int64_t)len * WRITE_NS_PER_BYTE;
+    struct timespec ts = {.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000};
+    nanosleep(&ts, NULL);
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return &s_slots[0];
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    return &s_slots[1];
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    if (partition == esp_ota_get_running_partition())
+        return ESP_ERR_OTA_PARTITION_CONFLICT;
+
+    pthread_mutex_lock(&s_lock);
+    if (s_open.slot != NULL)
+    {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    free(s_open.data);
+    s_open.data = malloc(partition->size);
+    s_open.len = 0;
+    s_open.slot = partition;
+    s_open.handle = s_next_handle++;
+    *out_handle = s_open.handle;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    pthread_mutex_lock(&s_lock);
+    if (s_open.slot == NULL || handle != s_open.handle)
+    {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_open.len + size > s_open.slot->size)
+    {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(s_open.data + s_open.len, data, size);
+    size_t at = s_open.len;
+    s_open.len += size;
+    pthread_mutex_unlock(&s_lock);
+
+    flash_delay(at, size);
+    return ESP_OK;
+}
+
+static void close_image(void)
+{
+    s_open.slot = NULL;
+    free(s_open.data);
+    s_open.data = NULL;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    pthread_mutex_lock(&s_lock);
+    if (s_open.slot == NULL || handle != s_open.handle)
+    {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t err = s_open.len > 0 ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+    if (err == ESP_OK && g_sim.ota_path != NULL)
+    {
+        char path[256];
+        snprintf(path, sizeof(path), "%s.%s", g_sim.ota_path, g_sim.name);
+        FILE *f = fopen(path, "wb");
+        if (f == NULL || fwrite(s_open.data, 1, s_open.len, f) != s_open.len)
+            err = ESP_FAIL;
+        if (f != NULL)
+            fclose(f);
+        ESP_LOGI(TAG, "Image of %zu bytes in %s written to %s", s_open.len, s_open.slot->label, path);
+    }
+    close_image();
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    pthread_mutex_lock(&s_lock);
+    if (s_open.slot != NULL && handle == s_open.handle)
+        close_image();
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    pthread_mutex_lock(&s_lock);
+    s_boot = partition;
+    pthread_mutex_unlock(&s_lock);
+    ESP_LOGI(TAG, "Boot slot is now %s", partition->label);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,79 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "esp_timer.h"
+#include "plant.h"
+
+#define AMBIENT_C       22.0
+#define HEATED_C        90.0
+#define TEMP_TAU_S      30.0
+#define RH_DRY          15.0
+#define RH_AMBIENT      55.0
+#define RH_TAU_S        60.0
+#define HEATER_A        8.0
+#define FAN_RPM         1800.0
+#define FAN_TAU_S       2.0
+#define NOISE_MV        2
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static int64_t s_last_us;
+static double s_temp_c = AMBIENT_C;
+static double s_rh = RH_AMBIENT;
+static double s_rpm;
+
+static double settle(double value, double target, double dt_s, double tau_s)
+{
+    return target + (value - target) * exp(-dt_s / tau_s);
+}
+
+// Advances the model to now and returns whether the heater is on. Called
+// with s_lock held.
+static bool plant_step(void)
+{
+    int64_t now = esp_timer_get_time();
+    double dt = s_last_us ? (now - s_last_us) / 1e6 : 0.0;
+    s_last_us = now;
+
+    bool heat = gpio_get_level(SIM_PLANT_HEATER_PIN) != 0;
+    bool fan = gpio_get_level(SIM_PLANT_FAN_PIN) != 0;
+    s_temp_c = settle(s_temp_c, heat ? HEATED_C : AMBIENT_C, dt, TEMP_TAU_S);
+    s_rh = settle(s_rh, heat ? RH_DRY : RH_AMBIENT, dt, RH_TAU_S);
+    s_rpm = settle(s_rpm, fan ? FAN_RPM : 0.0, dt, FAN_TAU_S);
+    return heat;
+}
+
+int sim_plant_adc_mv(adc_channel_t channel)
+{
+    pthread_mutex_lock(&s_lock);
+    bool heat = plant_step();
+    double mv;
+    switch (channel)
+    {
+    case ADC_CHANNEL_0: // LM35, 10 mV/degC
+        mv = s_temp_c * 10.0;
+        break;
+    case ADC_CHANNEL_3: // 0-3000 mV = 0-100 %RH
+        mv = s_rh * 30.0;
+        break;
+    case ADC_CHANNEL_6: // 100 mV/A
+        mv = heat ? HEATER_A * 100.0 : 0.0;
+        break;
+    default:
+        mv = 0.0;
+        break;
+    }
+    pthread_mutex_unlock(&s_lock);
+
+    int noisy = (int)lround(mv) + rand() % (2 * NOISE_MV + 1) - NOISE_MV;
+    return noisy < 0 ? 0 : noisy;
+}
+
+uint32_t sim_plant_fan_rpm(void)
+{
+    pthread_mutex_lock(&s_lock);
+    plant_step();
+    uint32_t rpm = (uint32_t)lround(s_rpm);
+    pthread_mutex_unlock(&s_lock);
+    return rpm;
+}
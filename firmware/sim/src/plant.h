@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include "driver/gpio.h"
+#include "esp_adc/adc_oneshot.h"
+
+// --- PLANT MODEL ---
+//
+// A crude dryer for the bottom board's sensors to look at. The heater and
+// fan follow their drive pins; temperature, humidity and fan speed settle
+// towards their on/off targets with first-order lags, so a heater driven at
+// a duty cycle settles in between. Outputs are what the bottom board's front
+// ends would put on the pins (see sensors.h and control.h there).
+
+#define SIM_PLANT_HEATER_PIN    25
+#define SIM_PLANT_FAN_PIN       26
+#define SIM_PLANT_TACH_PIN      27
+
+// Sensor voltage on an ADC1 channel, in mV, noise included
+int sim_plant_adc_mv(adc_channel_t channel);
+
+// Current fan speed
+uint32_t sim_plant_fan_rpm(void);
@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "esp_pm.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+
+// --- POWER MANAGEMENT ---
+// Lock counts decide whether the "CPU" would be at full speed; the meter
+// turns that and the radio's on-time into a current every report period.
+
+#define METER_PERIOD_S      10
+
+// ESP32 datasheet, both cores running, mid-range of each figure
+#define MA_CPU_MAX          35      // 160 MHz, radio in modem sleep: 27-44 mA
+#define MA_CPU_MIN          25      // 80 MHz: 20-31 mA
+#define MA_RADIO            65      // On top while it listens (95-100 mA total)
+
+struct sim_pm_lock
+{
+    esp_pm_lock_type_t type;
+    const char *name;
+    int count;
+};
+
+static const char *TAG = "SIM_PM";
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static esp_pm_config_t s_cfg;
+static bool s_configured;
+static int s_cpu_max_held;          // CPU_FREQ_MAX locks held, all of them
+static int64_t s_full_us;           // Time at full speed, up to s_full_at
+static int64_t s_full_at;
+static esp_timer_handle_t s_meter;
+
+// Called with s_lock held
+static void full_advance(int64_t now)
+{
+    if (!s_configured || s_cpu_max_held > 0)
+        s_full_us += now - s_full_at;
+    s_full_at = now;
+}
+
+static void meter_report(void *arg)
+{
+    static int64_t last_us, last_full_us, last_radio_us;
+
+    int64_t now = esp_timer_get_time();
+    pthread_mutex_lock(&s_lock);
+    full_advance(now);
+    int64_t full = s_full_us;
+    int max_mhz = s_configured ? s_cfg.max_freq_mhz : 0;
+    pthread_mutex_unlock(&s_lock);
+    int64_t radio = sim_wifi_radio_on_us();
+
+    double span = (double)(now - last_us);
+    double full_frac = (full - last_full_us) / span;
+    double radio_frac = (radio - last_radio_us) / span;
+    double ma = full_frac * MA_CPU_MAX + (1.0 - full_frac) * MA_CPU_MIN + radio_frac * MA_RADIO;
+    last_us = now;
+    last_full_us = full;
+    last_radio_us = radio;
+
+    if (max_mhz)
+        ESP_LOGI(TAG, "Last %d s: CPU at %d MHz %.1f%%, radio on %.1f%% -> ~%.0f mA", METER_PERIOD_S,
+                 max_mhz, full_frac * 100, radio_frac * 100, ma);
+    else
+        ESP_LOGI(TAG, "Last %d s: CPU at full speed (no DFS), radio on %.1f%% -> ~%.0f mA", METER_PERIOD_S,
+                 radio_frac * 100, ma);
+}
+
+// The meter starts with the first call into esp_pm; firmware that never
+// makes one gets no reports
+static void meter_start(void)
+{
+    if (s_meter)
+        return;
+    const esp_timer_create_args_t args = {.callback = meter_report, .name = "sim_pm_meter"};
+    esp_timer_create(&args, &s_meter);
+    esp_timer_start_periodic(s_meter, (uint64_t)METER_PERIOD_S * 1000000);
+}
+
+esp_err_t esp_pm_configure(const void *config)
+{
+    const esp_pm_config_t *cfg = config;
+    if (cfg->min_freq_mhz > cfg->max_freq_mhz)
+        return ESP_ERR_INVALID_ARG;
+
+    pthread_mutex_lock(&s_lock);
+    full_advance(esp_timer_get_time());
+    s_cfg = *cfg;
+    s_configured = true;
+    meter_start();
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_get_configuration(void *config)
+{
+    pthread_mutex_lock(&s_lock);
+    *(esp_pm_config_t *)config = s_cfg;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char *name, esp_pm_lock_handle_t *out)
+{
+    struct sim_pm_lock *l = calloc(1, sizeof(*l));
+    if (l == NULL)
+        return ESP_ERR_NO_MEM;
+    l->type = type;
+    l->name = name;
+    *out = l;
+
+    pthread_mutex_lock(&s_lock);
+    meter_start();
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+    pthread_mutex_lock(&s_lock);
+    full_advance(esp_timer_get_time());
+    handle->count++;
+    if (handle->type == ESP_PM_CPU_FREQ_MAX)
+        s_cpu_max_held++;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&s_lock);
+    if (handle->count == 0)
+    {
+        err = ESP_ERR_INVALID_STATE; // As IDF: released more than acquired
+    }
+    else
+    {
+        full_advance(esp_timer_get_time());
+        handle->count--;
+        if (handle->type == ESP_PM_CPU_FREQ_MAX)
+            s_cpu_max_held--;
+    }
+    pthread_mutex_unlock(&s_lock);
+    if (err != ESP_OK)
+        ESP_LOGE(TAG, "Lock \"%s\" released while not held", handle->name);
+    return err;
+}
+
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle)
+{
+    if (handle->count != 0)
+        return ESP_ERR_INVALID_STATE;
+    free(handle);
+    return ESP_OK;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- SIMULATOR OPTIONS ---
+// Filled in from the command line before app_main() runs. Only the shim
+// reads these; the firmware can't tell it isn't on an ESP32.
+
+#define SIM_NVS_BLOBS           4
+
+typedef struct
+{
+    const char *name;       // Log prefix, "top" or "bottom"
+    int uart_fd;            // Virtual link: socketpair end or pty
+    uint16_t http_port;     // Overrides httpd's server_port when non-zero
+    uint32_t baud;          // Link clean up to this rate and throttled; 0 = host speed
+    bool verbose;           // Enable ESP_LOGD
+    const char *nvs_path;   // Persist NVS to <path>.<name>; NULL = RAM only
+    const char *nvs_blobs[SIM_NVS_BLOBS]; // "ns:key:hex" put in NVS at boot, as provisioning would
+    int nvs_blob_count;
+    const char *ota_path;   // Write updated images to <path>.<name>; NULL = don't
+    uint32_t wifi_blip_s;   // Drop the Wi-Fi station this often; 0 = never
+    uint32_t link_degrade_s; // Link only clean up to 115200 after this; 0 = never
+    int node;               // On a bus: 0 the top controller, else this address; -1 = not
+} sim_opts_t;
+
+// The bus straps (aera_bus.h), as both firmwares' main.c wire them
+#define SIM_BUS_PIN             18
+#define SIM_BUS_ADDR_PINS       { 13, 14, 32, 33 }
+
+extern sim_opts_t g_sim;
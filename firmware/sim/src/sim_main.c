@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <termios.h>
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "sim.h"
+
+// Firmware entry point
+void app_main(void);
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s (--uart-fd N | --uart PATH) [--http-port P] [--baud B] [--name N]\n"
+            "          [--nvs PATH] [--nvs-blob NS:KEY:HEX] [--ota PATH] [--wifi-blip S] [--link-degrade S]\n"
+            "          [--node N] [--verbose]\n"
+            "  --uart-fd N     use an inherited fd (socketpair end) as the UART link\n"
+            "  --uart PATH     open a tty/pty as the UART link (e.g. one end of socat)\n"
+            "  --http-port P   serve httpd on P instead of the firmware's port\n"
+            "  --baud B        link is clean up to B baud; writes take as long as at\n"
+            "                  the firmware's rate (10 bits/byte)\n"
+            "  --nvs PATH      keep NVS in PATH.<name> across runs\n"
+            "  --nvs-blob NS:KEY:HEX  put this blob in NVS at boot, as provisioning\n"
+            "                  would (up to 4)\n"
+            "  --ota PATH      write each firmware update received to PATH.<name>\n"
+            "  --wifi-blip S   take the access point away every S seconds\n"
+            "  --link-degrade S  after S seconds the link is only clean up to 115200\n"
+            "  --node N        strap the board onto a bus: 0 for the top controller,\n"
+            "                  1..16 for a bottom controller at that address\n",
+            argv0);
+    exit(2);
+}
+
+static int open_tty(const char *path)
+{
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    if (isatty(fd))
+    {
+        struct termios tio;
+        tcgetattr(fd, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--verbose") == 0)
+        {
+            g_sim.verbose = true;
+            continue;
+        }
+        if (val == NULL)
+            usage(argv[0]);
+        i++;
+
+        if (strcmp(arg, "--uart-fd") == 0)
+            g_sim.uart_fd = atoi(val);
+        else if (strcmp(arg, "--uart") == 0)
+            g_sim.uart_fd = open_tty(val);
+        else if (strcmp(arg, "--http-port") == 0)
+            g_sim.http_port = (uint16_t)atoi(val);
+        else if (strcmp(arg, "--baud") == 0)
+            g_sim.baud = (uint32_t)strtoul(val, NULL, 10);
+        else if (strcmp(arg, "--name") == 0)
+            g_sim.name = val;
+        else if (strcmp(arg, "--nvs") == 0)
+            g_sim.nvs_path = val;
+        else if (strcmp(arg, "--nvs-blob") == 0 && g_sim.nvs_blob_count < SIM_NVS_BLOBS)
+            g_sim.nvs_blobs[g_sim.nvs_blob_count++] = val;
+        else if (strcmp(arg, "--ota") == 0)
+            g_sim.ota_path = val;
+        else if (strcmp(arg, "--wifi-blip") == 0)
+            g_sim.wifi_blip_s = (uint32_t)strtoul(val, NULL, 10);
+        else if (strcmp(arg, "--link-degrade") == 0)
+            g_sim.link_degrade_s = (uint32_t)strtoul(val, NULL, 10);
+        else if (strcmp(arg, "--node") == 0)
+            g_sim.node = atoi(val);
+        else
+            usage(argv[0]);
+    }
+    if (g_sim.uart_fd < 0 || g_sim.node > 16)
+        usage(argv[0]);
+
+    if (g_sim.node >= 0)
+    {
+        static const int addr_pins[] = SIM_BUS_ADDR_PINS;
+        sim_gpio_strap(SIM_BUS_PIN, 1);
+        for (int i = 0; g_sim.node > 0 && i < (int)(sizeof(addr_pins) / sizeof(addr_pins[0])); i++)
+            sim_gpio_strap(addr_pins[i], ((g_sim.node - 1) >> i) & 1);
+    }
+
+    if (g_sim.verbose)
+        sim_log_level = ESP_LOG_DEBUG;
+
+    // A peer that goes away shows up as a failed write, not a dead process
+    signal(SIGPIPE, SIG_IGN);
+
+    app_main();
+
+    // Like the ESP32, the firmware lives on in its tasks
+    for (;;)
+        pause();
+}
@@ -0,0 +1,309 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <malloc.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/random.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_random.h"
+#include "esp_heap_caps.h"
+#include "esp_app_desc.h"
+#include "nvs_flash.h"
+#include "sim.h"
+
+esp_log_level_t sim_log_level = ESP_LOG_INFO;
+
+// Defaults; sim_main.c sets them from the command line. Here rather than
+// there so the host tests can link the shim without its main().
+sim_opts_t g_sim = {
+    .name = "sim",
+    .uart_fd = -1,
+    .node = -1,
+};
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// --- TIMER ---
+
+static int64_t s_boot_us;
+
+__attribute__((constructor)) static void sim_boot(void)
+{
+    s_boot_us = now_us();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us() - s_boot_us;
+}
+
+struct sim_esp_timer
+{
+    esp_timer_create_args_t args;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint64_t period_us;     // 0 for one-shot
+    int64_t next_us;        // esp_timer_get_time() of the next expiry
+    bool armed;
+};
+
+static void *timer_thread(void *p)
+{
+    struct sim_esp_timer *t = p;
+    pthread_mutex_lock(&t->lock);
+    while (1)
+    {
+        while (!t->armed)
+            pthread_cond_wait(&t->cond, &t->lock);
+
+        int64_t due = s_boot_us + t->next_us;
+        struct timespec ts = {.tv_sec = due / 1000000, .tv_nsec = (due % 1000000) * 1000};
+        if (pthread_cond_timedwait(&t->cond, &t->lock, &ts) != ETIMEDOUT || !t->armed)
+            continue; // Re-armed or stopped meanwhile
+
+        if (t->period_us)
+            t->next_us += (int64_t)t->period_us;
+        else
+            t->armed = false;
+        pthread_mutex_unlock(&t->lock);
+        t->args.callback(t->args.arg);
+        pthread_mutex_lock(&t->lock);
+    }
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    struct sim_esp_timer *t = calloc(1, sizeof(*t));
+    if (t == NULL)
+        return ESP_ERR_NO_MEM;
+    t->args = *args;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&t->cond, &attr);
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_create(&t->thread, NULL, timer_thread, t);
+    pthread_detach(t->thread);
+    *out = t;
+    return ESP_OK;
+}
+
+static esp_err_t timer_arm(esp_timer_handle_t t, uint64_t first_us, uint64_t period_us)
+{
+    pthread_mutex_lock(&t->lock);
+    if (t->armed)
+    {
+        pthread_mutex_unlock(&t->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    t->period_us = period_us;
+    t->next_us = esp_timer_get_time() + (int64_t)first_us;
+    t->armed = true;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    return timer_arm(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_arm(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&timer->lock);
+    bool was_armed = timer->armed;
+    timer->armed = false;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+    return was_armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+// --- LOG ---
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    sim_log_level = level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+esp_log_level_t esp_log_level_get(const char *tag)
+{
+    return sim_log_level;
+}
+
+static pthread_mutex_t s_log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void sim_log(esp_log_level_t level, const char *tag, const char *fmt, ...)
+{
+    static const char letters[] = "NEWIDV";
+
+    if (level > sim_log_level)
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    pthread_mutex_lock(&s_log_lock);
+    fprintf(stderr, "%c (%lu) [%s] %s: ", letters[level], (unsigned long)esp_log_timestamp(), g_sim.name, tag);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    pthread_mutex_unlock(&s_log_lock);
+    va_end(ap);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *fmt, ...)
+{
+    if (level > sim_log_level)
+        return;
+
+    char line[512];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+
+    // "X (ms) rest": the board name goes where sim_log puts it
+    const char *rest = line;
+    if (line[0] != '\0' && line[1] == ' ' && line[2] == '(')
+    {
+        const char *close = strstr(line, ") ");
+        if (close)
+            rest = close + 2;
+    }
+    pthread_mutex_lock(&s_log_lock);
+    fprintf(stderr, "%.*s[%s] %s", (int)(rest - line), line, g_sim.name, rest);
+    pthread_mutex_unlock(&s_log_lock);
+}
+
+const char *esp_err_to_name(esp_err_t err)
+{
+    switch (err)
+    {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    default: return "ESP_ERR_UNKNOWN";
+    }
+}
+
+// --- SYSTEM ---
+
+// The host heap isn't the ESP32's 300-odd KB; report what glibc holds as
+// in-use against a nominal ESP32-sized heap so trends are still visible.
+#define SIM_HEAP_SIZE (300 * 1024)
+
+static uint32_t s_min_free = SIM_HEAP_SIZE;
+
+uint32_t esp_get_free_heap_size(void)
+{
+    struct mallinfo2 mi = mallinfo2();
+    uint32_t used = mi.uordblks > SIM_HEAP_SIZE ? SIM_HEAP_SIZE : (uint32_t)mi.uordblks;
+    uint32_t free_now = SIM_HEAP_SIZE - used;
+    if (free_now < s_min_free)
+        s_min_free = free_now;
+    return free_now;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    esp_get_free_heap_size();
+    return s_min_free;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return esp_get_free_heap_size();
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    return esp_get_minimum_free_heap_size();
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return esp_get_free_heap_size();
+}
+
+void esp_restart(void)
+{
+    ESP_LOGW("SIM", "esp_restart() called, exiting");
+    exit(3);
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return ESP_RST_POWERON;
+}
+
+void esp_fill_random(void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len > 0)
+    {
+        ssize_t n = getrandom(p, len, 0);
+        if (n <= 0)
+            continue;
+        p += n;
+        len -= (size_t)n;
+    }
+}
+
+uint32_t esp_random(void)
+{
+    uint32_t r;
+    esp_fill_random(&r, sizeof(r));
+    return r;
+}
+
+static const esp_app_desc_t s_app_desc = {
+    .version = SIM_APP_VERSION,
+    .project_name = "aera",
+    .time = __TIME__,
+    .date = __DATE__,
+    .idf_ver = "sim",
+};
+
+const esp_app_desc_t *esp_app_get_description(void)
+{
+    return &s_app_desc;
+}
+
+// --- NVS ---
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    return ESP_OK;
+}
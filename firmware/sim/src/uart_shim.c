@@ -0,0 +1,317 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sim.h"
+
+static const char *TAG = "SIM_UART";
+
+// One RX ring for the link, filled by the reader thread like the driver's
+// ISR fills its ring buffer.
+static struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t *ring;
+    size_t cap, head, count;
+    QueueHandle_t events;
+    bool installed;
+} s_rx = {.lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
+
+static pthread_mutex_t s_tx_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_uint s_baud = 115200;
+static int64_t s_tx_free_us; // When the virtual wire is idle again
+
+// --- WIRE ---
+// On the launcher's SOCK_SEQPACKET socketpair every write goes out as
+// messages of [sender's baud, u32][up to WIRE_MSG_MAX bytes], and the reader
+// decides what the line did to them. A tty or a stream socket carries plain
+// bytes and a perfect line.
+#define WIRE_MSG_MAX    4096
+#define WIRE_BASE_BAUD  115200 // What --link-degrade leaves clean
+
+static bool s_framed;
+
+// Highest rate the wire carries without errors right now; 0 = any
+static uint32_t wire_clean_baud(void)
+{
+    if (g_sim.link_degrade_s && esp_timer_get_time() >= (int64_t)g_sim.link_degrade_s * 1000000)
+        return WIRE_BASE_BAUD;
+    return g_sim.baud;
+}
+
+// A receiver at another rate sees noise. Above the clean rate each byte
+// takes a bit error with a chance that grows with the overshoot: 1/16 per
+// byte at twice the clean rate, enough that a probe burst never survives.
+static void wire_receive(uint8_t *data, size_t len, uint32_t sent_baud)
+{
+    static unsigned seed = 1;
+    uint32_t clean = wire_clean_baud();
+
+    if (sent_baud != atomic_load(&s_baud))
+    {
+        for (size_t i = 0; i < len; i++)
+            data[i] = (uint8_t)rand_r(&seed);
+        return;
+    }
+    if (clean == 0 || sent_baud <= clean)
+        return;
+
+    double p = (double)(sent_baud - clean) / clean / 16;
+    for (size_t i = 0; i < len; i++)
+    {
+        if ((double)rand_r(&seed) / RAND_MAX < p)
+            data[i] ^= (uint8_t)(1u << (rand_r(&seed) % 8));
+    }
+}
+
+static void post_event(uart_event_type_t type, size_t size)
+{
+    if (s_rx.events == NULL)
+        return;
+    uart_event_t ev = {.type = type, .size = size};
+    xQueueSend(s_rx.events, &ev, 0);
+}
+
+// Hands one read's worth to the "driver"
+static void rx_push(const uint8_t *chunk, size_t n)
+{
+    pthread_mutex_lock(&s_rx.lock);
+    size_t space = s_rx.cap - s_rx.count;
+    size_t take = n < space ? n : space;
+    for (size_t i = 0; i < take; i++)
+        s_rx.ring[(s_rx.head + s_rx.count + i) % s_rx.cap] = chunk[i];
+    s_rx.count += take;
+    pthread_cond_broadcast(&s_rx.cond);
+    pthread_mutex_unlock(&s_rx.lock);
+
+    // A read returning means the line went quiet or our chunk filled,
+    // which is what the driver's RX timeout / full threshold signal
+    if (take > 0)
+        post_event(UART_DATA, take);
+    if (take < n)
+        post_event(UART_BUFFER_FULL, 0);
+}
+
+static void *uart_reader(void *arg)
+{
+    static uint8_t msg[sizeof(uint32_t) + WIRE_MSG_MAX];
+    enum { CHUNK = 128 };
+
+    pthread_setname_np(pthread_self(), "sim_uart_rx");
+    for (;;)
+    {
+        ssize_t n = read(g_sim.uart_fd, msg, s_framed ? sizeof(msg) : CHUNK);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0 || (s_framed && n < (ssize_t)sizeof(uint32_t)))
+        {
+            ESP_LOGE(TAG, "Link closed (%s), stopping", n == 0 ? "EOF" : strerror(errno));
+            exit(0);
+        }
+
+        uint8_t *data = msg;
+        size_t len = (size_t)n;
+        if (s_framed)
+        {
+            uint32_t sent_baud;
+            memcpy(&sent_baud, msg, sizeof(sent_baud));
+            data += sizeof(sent_baud);
+            len -= sizeof(sent_baud);
+            wire_receive(data, len, sent_baud);
+        }
+        // Driver-sized reads, as if the FIFO threshold and RX timeout cut them
+        for (size_t at = 0; at < len; at += CHUNK)
+            rx_push(data + at, len - at < CHUNK ? len - at : CHUNK);
+    }
+    return NULL;
+}
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t *cfg)
+{
+    s_baud = (uint32_t)cfg->baud_rate;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_install(uart_port_t port, int rx_buffer_size, int tx_buffer_size,
+                              int queue_size, QueueHandle_t *queue, int intr_flags)
+{
+    if (s_rx.installed)
+        return ESP_ERR_INVALID_STATE;
+
+    s_rx.cap = (size_t)rx_buffer_size;
+    s_rx.ring = malloc(s_rx.cap);
+    if (queue_size > 0)
+    {
+        s_rx.events = xQueueCreate(queue_size, sizeof(uart_event_t));
+        if (queue)
+            *queue = s_rx.events;
+    }
+    s_rx.installed = true;
+
+    int type = 0;
+    socklen_t type_len = sizeof(type);
+    s_framed = getsockopt(g_sim.uart_fd, SOL_SOCKET, SO_TYPE, &type, &type_len) == 0 && type == SOCK_SEQPACKET;
+
+    pthread_t t;
+    pthread_create(&t, NULL, uart_reader, NULL);
+    pthread_detach(t);
+    return ESP_OK;
+}
+
+esp_err_t uart_set_rx_timeout(uart_port_t port, uint8_t symbols)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_set_rx_full_threshold(uart_port_t port, int threshold)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_set_baudrate(uart_port_t port, uint32_t baud)
+{
+    s_baud = baud;
+    return ESP_OK;
+}
+
+esp_err_t uart_get_baudrate(uart_port_t port, uint32_t *baud)
+{
+    *baud = atomic_load(&s_baud);
+    return ESP_OK;
+}
+
+esp_err_t uart_set_hw_flow_ctrl(uart_port_t port, uart_hw_flowcontrol_t flow, uint8_t rx_thresh)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_set_mode(uart_port_t port, uart_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t port)
+{
+    pthread_mutex_lock(&s_rx.lock);
+    s_rx.head = 0;
+    s_rx.count = 0;
+    pthread_mutex_unlock(&s_rx.lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t *size)
+{
+    pthread_mutex_lock(&s_rx.lock);
+    *size = s_rx.count;
+    pthread_mutex_unlock(&s_rx.lock);
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t len, TickType_t ticks)
+{
+    uint8_t *out = buf;
+    TickType_t start = xTaskGetTickCount();
+    size_t got = 0;
+
+    pthread_mutex_lock(&s_rx.lock);
+    while (got < len)
+    {
+        while (s_rx.count > 0 && got < len)
+        {
+            out[got++] = s_rx.ring[s_rx.head];
+            s_rx.head = (s_rx.head + 1) % s_rx.cap;
+            s_rx.count--;
+        }
+        if (got == len)
+            break;
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (ticks != portMAX_DELAY && elapsed >= ticks)
+            break;
+
+        // Coarse wait is fine: callers either ask for what is buffered with
+        // a zero timeout or block for a long time
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 1000000;
+        if (ts.tv_nsec >= 1000000000L)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&s_rx.cond, &s_rx.lock, &ts);
+    }
+    pthread_mutex_unlock(&s_rx.lock);
+    return (int)got;
+}
+
+static ssize_t wire_send(const uint8_t *p, size_t len, uint32_t baud)
+{
+    static uint8_t msg[sizeof(uint32_t) + WIRE_MSG_MAX];
+
+    if (!s_framed)
+        return write(g_sim.uart_fd, p, len);
+    if (len > WIRE_MSG_MAX)
+        len = WIRE_MSG_MAX;
+    memcpy(msg, &baud, sizeof(baud));
+    memcpy(msg + sizeof(baud), p, len);
+    ssize_t n = write(g_sim.uart_fd, msg, sizeof(baud) + len);
+    return n < 0 ? n : (ssize_t)len;
+}
+
+int uart_write_bytes(uart_port_t port, const void *src, size_t len)
+{
+    const uint8_t *p = src;
+    size_t left = len;
+
+    pthread_mutex_lock(&s_tx_lock);
+    uint32_t baud = atomic_load(&s_baud);
+    while (left > 0)
+    {
+        ssize_t n = wire_send(p, left, baud);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        p += n;
+        left -= (size_t)n;
+    }
+
+    // With --baud, hold the caller for as long as the bytes would take on
+    // a real wire at the firmware's rate (8N1 = 10 bits/byte), like a
+    // driver with no TX buffer
+    if (g_sim.baud)
+    {
+        int64_t now = esp_timer_get_time();
+        int64_t start = s_tx_free_us > now ? s_tx_free_us : now;
+        s_tx_free_us = start + (int64_t)len * 10 * 1000000 / baud;
+        int64_t wait = s_tx_free_us - now;
+        if (wait > 0)
+        {
+            struct timespec ts = {.tv_sec = wait / 1000000, .tv_nsec = (wait % 1000000) * 1000};
+            nanosleep(&ts, NULL);
+        }
+    }
+    pthread_mutex_unlock(&s_tx_lock);
+    return (int)(len - left);
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks)
+{
+    return ESP_OK;
+}
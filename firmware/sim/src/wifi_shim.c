@@ -0,0 +1,434 @@
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sim.h"
+
+static const char *TAG = "SIM_WIFI";
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+// --- EVENT LOOP ---
+
+#define MAX_HANDLERS    16
+#define MAX_EVENT_DATA  64
+
+typedef struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t fn;
+    void *arg;
+} handler_t;
+
+typedef struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    size_t size;
+    uint8_t data[MAX_EVENT_DATA];
+} event_t;
+
+static handler_t s_handlers[MAX_HANDLERS];
+static int s_handler_count;
+static QueueHandle_t s_events;
+
+static void event_loop_task(void *arg)
+{
+    event_t ev;
+    while (1)
+    {
+        if (xQueueReceive(s_events, &ev, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        for (int i = 0; i < s_handler_count; i++)
+        {
+            handler_t *h = &s_handlers[i];
+            if (h->base == ev.base && (h->id == ESP_EVENT_ANY_ID || h->id == ev.id))
+                h->fn(h->arg, ev.base, ev.id, ev.size ? ev.data : NULL);
+        }
+    }
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    if (s_events)
+        return ESP_ERR_INVALID_STATE;
+    s_events = xQueueCreate(16, sizeof(event_t));
+    xTaskCreate(event_loop_task, "sys_evt", 4096, NULL, 20, NULL);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t base, int32_t id,
+                                              esp_event_handler_t handler, void *arg,
+                                              esp_event_handler_instance_t *instance)
+{
+    if (s_handler_count == MAX_HANDLERS)
+        return ESP_ERR_NO_MEM;
+    s_handlers[s_handler_count++] = (handler_t){base, id, handler, arg};
+    if (instance)
+        *instance = &s_handlers[s_handler_count - 1];
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, const void *data, size_t size, uint32_t ticks)
+{
+    event_t ev = {.base = base, .id = id, .size = size};
+    if (size > MAX_EVENT_DATA)
+        return ESP_ERR_INVALID_SIZE;
+    if (size)
+        memcpy(ev.data, data, size);
+    return xQueueSend(s_events, &ev, ticks) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+// --- NETIF ---
+
+struct sim_netif
+{
+    esp_netif_ip_info_t ip_info;
+};
+
+static struct sim_netif s_sta;
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    esp_netif_str_to_ip4("127.0.0.1", &s_sta.ip_info.ip);
+    return &s_sta;
+}
+
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t *netif)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_str_to_ip4(const char *src, esp_ip4_addr_t *dst)
+{
+    struct in_addr a;
+    if (inet_pton(AF_INET, src, &a) != 1)
+        return ESP_ERR_INVALID_ARG;
+    dst->addr = a.s_addr;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_ip_info(esp_netif_t *netif, const esp_netif_ip_info_t *info)
+{
+    netif->ip_info = *info;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_dns_info(esp_netif_t *netif, esp_netif_dns_type_t type, esp_netif_dns_info_t *dns)
+{
+    return ESP_OK;
+}
+
+// --- WIFI ---
+// One access point. Connect attempts run on an esp_timer so they take
+// over-the-air time without blocking the caller, like the real driver.
+
+#define SIM_AP_CHANNEL      6
+#define SIM_AP_CHANNELS     13
+#define SIM_AP_DWELL_MS     120     // Active probe per channel
+#define SIM_AP_ASSOC_MS     60      // Auth, association and the 4-way handshake
+#define SIM_AP_OUTAGE_MS    2000    // How long a blip keeps the AP away
+#define SIM_AP_HOP_EVERY    3       // Every Nth blip the AP comes back on a new channel
+#define SIM_AP_BEACON_US    102400  // 100 TU
+#define SIM_AP_DTIM         1
+#define SIM_PS_ACTIVE_MS    50      // Radio stays up this long after traffic (IDF's default)
+#define SIM_PS_BEACON_US    2000    // Radio on to catch each beacon
+#define SIM_PS_LISTEN_DEF   3       // MAX_MODEM with listen_interval 0, as IDF
+
+static const uint8_t s_ap_bssid[6] = {0x02, 0xA5, 0x00, 0x00, 0x00, 0x01};
+
+static pthread_mutex_t s_wifi_lock = PTHREAD_MUTEX_INITIALIZER;
+static wifi_config_t s_sta_config;
+static uint8_t s_ap_channel = SIM_AP_CHANNEL;
+static int64_t s_ap_back_us;        // AP unreachable until then
+static uint32_t s_blips;
+static bool s_connected;
+static bool s_pending;              // An attempt is in flight
+static uint8_t s_pending_reason;    // 0 = it will succeed
+static esp_timer_handle_t s_attempt_timer;
+static esp_timer_handle_t s_blip_timer;
+
+// Modem sleep, and the radio's on-time for the power meter
+static wifi_ps_type_t s_ps = WIFI_PS_MIN_MODEM; // The driver's default for a station
+static bool s_started;
+static int64_t s_assoc_us;          // Beacons are counted from here
+static int64_t s_awake_until;       // Radio up after traffic until then
+static int64_t s_radio_us;          // On-time up to s_radio_at
+static int64_t s_radio_at;
+
+// --- MODEM SLEEP ---
+// All of these are called with s_wifi_lock held
+
+// Time between the radio's beacon wake-ups; 0 when it never sleeps
+static int64_t ps_period_us(void)
+{
+    if (s_ps == WIFI_PS_NONE)
+        return 0;
+    uint32_t beacons = SIM_AP_DTIM;
+    if (s_ps == WIFI_PS_MAX_MODEM)
+        beacons = s_sta_config.sta.listen_interval ? s_sta_config.sta.listen_interval : SIM_PS_LISTEN_DEF;
+    return (int64_t)beacons * SIM_AP_BEACON_US;
+}
+
+// Accounts for the radio up to now; call before changing anything above
+static void radio_advance(int64_t now)
+{
+    int64_t period = ps_period_us();
+    if (!s_started)
+    {
+        // Off
+    }
+    else if (!s_connected || period == 0)
+    {
+        s_radio_us += now - s_radio_at; // Listening, scanning or associating
+    }
+    else
+    {
+        int64_t until = s_awake_until < now ? s_awake_until : now;
+        if (until > s_radio_at)
+            s_radio_us += until - s_radio_at;
+        int64_t beacons = (now - s_assoc_us) / period - (s_radio_at - s_assoc_us) / period;
+        s_radio_us += beacons * SIM_PS_BEACON_US;
+    }
+    s_radio_at = now;
+}
+
+static void radio_busy(int64_t now)
+{
+    radio_advance(now);
+    if (now + SIM_PS_ACTIVE_MS * 1000 > s_awake_until)
+        s_awake_until = now + SIM_PS_ACTIVE_MS * 1000;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *cfg)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t iface, wifi_config_t *cfg)
+{
+    pthread_mutex_lock(&s_wifi_lock);
+    radio_advance(esp_timer_get_time());
+    s_sta_config = *cfg;
+    pthread_mutex_unlock(&s_wifi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t iface, wifi_config_t *cfg)
+{
+    pthread_mutex_lock(&s_wifi_lock);
+    *cfg = s_sta_config;
+    pthread_mutex_unlock(&s_wifi_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    pthread_mutex_lock(&s_wifi_lock);
+    radio_advance(esp_timer_get_time());
+    s_ps = type;
+    pthread_mutex_unlock(&s_wifi_lock);
+    return ESP_OK;
+}
+
+static void post_disconnected(uint8_t reason)
+{
+    wifi_event_sta_disconnected_t ev = {.reason = reason, .rssi = -60};
+    memcpy(ev.bssid, s_ap_bssid, sizeof(ev.bssid));
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &ev, sizeof(ev), portMAX_DELAY);
+}
+
+static void attempt_done(void *arg)
+{
+    pthread_mutex_lock(&s_wifi_lock);
+    uint8_t reason = s_pending_reason;
+    bool pending = s_pending;
+    int64_t now = esp_timer_get_time();
+    radio_advance(now);
+    s_pending = false;
+    s_connected = pending && reason == 0;
+    s_assoc_us = now;
+    s_awake_until = now + SIM_PS_ACTIVE_MS * 1000;
+    uint8_t channel = s_ap_channel;
+    int64_t period = ps_period_us();
+    pthread_mutex_unlock(&s_wifi_lock);
+
+    if (!pending)
+        return; // Disconnected meanwhile
+    if (reason != 0)
+    {
+        post_disconnected(reason);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Associated with \"%s\" on channel %u (simulated)", (const char *)s_sta_config.sta.ssid, channel);
+    if (period)
+        ESP_LOGI(TAG, "Modem sleep: radio wakes every %lu ms", (unsigned long)(period / 1000));
+    wifi_event_sta_connected_t ev = {.channel = channel, .authmode = 3};
+    memcpy(ev.bssid, s_ap_bssid, sizeof(ev.bssid));
+    ev.ssid_len = (uint8_t)strnlen((const char *)s_sta_config.sta.ssid, sizeof(ev.ssid));
+    memcpy(ev.ssid, s_sta_config.sta.ssid, ev.ssid_len);
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &ev, sizeof(ev), portMAX_DELAY);
+
+    ip_event_got_ip_t got = {.ip_info = s_sta.ip_info};
+    esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &got, sizeof(got), portMAX_DELAY);
+}
+
+static void blip(void *arg)
+{
+    sim_wifi_drop();
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    pthread_mutex_lock(&s_wifi_lock);
+    s_started = true;
+    s_radio_at = esp_timer_get_time();
+    pthread_mutex_unlock(&s_wifi_lock);
+
+    const esp_timer_create_args_t attempt = {.callback = attempt_done, .name = "sim_wifi"};
+    esp_timer_create(&attempt, &s_attempt_timer);
+    if (g_sim.wifi_blip_s)
+    {
+        const esp_timer_create_args_t args = {.callback = blip, .name = "sim_blip"};
+        esp_timer_create(&args, &s_blip_timer);
+        esp_timer_start_periodic(s_blip_timer, (uint64_t)g_sim.wifi_blip_s * 1000000);
+    }
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, portMAX_DELAY);
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    pthread_mutex_lock(&s_wifi_lock);
+    if (s_pending || s_connected)
+    {
+        pthread_mutex_unlock(&s_wifi_lock);
+        return ESP_ERR_INVALID_STATE; // The real driver says "connecting"
+    }
+
+    // How many channels get probed before we find the AP, or give up
+    const wifi_sta_config_t *sta = &s_sta_config.sta;
+    bool ap_up = esp_timer_get_time() >= s_ap_back_us;
+    bool bssid_ok = !sta->bssid_set || memcmp(sta->bssid, s_ap_bssid, 6) == 0;
+    uint32_t dwells;
+    bool found;
+    if (sta->channel != 0)
+    {
+        dwells = 1;
+        found = ap_up && bssid_ok && sta->channel == s_ap_channel;
+    }
+    else
+    {
+        found = ap_up && bssid_ok;
+        dwells = found && sta->scan_method == WIFI_FAST_SCAN ? s_ap_channel : SIM_AP_CHANNELS;
+    }
+    s_pending = true;
+    s_pending_reason = found ? 0 : WIFI_REASON_NO_AP_FOUND;
+    pthread_mutex_unlock(&s_wifi_lock);
+
+    uint64_t ms = dwells * SIM_AP_DWELL_MS + (found ? SIM_AP_ASSOC_MS : 0);
+    ESP_LOGD(TAG, "Connect: %lu channel(s) to probe, %s", (unsigned long)dwells, found ? "AP found" : "no AP");
+    return esp_timer_start_once(s_attempt_timer, ms * 1000);
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    pthread_mutex_lock(&s_wifi_lock);
+    bool was = s_connected || s_pending;
+    radio_advance(esp_timer_get_time());
+    s_connected = false;
+    s_pending = false;
+    pthread_mutex_unlock(&s_wifi_lock);
+
+    esp_timer_stop(s_attempt_timer);
+    if (was)
+        post_disconnected(WIFI_REASON_ASSOC_LEAVE);
+    return ESP_OK;
+}
+
+bool sim_wifi_link_up(void)
+{
+    pthread_mutex_lock(&s_wifi_lock);
+    bool up = s_connected;
+    pthread_mutex_unlock(&s_wifi_lock);
+    return up;
+}
+
+void sim_wifi_drop(void)
+{
+    pthread_mutex_lock(&s_wifi_lock);
+    bool was = s_connected;
+    radio_advance(esp_timer_get_time());
+    s_connected = false;
+    s_ap_back_us = esp_timer_get_time() + SIM_AP_OUTAGE_MS * 1000;
+    if (++s_blips % SIM_AP_HOP_EVERY == 0)
+        s_ap_channel = s_ap_channel % SIM_AP_CHANNELS + 1;
+    uint8_t channel = s_ap_channel;
+    pthread_mutex_unlock(&s_wifi_lock);
+
+    ESP_LOGW(TAG, "Access point gone for %d ms (simulated router blip), back on channel %u",
+             SIM_AP_OUTAGE_MS, channel);
+    if (was)
+        post_disconnected(WIFI_REASON_BEACON_TIMEOUT);
+}
+
+void sim_wifi_rx(void)
+{
+    pthread_mutex_lock(&s_wifi_lock);
+    int64_t now = esp_timer_get_time();
+    int64_t period = ps_period_us();
+    int64_t wake = now;
+    if (s_connected && period && now >= s_awake_until)
+        wake = s_assoc_us + ((now - s_assoc_us) / period + 1) * period;
+    pthread_mutex_unlock(&s_wifi_lock);
+
+    // Held at the AP until the beacon that tells us about it
+    if (wake > now)
+        usleep((useconds_t)(wake - now));
+
+    pthread_mutex_lock(&s_wifi_lock);
+    radio_busy(esp_timer_get_time());
+    pthread_mutex_unlock(&s_wifi_lock);
+}
+
+void sim_wifi_tx(void)
+{
+    pthread_mutex_lock(&s_wifi_lock);
+    radio_busy(esp_timer_get_time());
+    pthread_mutex_unlock(&s_wifi_lock);
+}
+
+int64_t sim_wifi_radio_on_us(void)
+{
+    pthread_mutex_lock(&s_wifi_lock);
+    radio_advance(esp_timer_get_time());
+    int64_t us = s_radio_us;
+    pthread_mutex_unlock(&s_wifi_lock);
+    return us;
+}
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "aera_link.h"
+
+// The streaming reassembler (aera_link_rx_push/next) fed the way a UART
+// feeds it: frames split over reads and several in one, garbage between
+// them, bad CRCs, and long enough to go round the ring and its free-running
+// indices many times.
+
+static int s_failed;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "FAIL: %s\n", what);
+        s_failed++;
+    }
+}
+
+// Frame seq, its payload len bytes derived from seq
+static size_t make_frame(uint8_t *buf, uint8_t seq, uint8_t len)
+{
+    uint8_t payload[AERA_LINK_MAX_PAYLOAD];
+    for (int i = 0; i < len; i++)
+        payload[i] = (uint8_t)(seq * 7 + i);
+    return aera_link_encode(buf, AERA_LINK_MAX_FRAME, 1, 0x42, seq, payload, len);
+}
+
+static bool frame_is(const aera_frame_t *f, uint8_t seq, uint8_t len)
+{
+    if (f->addr != 1 || f->opcode != 0x42 || f->seq != seq || f->len != len)
+        return false;
+    for (int i = 0; i < len; i++)
+    {
+        if (f->payload[i] != (uint8_t)(seq * 7 + i))
+            return false;
+    }
+    return true;
+}
+
+// One byte per read; nothing comes out until the last one is in
+static void split_reads(void)
+{
+    aera_link_rx_t rx;
+    aera_frame_t f;
+    uint8_t buf[AERA_LINK_MAX_FRAME];
+    size_t n = make_frame(buf, 5, 10);
+
+    aera_link_rx_init(&rx);
+    for (size_t i = 0; i < n; i++)
+    {
+        aera_link_rx_push(&rx, &buf[i], 1);
+        bool got = aera_link_rx_next(&rx, &f);
+        check(got == (i == n - 1), "split: frame out only after its last byte");
+    }
+    check(frame_is(&f, 5, 10), "split: frame intact");
+    check(rx.frames == 1 && rx.skipped_bytes == 0, "split: counters");
+}
+
+// Three frames, one empty, in one read; out in order
+static void coalesced_reads(void)
+{
+    aera_link_rx_t rx;
+    aera_frame_t f;
+    uint8_t buf[3 * AERA_LINK_MAX_FRAME];
+    size_t n = 0;
+    n += make_frame(buf + n, 1, 3);
+    n += make_frame(buf + n, 2, 0);
+    n += make_frame(buf + n, 3, AERA_LINK_MAX_PAYLOAD);
+
+    aera_link_rx_init(&rx);
+    check(aera_link_rx_push(&rx, buf, n) == n, "coalesced: push taken whole");
+    check(aera_link_rx_next(&rx, &f) && frame_is(&f, 1, 3), "coalesced: first");
+    check(aera_link_rx_next(&rx, &f) && frame_is(&f, 2, 0), "coalesced: second");
+    check(aera_link_rx_next(&rx, &f) && frame_is(&f, 3, AERA_LINK_MAX_PAYLOAD), "coalesced: third");
+    check(!aera_link_rx_next(&rx, &f), "coalesced: nothing more");
+}
+
+// Noise, a sync byte with an impossible length and one that starts a frame
+// that isn't there, then a real frame
+static void garbage_resync(void)
+{
+    aera_link_rx_t rx;
+    aera_frame_t f;
+    uint8_t buf[64 + AERA_LINK_MAX_FRAME];
+    const uint8_t noise[] = {0x00, 0xFF, 0x13, AERA_LINK_SYNC, 0xFF, 0x37, AERA_LINK_SYNC, 0x02, 0x01, 0x42,
+                             0x09, 0xAA, 0xBB, 0x00, 0x00};
+    memcpy(buf, noise, sizeof(noise));
+    size_t n = sizeof(noise) + make_frame(buf + sizeof(noise), 9, 4);
+
+    aera_link_rx_init(&rx);
+    aera_link_rx_push(&rx, buf, n);
+    check(aera_link_rx_next(&rx, &f) && frame_is(&f, 9, 4), "garbage: frame found behind it");
+    check(rx.skipped_bytes == sizeof(noise), "garbage: every byte of it skipped");
+    check(rx.crc_errors == 1, "garbage: the false frame failed its CRC");
+    check(!aera_link_rx_next(&rx, &f), "garbage: nothing more");
+}
+
+// A flipped bit anywhere drops the frame, never the good one after it. The
+// idle line behind them lets a length made longer by the flip run out.
+static void crc_rejection(void)
+{
+    uint8_t buf[3 * AERA_LINK_MAX_FRAME] = {0};
+    size_t first = make_frame(buf, 20, 8);
+    size_t n = first + make_frame(buf + first, 21, 8) + AERA_LINK_MAX_FRAME;
+
+    for (size_t bit = 0; bit < first * 8; bit++)
+    {
+        aera_link_rx_t rx;
+        aera_frame_t f;
+        buf[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+
+        aera_link_rx_init(&rx);
+        aera_link_rx_push(&rx, buf, n);
+        bool got = aera_link_rx_next(&rx, &f);
+        check(got && frame_is(&f, 21, 8), "crc: corrupted frame dropped, next one kept");
+        check(!aera_link_rx_next(&rx, &f), "crc: nothing more");
+
+        buf[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+    }
+}
+
+// Frames of every length, pushed in reads that never line up with them,
+// drained after each read, past the ring's end and the indices' wrap
+static void ring_wrap(void)
+{
+    static aera_link_rx_t rx;
+    static uint8_t stream[200000];
+    aera_frame_t f;
+    size_t n = 0;
+    int frames = 0;
+
+    while (n + AERA_LINK_MAX_FRAME <= sizeof(stream))
+    {
+        n += make_frame(stream + n, (uint8_t)frames, (uint8_t)(frames % (AERA_LINK_MAX_PAYLOAD + 1)));
+        frames++;
+    }
+
+    aera_link_rx_init(&rx);
+    int seen = 0;
+    bool in_order = true;
+    for (size_t at = 0, step = 1; at < n; at += step, step = (step + 37) % AERA_LINK_RX_MAX_PUSH + 1)
+    {
+        size_t len = n - at < step ? n - at : step;
+        aera_link_rx_push(&rx, stream + at, len);
+        while (aera_link_rx_next(&rx, &f))
+        {
+            in_order &= frame_is(&f, (uint8_t)seen, (uint8_t)(seen % (AERA_LINK_MAX_PAYLOAD + 1)));
+            seen++;
+        }
+    }
+    check(seen == frames && in_order, "wrap: every frame, intact and in order");
+    check(rx.skipped_bytes == 0 && rx.crc_errors == 0 && rx.overflow_bytes == 0, "wrap: counters");
+}
+
+// More than fits is cut short and counted, and what fit still parses
+static void overflow(void)
+{
+    static uint8_t stream[AERA_LINK_RX_RING + AERA_LINK_MAX_FRAME];
+    aera_link_rx_t rx;
+    aera_frame_t f;
+    size_t n = 0;
+    int frames = 0;
+    while (n + AERA_LINK_OVERHEAD + 16 <= sizeof(stream))
+        n += make_frame(stream + n, (uint8_t)frames++, 16);
+
+    aera_link_rx_init(&rx);
+    size_t taken = aera_link_rx_push(&rx, stream, n);
+    check(taken == AERA_LINK_RX_RING && rx.overflow_bytes == n - taken, "overflow: cut at the ring size");
+    int seen = 0;
+    while (aera_link_rx_next(&rx, &f) && frame_is(&f, (uint8_t)seen, 16))
+        seen++;
+    check(seen == (int)(AERA_LINK_RX_RING / (AERA_LINK_OVERHEAD + 16)), "overflow: the whole frames that fit");
+}
+
+int main(void)
+{
+    split_reads();
+    coalesced_reads();
+    garbage_resync();
+    crc_rejection();
+    ring_wrap();
+    overflow();
+    printf("%s\n", s_failed ? "reassembler checks failed" : "reassembler checks pass");
+    return s_failed != 0;
+}
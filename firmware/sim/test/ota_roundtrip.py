@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""Packs images with tools/ota_pack.py, unpacks them with aera_ota.c (the
+ota_unpack host tool) and checks they come back byte for byte.
+
+    ota_roundtrip.py build-sim/ota_unpack [more images...]
+
+Besides any images given, it runs a set made up to hit the packer's edges:
+nothing to match, runs far longer than a back-reference, matches exactly a
+window back, and sizes either side of a flag byte's worth of items.
+"""
+
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "tools"))
+from ota_pack import WINDOW, pack  # noqa: E402
+
+
+def made_up():
+    rng = random.Random(1)
+    noise = bytes(rng.getrandbits(8) for _ in range(3 * WINDOW))
+    text = b"".join(b"STATUS:%s@%d\n" % (rng.choice((b"ON", b"OFF")), rng.randrange(16)) for _ in range(2000))
+    return {
+        "one byte": b"\x5a",
+        "eight bytes": bytes(range(8)),
+        "nine bytes": bytes(range(9)),
+        "zeros": bytes(20000),
+        "noise": noise,
+        "text": text,
+        "a window back": noise[:WINDOW] + noise[:WINDOW] + noise[:100],
+        "a window and one back": noise[:WINDOW + 1] + noise[:WINDOW + 1],
+    }
+
+
+def main():
+    unpack_tool = sys.argv[1]
+    cases = made_up()
+    for path in sys.argv[2:]:
+        with open(path, "rb") as f:
+            cases[os.path.basename(path)] = f.read()
+
+    failed = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        aota = os.path.join(tmp, "in.aota")
+        out = os.path.join(tmp, "out.bin")
+        for name, image in cases.items():
+            for store in (False, True):
+                with open(aota, "wb") as f:
+                    f.write(pack(image, store))
+                r = subprocess.run([unpack_tool, aota, out], capture_output=True, text=True)
+                ok = r.returncode == 0 and open(out, "rb").read() == image
+                kind = "stored" if store else "lzss"
+                print(f"{'ok  ' if ok else 'FAIL'} {name} ({len(image)} bytes, {kind}) {r.stderr.strip()}")
+                failed += not ok
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
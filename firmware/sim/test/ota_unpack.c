@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "aera_ota.h"
+
+// Host side of the ota_roundtrip test: unpacks an .aota file with the
+// decoder the bottom controller runs, fed AERA_OTA_CHUNK bytes at a time
+// like the link does, and writes the image out.
+//
+//   ota_unpack in.aota out.bin
+
+typedef struct
+{
+    uint8_t *buf;
+    uint32_t len;
+    uint32_t cap;
+} image_t;
+
+static void emit(uint8_t b, void *arg)
+{
+    image_t *img = arg;
+    if (img->len < img->cap)
+        img->buf[img->len] = b;
+    img->len++;
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(*len + 1);
+    if (buf != NULL && fread(buf, 1, *len, f) != *len)
+    {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+static int fail(const char *path, const char *why)
+{
+    fprintf(stderr, "%s: %s\n", path, why);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s in.aota out.bin\n", argv[0]);
+        return 2;
+    }
+
+    size_t len;
+    uint8_t *file = read_file(argv[1], &len);
+    aera_ota_header_t h;
+    if (file == NULL)
+        return fail(argv[1], "can't read");
+    if (len < AERA_OTA_HEADER_LEN || !aera_ota_parse_header(file, &h))
+        return fail(argv[1], "not an .aota file");
+    if (len != AERA_OTA_HEADER_LEN + h.stream_len)
+        return fail(argv[1], "length doesn't match the header");
+    const uint8_t *stream = file + AERA_OTA_HEADER_LEN;
+    if (aera_crc32(0, stream, h.stream_len) != h.stream_crc)
+        return fail(argv[1], "stream CRC32 mismatch");
+
+    static aera_ota_decoder_t dec;
+    image_t img = {.buf = malloc(h.image_len + 1), .cap = h.image_len};
+    aera_ota_decode_init(&dec, &h);
+    for (uint32_t at = 0; at < h.stream_len; at += AERA_OTA_CHUNK)
+    {
+        uint32_t n = h.stream_len - at < AERA_OTA_CHUNK ? h.stream_len - at : AERA_OTA_CHUNK;
+        aera_ota_error_t err = aera_ota_decode(&dec, stream + at, n, emit, &img);
+        if (err != AERA_OTA_ERR_NONE)
+            return fail(argv[1], aera_ota_error_name(err));
+    }
+    if (dec.out != h.image_len || img.len != h.image_len || dec.half)
+        return fail(argv[1], "image comes out short");
+
+    FILE *out = fopen(argv[2], "wb");
+    if (out == NULL || fwrite(img.buf, 1, img.len, out) != img.len || fclose(out) != 0)
+        return fail(argv[2], "can't write");
+    free(img.buf);
+    free(file);
+    return 0;
+}
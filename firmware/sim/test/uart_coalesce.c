@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "aera_cmd.h"
+#include "uart_tx.h"
+#include "uart_tx_priv.h"
+#include "ota_stream.h"
+#include "link_rate_tx.h"
+#include "bus_sched.h"
+
+// uart_tx.c's coalescing (uart_tx.h), run on its own TX task as in the
+// firmware. The link is a fake: uart_write_bytes() decodes what would go
+// out and the test posts the ACKs. The other parts of the TX task stand
+// aside: a point-to-point link, steady, no OTA. Each case has a node of its
+// own, since coalescing is per node and target.
+
+#define SETTLE_US   20000   // Well inside UART_TX_ACK_TIMEOUT_MS
+#define MAX_SENT    256
+#define MAX_DONE    64
+
+typedef struct
+{
+    uint8_t node, opcode, seq;
+} sent_t;
+
+typedef struct
+{
+    uint8_t node, opcode, state;
+    bool acked;
+    int64_t origin_us;
+} done_t;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static sent_t s_sent[MAX_SENT];
+static int s_sent_count;
+static done_t s_done[MAX_DONE];
+static int s_done_count;
+static int s_failed;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "FAIL: %s\n", what);
+        s_failed++;
+    }
+}
+
+// --- FAKE LINK ---
+int uart_write_bytes(uart_port_t port, const void *src, size_t len)
+{
+    static aera_link_rx_t rx;
+    aera_frame_t f;
+    pthread_mutex_lock(&s_lock);
+    aera_link_rx_push(&rx, src, len);
+    while (aera_link_rx_next(&rx, &f))
+    {
+        if (s_sent_count < MAX_SENT)
+            s_sent[s_sent_count++] = (sent_t){f.addr, f.opcode, f.seq};
+    }
+    pthread_mutex_unlock(&s_lock);
+    return (int)len;
+}
+
+static void on_done(uint8_t node, uint8_t opcode, bool acked, uint8_t state, int64_t origin_us)
+{
+    pthread_mutex_lock(&s_lock);
+    if (s_done_count < MAX_DONE)
+        s_done[s_done_count++] = (done_t){node, opcode, state, acked, origin_us};
+    pthread_mutex_unlock(&s_lock);
+}
+
+// Commands of opcode sent to node so far, not counting their retries;
+// *seq the last one's
+static int sent(uint8_t node, uint8_t opcode, uint8_t *seq)
+{
+    int n = 0;
+    int last = -1;
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < s_sent_count; i++)
+    {
+        if (s_sent[i].node == node && s_sent[i].opcode == opcode && s_sent[i].seq != last)
+        {
+            n++;
+            last = s_sent[i].seq;
+        }
+    }
+    if (seq && last >= 0)
+        *seq = (uint8_t)last;
+    pthread_mutex_unlock(&s_lock);
+    return n;
+}
+
+// The done callback's run for node and origin_us, NULL if it hasn't
+static const done_t *done(uint8_t node, int64_t origin_us)
+{
+    const done_t *d = NULL;
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < s_done_count; i++)
+    {
+        if (s_done[i].node == node && s_done[i].origin_us == origin_us)
+            d = &s_done[i];
+    }
+    pthread_mutex_unlock(&s_lock);
+    return d;
+}
+
+static void ack(uint8_t node, uint8_t opcode, uint8_t seq, uint8_t state)
+{
+    const uint8_t payload[AERA_ACK_PAYLOAD_LEN] = {opcode, state};
+    aera_frame_t f = {.addr = node, .opcode = AERA_OP_ACK, .seq = seq, .len = sizeof(payload), .payload = payload};
+    uart_tx_post_ack(&f);
+}
+
+static uint32_t coalesced(void)
+{
+    uart_tx_stats_t st;
+    uart_tx_get_stats(&st);
+    return st.coalesced;
+}
+
+static void settle(int64_t us)
+{
+    usleep((useconds_t)us);
+}
+
+// --- STAND-INS ---
+void ota_stream_init(void) {}
+void ota_stream_service(int64_t now) {}
+int64_t ota_stream_next_us(void) { return INT64_MAX; }
+
+void link_rate_tx_init(uart_port_t port, bool rts_cts, bool bus) {}
+void link_rate_tx_service(int64_t now) {}
+int64_t link_rate_tx_next_us(void) { return INT64_MAX; }
+bool link_rate_tx_steady(void) { return true; }
+void link_rate_tx_on_done(bool acked) {}
+void link_rate_tx_on_failed(void) {}
+
+void bus_sched_init(bool on) {}
+bool bus_sched_on(void) { return false; }
+bool bus_sched_present(uint8_t node) { return false; }
+bool bus_sched_open(uint8_t node, int64_t now) { return true; }
+uint8_t bus_sched_turn(void) { return 0; }
+bool bus_sched_on_reply(uint8_t node, uint8_t seq, const aera_bus_reply_t *reply, int64_t rx_us) { return false; }
+void bus_sched_on_ack(uint8_t node, uint32_t rtt_us) {}
+void bus_sched_on_sent(size_t bytes) {}
+void bus_sched_check(int64_t now) {}
+void bus_sched_service(int64_t now) {}
+int64_t bus_sched_next_us(void) { return INT64_MAX; }
+
+// --- CASES ---
+
+// OFF then ON while ON waits for its ACK: the OFF is replaced, and the ON
+// left would change nothing, so it never goes out but is still answered
+static void replaced_then_unchanged(void)
+{
+    const uint8_t node = 1;
+    uint32_t base = coalesced();
+    uint8_t seq;
+
+    uart_tx_enqueue(node, AERA_OP_LED_ON, NULL, 0, 100);
+    settle(SETTLE_US);
+    check(sent(node, AERA_OP_LED_ON, &seq) == 1, "replaced: first ON goes out at once");
+
+    uart_tx_enqueue(node, AERA_OP_LED_OFF, NULL, 0, 101);
+    uart_tx_enqueue(node, AERA_OP_LED_ON, NULL, 0, 102);
+    settle(SETTLE_US);
+    check(sent(node, AERA_OP_LED_OFF, NULL) == 0, "replaced: OFF held while ON is unACKed");
+    check(coalesced() == base + 1, "replaced: the replaced OFF counts as coalesced");
+    check(done(node, 101) == NULL, "replaced: no answer for the replaced OFF of its own");
+
+    ack(node, AERA_OP_LED_ON, seq, 1);
+    settle(SETTLE_US);
+    const done_t *first = done(node, 100);
+    const done_t *second = done(node, 102);
+    check(first && first->acked && first->state == 1, "unchanged: first ON answered by its ACK");
+    check(second && second->acked && second->opcode == AERA_OP_LED_ON && second->state == 1,
+          "unchanged: the ON equal to the ACKed state is answered with it");
+    check(sent(node, AERA_OP_LED_ON, NULL) == 1 && sent(node, AERA_OP_LED_OFF, NULL) == 0,
+          "unchanged: nothing more goes out");
+    check(coalesced() == base + 2, "unchanged: dropped one counts as coalesced");
+}
+
+// OFF, ON, OFF while ON is unACKed: the two replaced count, the last OFF
+// goes out once the window is over
+static void replaced_then_sent(void)
+{
+    const uint8_t node = 2;
+    uint32_t base = coalesced();
+    uint8_t seq;
+
+    uart_tx_enqueue(node, AERA_OP_LED_ON, NULL, 0, 200);
+    settle(SETTLE_US);
+    sent(node, AERA_OP_LED_ON, &seq);
+    uart_tx_enqueue(node, AERA_OP_LED_OFF, NULL, 0, 201);
+    uart_tx_enqueue(node, AERA_OP_LED_ON, NULL, 0, 202);
+    uart_tx_enqueue(node, AERA_OP_LED_OFF, NULL, 0, 203);
+    ack(node, AERA_OP_LED_ON, seq, 1);
+    settle((int64_t)UART_TX_COALESCE_MS * 1000 + SETTLE_US);
+
+    check(coalesced() == base + 2, "sent: both replaced count as coalesced");
+    check(sent(node, AERA_OP_LED_ON, NULL) == 1 && sent(node, AERA_OP_LED_OFF, &seq) == 1,
+          "sent: only the last one goes out after");
+    ack(node, AERA_OP_LED_OFF, seq, 0);
+    settle(SETTLE_US);
+    const done_t *d = done(node, 203);
+    check(d && d->acked && d->opcode == AERA_OP_LED_OFF, "sent: the last one answered by its ACK");
+}
+
+// An unACKed ON holds back only ON/OFF for its own node
+static void other_targets(void)
+{
+    const uint8_t node = 3;
+    const uint8_t temp = 60;
+    uint32_t base = coalesced();
+
+    uart_tx_enqueue(node, AERA_OP_LED_ON, NULL, 0, 300);
+    settle(SETTLE_US);
+    uart_tx_enqueue(node, AERA_OP_DRY_TEMP, &temp, 1, 301);
+    uart_tx_enqueue(node, AERA_OP_PING, NULL, 0, 302);
+    uart_tx_enqueue(node + 1, AERA_OP_LED_ON, NULL, 0, 303);
+    settle(SETTLE_US);
+
+    check(sent(node, AERA_OP_DRY_TEMP, NULL) == 1, "targets: TEMP not held behind ON");
+    check(sent(node, AERA_OP_PING, NULL) == 1, "targets: PING not held behind ON");
+    check(sent(node + 1, AERA_OP_LED_ON, NULL) == 1, "targets: another node's ON not held");
+    check(coalesced() == base, "targets: nothing coalesced");
+}
+
+// An ON never ACKed leaves the state unknown: the same ON after it is
+// sent, not dropped as unchanged
+static void no_ack_forgets(void)
+{
+    const uint8_t node = 5;
+    uint32_t base = coalesced();
+    uint8_t first, seq;
+
+    uart_tx_enqueue(node, AERA_OP_LED_ON, NULL, 0, 500);
+    settle(SETTLE_US);
+    sent(node, AERA_OP_LED_ON, &first);
+    uart_tx_enqueue(node, AERA_OP_LED_ON, NULL, 0, 501);
+    settle((int64_t)UART_TX_ACK_TIMEOUT_MS * 1000 * (UART_TX_MAX_RETRIES + 2));
+
+    const done_t *d = done(node, 500);
+    check(d && !d->acked, "no ack: first ON given up on");
+    check(sent(node, AERA_OP_LED_ON, &seq) == 2 && seq != first,
+          "no ack: the held ON goes out as a new frame");
+    check(coalesced() == base, "no ack: the held ON isn't dropped as unchanged");
+    ack(node, AERA_OP_LED_ON, seq, 1);
+    settle(SETTLE_US);
+    d = done(node, 501);
+    check(d && d->acked, "no ack: the held ON answered by its ACK");
+}
+
+int main(void)
+{
+    uart_tx_start(UART_NUM_2, false, false, on_done);
+    replaced_then_unchanged();
+    replaced_then_sent();
+    other_targets();
+    no_ack_forgets();
+    printf("%s\n", s_failed ? "coalescing checks failed" : "coalescing checks pass");
+    return s_failed != 0;
+}
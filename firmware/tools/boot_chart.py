@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+"""Record and chart the top controller's boot phases across firmware builds.
+
+`record` waits for the unit to come up, sends BOOT as soon as the WebSocket
+accepts a connection (so first_cmd is as early as the unit allows) and
+appends one JSON line per boot to a file. Power-cycle the unit while it
+waits, or let it start the host simulation itself:
+
+    boot_chart.py record --url ws://192.168.18.200:81 --out boots.jsonl
+    boot_chart.py record --sim build-sim/aera_sim --runs 5 --out boots.jsonl
+
+`chart` reads any number of those files, groups boots by label (default:
+the firmware build the unit reported) and prints the median time of every
+phase per build, with a timeline bar; --svg also draws it:
+
+    boot_chart.py chart boots.jsonl --svg boots.svg
+
+Phase times are milliseconds since esp_timer started, i.e. after the
+bootloader; see boot_trace.h for what each one marks.
+
+Only the standard library is used, like ws_bench.py.
+"""
+
+import argparse
+import asyncio
+import json
+import statistics
+import subprocess
+import sys
+import time
+
+from ws_bench import git_describe, parse_kv, wait_for_server
+
+# boot_trace.h order
+PHASES = ["app_main", "uart", "httpd", "nvs", "wifi_start", "link", "wifi_up", "first_cmd"]
+
+
+# --- RECORD ---
+
+async def ask_boot(ws, timeout):
+    await ws.send_text("BOOT")
+    while True:
+        op, payload = await asyncio.wait_for(ws.recv(), timeout)
+        text = payload.decode(errors="replace") if op == 0x1 else ""
+        if text.startswith("BOOT:"):
+            return parse_kv(text)
+
+
+async def record_one(host, port, wait_s, settle_s, timeout):
+    """Polls until the server answers, then asks BOOT twice: once right away
+    for first_cmd, and again after settle_s for phases that come later."""
+    ws = await wait_for_server(host, port, wait_s, timeout)
+    try:
+        await ask_boot(ws, timeout)
+        await asyncio.sleep(settle_s)
+        return await ask_boot(ws, timeout)
+    finally:
+        await ws.close()
+
+
+def to_record(kv, label, target):
+    phases = {p: kv[p] / 1000.0 for p in PHASES if isinstance(kv.get(p), int)}
+    prev = {p: kv["prev_" + p] / 1000.0 for p in PHASES if isinstance(kv.get("prev_" + p), int)}
+    return {
+        "label": label or kv.get("build"),
+        "build": kv.get("build"),
+        "order": kv.get("order"),
+        "reset": kv.get("reset"),
+        "boots": kv.get("boots"),
+        "git": git_describe(),
+        "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        "target": target,
+        "phases_ms": phases,
+        "prev_phases_ms": prev,
+    }
+
+
+def cmd_record(args):
+    out = open(args.out, "a") if args.out else sys.stdout
+    runs = args.runs if args.sim else 1
+    for i in range(runs):
+        sim = None
+        if args.sim:
+            cmd = [args.sim, "--http-port", str(args.sim_port)] + args.sim_args
+            sim = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+            host, port = "127.0.0.1", args.sim_port
+        else:
+            hostport = args.url.split("://", 1)[-1].split("/", 1)[0]
+            host, _, p = hostport.partition(":")
+            port = int(p or 80)
+            print(f"waiting for ws://{host}:{port} (power-cycle the unit now)", file=sys.stderr)
+        try:
+            kv = asyncio.run(record_one(host, port, args.wait, args.settle, args.timeout))
+        finally:
+            if sim:
+                sim.terminate()
+                sim.wait()
+
+        rec = to_record(kv, args.label, f"ws://{host}:{port}")
+        out.write(json.dumps(rec) + "\n")
+        out.flush()
+        ph = rec["phases_ms"]
+        print(f"[{i + 1}/{runs}] {rec['label']}: ready (first_cmd) at {ph.get('first_cmd', float('nan')):.1f} ms, "
+              f"wifi_up {ph.get('wifi_up', float('nan')):.1f} ms", file=sys.stderr)
+    if args.out:
+        out.close()
+
+
+# --- CHART ---
+
+def load(paths):
+    recs = []
+    for path in paths:
+        with open(path) as f:
+            recs += [json.loads(line) for line in f if line.strip()]
+    return recs
+
+
+def medians(recs):
+    """label -> (boot count, {phase: median ms}), labels in first-seen order"""
+    groups = {}
+    for r in recs:
+        groups.setdefault(r.get("label") or "?", []).append(r["phases_ms"])
+    out = {}
+    for label, boots in groups.items():
+        med = {}
+        for p in PHASES:
+            vals = [b[p] for b in boots if p in b]
+            if vals:
+                med[p] = statistics.median(vals)
+        out[label] = (len(boots), med)
+    return out
+
+
+def print_chart(table, width):
+    span = max((max(m.values(), default=0) for _, m in table.values()), default=0) or 1.0
+    for label, (n, med) in table.items():
+        print(f"{label}  (n={n})")
+        for p in PHASES:
+            if p not in med:
+                print(f"  {p:10} {'-':>9}")
+                continue
+            bar = "#" * max(1, int(round(med[p] / span * width)))
+            print(f"  {p:10} {med[p]:8.1f}ms |{bar}")
+        print()
+
+    labels = list(table)
+    if len(labels) > 1:
+        print("phase      " + "".join(f"{lab[:14]:>15}" for lab in labels))
+        for p in PHASES:
+            cells = "".join(f"{table[lab][1][p]:13.1f}ms" if p in table[lab][1] else f"{'-':>15}" for lab in labels)
+            print(f"{p:10} {cells}")
+
+
+def write_svg(table, path):
+    """One row per build: a time axis with a tick and label per phase"""
+    span = max((max(m.values(), default=0) for _, m in table.values()), default=0) or 1.0
+    left, right, row_h, top = 160, 40, 90, 30
+    width = 960
+    scale = (width - left - right) / span
+    height = top + row_h * len(table) + 30
+    parts = [f'<svg xmlns="http://www.w3.org/2000/svg" width="{width}" height="{height}" '
+             f'font-family="sans-serif" font-size="11">']
+    for i, (label, (n, med)) in enumerate(table.items()):
+        y = top + i * row_h + row_h / 2
+        parts.append(f'<text x="8" y="{y + 4}" font-weight="bold">{label} (n={n})</text>')
+        parts.append(f'<line x1="{left}" y1="{y}" x2="{left + span * scale}" y2="{y}" stroke="#999"/>')
+        for k, p in enumerate(p for p in PHASES if p in med):
+            x = left + med[p] * scale
+            dy = -10 - 12 * (k % 3) if k % 2 == 0 else 18 + 12 * (k % 3)
+            parts.append(f'<circle cx="{x:.1f}" cy="{y}" r="3" fill="#c33"/>')
+            parts.append(f'<text x="{x:.1f}" y="{y + dy}" text-anchor="middle">{p} {med[p]:.0f}</text>')
+    axis_y = height - 12
+    parts.append(f'<text x="{left}" y="{axis_y}">0 ms</text>')
+    parts.append(f'<text x="{left + span * scale}" y="{axis_y}" text-anchor="end">{span:.0f} ms</text>')
+    parts.append("</svg>")
+    with open(path, "w") as f:
+        f.write("\n".join(parts) + "\n")
+
+
+def cmd_chart(args):
+    table = medians(load(args.files))
+    if not table:
+        sys.exit("no boots recorded")
+    print_chart(table, args.width)
+    if args.svg:
+        write_svg(table, args.svg)
+        print(f"wrote {args.svg}", file=sys.stderr)
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    sub = p.add_subparsers(dest="cmd", required=True)
+
+    r = sub.add_parser("record", help="capture boot phases from a unit or the simulation")
+    r.add_argument("--url", default="ws://192.168.18.200:81", help="ws://host:port of the top controller")
+    r.add_argument("--sim", metavar="AERA_SIM", help="start this aera_sim binary for each run")
+    r.add_argument("--sim-port", type=int, default=8081)
+    r.add_argument("--sim-args", nargs=argparse.REMAINDER, default=[],
+                   help="extra aera_sim arguments (must come last)")
+    r.add_argument("--runs", type=int, default=1, help="boots to record (--sim only)")
+    r.add_argument("--label", help="group under this name instead of the reported build")
+    r.add_argument("--wait", type=float, default=60.0, help="seconds to wait for the unit")
+    r.add_argument("--settle", type=float, default=1.0, help="seconds before the second BOOT")
+    r.add_argument("--timeout", type=float, default=2.0)
+    r.add_argument("--out", help="append JSON lines here (default: stdout)")
+    r.set_defaults(fn=cmd_record)
+
+    c = sub.add_parser("chart", help="median phase times per build")
+    c.add_argument("files", nargs="+")
+    c.add_argument("--width", type=int, default=50, help="bar width in characters")
+    c.add_argument("--svg", help="also draw the timeline here")
+    c.set_defaults(fn=cmd_chart)
+
+    args = p.parse_args()
+    args.fn(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Decode the controllers' raw deferred-log output.
+
+With LOG:<16 + level> sent over the WebSocket both boards print their
+AERA_DLOG() entries as "#D <id> <us> <args...>" in hex instead of
+formatting them on the chip. This turns those lines back into the usual
+ESP_LOG text and passes every other line through unchanged:
+
+    idf.py monitor | dlog_decode.py
+    build-sim/aera_sim 2>&1 | dlog_decode.py
+    dlog_decode.py capture.log
+
+The messages are read from aera_dlog_msgs.h, so decode with the header of
+the build that produced the log: ids are positions in that list.
+
+Only the standard library is used, like ws_bench.py.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "components", "aera_dlog",
+                      "include", "aera_dlog_msgs.h")
+
+ENTRY = re.compile(r'X\(\s*(\w+)\s*,\s*([EWIDV])\s*,\s*"([^"]*)"\s*,\s*(\d+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+SPEC = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?([diuxXcs%])")
+# Raw line, after the board name the simulation puts in front
+RAW = re.compile(r"^(?P<pre>.*?)#D (?P<id>[0-9a-f]+) (?P<us>[0-9a-f]+)(?P<args>(?: [0-9a-f]+)*)\s*$")
+
+
+# --- MESSAGES ---
+
+def slots(fmt):
+    """Argument slots a format takes, as aera_dlog.c reads them."""
+    n = 0
+    for m in SPEC.finditer(fmt):
+        conv = m.group(4)
+        if conv == "s":
+            n += (int(m.group(3) or 4) + 3) // 4
+        elif conv != "%":
+            n += 1
+    return n
+
+
+def load_messages(path):
+    text = open(path).read().replace("\\\n", " ")
+    text = re.sub(r"/\*.*?\*/", " ", text, flags=re.S)
+    msgs = []
+    for m in ENTRY.finditer(text):
+        name, level, tag, nargs, fmt = m.groups()
+        fmt = bytes(fmt, "ascii").decode("unicode_escape")
+        if slots(fmt) != int(nargs):
+            print(f"dlog_decode: {name} takes {slots(fmt)} slot(s) but is declared with {nargs}",
+                  file=sys.stderr)
+        msgs.append((name, level, tag, fmt))
+    if not msgs:
+        raise SystemExit(f"dlog_decode: no messages in {path}")
+    return msgs
+
+
+# --- DECODING ---
+
+def unpack(words, n):
+    """Up to n characters packed four to a word, first one lowest."""
+    out = bytearray()
+    for w in words:
+        for i in range(4):
+            c = (w >> (8 * i)) & 0xFF
+            if c == 0 or len(out) == n:
+                return out.decode("latin-1")
+            out.append(c)
+    return out.decode("latin-1")
+
+
+def format_entry(fmt, args):
+    out = []
+    pos = 0
+    a = 0
+    for m in SPEC.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        if conv == "s":
+            n = int(prec or 4)
+            take = (n + 3) // 4
+            out.append(("%" + flags + width + "s") % unpack(args[a:a + take], n))
+            a += take
+            continue
+        v = args[a] if a < len(args) else 0
+        a += 1
+        if conv in "di":
+            v = v - (1 << 32) if v & 0x80000000 else v
+        elif conv == "c":
+            v = chr(v & 0xFF)
+        out.append(("%" + flags + width + ("." + prec if prec else "") + conv) % v)
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def decode_line(line, msgs):
+    m = RAW.match(line)
+    if m is None:
+        return line
+    mid = int(m.group("id"), 16)
+    if mid >= len(msgs):
+        return line.rstrip("\n") + "  <unknown id; header too old?>\n"
+    name, level, tag, fmt = msgs[mid]
+    us = int(m.group("us"), 16)
+    args = [int(x, 16) for x in m.group("args").split()]
+    # The simulation prints the board as "[top] "; keep it where sim_log does
+    board = m.group("pre")
+    return f"{level} ({us // 1000}) {board}{tag}: {format_entry(fmt, args)}\n"
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    p.add_argument("files", nargs="*", help="logs to decode (default: stdin)")
+    p.add_argument("--header", default=HEADER, help="aera_dlog_msgs.h of the build that logged")
+    args = p.parse_args()
+
+    msgs = load_messages(args.header)
+    streams = [open(f, errors="replace") for f in args.files] or [sys.stdin]
+    try:
+        for s in streams:
+            for line in s:
+                sys.stdout.write(decode_line(line, msgs))
+                sys.stdout.flush()
+    except (BrokenPipeError, KeyboardInterrupt):
+        pass
+
+
+if __name__ == "__main__":
+    main()
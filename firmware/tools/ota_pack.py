@@ -0,0 +1,295 @@
+#!/usr/bin/env python3
+"""Pack bottom controller firmware into .aota files and update it through the top controller.
+
+`pack` turns the bottom controller's firmware.bin into an .aota file
+(aera_ota.h): LZSS-packed unless --store, checked by unpacking it again.
+`upload` POSTs one to the top controller's /ota/bottom and, if the upload
+drops, POSTs it again: the bottom controller keeps what it already has and
+the update carries on from there. A .bin is packed on the way.
+
+    ota_pack.py pack .pio/build/esp32dev/firmware.bin -o bottom.aota
+    ota_pack.py upload bottom.aota --url http://192.168.18.200:81
+
+`bench` runs the host simulation at each link speed, once with the image
+stored and once packed, and prints how long each update took. The sim
+writes what the bottom controller received to a file, which is compared
+with the image:
+
+    ota_pack.py bench firmware.bin --sim build-sim/aera_sim --bauds 115200,460800,921600
+
+Only the standard library is used, like ws_bench.py.
+"""
+
+import argparse
+import asyncio
+import json
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+import urllib.error
+import urllib.request
+import zlib
+
+from ws_bench import git_describe, parse_kv, wait_for_server
+
+# aera_ota.h
+MAGIC = b"AOTA"
+STORED, LZSS = 0, 1
+WINDOW = 4096
+MIN_MATCH = 3
+MAX_MATCH = 18
+HEADER = struct.Struct(">4sB3xIII")
+
+
+# --- LZSS ---
+
+def lzss_pack(data, max_chain=32):
+    """Greedy LZSS with hash chains over 3-byte prefixes. max_chain bounds
+    how many earlier positions are tried for each match."""
+    n = len(data)
+    out = bytearray()
+    head = {}
+    prev = [-1] * n
+    flags_at, items = 0, 8
+
+    def insert(pos):
+        if pos + MIN_MATCH <= n:
+            key = data[pos:pos + MIN_MATCH]
+            prev[pos] = head.get(key, -1)
+            head[key] = pos
+
+    i = 0
+    while i < n:
+        if items == 8:
+            flags_at, items = len(out), 0
+            out.append(0)
+
+        best_len, best_dist = 0, 0
+        limit = min(MAX_MATCH, n - i)
+        if limit >= MIN_MATCH:
+            cand = head.get(data[i:i + MIN_MATCH], -1)
+            chain = 0
+            while cand >= 0 and i - cand <= WINDOW and chain < max_chain:
+                # Cheap reject first: it has to beat the best one so far
+                if best_len == 0 or data[cand + best_len] == data[i + best_len]:
+                    length = MIN_MATCH
+                    while length < limit and data[cand + length] == data[i + length]:
+                        length += 1
+                    if length > best_len:
+                        best_len, best_dist = length, i - cand
+                        if length == limit:
+                            break
+                cand = prev[cand]
+                chain += 1
+
+        if best_len >= MIN_MATCH:
+            d = best_dist - 1
+            out += bytes((d >> 4, (d & 0x0F) << 4 | (best_len - MIN_MATCH)))
+            for k in range(best_len):
+                insert(i + k)
+            i += best_len
+        else:
+            out[flags_at] |= 0x80 >> items
+            out.append(data[i])
+            insert(i)
+            i += 1
+        items += 1
+    return bytes(out)
+
+
+def lzss_unpack(stream):
+    """Reference unpacker, as aera_ota_decode() does it"""
+    out = bytearray()
+    i, n = 0, len(stream)
+    while i < n:
+        flags = stream[i]
+        i += 1
+        for bit in range(8):
+            if i >= n:
+                break
+            if flags & (0x80 >> bit):
+                out.append(stream[i])
+                i += 1
+            else:
+                if i + 1 >= n:
+                    raise ValueError("stream ends inside a back-reference")
+                dist = (stream[i] << 4 | stream[i + 1] >> 4) + 1
+                length = (stream[i + 1] & 0x0F) + MIN_MATCH
+                i += 2
+                if dist > len(out):
+                    raise ValueError("back-reference before the start")
+                for _ in range(length):
+                    out.append(out[-dist])
+    return bytes(out)
+
+
+# --- .AOTA FILES ---
+
+def pack(image, store=False):
+    stream = image if store else lzss_pack(image)
+    if not store and lzss_unpack(stream) != image:
+        raise RuntimeError("LZSS round trip failed")
+    header = HEADER.pack(MAGIC, STORED if store else LZSS, len(image), len(stream), zlib.crc32(stream))
+    return header + stream
+
+
+def describe(blob):
+    magic, fmt, image_len, stream_len, crc = HEADER.unpack_from(blob)
+    if magic != MAGIC or len(blob) != HEADER.size + stream_len:
+        raise ValueError("not an .aota file")
+    return {"format": "stored" if fmt == STORED else "lzss", "image": image_len,
+            "stream": stream_len, "crc32": f"{crc:08x}"}
+
+
+def load(path, store=False):
+    with open(path, "rb") as f:
+        data = f.read()
+    return data if data[:4] == MAGIC else pack(data, store)
+
+
+# --- UPLOAD ---
+
+def upload(url, blob, reboot=True, retries=5, timeout=300.0, log=sys.stderr, unit=None):
+    """POSTs the file until the top controller says OTA:done. Returns its
+    fields, plus how many POSTs it took. unit picks the bottom controller
+    on a bus."""
+    query = [] if reboot else ["reboot=0"]
+    if unit is not None:
+        query.append(f"unit={unit}")
+    target = url.rstrip("/") + "/ota/bottom" + ("?" + "&".join(query) if query else "")
+    for attempt in range(1, retries + 2):
+        req = urllib.request.Request(target, data=blob, method="POST",
+                                     headers={"Content-Type": "application/octet-stream"})
+        try:
+            with urllib.request.urlopen(req, timeout=timeout) as resp:
+                result = parse_kv(resp.read().decode(errors="replace"))
+                result["posts"] = attempt
+                return result
+        except urllib.error.HTTPError as e:
+            text = e.read().decode(errors="replace").strip()
+            if e.code == 400:
+                raise RuntimeError(text)
+            print(f"POST {attempt}: {text}", file=log)
+        except (urllib.error.URLError, OSError) as e:
+            print(f"POST {attempt}: {e}", file=log)
+        time.sleep(1.0)
+    raise RuntimeError(f"no update after {retries + 1} POSTs")
+
+
+# --- BENCH ---
+
+def bench_one(args, image, blob, baud, store):
+    out_base = os.path.join(tempfile.mkdtemp(prefix="aera_ota_"), "img")
+    sim = subprocess.Popen([args.sim, "--http-port", str(args.sim_port), "--baud", str(baud),
+                            "--ota", out_base], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        asyncio.run(_wait(args.sim_port))
+        t0 = time.perf_counter()
+        result = upload(f"http://127.0.0.1:{args.sim_port}", blob, reboot=False, retries=args.retries)
+        seconds = time.perf_counter() - t0
+    finally:
+        sim.terminate()
+        sim.wait()
+
+    with open(out_base + ".bottom", "rb") as f:
+        received = f.read()
+    info = describe(blob)
+    return {
+        "baud": baud,
+        "format": "stored" if store else "lzss",
+        "image": info["image"],
+        "stream": info["stream"],
+        "ratio": round(info["stream"] / info["image"], 3),
+        "seconds": round(seconds, 2),
+        "image_kb_s": round(len(image) / seconds / 1024, 2),
+        "line_use": round(info["stream"] * 10 / baud / seconds, 3),
+        "resent": result.get("resent"),
+        "gaps": result.get("gaps"),
+        "busy": result.get("busy"),
+        "stalls": result.get("stalls"),
+        "intact": received == image,
+    }
+
+
+async def _wait(port):
+    await (await wait_for_server("127.0.0.1", port, 30.0, 2.0)).close()
+
+
+def print_table(rows):
+    print(f"{'baud':>7} {'format':>6} {'image':>8} {'stream':>8} {'ratio':>6} {'s':>7} "
+          f"{'KB/s':>6} {'line':>5} {'resent':>6} {'busy':>4} ok", file=sys.stderr)
+    for r in rows:
+        print(f"{r['baud']:>7} {r['format']:>6} {r['image']:>8} {r['stream']:>8} {r['ratio']:>6.3f} "
+              f"{r['seconds']:>7.2f} {r['image_kb_s']:>6.2f} {r['line_use']:>5.2f} {r['resent']:>6} "
+              f"{r['busy']:>4} {'yes' if r['intact'] else 'NO'}", file=sys.stderr)
+
+
+# --- MAIN ---
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    sub = p.add_subparsers(dest="cmd", required=True)
+
+    k = sub.add_parser("pack", help="firmware.bin -> .aota")
+    k.add_argument("image")
+    k.add_argument("-o", "--out", required=True)
+    k.add_argument("--store", action="store_true", help="don't compress")
+
+    u = sub.add_parser("upload", help="update the bottom controller")
+    u.add_argument("file", help=".aota, or a firmware.bin to pack first")
+    u.add_argument("--url", default="http://192.168.18.200:81", help="http://host:port of the top controller")
+    u.add_argument("--store", action="store_true", help="don't compress a .bin")
+    u.add_argument("--no-reboot", action="store_true", help="boot the new image on the next reset instead")
+    u.add_argument("--retries", type=int, default=5, help="POSTs after the first if the upload drops")
+    u.add_argument("--unit", type=int, help="bottom controller address, with them on a bus")
+
+    b = sub.add_parser("bench", help="time updates in the host simulation")
+    b.add_argument("image", help="firmware.bin")
+    b.add_argument("--sim", metavar="AERA_SIM", required=True, help="aera_sim binary")
+    b.add_argument("--sim-port", type=int, default=8081)
+    b.add_argument("--bauds", default="115200,460800,921600")
+    b.add_argument("--retries", type=int, default=2)
+    b.add_argument("--out", help="write the JSON result here (default: stdout)")
+
+    args = p.parse_args()
+
+    if args.cmd == "pack":
+        with open(args.image, "rb") as f:
+            blob = pack(f.read(), args.store)
+        with open(args.out, "wb") as f:
+            f.write(blob)
+        info = describe(blob)
+        print(f"{args.out}: {info['format']}, {info['image']} -> {info['stream']} bytes "
+              f"({info['stream'] / info['image']:.1%}), crc32 {info['crc32']}")
+
+    elif args.cmd == "upload":
+        blob = load(args.file, args.store)
+        info = describe(blob)
+        print(f"Sending {info['stream']} bytes ({info['format']}) for a {info['image']} byte image", file=sys.stderr)
+        result = upload(args.url, blob, reboot=not args.no_reboot, retries=args.retries, unit=args.unit)
+        print(json.dumps(result, indent=2))
+
+    else:
+        with open(args.image, "rb") as f:
+            image = f.read()
+        blobs = {store: pack(image, store) for store in (True, False)}
+        rows = [bench_one(args, image, blobs[store], int(baud), store)
+                for baud in args.bauds.split(",") for store in (True, False)]
+        print_table(rows)
+        text = json.dumps({"meta": {"tool": "ota_pack bench", "git": git_describe(),
+                                    "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"), "image": args.image},
+                           "runs": rows}, indent=2)
+        if args.out:
+            with open(args.out, "w") as f:
+                f.write(text + "\n")
+        else:
+            print(text)
+        if not all(r["intact"] for r in rows):
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
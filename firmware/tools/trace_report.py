@@ -0,0 +1,334 @@
+#!/usr/bin/env python3
+"""Per-stage latency breakdown of commands, from both boards' tracepoints.
+
+Sends TRACE, which dumps the top and the bottom controller's trace rings
+(aera_trace.h), lines the two up by link sequence number, works out the
+offset between the boards' clocks and prints where each command's time
+went: httpd, the TX queue, the wire out, the bottom board's wake-up and
+handling, the wire back. The slowest commands are listed stage by stage.
+
+    trace_report.py --url ws://192.168.18.200:81
+    trace_report.py --sim build-sim/aera_sim --probe 50
+    trace_report.py --load dump.txt --commands
+
+--probe N sends N ON/OFF first and times them on this side as well; what
+the boards don't account for is the Wi-Fi and TCP both ways plus the STATUS
+broadcast, reported as "network". --save keeps the raw replies, --load
+reads them back instead of asking a board, --json writes the result.
+
+Clock offset: uart_tx, b_rx, b_ack and ack_rx of a command are an NTP
+exchange. The commands with the shortest round trip give the offset (a
+straight-line fit, if they span long enough to show drift); its error is
+at most half their round trip. The wire stages include the line-idle wait
+before the receiving board wakes up.
+
+Only the standard library is used, like ws_bench.py.
+"""
+
+import argparse
+import asyncio
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+
+from ws_bench import git_describe, percentile, wait_for_server
+
+REGISTRY = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "components", "aera_link",
+                        "include", "aera_cmd.h")
+
+# A command's stages arrive within this of each other, retries included
+# (4 tries x 50 ms); seq numbers come round much later than that
+SAME_CMD_US = 500_000
+# Stages recorded again on every retry of a frame
+REPEATING = {"uart_tx", "b_rx", "b_parsed", "b_ack"}
+
+# (name, from stage, to stage), in path order; times on the top board's clock
+SEGMENTS = [
+    ("httpd", "ws_rx", "queued"),
+    ("tx_queue", "queued", "uart_tx"),
+    ("wire_out", "uart_tx", "b_rx"),
+    ("b_parse", "b_rx", "b_parsed"),
+    ("b_gpio", "b_parsed", "b_gpio"),
+    ("b_ack", "b_parsed", "b_ack"),
+    ("wire_back", "b_ack", "ack_rx"),
+    ("total", "ws_rx", "ack_rx"),
+]
+
+
+def load_opcodes(path):
+    names = {}
+    try:
+        text = open(path).read()
+    except OSError:
+        return names
+    for m in re.finditer(r"X\(\s*(\w+)\s*,\s*0x([0-9A-Fa-f]+)\s*,", text):
+        names[int(m.group(2), 16)] = m.group(1)
+    return names
+
+
+# --- FETCH ---
+
+async def fetch(host, port, probes, interval, timeout):
+    """TRACE replies from the top and the bottom board, after sending the
+    probes; returns (replies, probe round trips in us, in order)"""
+    ws = await wait_for_server(host, port, 30.0, timeout)
+    rtts = []
+    try:
+        for i in range(probes):
+            cmd = "ON" if i % 2 == 0 else "OFF"
+            t0 = time.perf_counter()
+            await ws.send_text(cmd)
+            while True:
+                op, payload = await asyncio.wait_for(ws.recv(), timeout)
+                if payload.decode(errors="replace") == "STATUS:" + cmd:
+                    break
+            rtts.append((time.perf_counter() - t0) * 1e6)
+            await asyncio.sleep(interval)
+
+        await ws.send_text("TRACE")
+        replies = {}
+        while len(replies) < 2:
+            op, payload = await asyncio.wait_for(ws.recv(), timeout)
+            text = payload.decode(errors="replace")
+            if text.startswith("TRACE:"):
+                replies[text[6:].split(",", 1)[0]] = text
+        return [replies["top"], replies["bottom"]], rtts
+    finally:
+        await ws.close()
+
+
+# --- PARSE ---
+
+def parse_dump(text):
+    """'TRACE:top,now=..,n=..,stages=a/b;s,seq,op,us;...' -> dict, or None
+    for a board that didn't answer. Times are unwrapped against now."""
+    head, _, body = text.strip().partition(";")
+    fields = head[6:].split(",")
+    kv = dict(f.split("=", 1) for f in fields[1:] if "=" in f)
+    if "now" not in kv:
+        return None
+    now = int(kv["now"])
+    stages = kv["stages"].split("/")
+    events = []
+    for item in body.split(";") if body else []:
+        stage, seq, op, us = item.split(",")
+        us = int(us)
+        events.append((stages[int(stage)], int(seq), int(op, 16), now - ((now - us) & 0xFFFFFFFF)))
+    return {"board": fields[0], "now": now, "events": events}
+
+
+def group_commands(events):
+    """Events -> one record per command, keyed by (seq, opcode)"""
+    open_recs = {}
+    done = []
+    for stage, seq, op, us in events:
+        key = (seq, op)
+        rec = open_recs.get(key)
+        if rec is not None and (us - rec["first"] > SAME_CMD_US or
+                                (stage in rec["t"] and stage not in REPEATING)):
+            done.append(rec)
+            rec = None
+        if rec is None:
+            rec = open_recs[key] = {"seq": seq, "op": op, "first": us, "t": {}}
+        rec["t"].setdefault(stage, []).append(us)
+    done.extend(open_recs.values())
+    return sorted(done, key=lambda r: r["first"])
+
+
+def pair(top_recs, bottom_recs, coarse):
+    """Each top record with the bottom one of the same (seq, opcode) nearest
+    in time, going by the coarse offset"""
+    by_key = {}
+    for b in bottom_recs:
+        by_key.setdefault((b["seq"], b["op"]), []).append(b)
+    for t in top_recs:
+        start = t["t"].get("uart_tx", [t["first"]])[0]
+        cands = by_key.get((t["seq"], t["op"]), [])
+        best = min(cands, key=lambda b: abs(b["first"] - coarse - start), default=None)
+        if best is not None and abs(best["first"] - coarse - start) < SAME_CMD_US:
+            t["bottom"] = best
+
+
+# --- CLOCK ---
+
+def estimate_offset(top_recs, coarse):
+    """bottom clock - top clock, as a function of top time, from the
+    single-try commands with the shortest round trips"""
+    samples = []
+    for t in top_recs:
+        b = t.get("bottom")
+        if b is None:
+            continue
+        tt, bt = t["t"], b["t"]
+        if len(tt.get("uart_tx", [])) != 1 or len(bt.get("b_rx", [])) != 1 or \
+                len(bt.get("b_ack", [])) != 1 or "ack_rx" not in tt:
+            continue
+        t0, t1, t2, t3 = tt["uart_tx"][0], bt["b_rx"][0], bt["b_ack"][0], tt["ack_rx"][0]
+        samples.append((t0, ((t1 - t0) + (t2 - t3)) / 2.0, (t3 - t0) - (t2 - t1)))
+
+    if not samples:
+        return {"fn": lambda t: coarse, "samples": 0, "offset_us": coarse, "drift_ppm": None, "error_us": None}
+
+    best = sorted(samples, key=lambda s: s[2])[:max(1, len(samples) // 4)]
+    error = max(0.0, best[0][2] / 2.0)
+    xs = [s[0] for s in best]
+    ys = [s[1] for s in best]
+    if len(best) >= 3 and max(xs) - min(xs) > 2e6:
+        mx, my = sum(xs) / len(xs), sum(ys) / len(ys)
+        slope = sum((x - mx) * (y - my) for x, y in zip(xs, ys)) / sum((x - mx) ** 2 for x in xs)
+        fn = lambda t: my + slope * (t - mx)
+        drift = slope * 1e6
+    else:
+        mid = sorted(ys)[len(ys) // 2]
+        fn = lambda t: mid
+        drift = None
+    return {"fn": fn, "samples": len(samples), "offset_us": fn(xs[-1]), "drift_ppm": drift, "error_us": error}
+
+
+# --- STAGES ---
+
+def breakdown(top_recs, clock):
+    """Per command: stage times on the top board's clock and the segments"""
+    rows = []
+    for t in top_recs:
+        if "queued" not in t["t"] and "ws_rx" not in t["t"] and "uart_tx" not in t["t"]:
+            continue    # Only the tail end of it is left in the ring
+        at = dict(t["t"])
+        b = t.get("bottom")
+        if b is not None:
+            for stage, times in b["t"].items():
+                at[stage] = [us - clock(us) for us in times]
+        # From the first try out; the way back from the ACK that got through
+        first = {s: v[0] for s, v in at.items()}
+        last_ack = at["b_ack"][-1] if "b_ack" in at else None
+        seg = {}
+        for name, a, z in SEGMENTS:
+            start = last_ack if a == "b_ack" else first.get(a)
+            if start is not None and z in first:
+                seg[name] = first[z] - start
+        rows.append({"seq": t["seq"], "op": t["op"], "at": first.get("ws_rx", first.get("queued", t["first"])),
+                     "tries": len(at.get("uart_tx", [])), "segments": seg})
+    return rows
+
+
+def attach_probes(rows, rtts):
+    """The probes were the last len(rtts) ON/OFF commands the top board saw
+    from the WebSocket, in order"""
+    cands = [r for r in rows if r["op"] in (0x01, 0x02) and "total" in r["segments"]]
+    if not rtts or len(cands) < len(rtts):
+        return
+    for r, rtt in zip(cands[-len(rtts):], rtts):
+        r["segments"]["network"] = rtt - r["segments"]["total"]
+        r["segments"]["client"] = rtt
+
+
+def summarize(rows):
+    names = [name for name, _, _ in SEGMENTS] + ["network", "client"]
+    out = {}
+    for name in names:
+        vals = sorted(r["segments"][name] for r in rows if name in r["segments"])
+        if vals:
+            out[name] = {"n": len(vals), "min_us": round(vals[0]), "p50_us": round(percentile(vals, 50)),
+                         "p90_us": round(percentile(vals, 90)), "max_us": round(vals[-1])}
+    return out
+
+
+# --- OUTPUT ---
+
+def print_report(result, opnames, commands, slowest):
+    c = result["clock"]
+    if c["error_us"] is None:
+        print(f"clock: no exchange to go by, coarse offset {c['offset_us'] / 1e3:.1f} ms", file=sys.stderr)
+    else:
+        drift = "" if c["drift_ppm"] is None else f", drift {c['drift_ppm']:+.1f} ppm"
+        print(f"clock: bottom - top = {c['offset_us'] / 1e3:.3f} ms +/- {c['error_us'] / 1e3:.3f} ms "
+              f"from {c['samples']} exchange(s){drift}", file=sys.stderr)
+    print(f"commands: {len(result['rows'])}", file=sys.stderr)
+    print(f"{'stage':10} {'n':>5} {'min ms':>8} {'p50 ms':>8} {'p90 ms':>8} {'max ms':>8}", file=sys.stderr)
+    for name, s in result["stages"].items():
+        print(f"{name:10} {s['n']:5} {s['min_us'] / 1e3:8.3f} {s['p50_us'] / 1e3:8.3f} {s['p90_us'] / 1e3:8.3f} "
+              f"{s['max_us'] / 1e3:8.3f}", file=sys.stderr)
+
+    rows = result["rows"]
+    if not commands:
+        rows = sorted((r for r in rows if "total" in r["segments"]), key=lambda r: -r["segments"]["total"])
+        rows = rows[:slowest]
+        if rows:
+            print(f"slowest {len(rows)}:", file=sys.stderr)
+    for r in rows:
+        parts = " ".join(f"{k}={v / 1e3:.3f}" for k, v in r["segments"].items())
+        name = opnames.get(r["op"], f"0x{r['op']:02x}")
+        tries = f" tries={r['tries']}" if r["tries"] > 1 else ""
+        print(f"  seq={r['seq']:3} {name:10}{tries} {parts}", file=sys.stderr)
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    p.add_argument("--url", default="ws://192.168.18.200:81", help="ws://host:port of the top controller")
+    p.add_argument("--sim", metavar="AERA_SIM", help="start this aera_sim binary and trace it")
+    p.add_argument("--sim-port", type=int, default=8081)
+    p.add_argument("--probe", type=int, default=0, metavar="N", help="send N ON/OFF first, timed from here too")
+    p.add_argument("--interval", type=float, default=0.1, help="seconds between probes")
+    p.add_argument("--timeout", type=float, default=2.0)
+    p.add_argument("--save", help="write the raw TRACE replies here")
+    p.add_argument("--load", help="read raw TRACE replies from here instead of asking a board")
+    p.add_argument("--commands", action="store_true", help="list every command, not just the slowest")
+    p.add_argument("--slowest", type=int, default=5)
+    p.add_argument("--json", help="write the result here")
+    args = p.parse_args()
+
+    rtts = []
+    if args.load:
+        replies = [line for line in open(args.load).read().splitlines() if line.startswith("TRACE:")]
+    else:
+        sim = None
+        if args.sim:
+            sim = subprocess.Popen([args.sim, "--http-port", str(args.sim_port)],
+                                   stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+            host, port = "127.0.0.1", args.sim_port
+        else:
+            hostport = args.url.split("://", 1)[-1].split("/", 1)[0]
+            host, _, port = hostport.partition(":")
+            port = int(port or 80)
+        try:
+            replies, rtts = asyncio.run(fetch(host, port, args.probe, args.interval, args.timeout))
+        finally:
+            if sim:
+                sim.terminate()
+                sim.wait()
+        if args.save:
+            with open(args.save, "w") as f:
+                f.write("\n".join(replies) + "\n")
+
+    dumps = {d["board"]: d for d in map(parse_dump, replies) if d is not None}
+    if "top" not in dumps:
+        raise SystemExit("trace_report: no TRACE:top reply")
+    top_recs = group_commands(dumps["top"]["events"])
+    coarse = 0
+    if "bottom" in dumps:
+        # The bottom board dumped just after the top one; close enough to pair
+        coarse = dumps["bottom"]["now"] - dumps["top"]["now"]
+        pair(top_recs, group_commands(dumps["bottom"]["events"]), coarse)
+    else:
+        print("trace_report: the bottom board's ring didn't come; top stages only", file=sys.stderr)
+
+    clock = estimate_offset(top_recs, coarse)
+    rows = breakdown(top_recs, clock["fn"])
+    attach_probes(rows, rtts)
+    result = {
+        "meta": {"tool": "trace_report", "git": git_describe(), "time": time.strftime("%Y-%m-%dT%H:%M:%S%z")},
+        "clock": {k: v for k, v in clock.items() if k != "fn"},
+        "stages": summarize(rows),
+        "rows": rows,
+    }
+    print_report(result, load_opcodes(REGISTRY), args.commands, args.slowest)
+    if args.json:
+        with open(args.json, "w") as f:
+            f.write(json.dumps(result, indent=2) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,679 @@
+#!/usr/bin/env python3
+"""WebSocket load generator and latency benchmark for the control path.
+
+Opens N WebSocket clients against the top controller and drives a mix of
+commands at a fixed rate each, either closed-loop (wait for the reply before
+the next command) or open-loop (send on schedule whatever happens). Reports
+throughput, p50/p99/p999 latency per command, errors and timeouts, plus the
+server's own STATS before and after the run, and writes it all as JSON so
+runs can be compared across commits. POWER either side of the run gives the
+power mode and how much of the run the CPU spent at full speed; run once
+with POWER_SAVE on and once off to see what modem sleep costs in latency.
+
+Works against hardware or the host simulation:
+
+    ws_bench.py --url ws://192.168.18.200:81 --clients 4 --rate 20 --duration 30
+    ws_bench.py --sim build-sim/aera_sim --clients 10 --mix ON=1,OFF=1,PING=2 --out run.json
+
+--mode idle sends no commands and counts what it takes to keep the clients
+connected instead: every frame and byte each way, control frames included.
+Every frame a client sends is one run of the server's WebSocket handler.
+--app-ping 1.5 adds the PING the app used to send on its own, to compare:
+
+    ws_bench.py --sim build-sim/aera_sim --clients 10 --mode idle --duration 60
+    ws_bench.py --sim build-sim/aera_sim --clients 10 --mode idle --duration 60 --app-ping 1.5
+
+--transport udp drives the same load over the UDP control channel
+(udp_ctrl.h) instead, under the unit's key (--udp-key, 32 hex digits; with
+--sim a random one is provisioned); both runs one after the other,
+WebSocket first, and reports the UDP rows as udp:ON etc. next to them.
+Commands not answered within --udp-retry are sent again with the same
+sequence number, which the firmware answers without acting twice:
+
+    ws_bench.py --sim build-sim/aera_sim --clients 4 --rate 20 --transport both
+
+Latency is measured from send to the reply that answers it: PONG for PING,
+the next STATUS:ON/OFF broadcast for ON/OFF. With several clients toggling
+at once a STATUS can be the answer to someone else's command; the numbers
+are then "time until this client saw the state it asked for". Over UDP it
+is the reply datagram for the command's sequence number, first send to
+first answer.
+
+Only the standard library is used, so it runs anywhere Python 3.8+ does.
+"""
+
+import argparse
+import asyncio
+import base64
+import json
+import os
+import random
+import struct
+import subprocess
+import sys
+import time
+
+# Reply that answers each command, by prefix
+REPLY_FOR = {
+    "PING": "PONG",
+    "ON": "STATUS:ON",
+    "OFF": "STATUS:OFF",
+    "STATS": "STATS:",
+    "LATENCY": "LATENCY:",
+}
+
+# Registry opcodes (aera_cmd.h) of the commands UDP takes
+UDP_OPCODE = {"OFF": 0x01, "ON": 0x02, "PING": 0x03}
+UDP_STATUS = ("OK", "NO_ACK", "TIMEOUT", "BUSY", "REFUSED", "NONCE")
+UDP_NONCE = 5
+
+
+# --- MINIMAL WEBSOCKET CLIENT ---
+
+class WsClient:
+    def __init__(self, reader, writer):
+        self.reader = reader
+        self.writer = writer
+        # Frames and bytes on the wire, headers and control frames included
+        self.frames_in = self.bytes_in = 0
+        self.frames_out = self.bytes_out = 0
+
+    @classmethod
+    async def connect(cls, host, port, path="/"):
+        reader, writer = await asyncio.open_connection(host, port)
+        key = base64.b64encode(os.urandom(16)).decode()
+        writer.write(
+            (f"GET {path} HTTP/1.1\r\nHost: {host}:{port}\r\nUpgrade: websocket\r\n"
+             f"Connection: Upgrade\r\nSec-WebSocket-Key: {key}\r\n"
+             "Sec-WebSocket-Version: 13\r\n\r\n").encode())
+        await writer.drain()
+        head = await reader.readuntil(b"\r\n\r\n")
+        if b" 101 " not in head.split(b"\r\n", 1)[0]:
+            raise ConnectionError(head.split(b"\r\n", 1)[0].decode(errors="replace"))
+        return cls(reader, writer)
+
+    async def send_text(self, text, opcode=0x1):
+        payload = text.encode() if isinstance(text, str) else text
+        mask = os.urandom(4)
+        n = len(payload)
+        if n < 126:
+            head = struct.pack("!BB", 0x80 | opcode, 0x80 | n)
+        elif n < 65536:
+            head = struct.pack("!BBH", 0x80 | opcode, 0x80 | 126, n)
+        else:
+            head = struct.pack("!BBQ", 0x80 | opcode, 0x80 | 127, n)
+        body = bytes(b ^ mask[i & 3] for i, b in enumerate(payload))
+        self.writer.write(head + mask + body)
+        self.frames_out += 1
+        self.bytes_out += len(head) + len(mask) + n
+        await self.writer.drain()
+
+    async def recv(self):
+        """Returns (opcode, payload bytes). Answers server pings itself."""
+        while True:
+            b0, b1 = await self.reader.readexactly(2)
+            n = b1 & 0x7F
+            head = 2
+            if n == 126:
+                n = struct.unpack("!H", await self.reader.readexactly(2))[0]
+                head = 4
+            elif n == 127:
+                n = struct.unpack("!Q", await self.reader.readexactly(8))[0]
+                head = 10
+            payload = await self.reader.readexactly(n)
+            self.frames_in += 1
+            self.bytes_in += head + n
+            opcode = b0 & 0x0F
+            if opcode == 0x9:
+                await self.send_text(payload, opcode=0xA)
+                continue
+            return opcode, payload
+
+    async def close(self):
+        try:
+            await self.send_text(b"", opcode=0x8)
+        except Exception:
+            pass
+        self.writer.close()
+
+
+async def wait_for_server(host, port, wait_s, timeout):
+    """Retries the handshake until it goes through and returns the client.
+    A board just powered up, or the simulation, only answers once its Wi-Fi
+    is up."""
+    deadline = time.monotonic() + wait_s
+    while True:
+        try:
+            return await asyncio.wait_for(WsClient.connect(host, port), timeout)
+        except (OSError, ConnectionError, asyncio.TimeoutError, asyncio.IncompleteReadError):
+            if time.monotonic() > deadline:
+                raise TimeoutError(f"ws://{host}:{port} did not come up within {wait_s} s")
+            await asyncio.sleep(0.01)
+
+
+# --- STATS ---
+
+# --- UDP CONTROL CLIENT ---
+
+def siphash24(key, data):
+    """SipHash-2-4 of data under a 16-byte key, as 8 little-endian bytes"""
+    mask = (1 << 64) - 1
+    rotl = lambda x, b: ((x << b) | (x >> (64 - b))) & mask
+    k0, k1 = struct.unpack("<QQ", key)
+    v = [k0 ^ 0x736f6d6570736575, k1 ^ 0x646f72616e646f6d, k0 ^ 0x6c7967656e657261, k1 ^ 0x7465646279746573]
+
+    def rnd():
+        v[0] = (v[0] + v[1]) & mask
+        v[1] = rotl(v[1], 13) ^ v[0]
+        v[0] = rotl(v[0], 32)
+        v[2] = (v[2] + v[3]) & mask
+        v[3] = rotl(v[3], 16) ^ v[2]
+        v[0] = (v[0] + v[3]) & mask
+        v[3] = rotl(v[3], 21) ^ v[0]
+        v[2] = (v[2] + v[1]) & mask
+        v[1] = rotl(v[1], 17) ^ v[2]
+        v[2] = rotl(v[2], 32)
+
+    full = len(data) & ~7
+    tail = data[full:] + bytes(7 - len(data) % 8) + bytes([len(data) & 0xFF])
+    for i in range(0, full + 8, 8):
+        m = struct.unpack_from("<Q", data[i:i + 8] if i < full else tail)[0]
+        v[3] ^= m
+        rnd()
+        rnd()
+        v[0] ^= m
+    v[2] ^= 0xFF
+    for _ in range(4):
+        rnd()
+    return struct.pack("<Q", v[0] ^ v[1] ^ v[2] ^ v[3])
+
+
+class UdpClient(asyncio.DatagramProtocol):
+    """One client of the control channel: its own random id and sequence
+    numbers. on_reply(seq, status, state) runs for each authentic reply.
+    A command refused for the server's nonce is sent again at once with the
+    one the answer carries, and only that one's answer is passed on."""
+
+    def __init__(self, key, on_reply):
+        self.key = key
+        self.on_reply = on_reply
+        self.client = random.getrandbits(32)
+        self.seq = 0
+        self.nonce = 0          # The server's; learnt from the first answer
+        self.unsent = {}        # seq -> (nonce it went with, send() arguments), until answered
+        self.transport = None
+        self.frames_in = self.bytes_in = 0
+        self.frames_out = self.bytes_out = 0
+
+    @classmethod
+    async def connect(cls, host, port, key, on_reply):
+        loop = asyncio.get_running_loop()
+        _, proto = await loop.create_datagram_endpoint(lambda: cls(key, on_reply), remote_addr=(host, port))
+        return proto
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def send(self, seq, opcode, payload=b"", unit=0):
+        self.unsent[seq] = (self.nonce, (opcode, payload, unit))
+        body = struct.pack(">BBIIIBBB", 0xAE, 2, self.nonce, self.client, seq, unit, opcode,
+                           len(payload)) + payload
+        datagram = body + siphash24(self.key, body)
+        self.transport.sendto(datagram)
+        self.frames_out += 1
+        self.bytes_out += len(datagram)
+
+    def datagram_received(self, data, addr):
+        self.frames_in += 1
+        self.bytes_in += len(data)
+        if len(data) != 26 or data[:2] != b"\xae\x82" or siphash24(self.key, data[:18]) != data[18:]:
+            return
+        nonce, client, seq, _unit, _opcode, status, state = struct.unpack(">IIIBBBB", data[2:18])
+        if client != self.client:
+            return
+        if status == UDP_NONCE:
+            sent = self.unsent.get(seq)
+            self.nonce = nonce
+            if sent is not None and sent[0] != nonce:
+                self.send(seq, *sent[1])
+            return
+        self.unsent.pop(seq, None)
+        self.on_reply(seq, status, state)
+
+    def close(self):
+        self.transport.close()
+
+
+def parse_kv(text):
+    """'STATS:a=1,b=2/3' -> {'a': 1, 'b': '2/3'}"""
+    out = {}
+    body = text.split(":", 1)[1] if ":" in text else text
+    for item in body.split(","):
+        if "=" not in item:
+            continue
+        k, v = item.split("=", 1)
+        try:
+            out[k] = int(v)
+        except ValueError:
+            out[k] = v
+    return out
+
+
+def percentile(sorted_vals, pct):
+    if not sorted_vals:
+        return None
+    idx = min(len(sorted_vals) - 1, max(0, int(round(pct / 100.0 * len(sorted_vals) + 0.5)) - 1))
+    return sorted_vals[idx]
+
+
+async def query_stats(host, port, timeout, cmd="STATS"):
+    try:
+        ws = await asyncio.wait_for(WsClient.connect(host, port), timeout)
+        await ws.send_text(cmd)
+        while True:
+            op, payload = await asyncio.wait_for(ws.recv(), timeout)
+            text = payload.decode(errors="replace")
+            if text.startswith(cmd + ":"):
+                await ws.close()
+                return parse_kv(text)
+    except Exception as e:
+        return {"error": str(e)}
+
+
+# --- LOAD ---
+
+class Totals:
+    def __init__(self):
+        self.latencies = {}   # cmd -> [seconds]
+        self.sent = {}
+        self.timeouts = {}
+        self.errors = {}      # reason -> count
+        self.connect_failures = 0
+        self.wire = {"frames_in": 0, "bytes_in": 0, "frames_out": 0, "bytes_out": 0}
+        self.disconnects = 0  # Sessions that ended before the run did
+        self.resent = 0       # UDP commands sent again after --udp-retry
+
+    def add_wire(self, ws):
+        for k in self.wire:
+            self.wire[k] += getattr(ws, k)
+
+    def count(self, table, key):
+        table[key] = table.get(key, 0) + 1
+
+
+async def run_client(idx, args, host, port, mix, totals, t_end):
+    try:
+        ws = await asyncio.wait_for(WsClient.connect(host, port), args.timeout)
+    except Exception as e:
+        totals.connect_failures += 1
+        totals.count(totals.errors, f"connect: {e}")
+        return
+
+    if args.mode == "idle":
+        await run_idle(ws, args, totals, t_end)
+        return
+
+    rng = random.Random(args.seed + idx)
+    names, weights = zip(*mix)
+    pending = []              # [(cmd, t_sent)] in send order
+    interval = 1.0 / args.rate if args.rate > 0 else 0.0
+    next_send = time.perf_counter() + rng.random() * interval  # Spread clients out
+    reply_event = asyncio.Event()
+
+    async def reader():
+        while True:
+            try:
+                op, payload = await ws.recv()
+            except Exception:
+                return
+            now = time.perf_counter()
+            text = payload.decode(errors="replace")
+            if text.startswith("ERROR:"):
+                totals.count(totals.errors, text)
+            for i, (cmd, t0) in enumerate(pending):
+                if text.startswith(REPLY_FOR[cmd]):
+                    totals.latencies.setdefault(cmd, []).append(now - t0)
+                    del pending[i]
+                    reply_event.set()
+                    break
+
+    rtask = asyncio.create_task(reader())
+    try:
+        while time.perf_counter() < t_end:
+            # Expire anything that waited too long
+            now = time.perf_counter()
+            while pending and now - pending[0][1] > args.timeout:
+                totals.count(totals.timeouts, pending.pop(0)[0])
+
+            if args.mode == "closed" and pending:
+                reply_event.clear()
+                try:
+                    await asyncio.wait_for(reply_event.wait(), args.timeout)
+                except asyncio.TimeoutError:
+                    pass
+                continue
+
+            # Always yield, so the reader keeps up even at --rate 0
+            await asyncio.sleep(max(0.0, next_send - time.perf_counter()))
+            next_send += interval
+            if args.mode == "open" and next_send < time.perf_counter():
+                next_send = time.perf_counter()  # Don't burst to catch up
+
+            cmd = rng.choices(names, weights)[0]
+            pending.append((cmd, time.perf_counter()))
+            totals.count(totals.sent, cmd)
+            try:
+                await ws.send_text(cmd)
+            except Exception as e:
+                totals.count(totals.errors, f"send: {e}")
+                return
+
+        # Give the tail a chance to come back
+        deadline = time.perf_counter() + args.timeout
+        while pending and time.perf_counter() < deadline:
+            await asyncio.sleep(0.01)
+        for cmd, _ in pending:
+            totals.count(totals.timeouts, cmd)
+    finally:
+        rtask.cancel()
+        await ws.close()
+        totals.add_wire(ws)
+
+
+async def run_udp_client(idx, args, host, port, mix, totals, t_end):
+    """run_client() over the UDP control channel. Latencies go in as udp:<cmd>."""
+    rng = random.Random(args.seed + idx)
+    names, weights = zip(*mix)
+    pending = {}              # seq -> [cmd, t_first_sent, t_last_sent]
+    interval = 1.0 / args.rate if args.rate > 0 else 0.0
+    next_send = time.perf_counter() + rng.random() * interval
+    reply_event = asyncio.Event()
+
+    def on_reply(seq, status, state):
+        entry = pending.pop(seq, None)
+        if entry is None:
+            return            # Answer to a resend of one already answered
+        if status == 0:
+            totals.latencies.setdefault("udp:" + entry[0], []).append(time.perf_counter() - entry[1])
+        else:
+            name = UDP_STATUS[status] if status < len(UDP_STATUS) else status
+            totals.count(totals.errors, f"udp:{name}")
+        reply_event.set()
+
+    udp = await UdpClient.connect(host, args.udp_port, bytes.fromhex(args.udp_key), on_reply)
+
+    def service(now):
+        for seq, entry in list(pending.items()):
+            if now - entry[1] > args.timeout:
+                totals.count(totals.timeouts, "udp:" + entry[0])
+                del pending[seq]
+            elif now - entry[2] > args.udp_retry:
+                udp.send(seq, UDP_OPCODE[entry[0]])
+                entry[2] = now
+                totals.resent += 1
+
+    try:
+        while time.perf_counter() < t_end:
+            service(time.perf_counter())
+            if args.mode == "closed" and pending:
+                reply_event.clear()
+                try:
+                    await asyncio.wait_for(reply_event.wait(), args.udp_retry)
+                except asyncio.TimeoutError:
+                    pass
+                continue
+
+            await asyncio.sleep(max(0.0, next_send - time.perf_counter()))
+            next_send += interval
+            if args.mode == "open" and next_send < time.perf_counter():
+                next_send = time.perf_counter()
+
+            cmd = rng.choices(names, weights)[0]
+            udp.seq += 1
+            now = time.perf_counter()
+            pending[udp.seq] = [cmd, now, now]
+            totals.count(totals.sent, "udp:" + cmd)
+            udp.send(udp.seq, UDP_OPCODE[cmd])
+
+        deadline = time.perf_counter() + args.timeout
+        while pending and time.perf_counter() < deadline:
+            service(time.perf_counter())
+            await asyncio.sleep(0.01)
+        for cmd, _, _ in pending.values():
+            totals.count(totals.timeouts, "udp:" + cmd)
+    finally:
+        udp.close()
+        totals.add_wire(udp)
+
+
+async def run_idle(ws, args, totals, t_end):
+    """Stays connected until t_end, answering the server's pings, and sends
+    a PING every --app-ping seconds if asked to"""
+    async def reader():
+        while True:
+            await ws.recv()
+
+    rtask = asyncio.create_task(reader())
+    try:
+        while time.perf_counter() < t_end and not rtask.done():
+            if args.app_ping > 0:
+                await ws.send_text("PING")
+                await asyncio.sleep(min(args.app_ping, max(0.0, t_end - time.perf_counter())))
+            else:
+                await asyncio.wait([rtask], timeout=max(0.0, t_end - time.perf_counter()))
+        if rtask.done():
+            totals.disconnects += 1
+    except Exception as e:
+        totals.count(totals.errors, f"send: {e}")
+    finally:
+        rtask.cancel()
+        totals.add_wire(ws)
+        await ws.close()
+
+
+def parse_mix(text):
+    mix = []
+    for part in text.split(","):
+        name, _, weight = part.partition("=")
+        name = name.strip().upper()
+        if name not in REPLY_FOR:
+            raise argparse.ArgumentTypeError(f"unknown command {name!r}")
+        mix.append((name, float(weight or 1)))
+    return mix
+
+
+def git_describe():
+    try:
+        return subprocess.check_output(["git", "describe", "--always", "--dirty"],
+                                       stderr=subprocess.DEVNULL, text=True).strip()
+    except Exception:
+        return None
+
+
+async def main_async(args):
+    host, port = args.host, args.port
+    mix = parse_mix(args.mix)
+    if args.sim:
+        await (await wait_for_server(host, port, 30.0, args.timeout)).close()
+
+    before = await query_stats(host, port, args.timeout)
+    power_before = await query_stats(host, port, args.timeout, "POWER")
+
+    # One run per transport, one after the other so they don't share the link
+    totals = Totals()
+    rows = []
+    elapsed = 0.0
+    for transport in ("ws", "udp"):
+        if args.transport not in (transport, "both"):
+            continue
+        run = run_client if transport == "ws" else run_udp_client
+        rows += [(cmd if transport == "ws" else "udp:" + cmd) for cmd, _ in mix]
+        t_start = time.perf_counter()
+        t_end = t_start + args.duration
+        await asyncio.gather(*(run(i, args, host, port, mix, totals, t_end) for i in range(args.clients)))
+        elapsed += time.perf_counter() - t_start
+
+    after = await query_stats(host, port, args.timeout)
+    power_after = await query_stats(host, port, args.timeout, "POWER")
+
+    per_cmd = {}
+    total_ok = 0
+    for cmd in rows:
+        lat = sorted(totals.latencies.get(cmd, []))
+        total_ok += len(lat)
+        per_cmd[cmd] = {
+            "sent": totals.sent.get(cmd, 0),
+            "ok": len(lat),
+            "timeouts": totals.timeouts.get(cmd, 0),
+            "p50_ms": None if not lat else round(percentile(lat, 50) * 1e3, 3),
+            "p99_ms": None if not lat else round(percentile(lat, 99) * 1e3, 3),
+            "p999_ms": None if not lat else round(percentile(lat, 99.9) * 1e3, 3),
+            "max_ms": None if not lat else round(lat[-1] * 1e3, 3),
+        }
+
+    return {
+        "meta": {
+            "tool": "ws_bench",
+            "git": git_describe(),
+            "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+            "target": f"ws://{host}:{port}",
+            "clients": args.clients,
+            "rate_per_client": args.rate,
+            "mode": args.mode,
+            "transport": args.transport,
+            "app_ping_s": args.app_ping,
+            "mix": dict(mix),
+            "duration_s": round(elapsed, 3),
+        },
+        "throughput_cmds_per_s": round(total_ok / elapsed, 2) if elapsed > 0 else 0,
+        "commands": per_cmd,
+        "errors": totals.errors,
+        "connect_failures": totals.connect_failures,
+        "wire": totals.wire,
+        "wire_per_client_per_min": per_client_per_min(totals.wire, args.clients, elapsed),
+        "disconnects": totals.disconnects,
+        "udp_resent": totals.resent,
+        "server_before": before,
+        "server_after": after,
+        "power": power_during(power_before, power_after),
+    }
+
+
+def per_client_per_min(wire, clients, elapsed):
+    if clients <= 0 or elapsed <= 0:
+        return None
+    return {k: round(v * 60.0 / elapsed / clients, 2) for k, v in wire.items()}
+
+
+def power_during(before, after):
+    """Top controller's power mode and the share of the run it spent at full
+    speed, from POWER replies either side of it (None on older firmware)"""
+    try:
+        up = after["up_ms"] - before["up_ms"]
+        busy = after["busy_ms"] - before["busy_ms"]
+        return {
+            "save": after["save"],
+            "mhz": after["mhz"],
+            "listen": after["listen"],
+            "busy_pct": round(100.0 * busy / up, 2) if up > 0 else None,
+        }
+    except (KeyError, TypeError):
+        return None
+
+
+def print_summary(result):
+    m = result["meta"]
+    print(f"{m['target']}  clients={m['clients']}  rate={m['rate_per_client']}/s  mode={m['mode']}  "
+          f"transport={m['transport']}  {m['duration_s']}s", file=sys.stderr)
+    print(f"throughput: {result['throughput_cmds_per_s']} cmds/s", file=sys.stderr)
+    print(f"{'cmd':8} {'sent':>7} {'ok':>7} {'t/o':>5} {'p50ms':>8} {'p99ms':>8} {'p999ms':>8} {'maxms':>8}",
+          file=sys.stderr)
+    for cmd, r in result["commands"].items():
+        fmt = lambda v: "-" if v is None else f"{v:.2f}"
+        print(f"{cmd:8} {r['sent']:7} {r['ok']:7} {r['timeouts']:5} {fmt(r['p50_ms']):>8} "
+              f"{fmt(r['p99_ms']):>8} {fmt(r['p999_ms']):>8} {fmt(r['max_ms']):>8}", file=sys.stderr)
+    w = result.get("wire_per_client_per_min")
+    if w:
+        print(f"per client per minute: {w['frames_out']} frames / {w['bytes_out']} B to the server "
+              f"(handler runs), {w['frames_in']} frames / {w['bytes_in']} B back; "
+              f"{result['disconnects']} dropped", file=sys.stderr)
+    pw = result.get("power")
+    if pw:
+        print(f"power: save={pw['save']} mhz={pw['mhz']} listen={pw['listen']}  "
+              f"CPU at full speed {pw['busy_pct']}% of the run", file=sys.stderr)
+    if result["udp_resent"]:
+        print(f"udp: {result['udp_resent']} commands sent again", file=sys.stderr)
+    if result["errors"]:
+        print(f"errors: {result['errors']}", file=sys.stderr)
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    p.add_argument("--url", default="ws://192.168.18.200:81", help="ws://host:port of the top controller")
+    p.add_argument("--sim", metavar="AERA_SIM", help="start this aera_sim binary and benchmark it")
+    p.add_argument("--sim-port", type=int, default=8081)
+    p.add_argument("--clients", type=int, default=1)
+    p.add_argument("--rate", type=float, default=10.0, help="commands per second per client (0 = as fast as possible)")
+    p.add_argument("--mode", choices=("closed", "open", "idle"), default="closed",
+                   help="closed: one command outstanding per client; open: send on schedule regardless; "
+                        "idle: no commands, count the keepalive traffic")
+    p.add_argument("--transport", choices=("ws", "udp", "both"), default="ws",
+                   help="send commands over the WebSocket, the UDP control channel, or each in turn")
+    p.add_argument("--udp-port", type=int, help="UDP control port (default: the WebSocket port)")
+    p.add_argument("--udp-key", help="the unit's UDP control key, 32 hex digits (default with --sim: random)")
+    p.add_argument("--udp-retry", type=float, default=0.25,
+                   help="seconds before an unanswered UDP command is sent again")
+    p.add_argument("--app-ping", type=float, default=0.0,
+                   help="idle mode: also send PING this often, in seconds, like the app used to")
+    p.add_argument("--mix", default="ON=1,OFF=1,PING=2", help="weighted command mix, e.g. ON=1,OFF=1,PING=2")
+    p.add_argument("--duration", type=float, default=10.0, help="seconds")
+    p.add_argument("--timeout", type=float, default=2.0, help="seconds before a command counts as dropped")
+    p.add_argument("--seed", type=int, default=1)
+    p.add_argument("--out", help="write the JSON result here (default: stdout)")
+    args = p.parse_args()
+    if args.transport != "ws":
+        if args.mode == "idle":
+            p.error("--mode idle is WebSocket only")
+        if args.udp_key is None and args.sim:
+            args.udp_key = os.urandom(16).hex()
+        try:
+            if len(bytes.fromhex(args.udp_key or "")) != 16:
+                raise ValueError
+        except ValueError:
+            p.error("--udp-key is 16 bytes, as 32 hex digits")
+        unknown = [name for name, _ in parse_mix(args.mix) if name not in UDP_OPCODE]
+        if unknown:
+            p.error(f"not UDP commands: {', '.join(unknown)}")
+
+    sim = None
+    if args.sim:
+        cmd = [args.sim, "--http-port", str(args.sim_port)]
+        if args.udp_key:
+            cmd += ["--nvs-blob", f"udp_ctrl:key:{args.udp_key}"]
+        sim = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        args.host, args.port = "127.0.0.1", args.sim_port
+    else:
+        hostport = args.url.split("://", 1)[-1].split("/", 1)[0]
+        args.host, _, port = hostport.partition(":")
+        args.port = int(port or 80)
+    if args.udp_port is None:
+        args.udp_port = args.port
+
+    try:
+        result = asyncio.run(main_async(args))
+    finally:
+        if sim:
+            sim.terminate()
+            sim.wait()
+
+    print_summary(result)
+    text = json.dumps(result, indent=2)
+    if args.out:
+        with open(args.out, "w") as f:
+            f.write(text + "\n")
+    else:
+        print(text)
+
+
+if __name__ == "__main__":
+    main()
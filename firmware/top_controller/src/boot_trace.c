@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_app_desc.h"
+#include "boot_trace.h"
+
+#define BOOT_TRACE_MAGIC 0xB007A5A5u
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t boots;
+    int64_t now[BOOT_PHASES];   // 0 = not reached
+    int64_t prev[BOOT_PHASES];
+} boot_trace_t;
+
+// Not zeroed at startup; boot_trace_init() decides whether it is valid
+static RTC_NOINIT_ATTR boot_trace_t s_trace;
+
+static const char *const s_phase_names[BOOT_PHASES] = {
+    "app_main", "uart", "httpd", "nvs", "wifi_start", "link", "wifi_up", "first_cmd",
+};
+
+static const char *reset_name(esp_reset_reason_t reason)
+{
+    switch (reason)
+    {
+    case ESP_RST_POWERON: return "poweron";
+    case ESP_RST_EXT: return "ext";
+    case ESP_RST_SW: return "sw";
+    case ESP_RST_PANIC: return "panic";
+    case ESP_RST_INT_WDT: return "int_wdt";
+    case ESP_RST_TASK_WDT: return "task_wdt";
+    case ESP_RST_WDT: return "wdt";
+    case ESP_RST_DEEPSLEEP: return "deepsleep";
+    case ESP_RST_BROWNOUT: return "brownout";
+    default: return "unknown";
+    }
+}
+
+void boot_trace_init(void)
+{
+    int64_t t = esp_timer_get_time();
+    if (s_trace.magic == BOOT_TRACE_MAGIC)
+    {
+        memcpy(s_trace.prev, s_trace.now, sizeof(s_trace.prev));
+        s_trace.boots++;
+    }
+    else
+    {
+        memset(&s_trace, 0, sizeof(s_trace));
+        s_trace.magic = BOOT_TRACE_MAGIC;
+    }
+    memset(s_trace.now, 0, sizeof(s_trace.now));
+    s_trace.now[BOOT_APP_MAIN] = t > 0 ? t : 1;
+}
+
+void boot_mark(boot_phase_t phase)
+{
+    if (phase < BOOT_PHASES && s_trace.now[phase] == 0)
+        s_trace.now[phase] = esp_timer_get_time();
+}
+
+static int format_phases(char *buf, size_t cap, const int64_t *t, const char *prefix)
+{
+    int n = 0;
+    for (int i = 0; i < BOOT_PHASES && n < (int)cap; i++)
+    {
+        if (t[i] != 0)
+            n += snprintf(buf + n, cap - n, ",%s%s=%lld", prefix, s_phase_names[i], (long long)t[i]);
+    }
+    return n < (int)cap ? n : (int)cap - 1;
+}
+
+int boot_trace_format(char *buf, size_t cap, const char *order)
+{
+    int n = snprintf(buf, cap, "BOOT:build=%s,boots=%lu,reset=%s,order=%s", esp_app_get_description()->version,
+                     (unsigned long)s_trace.boots, reset_name(esp_reset_reason()), order);
+    if (n >= (int)cap)
+        return (int)cap - 1;
+    n += format_phases(buf + n, cap - n, s_trace.now, "");
+    n += format_phases(buf + n, cap - n, s_trace.prev, "prev_");
+    return n;
+}
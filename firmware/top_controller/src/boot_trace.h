@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+
+// --- BOOT TRACE ---
+//
+// When each step between reset and the first WebSocket command we accept
+// happened, in microseconds of esp_timer time (which starts as the
+// second-stage bootloader hands over, so ROM and bootloader time is not in
+// it). The markers live in RTC memory that survives a software reset but
+// not a power cycle: after a panic or watchdog reset, the last boot's
+// markers are still there to show how far it got.
+//
+// BOOT answers with both:
+//
+//   BOOT:build=<version>,boots=<n>,reset=<reason>,order=<link_first|nvs_first>,
+//        <phase>=<us>,...,prev_<phase>=<us>,...
+//
+// Phases not reached (yet) are left out. boots counts software resets since
+// the last power-on.
+
+typedef enum
+{
+    BOOT_APP_MAIN,      // app_main() entered
+    BOOT_UART,          // UART driver and link tasks up
+    BOOT_HTTPD,         // Server listening
+    BOOT_NVS,           // NVS ready
+    BOOT_WIFI_START,    // Station started, first connect on its way
+    BOOT_LINK,          // First frame from the bottom board
+    BOOT_WIFI_UP,       // Got our IP
+    BOOT_FIRST_CMD,     // First WebSocket command accepted
+    BOOT_PHASES,
+} boot_phase_t;
+
+// First thing in app_main()
+void boot_trace_init(void);
+
+// Records the phase the first time it is reached; later calls are ignored,
+// so it is cheap to call on every frame or command. Any task.
+void boot_mark(boot_phase_t phase);
+
+// The BOOT reply. Returns its length.
+int boot_trace_format(char *buf, size_t cap, const char *order);
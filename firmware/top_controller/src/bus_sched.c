@@ -0,0 +1,252 @@
+#include "esp_timer.h"
+#include "aera_cmd.h"
+#include "aera_dlog.h"
+#include "uart_tx.h"
+#include "uart_tx_priv.h"
+#include "bus_sched.h"
+
+#define BUS_POLL_US ((int64_t)AERA_BUS_POLL_MS * 1000)
+#define BUS_DISCOVER_US ((int64_t)AERA_BUS_DISCOVER_MS * 1000)
+#define BUS_TURNAROUND_US ((int64_t)AERA_BUS_TURNAROUND_MS * 1000)
+#define ACK_TIMEOUT_US ((int64_t)UART_TX_ACK_TIMEOUT_MS * 1000)
+#define UART_FIFO_BYTES 128 // What uart_write_bytes() returns with still to go out
+
+// TX task only
+static struct
+{
+    bool on;
+    bool waiting;               // A node has the bus
+    uint8_t batch_node;         // Whose frames the batch holds; 0 if nobody's yet
+    uint8_t turn_node;          // While waiting: whose turn it is
+    uint8_t turn_seq;           // ... and the seq of its BUS_POLL
+    int64_t turn_us;            // When the BUS_POLL went out
+    int64_t deadline_us;        // No BUS_REPLY by then: take the bus back
+    uint8_t sweep_left;         // Addresses still to try in the first sweep
+    uint8_t sweep_next;         // Next address the sweep tries
+    int64_t sweep_us;           // When it next tries one
+    uint8_t rr_next;            // Where the search for a node's turn starts
+    struct
+    {
+        uint8_t misses;         // Turns in a row that timed out
+        uint16_t backlog;       // Left behind in its last turn
+        int64_t poll_us;        // Next poll due
+    } nodes[UART_TX_NODES];
+    bus_sched_stats_t stats;
+} s_bus;
+
+void bus_sched_get_stats(bus_sched_stats_t *out)
+{
+    *out = s_bus.stats;
+}
+
+void bus_sched_init(bool on)
+{
+    s_bus.on = on;
+    s_bus.stats.on = on;
+    s_bus.sweep_left = AERA_BUS_MAX_NODES;
+    s_bus.sweep_us = esp_timer_get_time();
+}
+
+bool bus_sched_on(void)
+{
+    return s_bus.on;
+}
+
+bool bus_sched_present(uint8_t node)
+{
+    return !s_bus.on || s_bus.stats.nodes[node].present;
+}
+
+uint8_t bus_sched_turn(void)
+{
+    return s_bus.waiting ? s_bus.turn_node : 0;
+}
+
+void bus_sched_on_ack(uint8_t node, uint32_t rtt_us)
+{
+    lat_hist_add(&s_bus.stats.nodes[node].rtt, rtt_us);
+}
+
+void bus_sched_on_sent(size_t bytes)
+{
+    s_bus.stats.nodes[s_bus.batch_node].bytes_out += bytes;
+    s_bus.stats.wire_bytes += bytes;
+}
+
+static int64_t wire_us(uint32_t bytes)
+{
+    return (int64_t)bytes * 10 * 1000000 / AERA_BAUD_BASE;
+}
+
+// A node owed a turn: one that left frames behind, then one due its poll.
+// 0 if nobody is.
+static uint8_t owed(int64_t now)
+{
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < AERA_BUS_MAX_NODES; i++)
+        {
+            uint8_t node = (uint8_t)(1 + (s_bus.rr_next + i) % AERA_BUS_MAX_NODES);
+            if (!s_bus.stats.nodes[node].present)
+                continue;
+            if (pass == 0 ? s_bus.nodes[node].backlog > 0 : now >= s_bus.nodes[node].poll_us)
+                return node;
+        }
+    }
+    return 0;
+}
+
+// On a bus: while nobody else has the bus and the batch holds no
+// other node's frames; the first to ask gets the next turn, unless another
+// node is owed it. That keeps a stream of frames for one node (an OTA)
+// from starving the rest.
+bool bus_sched_open(uint8_t node, int64_t now)
+{
+    if (!s_bus.on)
+        return true;
+    if (s_bus.waiting)
+        return false;
+    if (s_bus.batch_node == 0)
+    {
+        uint8_t first = owed(now);
+        if (first != 0 && first != node)
+            return false;
+        s_bus.batch_node = node;
+    }
+    return s_bus.batch_node == node;
+}
+
+// A turn is over. Frames to node it didn't ACK are resent as soon as the
+// bus is free, unless it said it had more to send; then they wait for its
+// next turn, which comes first.
+static void turn_over(uint8_t node, int64_t now, bool more)
+{
+    uart_tx_set_deadline(node, more ? now + ACK_TIMEOUT_US : now);
+}
+
+bool bus_sched_on_reply(uint8_t node, uint8_t seq, const aera_bus_reply_t *reply, int64_t rx_us)
+{
+    if (!s_bus.waiting || node != s_bus.turn_node || seq != s_bus.turn_seq)
+        return false;
+
+    bus_sched_node_t *st = &s_bus.stats.nodes[node];
+    s_bus.waiting = false;
+    if (!st->present)
+    {
+        st->present = true;
+        AERA_DLOG(TX_BUS_NODE_FOUND, node);
+    }
+    s_bus.nodes[node].misses = 0;
+    s_bus.nodes[node].backlog = reply->backlog;
+
+    uint32_t in = reply->sent + AERA_LINK_OVERHEAD + AERA_BUS_REPLY_LEN;
+    st->bytes_in += in;
+    s_bus.stats.wire_bytes += in;
+    lat_hist_add(&st->poll, (uint32_t)(rx_us - s_bus.turn_us));
+    turn_over(node, rx_us, reply->backlog > 0);
+    return true;
+}
+
+// Takes the bus back from a node that never answered
+void bus_sched_check(int64_t now)
+{
+    if (!s_bus.waiting || now < s_bus.deadline_us)
+        return;
+
+    uint8_t node = s_bus.turn_node;
+    bus_sched_node_t *st = &s_bus.stats.nodes[node];
+    s_bus.waiting = false;
+    s_bus.nodes[node].backlog = 0;
+    if (st->present)
+    {
+        st->missed++;
+        if (++s_bus.nodes[node].misses >= AERA_BUS_MAX_MISSES)
+        {
+            st->present = false;
+            AERA_DLOG(TX_BUS_NODE_LOST, node, s_bus.nodes[node].misses);
+        }
+    }
+    turn_over(node, now, false);
+}
+
+// Whose turn it is when no frames are batched for anyone: a node owed one,
+// then the sweep's next address. 0 if nobody's.
+static uint8_t pick(int64_t now, bool *probe)
+{
+    uint8_t first = owed(now);
+    if (first != 0)
+        return first;
+
+    if (now < s_bus.sweep_us)
+        return 0;
+    // The first sweep goes straight through, then one address at a time
+    if (s_bus.sweep_left > 0)
+        s_bus.sweep_left--;
+    s_bus.sweep_us = s_bus.sweep_left > 0 ? now : now + BUS_DISCOVER_US;
+    for (int i = 0; i < AERA_BUS_MAX_NODES; i++)
+    {
+        uint8_t node = (uint8_t)(1 + (s_bus.sweep_next + i) % AERA_BUS_MAX_NODES);
+        if (!s_bus.stats.nodes[node].present)
+        {
+            s_bus.sweep_next = node % AERA_BUS_MAX_NODES;
+            *probe = true;
+            return node;
+        }
+    }
+    return 0;
+}
+
+// Last in each round: ends the batch with a BUS_POLL, so whoever it is for
+// gets the bus
+void bus_sched_service(int64_t now)
+{
+    if (!s_bus.on || s_bus.waiting)
+        return;
+
+    bool probe = false;
+    uint8_t node = s_bus.batch_node;
+    if (node == 0)
+        node = pick(now, &probe);
+    if (node == 0)
+        return;
+
+    s_bus.batch_node = node;
+    s_bus.rr_next = node % AERA_BUS_MAX_NODES;
+    s_bus.turn_node = node;
+    s_bus.turn_seq = uart_tx_next_seq(node);
+    uart_tx_batch_add(node, AERA_OP_BUS_POLL, s_bus.turn_seq, NULL, 0);
+    size_t last = uart_tx_batch_flush();
+    s_bus.batch_node = 0;
+
+    // The write returns with up to a FIFO's worth still to go out; then the
+    // node's slot, its BUS_REPLY and the time to turn the line around
+    int64_t sent_us = esp_timer_get_time();
+    uint32_t fifo = last < UART_FIFO_BYTES ? (uint32_t)last : UART_FIFO_BYTES;
+    s_bus.waiting = true;
+    s_bus.turn_us = sent_us;
+    s_bus.deadline_us = sent_us + BUS_TURNAROUND_US +
+                        wire_us(fifo + AERA_BUS_SLOT_BYTES + AERA_LINK_OVERHEAD + AERA_BUS_REPLY_LEN);
+    s_bus.nodes[node].poll_us = sent_us + BUS_POLL_US;
+    s_bus.stats.turns++;
+    s_bus.stats.nodes[node].polls++;
+    if (probe)
+        s_bus.stats.probes++;
+}
+
+// When bus_sched_service() or bus_sched_check() next has something to do on
+// its own
+int64_t bus_sched_next_us(void)
+{
+    if (!s_bus.on)
+        return INT64_MAX;
+    if (s_bus.waiting)
+        return s_bus.deadline_us;
+
+    int64_t next = s_bus.sweep_us;
+    for (int node = 1; node < UART_TX_NODES; node++)
+    {
+        if (s_bus.stats.nodes[node].present && s_bus.nodes[node].poll_us < next)
+            next = s_bus.nodes[node].poll_us;
+    }
+    return next;
+}
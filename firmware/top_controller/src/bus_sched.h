@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "aera_bus.h"
+#include "lat_hist.h"
+
+// --- BUS SCHEDULE ---
+//
+// With the bottom controllers on a shared bus (aera_bus.h), the UART TX
+// task hands it out in turns. Every frame is for one node; a node's frames
+// go out together and end with a BUS_POLL, and until its BUS_REPLY, or the
+// turn times out, nothing else goes out. A node that left frames behind
+// last time, then one due its AERA_BUS_POLL_MS poll, gets the next turn
+// before anyone's new frames; with nothing owed or to send, the turn goes
+// to the discovery sweep. Frames a turn didn't ACK are resent once it is
+// over. The link stays at AERA_BAUD_BASE.
+
+typedef struct
+{
+    bool present;          // Answering its polls
+    uint32_t polls;        // Turns it was given
+    uint32_t missed;       // ... that timed out while it was present
+    uint32_t bytes_out;    // Bytes we sent it, polls included
+    uint32_t bytes_in;     // Bytes it sent in its turns
+    lat_hist_t poll;       // BUS_POLL written -> BUS_REPLY received
+    lat_hist_t rtt;        // Command queued -> ACK received
+} bus_sched_node_t;
+
+typedef struct
+{
+    bool on;               // Bus, not point to point
+    uint32_t turns;        // Polls sent, discovery included
+    uint32_t probes;       // ... of which to addresses nobody was at
+    uint64_t wire_bytes;   // Both ways, for the utilisation
+    bus_sched_node_t nodes[AERA_BUS_MAX_NODES + 1]; // By address; 0 unused
+} bus_sched_stats_t;
+
+// Plain copy, like the latency histograms
+void bus_sched_get_stats(bus_sched_stats_t *out);
+
+// uart_tx.c only: init from uart_tx_start(), the rest on the TX task
+void bus_sched_init(bool on);
+bool bus_sched_on(void);
+// Answering its polls; always, point to point
+bool bus_sched_present(uint8_t node);
+// True if a frame for node may go into the batch now
+bool bus_sched_open(uint8_t node, int64_t now);
+// The node that has the bus; 0 while nobody has
+uint8_t bus_sched_turn(void);
+// A BUS_REPLY; false if it wasn't for the turn under way
+bool bus_sched_on_reply(uint8_t node, uint8_t seq, const aera_bus_reply_t *reply, int64_t rx_us);
+void bus_sched_on_ack(uint8_t node, uint32_t rtt_us);
+void bus_sched_on_sent(size_t bytes);
+void bus_sched_check(int64_t now);
+void bus_sched_service(int64_t now);
+int64_t bus_sched_next_us(void);
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "history.h"
+
+#define CHUNK_SIZE      512
+#define CSV_ROW_MAX     64
+
+typedef struct
+{
+    aera_telem_sample_t *ring;
+    uint16_t capacity;
+    uint16_t factor;        // Inputs (samples or finer points) per point
+    uint16_t interval_s;
+    uint32_t total;         // Points ever written; the newest is total - 1
+    int64_t newest_us;      // When the newest point closed
+
+    // Point being built
+    int32_t sum[AERA_TELEM_CHANNELS];
+    uint16_t valid;
+    uint16_t inputs;
+} tier_t;
+
+static const char *TAG = "HISTORY";
+
+static aera_telem_sample_t s_t0[HISTORY_T0_POINTS];
+static aera_telem_sample_t s_t1[HISTORY_T1_POINTS];
+static aera_telem_sample_t s_t2[HISTORY_T2_POINTS];
+
+// Guarded by s_lock: written by the UART RX task, read by httpd
+static SemaphoreHandle_t s_lock;
+static tier_t s_tiers[HISTORY_TIERS] = {
+    {s_t0, HISTORY_T0_POINTS, 1000 / AERA_TELEM_PERIOD_MS, 1},
+    {s_t1, HISTORY_T1_POINTS, 10, 10},
+    {s_t2, HISTORY_T2_POINTS, 6, 60},
+};
+
+_Static_assert(1000 % AERA_TELEM_PERIOD_MS == 0, "Tier 0 needs a whole number of samples per second");
+_Static_assert(sizeof(s_t0) + sizeof(s_t1) + sizeof(s_t2) + sizeof(s_tiers) <= HISTORY_RAM_BUDGET,
+               "History is over its RAM budget");
+
+// Per channel, for CSV: column name and how many decimals the unit hides
+static const char *const s_csv_names[AERA_TELEM_CHANNELS] = {"temp_c", "rh_pct", "heater_a", "fan_rpm"};
+static const uint8_t s_csv_decimals[AERA_TELEM_CHANNELS] = {2, 2, 3, 0};
+
+void history_init(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    ESP_LOGI(TAG, "%u bytes of history: %us x %u, %us x %u, %us x %u",
+             (unsigned)(sizeof(s_t0) + sizeof(s_t1) + sizeof(s_t2)),
+             s_tiers[0].interval_s, s_tiers[0].capacity, s_tiers[1].interval_s, s_tiers[1].capacity,
+             s_tiers[2].interval_s, s_tiers[2].capacity);
+}
+
+// --- INSERT ---
+// Folds one input into tier k. NULL is an input with no data. When the
+// point is complete it is stored and fed to the next tier up.
+static void tier_input(int k, const aera_telem_sample_t *in, int64_t now_us)
+{
+    tier_t *t = &s_tiers[k];
+    if (in != NULL)
+    {
+        for (int c = 0; c < AERA_TELEM_CHANNELS; c++)
+            t->sum[c] += in->ch[c];
+        t->valid++;
+    }
+    if (++t->inputs < t->factor)
+        return;
+
+    aera_telem_sample_t *out = &t->ring[t->total % t->capacity];
+    for (int c = 0; c < AERA_TELEM_CHANNELS; c++)
+        out->ch[c] = t->valid ? (int16_t)(t->sum[c] / t->valid) : HISTORY_NO_DATA;
+    bool has_data = t->valid > 0;
+    t->total++;
+    t->newest_us = now_us;
+
+    memset(t->sum, 0, sizeof(t->sum));
+    t->valid = 0;
+    t->inputs = 0;
+
+    if (k + 1 < HISTORY_TIERS)
+        tier_input(k + 1, has_data ? out : NULL, now_us);
+}
+
+void history_add(const aera_telem_sample_t *samples, uint8_t count, uint32_t lost)
+{
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (lost <= HISTORY_MAX_GAP_FILL)
+    {
+        for (uint32_t i = 0; i < lost; i++)
+            tier_input(0, NULL, now);
+    }
+    for (uint8_t i = 0; i < count; i++)
+        tier_input(0, &samples[i], now);
+    xSemaphoreGive(s_lock);
+}
+
+// --- HTTP ---
+
+static int put_fixed(char *p, size_t cap, int16_t v, uint8_t decimals)
+{
+    static const int32_t scale[] = {1, 10, 100, 1000};
+    if (v == HISTORY_NO_DATA)
+        return 0; // Empty field
+    if (decimals == 0)
+        return snprintf(p, cap, "%d", v);
+
+    int32_t a = v < 0 ? -(int32_t)v : v;
+    return snprintf(p, cap, "%s%ld.%0*ld", v < 0 ? "-" : "", (long)(a / scale[decimals]),
+                    (int)decimals, (long)(a % scale[decimals]));
+}
+
+static bool query_u32(const char *query, const char *key, uint32_t *out)
+{
+    char val[12];
+    if (httpd_query_key_value(query, key, val, sizeof(val)) != ESP_OK)
+        return false;
+    char *end;
+    unsigned long v = strtoul(val, &end, 10);
+    if (end == val || *end != '\0')
+        return false;
+    *out = (uint32_t)v;
+    return true;
+}
+
+esp_err_t history_http_handler(httpd_req_t *req)
+{
+    char query[96] = "";
+    char format[8] = "csv";
+    uint32_t res = 0, from = UINT32_MAX, to = 0;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK)
+    {
+        query_u32(query, "res", &res);
+        query_u32(query, "from", &from);
+        query_u32(query, "to", &to);
+        httpd_query_key_value(query, "format", format, sizeof(format));
+    }
+    bool bin = strcmp(format, "bin") == 0;
+    if (!bin && strcmp(format, "csv") != 0)
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "format is csv or bin");
+
+    // Pick the tier: as asked, or the finest one that reaches back far enough
+    int k = -1;
+    for (int i = 0; i < HISTORY_TIERS; i++)
+    {
+        uint32_t span = (uint32_t)s_tiers[i].capacity * s_tiers[i].interval_s;
+        if (res ? s_tiers[i].interval_s == res : (from == UINT32_MAX || span >= from))
+        {
+            k = i;
+            break;
+        }
+    }
+    if (k < 0 && res == 0)
+        k = HISTORY_TIERS - 1;
+    if (k < 0)
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "res is 1, 10 or 60");
+    if (from != UINT32_MAX && to > from)
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "to is after from");
+
+    tier_t *t = &s_tiers[k];
+    int64_t iv_ms = (int64_t)t->interval_s * 1000;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t total = t->total;
+    int64_t newest_us = t->newest_us;
+    xSemaphoreGive(s_lock);
+
+    // Point i back from the newest is age0 + i * interval old
+    uint32_t available = total < t->capacity ? total : t->capacity;
+    int64_t age0_ms = (esp_timer_get_time() - newest_us) / 1000;
+    int64_t from_ms = from == UINT32_MAX ? INT64_MAX / 2 : (int64_t)from * 1000;
+    int64_t to_ms = (int64_t)to * 1000;
+
+    int64_t i_lo = to_ms > age0_ms ? (to_ms - age0_ms + iv_ms - 1) / iv_ms : 0;
+    int64_t i_hi = from_ms >= age0_ms ? (from_ms - age0_ms) / iv_ms : -1;
+    if (i_hi > (int64_t)available - 1)
+        i_hi = (int64_t)available - 1;
+    uint32_t count = i_hi >= i_lo ? (uint32_t)(i_hi - i_lo + 1) : 0;
+    if (count > UINT16_MAX)
+        count = UINT16_MAX;
+    uint32_t last_age_ms = (uint32_t)(age0_ms + i_lo * iv_ms);
+    uint32_t first_point = total - 1 - (uint32_t)i_lo - (count - 1); // Oldest, by absolute number
+
+    char buf[CHUNK_SIZE];
+    size_t n = 0;
+
+    httpd_resp_set_type(req, bin ? "application/octet-stream" : "text/csv");
+    if (bin)
+    {
+        buf[0] = 'H';
+        buf[1] = AERA_TELEM_CHANNELS;
+        buf[2] = (char)(t->interval_s >> 8);
+        buf[3] = (char)(t->interval_s & 0xFF);
+        buf[4] = (char)(count >> 8);
+        buf[5] = (char)(count & 0xFF);
+        for (int b = 0; b < 4; b++)
+            buf[6 + b] = (char)(last_age_ms >> (24 - 8 * b));
+        n = 10;
+    }
+    else
+    {
+        n = (size_t)snprintf(buf, sizeof(buf), "t_s");
+        for (int c = 0; c < AERA_TELEM_CHANNELS; c++)
+            n += (size_t)snprintf(buf + n, sizeof(buf) - n, ",%s", s_csv_names[c]);
+        buf[n++] = '\n';
+    }
+
+    for (uint32_t j = 0; j < count; j++)
+    {
+        // Copy one point at a time; the lock is never held across a send
+        uint32_t p = first_point + j;
+        aera_telem_sample_t s;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (t->total - p <= t->capacity)
+        {
+            s = t->ring[p % t->capacity];
+        }
+        else
+        {
+            for (int c = 0; c < AERA_TELEM_CHANNELS; c++)
+                s.ch[c] = HISTORY_NO_DATA; // Overwritten while we were sending
+        }
+        xSemaphoreGive(s_lock);
+
+        if (bin)
+        {
+            for (int c = 0; c < AERA_TELEM_CHANNELS; c++)
+            {
+                buf[n++] = (char)((uint16_t)s.ch[c] >> 8);
+                buf[n++] = (char)((uint16_t)s.ch[c] & 0xFF);
+            }
+        }
+        else
+        {
+            uint32_t age_ms = last_age_ms + (count - 1 - j) * (uint32_t)iv_ms;
+            uint32_t age_s = (age_ms + 500) / 1000;
+            n += (size_t)snprintf(buf + n, sizeof(buf) - n, "%s%lu", age_s ? "-" : "", (unsigned long)age_s);
+            for (int c = 0; c < AERA_TELEM_CHANNELS; c++)
+            {
+                buf[n++] = ',';
+                n += (size_t)put_fixed(buf + n, sizeof(buf) - n, s.ch[c], s_csv_decimals[c]);
+            }
+            buf[n++] = '\n';
+        }
+
+        if (sizeof(buf) - n < CSV_ROW_MAX)
+        {
+            if (httpd_resp_send_chunk(req, buf, n) != ESP_OK)
+                return ESP_FAIL;
+            n = 0;
+        }
+    }
+
+    if (n > 0 && httpd_resp_send_chunk(req, buf, n) != ESP_OK)
+        return ESP_FAIL;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_http_server.h"
+#include "aera_telem.h"
+
+// --- TELEMETRY HISTORY ---
+//
+// Fixed-size rings of sensor history at three resolutions, all in static
+// RAM (HISTORY_RAM_BUDGET, checked at compile time):
+//
+//   tier 0:  1 s points, last 10 min
+//   tier 1: 10 s points, last 2 h
+//   tier 2: 60 s points, last 24 h
+//
+// Each tier is built incrementally from the one below: tier 0 averages
+// every second of telemetry, tier 1 every ten tier-0 points and so on, so an
+// insert is a handful of additions and never allocates. A point whose
+// window saw no samples (lost frames) holds HISTORY_NO_DATA in every channel.
+//
+// GET /history returns a window of one tier:
+//
+//   res=1|10|60      seconds per point; default is the finest tier that
+//                    reaches back to `from`
+//   from=<s>, to=<s> window as seconds before now; default the whole tier
+//   format=csv|bin   default csv
+//
+// CSV has a header row and one row per point, oldest first, with t_s as
+// seconds before now. Binary is big-endian, like the link:
+//
+//   ['H'][channels][interval s, u16][count, u16][age of the last point ms, u32]
+//   count x [one i16 per channel, aera_telem.h order and units]
+
+#define HISTORY_TIERS           3
+#define HISTORY_T0_POINTS       600     // 10 min of 1 s
+#define HISTORY_T1_POINTS       720     // 2 h of 10 s
+#define HISTORY_T2_POINTS       1440    // 24 h of 60 s
+#define HISTORY_RAM_BUDGET      (24 * 1024)
+#define HISTORY_NO_DATA         INT16_MIN
+
+// A jump in the sample index bigger than this is the bottom board
+// restarting, not lost frames, and is not filled with empty points
+#define HISTORY_MAX_GAP_FILL    (30 * 1000 / AERA_TELEM_PERIOD_MS)
+
+void history_init(void);
+
+// Appends telemetry samples, after `lost` samples that never arrived.
+// Called from the UART RX task.
+void history_add(const aera_telem_sample_t *samples, uint8_t count, uint32_t lost);
+
+// GET handler for /history
+esp_err_t history_http_handler(httpd_req_t *req);
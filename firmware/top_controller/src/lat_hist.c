@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include "lat_hist.h"
+
+#define FIRST_EDGE_LOG2 6 // Bucket 0 ends at 64 us
+
+static unsigned bucket_of(uint32_t us)
+{
+    if (us < (1u << FIRST_EDGE_LOG2))
+        return 0;
+
+    unsigned b = (unsigned)(31 - __builtin_clz(us)) - FIRST_EDGE_LOG2 + 1;
+    return b < LAT_HIST_BUCKETS ? b : LAT_HIST_BUCKETS - 1;
+}
+
+void lat_hist_add(lat_hist_t *h, uint32_t us)
+{
+    h->count[bucket_of(us)]++;
+    h->samples++;
+    h->total_us += us;
+    if (us > h->max_us)
+        h->max_us = us;
+}
+
+uint32_t lat_hist_percentile(const lat_hist_t *h, uint32_t pct)
+{
+    if (h->samples == 0)
+        return 0;
+
+    uint64_t want = ((uint64_t)h->samples * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < LAT_HIST_BUCKETS - 1; b++)
+    {
+        seen += h->count[b];
+        if (seen >= want)
+        {
+            uint32_t edge = 1u << (b + FIRST_EDGE_LOG2);
+            return edge < h->max_us ? edge : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+int lat_hist_format(const lat_hist_t *h, char *buf, size_t cap)
+{
+    int n = snprintf(buf, cap, "n=%lu,avg=%lu,p50=%lu,p99=%lu,max=%lu,b=",
+                     (unsigned long)h->samples,
+                     (unsigned long)(h->samples ? h->total_us / h->samples : 0),
+                     (unsigned long)lat_hist_percentile(h, 50),
+                     (unsigned long)lat_hist_percentile(h, 99),
+                     (unsigned long)h->max_us);
+
+    for (unsigned b = 0; b < LAT_HIST_BUCKETS && n >= 0 && (size_t)n < cap; b++)
+        n += snprintf(buf + n, cap - n, b ? "/%lu" : "%lu", (unsigned long)h->count[b]);
+    return n < (int)cap ? n : (int)cap - 1;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// --- LATENCY HISTOGRAM ---
+//
+// Fixed log2 buckets in microseconds, so adding a sample is a couple of
+// instructions and the memory never grows:
+//
+//   bucket 0        < 64 us
+//   bucket i        [2^(i+5), 2^(i+6)) us
+//   last bucket     >= 2^(LAT_HIST_BUCKETS+4) us (about 1 s)
+
+#define LAT_HIST_BUCKETS    16
+
+typedef struct
+{
+    uint32_t count[LAT_HIST_BUCKETS];
+    uint32_t samples;
+    uint32_t max_us;
+    uint64_t total_us;
+} lat_hist_t;
+
+void lat_hist_add(lat_hist_t *h, uint32_t us);
+
+// Upper edge of the bucket holding the given percentile (0-100), in us,
+// capped at max_us. 0 with no samples.
+uint32_t lat_hist_percentile(const lat_hist_t *h, uint32_t pct);
+
+// "n=..,avg=..,p50=..,p99=..,max=..,b=c0/c1/.../c15". Returns the length
+// written, at most cap - 1.
+int lat_hist_format(const lat_hist_t *h, char *buf, size_t cap);
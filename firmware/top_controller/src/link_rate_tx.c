@@ -0,0 +1,356 @@
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "aera_cmd.h"
+#include "aera_dlog.h"
+#include "uart_rx.h"
+#include "ota_stream.h"
+#include "uart_tx_priv.h"
+#include "link_rate_tx.h"
+
+#define RATE_POLL_US ((int64_t)LINK_RATE_TX_POLL_MS * 1000)
+#define RATE_RETRY_US ((int64_t)LINK_RATE_TX_RETRY_MS * 1000)
+#define RATE_RTS_THRESHOLD 100 // Bytes in the 128-byte RX FIFO before RTS goes up
+#define RATE_CHECK_US ((int64_t)AERA_BAUD_CHECK_MS * 1000)
+// Longest either side can be at a rate the other has left: the bottom
+// controller's silence timeout, and a window to notice
+#define RATE_LOST_US ((int64_t)(AERA_BAUD_SILENT_MS + AERA_BAUD_CHECK_MS) * 1000)
+
+// See aera_baud.h for the protocol
+typedef enum
+{
+    RATE_STEADY,
+    RATE_QUIESCE,       // Waiting for the commands in flight before a TRY
+    RATE_TRY,           // LINK_BAUD TRY in flight, at the old rate
+    RATE_PROBE,         // Switched: settling, then probes out and echoes back
+    RATE_COMMIT,        // LINK_BAUD COMMIT in flight, at the new rate
+    RATE_DROP,          // LINK_BAUD DROP in flight, at the failing rate
+    RATE_RECOVER,       // Probing until the bottom controller answers
+} rate_phase_t;
+
+// TX task only, but for the echo count the RX task bumps
+static struct
+{
+    uart_port_t port;
+    rate_phase_t phase;
+    int rung;                   // Agreed with the bottom controller
+    bool flow;
+    int trying;
+    bool trying_flow;
+    int ceiling;                // Highest rung still worth a try
+    bool rts_cts;               // Cleared once a rate fails with flow control on
+    bool probing;               // RATE_PROBE: probes are out
+    int64_t until_us;           // Deadline of the phase; in RATE_STEADY, the next climb
+    int64_t retry_us;           // RATE_RECOVER: how long after it to climb again
+    int64_t next_check_us;
+    int64_t next_probe_us;
+    uint8_t probe_index;
+    unsigned echoes_seen;
+    uint32_t crc_seen;
+    uint32_t lost;              // Frames out of tries this window
+    uint32_t silent_windows;
+    link_rate_tx_stats_t stats;
+} s_rate;
+static atomic_uint s_echoes;
+
+void link_rate_tx_post_probe(const aera_frame_t *probe)
+{
+    if (!aera_baud_probe_check(probe->payload))
+        return;
+    atomic_fetch_add(&s_echoes, 1);
+    uart_tx_wake();
+}
+
+void link_rate_tx_get_stats(link_rate_tx_stats_t *out)
+{
+    *out = s_rate.stats;
+}
+
+void link_rate_tx_init(uart_port_t port, bool rts_cts, bool bus)
+{
+    s_rate.port = port;
+    s_rate.rts_cts = rts_cts;
+    s_rate.stats.baud = AERA_BAUD_BASE;
+    s_rate.until_us = esp_timer_get_time() + (int64_t)LINK_RATE_TX_START_MS * 1000;
+    s_rate.ceiling = 0;
+    while (!bus && s_rate.ceiling + 1 < AERA_BAUD_RUNGS && aera_baud_rates[s_rate.ceiling + 1] <= LINK_RATE_TX_MAX)
+        s_rate.ceiling++;
+}
+
+bool link_rate_tx_steady(void)
+{
+    return s_rate.phase == RATE_STEADY;
+}
+
+void link_rate_tx_on_failed(void)
+{
+    s_rate.lost++;
+}
+
+// Whatever is batched goes out at the old rate first. APB stays at 80 MHz
+// through frequency scaling (aera_power.h), so the divider holds.
+static void rate_set(int rung, bool flow)
+{
+    uart_tx_batch_flush();
+    uart_wait_tx_done(s_rate.port, pdMS_TO_TICKS(20));
+    uart_set_baudrate(s_rate.port, aera_baud_rates[rung]);
+    uart_set_hw_flow_ctrl(s_rate.port, flow ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE,
+                          RATE_RTS_THRESHOLD);
+    s_rate.stats.baud = aera_baud_rates[rung];
+    s_rate.stats.flow = flow;
+}
+
+static bool rate_send_baud(int64_t now, int rung, bool flow, uint8_t phase)
+{
+    aera_baud_req_t req = {
+        .rate = aera_baud_rates[rung],
+        .flags = flow ? AERA_BAUD_FLAG_FLOW : 0,
+        .phase = phase,
+    };
+    uint8_t payload[AERA_BAUD_PAYLOAD_LEN];
+    aera_baud_pack(payload, &req);
+    // A resent TRY could reach the bottom controller after it has switched
+    // and then gone back: one try, and it only costs a retry later
+    return uart_tx_send_own(now, AERA_LINK_ADDR_P2P, AERA_OP_LINK_BAUD, payload, sizeof(payload),
+                            phase == AERA_BAUD_TRY);
+}
+
+static void rate_send_probe(void)
+{
+    uint8_t payload[AERA_BAUD_PROBE_LEN];
+    aera_baud_probe_fill(payload, s_rate.probe_index++);
+    uart_tx_batch_add(AERA_LINK_ADDR_P2P, AERA_OP_LINK_PROBE, uart_tx_next_seq(AERA_LINK_ADDR_P2P), payload,
+                      sizeof(payload));
+}
+
+// Both ways at once, with time to spare for the bottom controller's turnaround
+static int64_t rate_probe_wait_us(int rung)
+{
+    int64_t bits = (int64_t)AERA_BAUD_PROBES * (AERA_LINK_OVERHEAD + AERA_BAUD_PROBE_LEN) * 10;
+    return 2 * bits * 1000000 / aera_baud_rates[rung] + (int64_t)LINK_RATE_TX_PROBE_MS * 1000;
+}
+
+// A new health window, opened with a keepalive probe when above the base
+static void rate_start_window(int64_t now)
+{
+    uart_rx_stats_t rx;
+    uart_rx_get_stats(&rx);
+    s_rate.crc_seen = rx.crc_errors;
+    s_rate.lost = 0;
+    s_rate.echoes_seen = atomic_load(&s_echoes);
+    s_rate.next_check_us = now + RATE_CHECK_US;
+    if (s_rate.rung > 0)
+        rate_send_probe();
+}
+
+static void rate_recover(int64_t now, int64_t retry_us)
+{
+    s_rate.phase = RATE_RECOVER;
+    s_rate.until_us = now + RATE_LOST_US;
+    s_rate.retry_us = retry_us;
+    s_rate.next_probe_us = now;
+    s_rate.echoes_seen = atomic_load(&s_echoes);
+}
+
+static void rate_at_base(void)
+{
+    rate_set(0, false);
+    s_rate.rung = 0;
+    s_rate.flow = false;
+}
+
+void link_rate_tx_on_done(bool acked)
+{
+    int64_t now = esp_timer_get_time();
+
+    switch (s_rate.phase)
+    {
+    case RATE_TRY:
+        if (!acked)
+        {
+            // If it did switch, it comes back by itself
+            rate_recover(now, RATE_RETRY_US);
+            return;
+        }
+        rate_set(s_rate.trying, s_rate.trying_flow);
+        s_rate.phase = RATE_PROBE;
+        s_rate.probing = false;
+        s_rate.until_us = now + (int64_t)LINK_RATE_TX_SETTLE_MS * 1000;
+        return;
+
+    case RATE_COMMIT:
+        if (acked)
+        {
+            s_rate.rung = s_rate.trying;
+            s_rate.flow = s_rate.trying_flow;
+            s_rate.stats.steps++;
+            AERA_DLOG(TX_RATE, aera_baud_rates[s_rate.rung], s_rate.flow);
+            s_rate.phase = RATE_STEADY;
+            s_rate.until_us = now;
+            s_rate.silent_windows = 0;
+            rate_start_window(now);
+            return;
+        }
+        // Lost on the new rate, which either side may or may not be at:
+        // meet at the base, where the bottom controller ends up either way
+        s_rate.ceiling = s_rate.trying - 1;
+        s_rate.stats.fallbacks++;
+        AERA_DLOG(TX_RATE_FALLBACK, aera_baud_rates[s_rate.trying], 0, 0);
+        rate_at_base();
+        rate_recover(now, RATE_RETRY_US);
+        return;
+
+    case RATE_DROP:
+        rate_at_base();
+        if (acked)
+        {
+            s_rate.phase = RATE_STEADY;
+            s_rate.until_us = now + RATE_RETRY_US;
+            rate_start_window(now);
+        }
+        else
+        {
+            rate_recover(now, RATE_RETRY_US);
+        }
+        return;
+
+    default:
+        return;
+    }
+}
+
+// Above the base, once per window, and as soon as a frame goes unACKed.
+// True if it started a drop.
+static bool rate_check(int64_t now)
+{
+    uart_rx_stats_t rx;
+    uart_rx_get_stats(&rx);
+    bool silent = atomic_load(&s_echoes) == s_rate.echoes_seen;
+    uint32_t errors = (rx.crc_errors - s_rate.crc_seen) + s_rate.lost + (silent ? 1 : 0);
+
+    // A lost command is most often the bottom controller having restarted
+    // at the base rate; every command until the drop would be lost too
+    s_rate.silent_windows = silent ? s_rate.silent_windows + 1 : 0;
+    if (s_rate.lost == 0 && errors < AERA_BAUD_MAX_ERRORS && s_rate.silent_windows < 2)
+    {
+        rate_start_window(now);
+        return false;
+    }
+    if (!rate_send_baud(now, 0, false, AERA_BAUD_DROP))
+        return true; // Every slot busy; next round
+
+    // Errors mean this rate is marginal. Silence alone is more likely the
+    // bottom controller restarting, which says nothing about the rate.
+    if (errors >= AERA_BAUD_MAX_ERRORS)
+        s_rate.ceiling = s_rate.rung - 1;
+    s_rate.stats.fallbacks++;
+    AERA_DLOG(TX_RATE_FALLBACK, aera_baud_rates[s_rate.rung], errors, s_rate.silent_windows);
+    s_rate.silent_windows = 0;
+    s_rate.phase = RATE_DROP;
+    return true;
+}
+
+static void rate_try(int64_t now)
+{
+    if (uart_tx_inflight() == 0 && rate_send_baud(now, s_rate.trying, s_rate.trying_flow, AERA_BAUD_TRY))
+        s_rate.phase = RATE_TRY;
+}
+
+void link_rate_tx_service(int64_t now)
+{
+    switch (s_rate.phase)
+    {
+    case RATE_STEADY:
+        if (s_rate.rung > 0 && (now >= s_rate.next_check_us || s_rate.lost != 0) && rate_check(now))
+            return;
+        if (s_rate.rung >= s_rate.ceiling || now < s_rate.until_us)
+            return;
+        if (ota_stream_active())
+        {
+            s_rate.until_us = now + RATE_POLL_US;
+            return;
+        }
+        s_rate.trying = s_rate.rung + 1;
+        s_rate.trying_flow = s_rate.rts_cts;
+        s_rate.phase = RATE_QUIESCE;
+        rate_try(now);
+        return;
+
+    case RATE_QUIESCE:
+        rate_try(now);
+        return;
+
+    case RATE_PROBE:
+        if (!s_rate.probing)
+        {
+            if (now < s_rate.until_us)
+                return;
+            s_rate.echoes_seen = atomic_load(&s_echoes);
+            for (int i = 0; i < AERA_BAUD_PROBES; i++)
+                rate_send_probe();
+            s_rate.probing = true;
+            s_rate.until_us = now + rate_probe_wait_us(s_rate.trying);
+            return;
+        }
+        unsigned back = atomic_load(&s_echoes) - s_rate.echoes_seen;
+        if (back >= AERA_BAUD_PROBES)
+        {
+            // Quiesced, so there's a slot
+            rate_send_baud(now, s_rate.trying, s_rate.trying_flow, AERA_BAUD_COMMIT);
+            s_rate.phase = RATE_COMMIT;
+            return;
+        }
+        if (now < s_rate.until_us)
+            return;
+
+        s_rate.stats.probe_failures++;
+        AERA_DLOG(TX_RATE_PROBE_FAILED, aera_baud_rates[s_rate.trying], back, s_rate.trying_flow);
+        rate_set(s_rate.rung, s_rate.flow);
+        if (s_rate.trying_flow)
+            s_rate.rts_cts = false; // Same rate again, without
+        else
+            s_rate.ceiling = s_rate.trying - 1;
+        rate_recover(now, 0);
+        return;
+
+    case RATE_RECOVER:
+        if (atomic_load(&s_echoes) != s_rate.echoes_seen || now >= s_rate.until_us)
+        {
+            s_rate.phase = RATE_STEADY;
+            s_rate.until_us = now + s_rate.retry_us;
+            s_rate.silent_windows = 0;
+            rate_start_window(now);
+            return;
+        }
+        if (now >= s_rate.next_probe_us)
+        {
+            rate_send_probe();
+            s_rate.next_probe_us = now + RATE_POLL_US;
+        }
+        return;
+
+    default:
+        return; // A LINK_BAUD in flight; link_rate_tx_on_done() moves on
+    }
+}
+
+// When link_rate_tx_service() next has something to do on its own
+int64_t link_rate_tx_next_us(void)
+{
+    switch (s_rate.phase)
+    {
+    case RATE_STEADY:
+    {
+        int64_t next = s_rate.rung < s_rate.ceiling ? s_rate.until_us : INT64_MAX;
+        if (s_rate.rung > 0 && s_rate.next_check_us < next)
+            next = s_rate.next_check_us;
+        return next;
+    }
+    case RATE_PROBE:
+        return s_rate.until_us;
+    case RATE_RECOVER:
+        return s_rate.next_probe_us < s_rate.until_us ? s_rate.next_probe_us : s_rate.until_us;
+    default:
+        return INT64_MAX;
+    }
+}
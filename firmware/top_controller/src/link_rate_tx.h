@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/uart.h"
+#include "aera_link.h"
+#include "aera_baud.h"
+
+// --- LINK RATE ---
+//
+// The top controller's side of the rate negotiation (aera_baud.h), run by
+// the UART TX task. LINK_RATE_TX_START_MS after start, and whenever the
+// link settles, it tries the next rate up to LINK_RATE_TX_MAX; a rate that
+// fails isn't tried again. Above the base rate it drops back to it on
+// AERA_BAUD_MAX_ERRORS errors in an AERA_BAUD_CHECK_MS window (and lowers
+// the ceiling), two windows without an echo, or a single command out of
+// retries. While a phase is under way nothing else goes out. No climbing
+// during an OTA stream, nor ever on a bus.
+
+#define LINK_RATE_TX_MAX        5000000
+#define LINK_RATE_TX_START_MS   500
+#define LINK_RATE_TX_SETTLE_MS  5   // After a switch, so the bottom controller has too
+#define LINK_RATE_TX_PROBE_MS   20  // Spare time for the echoes, on top of the wire's
+#define LINK_RATE_TX_POLL_MS    100
+#define LINK_RATE_TX_RETRY_MS   5000
+
+typedef struct
+{
+    uint32_t baud;         // The UART's rate right now
+    bool flow;             // ... and whether RTS/CTS is on
+    uint32_t steps;        // Rates reached
+    uint32_t probe_failures;
+    uint32_t fallbacks;    // Drops to AERA_BAUD_BASE
+} link_rate_tx_stats_t;
+
+// A LINK_PROBE echo, from the UART RX task. Never blocks.
+void link_rate_tx_post_probe(const aera_frame_t *probe);
+
+// Plain copy
+void link_rate_tx_get_stats(link_rate_tx_stats_t *out);
+
+// uart_tx.c only: init from uart_tx_start(), the rest on the TX task.
+// rts_cts: the rates may turn flow control on.
+void link_rate_tx_init(uart_port_t port, bool rts_cts, bool bus);
+void link_rate_tx_service(int64_t now);
+int64_t link_rate_tx_next_us(void);
+// False while a switch is under way; then nothing else may go out
+bool link_rate_tx_steady(void);
+// A LINK_BAUD of ours was ACKed, or ran out of tries
+void link_rate_tx_on_done(bool acked);
+// Any frame ran out of tries
+void link_rate_tx_on_failed(void);
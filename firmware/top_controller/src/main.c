@@ -1,57 +1,624 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "esp_system.h"
-#include "esp_wifi.h"
-#include "esp_event.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "esp_netif.h"
+#include "esp_event.h"
 #include "driver/gpio.h"
 #include "driver/uart.h"
 #include "esp_http_server.h"
+#include "aera_cmd.h"
+#include "aera_power.h"
+#include "aera_dlog.h"
+#include "aera_stats.h"
+#include "uart_tx.h"
+#include "link_rate_tx.h"
+#include "bus_sched.h"
+#include "uart_rx.h"
+#include "ws_rx_pool.h"
+#include "ws_broadcast.h"
+#include "telemetry.h"
+#include "history.h"
+#include "sys_stats.h"
+#include "trace_dump.h"
+#include "ota_relay.h"
+#include "wifi_conn.h"
+#include "boot_trace.h"
+#include "udp_ctrl.h"
 
 // --- CONFIGURATION ---
 #define WIFI_SSID "HUAWEI-2.4G-ZxPH"
 #define WIFI_PASS "vq5hJkB8"
 #define SERVER_PORT 81
+// Boot order. 1: the bottom-board link and the server come up first and NVS
+// (which can take a while to mount, or to erase after an update) after
+// them, right before Wi-Fi needs it. 0: NVS first, as it used to be.
+#define BOOT_LINK_FIRST 1
+// Power saving. 1: the CPU drops to AERA_POWER_MIN_MHZ between bursts of
+// work, and with WIFI_LISTEN_INTERVAL > 0 the radio sleeps between beacons.
+// Off by default: with both on, PING p50 went from 0.34 ms to 34 ms and ON
+// p99 from 4.9 ms to 101 ms. Worth it only on battery.
+#define POWER_SAVE 0
+// Radio wake-ups in modem sleep (wifi_conn.h), used only with POWER_SAVE.
+// 0 keeps the radio awake, so POWER_SAVE saves on the CPU alone and costs
+// well under a millisecond. 1 wakes for every DTIM beacon: with a DTIM 1
+// router a command waits ~50 ms more on average, ~100 ms at worst.
+#define WIFI_LISTEN_INTERVAL 0
+// Control datagrams (udp_ctrl.h). 1: ON/OFF/TEMP/DRYTIME/PING are also
+// taken as signed datagrams on UDP port UDP_CTRL_PORT, as well as over
+// the WebSocket, once the unit has its own key in NVS. 0 leaves it out.
+#ifndef UDP_CTRL
+#define UDP_CTRL 0
+#endif
+#define UDP_CTRL_PORT SERVER_PORT
 
 // --- STATIC IP CONFIG ---
 #define STATIC_IP_ADDR "192.168.18.200"
 #define STATIC_GW_ADDR "192.168.18.1"
 #define STATIC_NM_ADDR "255.255.255.0"
+#define STATIC_DNS_ADDR "8.8.8.8"
 
 // --- PINS ---
 #define LED_PIN 2
 #define TXD2_PIN 5
 #define RXD2_PIN 4
+// Flow control for the faster link rates (link_rate_tx.h): wire RTS/CTS
+// across to the bottom board's and set both here, and on the bottom board
+#define RTS2_PIN UART_PIN_NO_CHANGE
+#define CTS2_PIN UART_PIN_NO_CHANGE
+#define LINK_RTS_CTS (RTS2_PIN != UART_PIN_NO_CHANGE && CTS2_PIN != UART_PIN_NO_CHANGE)
+// Bottom controllers on a bus (aera_bus.h) instead of one on the link: a
+// jumper to 3V3 on LINK_BUS_PIN, and the RS-485 transceiver's driver
+// enable on LINK_DE_PIN, its receiver enable tied low
+#define LINK_BUS_PIN 18
+#define LINK_DE_PIN 19
 #define UART_PORT_NUM UART_NUM_2
+// Holds the bottom board's biggest burst, a full TRACE dump (~2.2 KB), even
+// if the RX task is held up for the whole of it
+#define UART_RX_BUF_SIZE 4096
 
 // --- EVENT GROUP BITS ---
-// We use these bits to signal state between tasks safely
+// We use these bits to signal state between tasks safely. Exactly one of
+// the two is set at a time, so a task can sleep until either happens.
 #define WIFI_CONNECTED_BIT BIT0
+#define WIFI_DISCONNECTED_BIT BIT1
 
 static const char *TAG = "TOP_CONTROLLER";
 static EventGroupHandle_t s_wifi_event_group;
 static httpd_handle_t server = NULL;
+static QueueHandle_t s_uart_queue;
+
+// Path counters for STATS; the rest live with the modules they count
+static atomic_uint s_ws_in;         // WebSocket frames received
+static atomic_uint s_ws_replies;    // Replies sent (broadcasts are counted apart)
+static atomic_uint s_unknown;       // WebSocket and UDP commands, and link frames, refused
+
+// What a command handler knows about where its command came from. A
+// WebSocket command has the request to answer; one off the UDP control
+// channel (udp_ctrl.h) has none, its answer comes from on_uart_command_done().
+typedef struct
+{
+    httpd_req_t *req;   // NULL for a datagram
+    uint8_t unit;       // The bottom controller it is for ("@<unit>", aera_bus.h)
+    int64_t rx_us;      // When it was read, for the trace and the done callback
+    bool queued;        // Set by send_uart_command()
+} cmd_ctx_t;
 
 // --- UART SENDER HELPER ---
-void send_uart_command(const char *command)
+// Queues the command for the UART TX task; never blocks the caller
+static void send_uart_command(cmd_ctx_t *ctx, uint8_t opcode, const uint8_t *payload, uint8_t len)
+{
+    ctx->queued = uart_tx_enqueue(ctx->unit, opcode, payload, len, ctx->rx_us);
+    if (!ctx->queued)
+    {
+        AERA_DLOG(TX_QUEUE_FULL, opcode);
+    }
+}
+
+// --- WEBSOCKET REPLIES ---
+static void ws_reply_text(httpd_req_t *req, const char *text, size_t len)
+{
+    httpd_ws_frame_t resp_pkt;
+    memset(&resp_pkt, 0, sizeof(httpd_ws_frame_t));
+    resp_pkt.payload = (uint8_t *)text;
+    resp_pkt.len = len;
+    resp_pkt.type = HTTPD_WS_TYPE_TEXT;
+    httpd_ws_send_frame(req, &resp_pkt);
+    atomic_fetch_add_explicit(&s_ws_replies, 1, memory_order_relaxed);
+}
+
+// --- COMMAND HANDLERS ---
+// One per entry in the shared registry (aera_cmd.h). WebSocket text is
+// mapped to its registry entry and dispatched here with a cmd_ctx_t.
+#define AERA_CMD_CTX cmd_ctx_t *
+AERA_CMD_DEFINE_DISPATCH(dispatch_command)
+
+// Actuator commands only queue the frame. STATUS goes out from
+// on_uart_command_done() once the bottom board has ACKed it.
+static void cmd_LED_ON(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    send_uart_command(ctx, AERA_OP_LED_ON, NULL, 0);
+}
+
+static void cmd_LED_OFF(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    send_uart_command(ctx, AERA_OP_LED_OFF, NULL, 0);
+}
+
+// Setpoints go straight through; the bottom board owns their limits
+static void cmd_DRY_TEMP(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    send_uart_command(ctx, AERA_OP_DRY_TEMP, frame->payload, frame->len);
+}
+
+static void cmd_DRY_TIME(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    send_uart_command(ctx, AERA_OP_DRY_TIME, frame->payload, frame->len);
+}
+
+static void cmd_PING(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    ws_reply_text(ctx->req, "PONG", 4);
+}
+
+// This board's path counters and tasks, then the bottom board's (b.*),
+// which it reports in SYS frames after ACKing the forwarded STATS; the
+// reply goes out from sys_stats.c once they are in. If they don't come
+// within SYS_STATS_BOTTOM_WAIT_MS it says b=none. Task CPU shares cover the
+// time since the previous STATS.
+static void cmd_STATS(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    // Only ever runs on the httpd task; keeps all this off its stack
+    static char msg[SYS_STATS_TEXT_MAX];
+    static aera_task_stats_t tasks[AERA_STATS_MAX_TASKS];
+
+    uart_tx_stats_t st;
+    uart_tx_get_stats(&st);
+
+    link_rate_tx_stats_t rate;
+    link_rate_tx_get_stats(&rate);
+
+    uart_rx_stats_t rx;
+    uart_rx_get_stats(&rx);
+
+    ws_rx_pool_stats_t pool;
+    ws_rx_pool_get_stats(&pool);
+
+    ws_broadcast_stats_t bc;
+    ws_broadcast_get_stats(&bc);
+
+    udp_ctrl_stats_t udp;
+    udp_ctrl_get_stats(&udp);
+
+    telemetry_stats_t tm;
+    telemetry_get_stats(&tm);
+
+    wifi_conn_stats_t wf;
+    wifi_conn_get_stats(&wf);
+
+    aera_heap_stats_t heap;
+    aera_stats_heap(&heap);
+    int task_count = aera_stats_tasks(tasks, AERA_STATS_MAX_TASKS);
+
+    int n = snprintf(msg, sizeof(msg),
+                     "STATS:depth=%lu,max=%lu,dropped=%lu,batches=%lu,frames=%lu,"
+                     "acked=%lu,retries=%lu,failed=%lu,inflight=%lu,coalesced=%lu,"
+                     "rx_hits=%lu,rx_misses=%lu,rx_rejected=%lu,"
+                     "clients=%lu,bc_sent=%lu,bc_coalesced=%lu,bc_dropped=%lu,bc_us=%lu/%lu/%lu,"
+                     "tm_batches=%lu,tm_samples=%lu,tm_lost=%lu,tm_subs=%lu,"
+                     "wifi_connects=%lu,wifi_attempts=%lu,wifi_scans=%lu,wifi_ms=%lu/%lu,"
+                     "ws_in=%lu,ws_out=%lu,unknown=%lu,uart_in=%lu,uart_out=%lu,"
+                     "crc=%lu,skipped=%lu,overflows=%lu,bc_errors=%lu,ka_pings=%lu,ka_reaped=%lu,"
+                     "udp_in=%lu,udp_bad=%lu,udp_dups=%lu,udp_stale=%lu,udp_nonce=%lu,udp_renonces=%lu,"
+                     "udp_out=%lu,udp_timeouts=%lu,heap=%lu/%lu/%lu,"
+                     "baud=%lu,flow=%d,baud_steps=%lu,baud_probe_failures=%lu,baud_fallbacks=%lu",
+                     (unsigned long)st.depth, (unsigned long)st.max_depth, (unsigned long)st.dropped,
+                     (unsigned long)st.batches, (unsigned long)st.frames,
+                     (unsigned long)st.acked, (unsigned long)st.retries, (unsigned long)st.failed,
+                     (unsigned long)st.inflight, (unsigned long)st.coalesced,
+                     (unsigned long)pool.hits, (unsigned long)pool.misses, (unsigned long)pool.rejected,
+                     (unsigned long)bc.clients, (unsigned long)bc.sent, (unsigned long)bc.coalesced,
+                     (unsigned long)bc.dropped, (unsigned long)bc.latency_min_us,
+                     (unsigned long)bc.latency_avg_us, (unsigned long)bc.latency_max_us,
+                     (unsigned long)tm.batches, (unsigned long)tm.samples, (unsigned long)tm.lost,
+                     (unsigned long)tm.subscribers,
+                     (unsigned long)wf.connects, (unsigned long)wf.attempts, (unsigned long)wf.scans,
+                     (unsigned long)wf.last_ms, (unsigned long)wf.max_ms,
+                     (unsigned long)atomic_load(&s_ws_in), (unsigned long)(atomic_load(&s_ws_replies) + bc.sent),
+                     (unsigned long)atomic_load(&s_unknown), (unsigned long)rx.bytes, (unsigned long)st.bytes,
+                     (unsigned long)rx.crc_errors, (unsigned long)rx.skipped, (unsigned long)rx.overflows,
+                     (unsigned long)bc.send_errors, (unsigned long)bc.pings, (unsigned long)bc.reaped,
+                     (unsigned long)udp.received, (unsigned long)udp.bad, (unsigned long)udp.dups,
+                     (unsigned long)udp.stale, (unsigned long)udp.nonce, (unsigned long)udp.renonces,
+                     (unsigned long)udp.replies, (unsigned long)udp.timeouts,
+                     (unsigned long)heap.free, (unsigned long)heap.min_free, (unsigned long)heap.largest,
+                     (unsigned long)rate.baud, rate.flow, (unsigned long)rate.steps,
+                     (unsigned long)rate.probe_failures, (unsigned long)rate.fallbacks);
+    if (n < (int)sizeof(msg))
+        n += sys_stats_format_tasks(msg + n, sizeof(msg) - n, "", tasks, task_count);
+
+    sys_stats_expect(ctx->req, ctx->unit, msg, n < (int)sizeof(msg) ? n : (int)sizeof(msg) - 1);
+    send_uart_command(ctx, AERA_OP_STATS, NULL, 0);
+}
+
+// Both boards' tracepoints, as two replies (trace_dump.h). The bottom
+// board's ring follows the ACK of the forwarded TRACE and is sent from
+// trace_dump.c.
+static void cmd_TRACE(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    // Only ever runs on the httpd task; keeps all this off its stack
+    static trace_dump_t dump;
+    static char msg[TRACE_DUMP_TEXT_MAX];
+
+    dump.count = aera_trace_snapshot(dump.events, AERA_TRACE_LEN);
+    dump.now = (uint32_t)esp_timer_get_time();
+
+    // Ours first, so the bottom reply can't overtake it
+    ws_reply_text(ctx->req, msg, trace_dump_format(msg, sizeof(msg), "top", &dump));
+    trace_dump_expect(ctx->req, ctx->unit);
+    send_uart_command(ctx, AERA_OP_TRACE, NULL, 0);
+}
+
+static void cmd_BOOT(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    char msg[400];
+    int n = boot_trace_format(msg, sizeof(msg), BOOT_LINK_FIRST ? "link_first" : "nvs_first");
+    ws_reply_text(ctx->req, msg, n);
+}
+
+// Times are in ms since aera_power_init(); busy is time with a power lock
+// held, i.e. at full speed. The lock counts say who asked for it.
+static void cmd_POWER(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    aera_power_stats_t pw;
+    aera_power_get_stats(&pw);
+
+    char msg[200];
+    int n = snprintf(msg, sizeof(msg),
+                     "POWER:save=%d,mhz=%u/%u,listen=%d,up_ms=%llu,busy_ms=%llu,ws=%lu,link=%lu,control=%lu",
+                     pw.save, pw.min_mhz, pw.max_mhz, POWER_SAVE ? WIFI_LISTEN_INTERVAL : 0,
+                     (unsigned long long)(pw.up_us / 1000), (unsigned long long)(pw.busy_us / 1000),
+                     (unsigned long)pw.acquired[AERA_POWER_WS], (unsigned long)pw.acquired[AERA_POWER_LINK],
+                     (unsigned long)pw.acquired[AERA_POWER_CONTROL]);
+    ws_reply_text(ctx->req, msg, n);
+}
+
+// LOG:<level> sets the log level (0 none .. 5 verbose) on both boards;
+// LOG:<16 + level> switches them to raw output for tools/dlog_decode.py.
+// Answers with this board's counters.
+static void cmd_LOG(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    uint8_t arg = frame->payload[0];
+    aera_dlog_set((esp_log_level_t)(arg & AERA_DLOG_ARG_LEVEL), (arg & AERA_DLOG_ARG_RAW) != 0);
+    send_uart_command(ctx, AERA_OP_LOG, frame->payload, frame->len);
+
+    aera_dlog_stats_t st;
+    aera_dlog_get_stats(&st);
+    char msg[80];
+    int n = snprintf(msg, sizeof(msg), "LOG:level=%d,raw=%d,written=%lu,lost=%lu", st.level, st.raw,
+                     (unsigned long)st.written, (unsigned long)st.lost);
+    ws_reply_text(ctx->req, msg, n);
+}
+
+static void cmd_LATENCY(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    // Only ever runs on the httpd task; keeps the reply off its stack
+    static lat_hist_t rtt, gpio, ack;
+    static char msg[640];
+    uart_tx_get_latency(&rtt, &gpio, &ack);
+
+    static const struct
+    {
+        const char *label;
+        const lat_hist_t *hist;
+    } parts[] = {{"LATENCY:rtt:", &rtt}, {";gpio:", &gpio}, {";ack:", &ack}};
+
+    int n = 0;
+    for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]) && n < (int)sizeof(msg); i++)
+    {
+        n += snprintf(msg + n, sizeof(msg) - n, "%s", parts[i].label);
+        if (n < (int)sizeof(msg))
+            n += lat_hist_format(parts[i].hist, msg + n, sizeof(msg) - n);
+    }
+    ws_reply_text(ctx->req, msg, n < (int)sizeof(msg) ? n : (int)sizeof(msg) - 1);
+}
+
+// TELEM:<hz> subscribes this session to the sensor stream, of the one unit;
+// answers with the interval granted, TELEM:<ms> (TELEM:0 when unsubscribed
+// or out of room)
+static void cmd_TELEM(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    uint32_t interval_ms = telemetry_subscribe(httpd_req_to_sockfd(ctx->req), ctx->unit, frame->payload[0]);
+    char msg[24];
+    int n = snprintf(msg, sizeof(msg), "TELEM:%lu", (unsigned long)interval_ms);
+    ws_reply_text(ctx->req, msg, n);
+}
+
+// How busy the bus is since the last BUS, and per node that has ever
+// answered: its turns, those it missed, bytes each way and the p50/p99/max
+// of poll -> reply and of command -> ACK, in us.
+//
+//   BUS:mode=bus,baud=115200,present=3,turns=..,probes=..,util=41.7%;1:up=1,polls=..,...
+static void cmd_BUS(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    // Only ever runs on the httpd task; keeps all this off its stack
+    static bus_sched_stats_t bus;
+    static char msg[2560];
+    static uint64_t last_bytes;
+    static int64_t last_us;
+
+    bus_sched_stats_t *b = &bus;
+    bus_sched_get_stats(b);
+    if (!b->on)
+    {
+        ws_reply_text(ctx->req, "BUS:mode=p2p", 12);
+        return;
+    }
+
+    int present = 0;
+    for (int node = 1; node <= AERA_BUS_MAX_NODES; node++)
+        present += b->nodes[node].present;
+
+    int64_t now = esp_timer_get_time();
+    uint64_t wire_us = (b->wire_bytes - last_bytes) * 10 * 1000000 / AERA_BAUD_BASE;
+    uint32_t util = now > last_us ? (uint32_t)(wire_us * 1000 / (uint64_t)(now - last_us)) : 0;
+    last_bytes = b->wire_bytes;
+    last_us = now;
+
+    int n = snprintf(msg, sizeof(msg), "BUS:mode=bus,baud=%lu,present=%d,turns=%lu,probes=%lu,util=%lu.%lu%%",
+                     (unsigned long)AERA_BAUD_BASE, present, (unsigned long)b->turns, (unsigned long)b->probes,
+                     (unsigned long)(util / 10), (unsigned long)(util % 10));
+    for (int node = 1; node <= AERA_BUS_MAX_NODES && n < (int)sizeof(msg); node++)
+    {
+        const bus_sched_node_t *st = &b->nodes[node];
+        if (st->bytes_in == 0)
+            continue;
+        n += snprintf(msg + n, sizeof(msg) - n,
+                      ";%d:up=%d,polls=%lu,missed=%lu,out=%lu,in=%lu,poll_us=%lu/%lu/%lu,cmd_us=%lu/%lu/%lu", node,
+                      st->present, (unsigned long)st->polls, (unsigned long)st->missed,
+                      (unsigned long)st->bytes_out, (unsigned long)st->bytes_in,
+                      (unsigned long)lat_hist_percentile(&st->poll, 50),
+                      (unsigned long)lat_hist_percentile(&st->poll, 99), (unsigned long)st->poll.max_us,
+                      (unsigned long)lat_hist_percentile(&st->rtt, 50),
+                      (unsigned long)lat_hist_percentile(&st->rtt, 99), (unsigned long)st->rtt.max_us);
+    }
+    ws_reply_text(ctx->req, msg, n < (int)sizeof(msg) ? n : (int)sizeof(msg) - 1);
+}
+
+// Link-only: arrive over UART with ctx == NULL
+static void cmd_ACK(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    uart_tx_post_ack(frame);
+}
+
+static void cmd_BUS_REPLY(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    uart_tx_bus_post_reply(frame);
+}
+
+static void cmd_TELEMETRY(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    telemetry_ingest(frame);
+}
+
+static void cmd_SYS(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    sys_stats_ingest(frame);
+}
+
+static void cmd_TRACE_DUMP(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    trace_dump_ingest(frame);
+}
+
+static void cmd_OTA_STATUS(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    ota_relay_ingest(frame);
+}
+
+// We send these (the UART TX task, ota_relay.c); the bottom boards never do
+static void cmd_SYNC(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+}
+
+static void cmd_OTA_BEGIN(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+}
+
+static void cmd_OTA_DATA(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+}
+
+static void cmd_OTA_END(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+}
+
+static void cmd_LINK_BAUD(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+}
+
+static void cmd_BUS_POLL(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+}
+
+// The bottom board's echo of one of ours (link_rate_tx.h)
+static void cmd_LINK_PROBE(cmd_ctx_t *ctx, const aera_frame_t *frame)
+{
+    link_rate_tx_post_probe(frame);
+}
+
+// --- UART LINK CALLBACKS ---
+// Frames from the bottom board go through the same dispatcher as WebSocket
+// commands, just without a request to answer. Only link-only commands are
+// let through: the rest would reply to a NULL request.
+static void on_link_frame(const aera_frame_t *frame)
 {
-    // Send string + newline
-    uart_write_bytes(UART_PORT_NUM, command, strlen(command));
-    uart_write_bytes(UART_PORT_NUM, "\n", 1);
-    ESP_LOGI(TAG, "Sent UART: %s", command);
+    boot_mark(BOOT_LINK);
+    const aera_cmd_info_t *cmd = aera_cmd_by_opcode(frame->opcode);
+    if (cmd == NULL || cmd->alias != NULL || !dispatch_command(NULL, frame))
+    {
+        atomic_fetch_add_explicit(&s_unknown, 1, memory_order_relaxed);
+        AERA_DLOG(LINK_UNEXPECTED, frame->opcode, frame->len);
+    }
 }
 
+// Runs on the UART TX task once the bottom board has ACKed a command (or it
+// ran out of retries). Clients only ever see the state the board reported.
+// The default unit's messages are the plain ones; any other's end in
+// @<unit>, and each unit's STATUS has a topic of its own.
+static void on_uart_command_done(uint8_t node, uint8_t opcode, bool acked, uint8_t state, int64_t origin_us)
+{
+    udp_ctrl_on_done(node, opcode, acked, state, origin_us);
+
+    bool plain = node == uart_tx_default_node();
+    char msg[24];
+
+    if (!acked)
+    {
+        if (plain)
+            ws_broadcast_publish(WS_TOPIC_ERROR, "ERROR:NO_ACK");
+        else
+        {
+            snprintf(msg, sizeof(msg), "ERROR:NO_ACK@%u", node);
+            ws_broadcast_publish(WS_TOPIC_ERROR, msg);
+        }
+        return;
+    }
+    if (opcode == AERA_OP_LED_ON || opcode == AERA_OP_LED_OFF)
+    {
+        if (plain)
+            ws_broadcast_publish(WS_TOPIC_STATUS, state ? "STATUS:ON" : "STATUS:OFF");
+        else
+        {
+            snprintf(msg, sizeof(msg), "STATUS:%s@%u", state ? "ON" : "OFF", node);
+            ws_broadcast_publish((ws_topic_t)(WS_TOPIC_UNIT_STATUS + node), msg);
+        }
+    }
+}
+
+// --- UDP CONTROL CALLBACK ---
+// Runs on the UDP task; udp_ctrl.c only lets through commands that do no
+// more than queue a frame, so there is no request to answer here either.
+// The answer goes out from on_uart_command_done().
+#if UDP_CTRL
+static udp_ctrl_status_t on_udp_command(uint8_t unit, const aera_frame_t *frame, int64_t rx_us)
+{
+    cmd_ctx_t ctx = {.req = NULL, .unit = unit, .rx_us = rx_us};
+    if (!dispatch_command(&ctx, frame))
+    {
+        atomic_fetch_add_explicit(&s_unknown, 1, memory_order_relaxed);
+        return UDP_CTRL_REFUSED;
+    }
+    boot_mark(BOOT_FIRST_CMD);
+    return ctx.queued ? UDP_CTRL_OK : UDP_CTRL_BUSY;
+}
+#endif
+
 // --- WEBSOCKET HANDLER ---
+// "@<unit>" at the end picks the bottom controller on a bus; without it, or
+// on a point-to-point link, the command goes to the default one. False for
+// a unit that can't be there.
+static bool parse_ws_unit(const char *text, size_t *len, uint8_t *unit)
+{
+    *unit = uart_tx_default_node();
+    const char *at = memchr(text, '@', *len);
+    if (at == NULL)
+        return true;
+
+    char *end;
+    unsigned long v = strtoul(at + 1, &end, 10);
+    if (at[1] < '0' || at[1] > '9' || end != text + *len || *unit == AERA_LINK_ADDR_P2P || v < 1 ||
+        v > AERA_BUS_MAX_NODES)
+        return false;
+    *unit = (uint8_t)v;
+    *len = (size_t)(at - text);
+    return true;
+}
+
+// Maps "ALIAS" or "ALIAS:<decimal>" to a frame for the dispatcher. The number
+// is written big-endian into payload, as wide as the registry says; the
+// dispatcher then refuses a command given the wrong number of arguments.
+static bool parse_ws_command(const char *text, size_t len, aera_frame_t *frame, uint8_t *payload)
+{
+    const char *colon = memchr(text, ':', len);
+    const aera_cmd_info_t *cmd = aera_cmd_by_alias(text, colon ? (size_t)(colon - text) : len);
+    if (cmd == NULL)
+        return false;
+
+    frame->opcode = cmd->opcode;
+    frame->len = 0;
+    frame->payload = payload;
+    if (colon == NULL)
+        return true;
+
+    // text is NUL-terminated, or ends at the unit's '@', so strtoul stops at
+    // the end of the command
+    char *end;
+    unsigned long v = strtoul(colon + 1, &end, 10);
+    if (colon[1] < '0' || colon[1] > '9' || end != text + len)
+        return false;
+    if (cmd->payload_len == 0 || cmd->payload_len > sizeof(uint32_t) ||
+        (cmd->payload_len < sizeof(uint32_t) && (v >> (8 * cmd->payload_len)) != 0))
+        return false;
+
+    for (int i = cmd->payload_len - 1; i >= 0; i--)
+    {
+        payload[i] = (uint8_t)(v & 0xFF);
+        v >>= 8;
+    }
+    frame->len = cmd->payload_len;
+    return true;
+}
+
+// Control frames reach us because the keepalive needs to see PONGs
+// (ws_broadcast.h); PING and CLOSE get the answers httpd would have given.
+// A CLOSE fails the handler so httpd closes the session.
+static esp_err_t ws_control_frame(httpd_req_t *req, httpd_ws_frame_t *ws_pkt)
+{
+    uint8_t payload[125]; // Control frames carry no more (RFC 6455)
+    if (ws_pkt->len > sizeof(payload))
+        return ESP_FAIL;
+    ws_pkt->payload = payload;
+    esp_err_t ret = ws_pkt->len ? httpd_ws_recv_frame(req, ws_pkt, ws_pkt->len) : ESP_OK;
+    if (ret != ESP_OK)
+        return ret;
+
+    switch (ws_pkt->type)
+    {
+    case HTTPD_WS_TYPE_PING:
+        ws_pkt->type = HTTPD_WS_TYPE_PONG;
+        return httpd_ws_send_frame(req, ws_pkt);
+    case HTTPD_WS_TYPE_CLOSE:
+        httpd_ws_send_frame(req, ws_pkt);
+        return ESP_FAIL;
+    default:
+        return ESP_OK;
+    }
+}
+
 // This function handles the WebSocket data frames
 static esp_err_t ws_handler(httpd_req_t *req)
 {
+    int sockfd = httpd_req_to_sockfd(req);
     if (req->method == HTTP_GET)
     {
         ESP_LOGI(TAG, "Handshake done, WebSocket connection established");
+        ws_broadcast_add_client(sockfd);
+
+        // The server keeps the session alive; this tells the client how
+        // long it may go without hearing from us
+        char hello[64];
+        int n = snprintf(hello, sizeof(hello), "HELLO:ping_ms=%d,timeout_ms=%d", WS_BCAST_PING_MS,
+                         WS_BCAST_IDLE_TIMEOUT_MS);
+        ws_reply_text(req, hello, n);
         return ESP_OK;
     }
 
@@ -64,62 +631,75 @@ static esp_err_t ws_handler(httpd_req_t *req)
     esp_err_t ret = httpd_ws_recv_frame(req, &ws_pkt, 0);
     if (ret != ESP_OK)
         return ret;
+    ws_broadcast_client_seen(sockfd);
+    if (ws_pkt.type >= HTTPD_WS_TYPE_CLOSE)
+        return ws_control_frame(req, &ws_pkt);
 
     if (ws_pkt.len > 0)
     {
-        // 2. Allocate memory and read data
-        uint8_t *buf = calloc(1, ws_pkt.len + 1);
+        // 2. Take a slab from the pool and read data. Oversized frames are
+        // refused before anything is taken; failing the handler makes httpd
+        // close the session, since the unread payload is still on the socket.
+        uint8_t *buf = ws_rx_pool_take(ws_pkt.len);
+        if (buf == NULL)
+        {
+            AERA_DLOG(WS_TOO_BIG, ws_pkt.len, WS_RX_MAX_FRAME);
+            return ESP_FAIL;
+        }
+        aera_power_acquire(AERA_POWER_WS);
         ws_pkt.payload = buf;
         ret = httpd_ws_recv_frame(req, &ws_pkt, ws_pkt.len);
+        buf[ws_pkt.len] = '\0';
 
         if (ret == ESP_OK)
         {
-            ESP_LOGI(TAG, "WS Received: %s", ws_pkt.payload);
-
-            // 3. LOGIC: Handle Commands
-            if (strcmp((char *)ws_pkt.payload, "ON") == 0)
-            {
-                send_uart_command("turn_ON_led");
-
-                // Broadcast status back (Simple echo to sender for now)
-                httpd_ws_frame_t resp_pkt;
-                memset(&resp_pkt, 0, sizeof(httpd_ws_frame_t));
-                resp_pkt.payload = (uint8_t *)"STATUS:ON";
-                resp_pkt.len = 9;
-                resp_pkt.type = HTTPD_WS_TYPE_TEXT;
-                httpd_ws_send_frame(req, &resp_pkt);
-            }
-            else if (strcmp((char *)ws_pkt.payload, "OFF") == 0)
+            cmd_ctx_t ctx = {.req = req, .rx_us = esp_timer_get_time()};
+            atomic_fetch_add_explicit(&s_ws_in, 1, memory_order_relaxed);
+            AERA_DLOG(WS_RX, AERA_DLOG_STR((const char *)ws_pkt.payload, 16), ws_pkt.len);
+
+            // 3. LOGIC: Look the text up in the registry and dispatch it
+            aera_frame_t frame;
+            uint8_t payload[sizeof(uint32_t)];
+            size_t len = ws_pkt.len;
+            if (!parse_ws_unit((const char *)ws_pkt.payload, &len, &ctx.unit) ||
+                !parse_ws_command((const char *)ws_pkt.payload, len, &frame, payload) ||
+                !dispatch_command(&ctx, &frame))
             {
-                send_uart_command("turn_OFF_led");
-
-                httpd_ws_frame_t resp_pkt;
-                memset(&resp_pkt, 0, sizeof(httpd_ws_frame_t));
-                resp_pkt.payload = (uint8_t *)"STATUS:OFF";
-                resp_pkt.len = 10;
-                resp_pkt.type = HTTPD_WS_TYPE_TEXT;
-                httpd_ws_send_frame(req, &resp_pkt);
+                atomic_fetch_add_explicit(&s_unknown, 1, memory_order_relaxed);
+                AERA_DLOG(WS_BAD_CMD, AERA_DLOG_STR((const char *)ws_pkt.payload, 16), ws_pkt.len);
             }
-            else if (strcmp((char *)ws_pkt.payload, "PING") == 0)
+            else
             {
-                httpd_ws_frame_t resp_pkt;
-                memset(&resp_pkt, 0, sizeof(httpd_ws_frame_t));
-                resp_pkt.payload = (uint8_t *)"PONG";
-                resp_pkt.len = 4;
-                resp_pkt.type = HTTPD_WS_TYPE_TEXT;
-                httpd_ws_send_frame(req, &resp_pkt);
+                boot_mark(BOOT_FIRST_CMD);
             }
         }
-        free(buf);
+        ws_rx_pool_give(buf);
+        aera_power_release(AERA_POWER_WS);
     }
     return ret;
 }
 
 // --- SERVER INIT ---
+// httpd calls this for every socket it closes; once set, closing it is on us
+static void ws_session_closed(httpd_handle_t hd, int sockfd)
+{
+    telemetry_unsubscribe(sockfd);
+    ws_broadcast_remove_client(sockfd);
+    close(sockfd);
+}
+
 static void start_webserver(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = SERVER_PORT; // Set to 81 as per request
+    config.close_fn = ws_session_closed;
+    // Sessions whose peer vanished during a Wi-Fi drop linger until the
+    // keepalive reaps them (ws_broadcast.h); meanwhile let reconnecting
+    // clients push the oldest ones out. One socket more than there are
+    // WebSocket clients keeps room for /history and /ota. With httpd's own
+    // three and the UDP control socket, CONFIG_LWIP_MAX_SOCKETS is 17.
+    config.lru_purge_enable = true;
+    config.max_open_sockets = WS_BCAST_MAX_CLIENTS + 1;
 
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
     if (httpd_start(&server, &config) == ESP_OK)
@@ -130,111 +710,90 @@ static void start_webserver(void)
             .method = HTTP_GET,
             .handler = ws_handler,
             .user_ctx = NULL,
-            .is_websocket = true};
+            .is_websocket = true,
+            .handle_ws_control_frames = true};
         httpd_register_uri_handler(server, &ws_uri);
+
+        // Sensor history, plain HTTP on the same server
+        httpd_uri_t history_uri = {
+            .uri = "/history",
+            .method = HTTP_GET,
+            .handler = history_http_handler,
+            .user_ctx = NULL};
+        httpd_register_uri_handler(server, &history_uri);
+
+        // Bottom controller firmware updates
+        httpd_uri_t ota_uri = {
+            .uri = "/ota/bottom",
+            .method = HTTP_POST,
+            .handler = ota_relay_http_handler,
+            .user_ctx = NULL};
+        httpd_register_uri_handler(server, &ota_uri);
+        ws_broadcast_set_server(server);
+        boot_mark(BOOT_HTTPD);
     }
 }
 
-// --- WIFI EVENT HANDLER ---
-static void wifi_event_handler(void *arg, esp_event_base_t event_base,
-                               int32_t event_id, void *event_data)
+// --- WIFI STATE ---
+// Called on the event loop as the link comes and goes. The server stays up
+// throughout; sessions whose TCP connection survived a short blip just carry on.
+static void on_wifi_change(bool up)
 {
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
+    if (up)
     {
-        esp_wifi_connect();
+        boot_mark(BOOT_WIFI_UP);
+        xEventGroupClearBits(s_wifi_event_group, WIFI_DISCONNECTED_BIT);
+        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
-    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    else
     {
-        // Clear the Connected Bit
         xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
-        esp_wifi_connect();
-        ESP_LOGI(TAG, "Retry to connect to the AP");
-    }
-    else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
-    {
-        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
-        ESP_LOGI(TAG, "Got IP:" IPSTR, IP2STR(&event->ip_info.ip));
-        // Set the Connected Bit
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
-        start_webserver();
+        xEventGroupSetBits(s_wifi_event_group, WIFI_DISCONNECTED_BIT);
     }
 }
 
 // --- INITIALIZERS ---
-void init_uart()
+// True if the bottom controllers are on a bus
+bool init_uart()
 {
+    gpio_set_direction(LINK_BUS_PIN, GPIO_MODE_INPUT);
+    gpio_set_pull_mode(LINK_BUS_PIN, GPIO_PULLDOWN_ONLY);
+    bool bus = gpio_get_level(LINK_BUS_PIN);
+
+    // Both boards start here; link_rate_tx.c negotiates the rate up (aera_baud.h)
     const uart_config_t uart_config = {
-        .baud_rate = 115200,
+        .baud_rate = AERA_BAUD_BASE,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
     };
     uart_param_config(UART_PORT_NUM, &uart_config);
-    uart_set_pin(UART_PORT_NUM, TXD2_PIN, RXD2_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-    uart_driver_install(UART_PORT_NUM, 1024, 0, 0, NULL, 0);
-}
-
-void init_wifi_static_ip()
-{
-    s_wifi_event_group = xEventGroupCreate();
-
-    // Initialize networking stack
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-
-    // Create Default Wi-Fi Station
-    esp_netif_t *my_sta = esp_netif_create_default_wifi_sta();
-
-    // --- STATIC IP SETUP ---
-    // 1. Stop DHCP Client
-    ESP_ERROR_CHECK(esp_netif_dhcpc_stop(my_sta));
-
-    // 2. Set IP Info
-    esp_netif_ip_info_t ip_info;
-    esp_netif_str_to_ip4(STATIC_IP_ADDR, &ip_info.ip);
-    esp_netif_str_to_ip4(STATIC_GW_ADDR, &ip_info.gw);
-    esp_netif_str_to_ip4(STATIC_NM_ADDR, &ip_info.netmask);
-    ESP_ERROR_CHECK(esp_netif_set_ip_info(my_sta, &ip_info));
-
-    // 3. Set DNS (Google DNS)
-    esp_netif_dns_info_t dns_info;
-    esp_netif_str_to_ip4("8.8.8.8", &dns_info.ip.u_addr.ip4);
-    ESP_ERROR_CHECK(esp_netif_set_dns_info(my_sta, ESP_NETIF_DNS_MAIN, &dns_info));
-
-    // Standard Wi-Fi Init
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-
-    esp_event_handler_instance_t instance_any_id;
-    esp_event_handler_instance_t instance_got_ip;
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        ESP_EVENT_ANY_ID,
-                                                        &wifi_event_handler,
-                                                        NULL,
-                                                        &instance_any_id));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
-                                                        IP_EVENT_STA_GOT_IP,
-                                                        &wifi_event_handler,
-                                                        NULL,
-                                                        &instance_got_ip));
-
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = WIFI_SSID,
-            .password = WIFI_PASS,
-        },
-    };
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
+    // On the bus RTS drives the transceiver, on only while we send
+    if (bus)
+        uart_set_pin(UART_PORT_NUM, TXD2_PIN, RXD2_PIN, LINK_DE_PIN, UART_PIN_NO_CHANGE);
+    else
+        uart_set_pin(UART_PORT_NUM, TXD2_PIN, RXD2_PIN, RTS2_PIN, CTS2_PIN);
+    // The event queue wakes the RX task for ACKs; see uart_rx.h
+    uart_driver_install(UART_PORT_NUM, UART_RX_BUF_SIZE, 0, 10, &s_uart_queue, 0);
+    uart_set_rx_timeout(UART_PORT_NUM, 2);
+    // At a few Mbaud the 128-byte FIFO fills in a few hundred us; drain it
+    // at half
+    uart_set_rx_full_threshold(UART_PORT_NUM, 64);
+    if (bus)
+        uart_set_mode(UART_PORT_NUM, UART_MODE_RS485_HALF_DUPLEX);
+    return bus;
 }
 
 // --- TASK: LED STATUS ---
+// Sleeps on the event group. While connected it doesn't wake at all until
+// the link goes; while connecting it wakes to blink, and a connect cuts the
+// blink short.
 void status_led_task(void *pvParameters)
 {
     gpio_reset_pin(LED_PIN);
     gpio_set_direction(LED_PIN, GPIO_MODE_OUTPUT);
+    bool lit = false;
 
     while (1)
     {
@@ -245,21 +804,21 @@ void status_led_task(void *pvParameters)
         {
             // Connected: LED OFF (High logic or Low logic depending on your board, assuming LOW = OFF)
             gpio_set_level(LED_PIN, 0);
-            vTaskDelay(500 / portTICK_PERIOD_MS);
+            lit = false;
+            xEventGroupWaitBits(s_wifi_event_group, WIFI_DISCONNECTED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
         }
         else
         {
             // Connecting: Blink Fast (100ms)
-            gpio_set_level(LED_PIN, 1);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            gpio_set_level(LED_PIN, 0);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+            lit = !lit;
+            gpio_set_level(LED_PIN, lit);
+            xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(100));
         }
     }
 }
 
-// --- MAIN ---
-void app_main(void)
+// --- STARTUP ---
+static void init_nvs(void)
 {
     // Initialize NVS (Required for WiFi)
     esp_err_t ret = nvs_flash_init();
@@ -269,10 +828,66 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    boot_mark(BOOT_NVS);
+}
 
-    init_uart();
-    init_wifi_static_ip(); // This triggers the connection process
+// UART and everything that hangs off the bottom-board link
+static void start_link(void)
+{
+    aera_cmd_init();
+    bool bus = init_uart();
+    uart_tx_start(UART_PORT_NUM, LINK_RTS_CTS && !bus, bus, on_uart_command_done);
+    ws_broadcast_start();
+    history_init();
+    telemetry_init(uart_tx_default_node()); // Before RX: the first batch can arrive right away
+    sys_stats_init();
+    trace_dump_init();
+    ota_relay_init();
+    uart_rx_start(UART_PORT_NUM, s_uart_queue, on_link_frame);
+    boot_mark(BOOT_UART);
+}
+
+// --- MAIN ---
+void app_main(void)
+{
+    boot_trace_init();
+    aera_power_init(POWER_SAVE);
+    aera_dlog_init();
+    s_wifi_event_group = xEventGroupCreate();
+    xEventGroupSetBits(s_wifi_event_group, WIFI_DISCONNECTED_BIT);
+
+#if !BOOT_LINK_FIRST
+    init_nvs();
+#endif
+    start_link();
+
+    // One server, and one control socket, for the life of the firmware.
+    // They listen on any address, so they can start before there is one
+    // and outlive every reconnect. They only need the TCP/IP stack, and
+    // the control socket its key from NVS.
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    start_webserver();
+
+#if BOOT_LINK_FIRST
+    init_nvs();
+#endif
+#if UDP_CTRL
+    udp_ctrl_start(UDP_CTRL_PORT, on_udp_command);
+#endif
+    const wifi_conn_config_t wifi = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+        .ip = STATIC_IP_ADDR,
+        .gw = STATIC_GW_ADDR,
+        .netmask = STATIC_NM_ADDR,
+        .dns = STATIC_DNS_ADDR,
+        .listen_interval = POWER_SAVE ? WIFI_LISTEN_INTERVAL : 0,
+        .on_change = on_wifi_change,
+    };
+    wifi_conn_start(&wifi); // This triggers the connection process
+    boot_mark(BOOT_WIFI_START);
 
     // Create the LED task
     xTaskCreate(status_led_task, "led_task", 2048, NULL, 5, NULL);
-}
\ No newline at end of file
+}
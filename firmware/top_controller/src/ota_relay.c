@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "aera_cmd.h"
+#include "aera_power.h"
+#include "uart_tx.h"
+#include "ota_stream.h"
+#include "ota_relay.h"
+
+// How often a silent socket is retried before the upload is given up
+#define RECV_TIMEOUT_RETRIES    3
+
+static const char *TAG = "OTA_RELAY";
+
+// The bottom board being updated. Set on the OTA task before it asks
+// anything; the UART RX task only reads it.
+static uint8_t s_unit;
+
+// Requests handed over by the httpd task; one at a time
+static QueueHandle_t s_requests;
+static atomic_bool s_busy;
+
+// Guarded by s_lock: filled on the UART RX task, read on the OTA task
+static SemaphoreHandle_t s_lock;
+static SemaphoreHandle_t s_done;
+static uint8_t s_waiting_for;           // Opcode whose answer is wanted; 0 if none
+static aera_ota_status_t s_reply;
+static aera_ota_status_t s_last;        // Latest status of any kind, for errors
+
+
+void ota_relay_ingest(const aera_frame_t *frame)
+{
+    aera_ota_status_t st;
+    aera_ota_unpack_status(frame->payload, &st);
+
+    // Some other unit's, from an update to it that was given up on
+    if (frame->addr != s_unit)
+        return;
+
+    // Chunk answers drive the stream; the rest answer ask_bottom()
+    if (st.opcode == AERA_OP_OTA_DATA)
+        ota_stream_post_status(&st);
+
+    bool answered = false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_last = st;
+    if (st.opcode == s_waiting_for)
+    {
+        s_reply = st;
+        s_waiting_for = 0;
+        answered = true;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (answered)
+        xSemaphoreGive(s_done);
+}
+
+// Sends OTA_BEGIN or OTA_END and waits for the OTA_STATUS that answers it
+static bool ask_bottom(uint8_t opcode, const uint8_t *payload, uint8_t len, uint32_t wait_ms,
+                       aera_ota_status_t *out)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_waiting_for = opcode;
+    xSemaphoreGive(s_lock);
+    xSemaphoreTake(s_done, 0);
+
+    if (!uart_tx_enqueue(s_unit, opcode, payload, len, 0) || xSemaphoreTake(s_done, pdMS_TO_TICKS(wait_ms)) != pdTRUE)
+    {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_waiting_for = 0;
+        xSemaphoreGive(s_lock);
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_reply;
+    xSemaphoreGive(s_lock);
+    return true;
+}
+
+static aera_ota_status_t last_status(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    aera_ota_status_t st = s_last;
+    xSemaphoreGive(s_lock);
+    return st;
+}
+
+// Up to len bytes of the body; <= 0 once it is gone or the client is
+static int recv_some(httpd_req_t *req, uint8_t *buf, size_t len)
+{
+    for (int tries = 0; tries <= RECV_TIMEOUT_RETRIES; tries++)
+    {
+        int n = httpd_req_recv(req, (char *)buf, len);
+        if (n != HTTPD_SOCK_ERR_TIMEOUT)
+            return n;
+    }
+    return HTTPD_SOCK_ERR_TIMEOUT;
+}
+
+static bool recv_exact(httpd_req_t *req, uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        int n = recv_some(req, buf, len);
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static esp_err_t reply_failed(httpd_req_t *req, const char *reason, uint32_t at)
+{
+    char msg[64];
+    snprintf(msg, sizeof(msg), "OTA:failed,%s,at=%lu", reason, (unsigned long)at);
+    ESP_LOGW(TAG, "%s", msg);
+    return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, msg);
+}
+
+// Why the stream stopped: the bottom controller's last word if it gave up
+// on it (or lost it to a restart), else it just stopped answering
+static const char *link_failure(void)
+{
+    aera_ota_status_t st = last_status();
+    return st.state != AERA_OTA_RECEIVING ? aera_ota_error_name(st.error) : "link";
+}
+
+// The stream from `from` on, straight from the socket to the link. NULL
+// once the bottom controller has all of it, else why not.
+static const char *stream_body(httpd_req_t *req, uint8_t *buf, uint32_t from, uint32_t total)
+{
+    // The bottom controller already has this much: read past it
+    for (uint32_t left = from; left > 0;)
+    {
+        int n = recv_some(req, buf, left < OTA_RELAY_READ_BYTES ? left : OTA_RELAY_READ_BYTES);
+        if (n <= 0)
+            return "upload";
+        left -= (uint32_t)n;
+    }
+
+    for (uint32_t left = total - from; left > 0;)
+    {
+        int n = recv_some(req, buf, left < OTA_RELAY_READ_BYTES ? left : OTA_RELAY_READ_BYTES);
+        if (n <= 0)
+            return "upload";
+        if (!ota_stream_write(buf, (size_t)n))
+            return link_failure();
+        left -= (uint32_t)n;
+    }
+    return ota_stream_drain() ? NULL : link_failure();
+}
+
+static esp_err_t relay_update(httpd_req_t *req)
+{
+    // Only ever runs on the OTA task; keeps it off its stack
+    static uint8_t buf[OTA_RELAY_READ_BYTES];
+
+    bool reboot = true;
+    uint8_t unit = uart_tx_default_node();
+    char query[32];
+    char val[4];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK)
+    {
+        if (httpd_query_key_value(query, "reboot", val, sizeof(val)) == ESP_OK)
+            reboot = strcmp(val, "0") != 0;
+        if (httpd_query_key_value(query, "unit", val, sizeof(val)) == ESP_OK)
+        {
+            unsigned long v = strtoul(val, NULL, 10);
+            if (unit == AERA_LINK_ADDR_P2P || v < 1 || v > AERA_BUS_MAX_NODES)
+                return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "no such unit");
+            unit = (uint8_t)v;
+        }
+    }
+
+    aera_ota_header_t h;
+    if (req->content_len < AERA_OTA_HEADER_LEN || !recv_exact(req, buf, AERA_OTA_HEADER_LEN) ||
+        !aera_ota_parse_header(buf, &h))
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "not an .aota file");
+    if (req->content_len != AERA_OTA_HEADER_LEN + h.stream_len)
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "length doesn't match the .aota header");
+
+    aera_power_acquire(AERA_POWER_WS);
+    int64_t start_us = esp_timer_get_time();
+    s_unit = unit;
+    ESP_LOGI(TAG, "Update: %lu byte image in %lu bytes", (unsigned long)h.image_len, (unsigned long)h.stream_len);
+
+    // The bottom controller says where to start: 0, or how far an earlier
+    // upload of this file got, or the end if it already has all of it
+    uint8_t begin[AERA_OTA_BEGIN_PAYLOAD_LEN];
+    aera_ota_pack_begin(begin, &h);
+    aera_ota_status_t st;
+    if (!ask_bottom(AERA_OP_OTA_BEGIN, begin, sizeof(begin), OTA_RELAY_REPLY_WAIT_MS, &st))
+    {
+        aera_power_release(AERA_POWER_WS);
+        return reply_failed(req, "no_answer", 0);
+    }
+    if (st.state != AERA_OTA_RECEIVING && st.state != AERA_OTA_DONE)
+    {
+        aera_power_release(AERA_POWER_WS);
+        return reply_failed(req, aera_ota_error_name(st.error), st.offset);
+    }
+    uint32_t from = st.state == AERA_OTA_DONE ? h.stream_len : st.offset;
+    if (from > 0)
+        ESP_LOGI(TAG, "Resuming at %lu", (unsigned long)from);
+
+    ota_stream_stats_t stats;
+    ota_stream_open(unit, from, h.stream_len);
+    const char *failed = stream_body(req, buf, from, h.stream_len);
+    ota_stream_close(&stats);
+
+    if (failed != NULL)
+    {
+        aera_power_release(AERA_POWER_WS);
+        return reply_failed(req, failed, last_status().offset);
+    }
+
+    uint8_t end = reboot;
+    bool answered = ask_bottom(AERA_OP_OTA_END, &end, sizeof(end), OTA_RELAY_END_WAIT_MS, &st);
+    aera_power_release(AERA_POWER_WS);
+    if (!answered)
+        return reply_failed(req, "no_answer", h.stream_len);
+    if (st.state != AERA_OTA_DONE)
+        return reply_failed(req, aera_ota_error_name(st.error), st.offset);
+
+    char msg[160];
+    int n = snprintf(msg, sizeof(msg),
+                     "OTA:done,image=%lu,stream=%lu,from=%lu,ms=%lu,chunks=%lu,resent=%lu,gaps=%lu,busy=%lu,stalls=%lu",
+                     (unsigned long)h.image_len, (unsigned long)h.stream_len, (unsigned long)from,
+                     (unsigned long)((esp_timer_get_time() - start_us) / 1000), (unsigned long)stats.chunks,
+                     (unsigned long)stats.resent, (unsigned long)stats.gaps, (unsigned long)stats.busy,
+                     (unsigned long)stats.stalls);
+    ESP_LOGI(TAG, "%s", msg);
+    httpd_resp_set_type(req, "text/plain");
+    return httpd_resp_send(req, msg, n);
+}
+
+// --- TASK ---
+static void ota_relay_task(void *arg)
+{
+    httpd_req_t *req;
+    while (1)
+    {
+        xQueueReceive(s_requests, &req, portMAX_DELAY);
+        relay_update(req);
+        httpd_req_async_handler_complete(req);
+        atomic_store(&s_busy, false);
+    }
+}
+
+void ota_relay_init(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    s_done = xSemaphoreCreateBinary();
+    s_requests = xQueueCreate(1, sizeof(httpd_req_t *));
+    xTaskCreatePinnedToCore(ota_relay_task, "ota_relay_task", OTA_RELAY_TASK_STACK, NULL, OTA_RELAY_TASK_PRIO,
+                            NULL, OTA_RELAY_TASK_CORE);
+}
+
+// Hands the request to the OTA task and returns, so the server goes on
+// serving everyone else for the length of the update
+esp_err_t ota_relay_http_handler(httpd_req_t *req)
+{
+    bool idle = false;
+    if (!atomic_compare_exchange_strong(&s_busy, &idle, true))
+        return reply_failed(req, "busy", 0);
+
+    httpd_req_t *async = NULL;
+    if (httpd_req_async_handler_begin(req, &async) != ESP_OK)
+    {
+        atomic_store(&s_busy, false);
+        return reply_failed(req, "no_memory", 0);
+    }
+    xQueueSend(s_requests, &async, portMAX_DELAY); // Empty while idle
+    return ESP_OK;
+}
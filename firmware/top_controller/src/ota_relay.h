@@ -0,0 +1,47 @@
+#pragma once
+
+#include "esp_http_server.h"
+#include "aera_link.h"
+#include "aera_ota.h"
+
+// --- BOTTOM CONTROLLER UPDATES ---
+//
+// POST /ota/bottom with an .aota file (aera_ota.h, tools/ota_pack.py) as the
+// body:
+//
+//   curl --data-binary @bottom.aota http://192.168.18.200:81/ota/bottom
+//
+// The file is read off the socket OTA_RELAY_READ_BYTES at a time and
+// streamed over the link (ota_stream.h), so the top controller never holds
+// more than its OTA ring of it. The bottom controller writes it to its
+// inactive slot and boots it, unless the URL has ?reboot=0. With bottom
+// controllers on a bus, ?unit=<address> picks the one (aera_bus.h);
+// without it the default one is updated. The reply:
+//
+//   OTA:done,image=<bytes>,stream=<bytes>,from=<offset>,ms=<ms>,chunks=<n>,resent=<n>,gaps=<n>,busy=<n>,stalls=<n>
+//   OTA:failed,<reason>,at=<offset>          (HTTP 500)
+//
+// from is where the stream started: POSTing the same file again after a
+// dropped upload picks up where the bottom controller got to, as long as it
+// hasn't restarted since, and the part it already has is read and skipped.
+//
+// The handler hands the request to ota_relay_task and returns
+// (httpd_req_async_handler_begin()), so WebSocket clients are served, and
+// kept alive, for the length of an update: about 15 s for a 256 KB image
+// LZSS-packed at 115200 baud, 27 s stored, 5 s at 460800. One update at a
+// time; a POST while one runs gets OTA:failed,busy.
+
+#define OTA_RELAY_READ_BYTES        512
+#define OTA_RELAY_TASK_CORE         0
+#define OTA_RELAY_TASK_PRIO         4       // Below httpd's, so commands go first
+#define OTA_RELAY_TASK_STACK        4096
+#define OTA_RELAY_REPLY_WAIT_MS     1000    // OTA_BEGIN's answer
+#define OTA_RELAY_END_WAIT_MS       5000    // OTA_END's: checks the whole image
+
+void ota_relay_init(void);
+
+// POST handler for /ota/bottom
+esp_err_t ota_relay_http_handler(httpd_req_t *req);
+
+// Called from the UART RX task with an OTA_STATUS frame
+void ota_relay_ingest(const aera_frame_t *frame);
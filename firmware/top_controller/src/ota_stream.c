@@ -0,0 +1,270 @@
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "aera_cmd.h"
+#include "aera_dlog.h"
+#include "bus_sched.h"
+#include "uart_tx_priv.h"
+#include "ota_stream.h"
+
+#define OTA_MASK (OTA_STREAM_RING - 1)
+#define OTA_TIMEOUT_US ((int64_t)OTA_STREAM_TIMEOUT_MS * 1000)
+#define OTA_BUSY_US ((int64_t)OTA_STREAM_BUSY_MS * 1000)
+
+_Static_assert((OTA_STREAM_RING & OTA_MASK) == 0, "OTA_STREAM_RING must be a power of two");
+_Static_assert(OTA_STREAM_RING >= AERA_OTA_WINDOW_CHUNKS, "The OTA ring must hold a whole window");
+
+// Chunk i of the stream starts at first + i * AERA_OTA_CHUNK. The writer
+// publishes chunks by moving filled, the TX task frees them by moving acked,
+// with release/acquire as in the command ring. The RX task only ever raises
+// reported and sets flags.
+enum
+{
+    OTA_FLAG_GAP = 1,
+    OTA_FLAG_BUSY = 2,
+};
+
+static struct
+{
+    uint8_t data[OTA_STREAM_RING][AERA_OTA_CHUNK];
+    uint32_t first;
+    uint32_t total;
+    uint8_t node;
+    atomic_uint gen;            // Bumped by every open
+    atomic_bool open;
+    atomic_bool failed;
+    atomic_uint filled;
+    atomic_uint acked;
+    atomic_uint reported;       // Furthest offset the bottom controller has
+    atomic_uint flags;
+
+    // Writer only
+    uint32_t written;           // Stream offset of the next byte written
+    size_t partial;             // Bytes in chunk `filled` so far
+} s_ota;
+static SemaphoreHandle_t s_room; // Chunks freed, or the stream failed
+
+// TX task only
+typedef struct
+{
+    unsigned gen;
+    unsigned sent;              // Next chunk to send
+    unsigned high;              // First chunk never sent, for counting resends
+    int64_t deadline_us;        // No progress by then: go back
+    int64_t hold_until_us;      // Bottom controller busy: nothing until then
+    uint32_t stalls;            // Timeouts in a row
+    ota_stream_stats_t stats;
+} ota_tx_t;
+static ota_tx_t s_tx;
+
+static unsigned chunks_upto(uint32_t offset)
+{
+    if (offset >= s_ota.total)
+        return (s_ota.total - s_ota.first + AERA_OTA_CHUNK - 1) / AERA_OTA_CHUNK;
+    return offset > s_ota.first ? (offset - s_ota.first) / AERA_OTA_CHUNK : 0;
+}
+
+static void fail(void)
+{
+    atomic_store(&s_ota.failed, true);
+    xSemaphoreGive(s_room);
+}
+
+// --- WRITER ---
+
+void ota_stream_open(uint8_t node, uint32_t offset, uint32_t total)
+{
+    s_ota.node = node;
+    s_ota.first = offset;
+    s_ota.total = total;
+    s_ota.written = offset;
+    s_ota.partial = 0;
+    atomic_store(&s_ota.filled, 0);
+    atomic_store(&s_ota.acked, 0);
+    atomic_store(&s_ota.reported, offset);
+    atomic_store(&s_ota.flags, 0);
+    atomic_store(&s_ota.failed, false);
+    xSemaphoreTake(s_room, 0);
+    atomic_fetch_add(&s_ota.gen, 1);
+    atomic_store_explicit(&s_ota.open, true, memory_order_release);
+}
+
+bool ota_stream_write(const uint8_t *data, size_t len)
+{
+    if (len > s_ota.total - s_ota.written)
+        return false;
+
+    while (len > 0)
+    {
+        if (atomic_load(&s_ota.failed))
+            return false;
+
+        unsigned filled = atomic_load_explicit(&s_ota.filled, memory_order_relaxed);
+        unsigned acked = atomic_load_explicit(&s_ota.acked, memory_order_acquire);
+        if (filled - acked >= OTA_STREAM_RING)
+        {
+            // The TX task gives it back as chunks are freed, and times out
+            // the stream itself if they never are
+            xSemaphoreTake(s_room, pdMS_TO_TICKS(OTA_STREAM_TIMEOUT_MS));
+            continue;
+        }
+
+        size_t n = AERA_OTA_CHUNK - s_ota.partial;
+        if (n > len)
+            n = len;
+        memcpy(&s_ota.data[filled & OTA_MASK][s_ota.partial], data, n);
+        s_ota.partial += n;
+        s_ota.written += n;
+        data += n;
+        len -= n;
+
+        // Only the stream's last chunk goes out short
+        if (s_ota.partial == AERA_OTA_CHUNK || s_ota.written == s_ota.total)
+        {
+            s_ota.partial = 0;
+            atomic_store_explicit(&s_ota.filled, filled + 1, memory_order_release);
+            uart_tx_wake();
+        }
+    }
+    return true;
+}
+
+bool ota_stream_drain(void)
+{
+    unsigned all = chunks_upto(s_ota.total);
+    while (!atomic_load(&s_ota.failed))
+    {
+        if (atomic_load_explicit(&s_ota.acked, memory_order_acquire) == all)
+            return true;
+        xSemaphoreTake(s_room, pdMS_TO_TICKS(OTA_STREAM_TIMEOUT_MS));
+    }
+    return false;
+}
+
+void ota_stream_close(ota_stream_stats_t *out)
+{
+    atomic_store(&s_ota.open, false);
+    // Plain copy, as for the latency histograms; the TX task is done with
+    // them. If it never got to this stream (nothing left to send), they are
+    // still the last one's.
+    if (s_tx.gen == atomic_load(&s_ota.gen))
+        *out = s_tx.stats;
+    else
+        *out = (ota_stream_stats_t){0};
+}
+
+void ota_stream_post_status(const aera_ota_status_t *status)
+{
+    // Statuses can be overtaken by resends, but the offset never goes back
+    unsigned prev = atomic_load(&s_ota.reported);
+    while (status->offset > prev && !atomic_compare_exchange_weak(&s_ota.reported, &prev, status->offset))
+    {
+    }
+
+    if (status->error == AERA_OTA_ERR_GAP)
+        atomic_fetch_or(&s_ota.flags, OTA_FLAG_GAP);
+    else if (status->error == AERA_OTA_ERR_BUSY)
+        atomic_fetch_or(&s_ota.flags, OTA_FLAG_BUSY);
+    // Failed, or restarted and knows nothing of the stream
+    if (status->state != AERA_OTA_RECEIVING)
+        fail();
+    uart_tx_wake();
+}
+
+// --- TX TASK ---
+
+void ota_stream_init(void)
+{
+    s_room = xSemaphoreCreateBinary();
+}
+
+bool ota_stream_active(void)
+{
+    return atomic_load(&s_ota.open);
+}
+
+static void send_chunk(unsigned i)
+{
+    uint8_t payload[AERA_OTA_DATA_PAYLOAD_LEN];
+    uint32_t offset = s_ota.first + i * AERA_OTA_CHUNK;
+    uint32_t len = s_ota.total - offset < AERA_OTA_CHUNK ? s_ota.total - offset : AERA_OTA_CHUNK;
+
+    aera_ota_pack_data(payload, offset, s_ota.data[i & OTA_MASK], (uint8_t)len);
+    uart_tx_batch_add(s_ota.node, AERA_OP_OTA_DATA, uart_tx_next_seq(s_ota.node), payload, sizeof(payload));
+    s_tx.stats.chunks++;
+    if (i < s_tx.high)
+        s_tx.stats.resent++;
+    else
+        s_tx.high = i + 1;
+}
+
+// Goes after commands in each round, so an update never holds one up by
+// more than the batch already on the wire
+void ota_stream_service(int64_t now)
+{
+    if (!atomic_load_explicit(&s_ota.open, memory_order_acquire) || atomic_load(&s_ota.failed))
+        return;
+    unsigned gen = atomic_load(&s_ota.gen);
+    if (gen != s_tx.gen)
+        s_tx = (ota_tx_t){.gen = gen};
+
+    unsigned acked = atomic_load_explicit(&s_ota.acked, memory_order_relaxed);
+    unsigned reached = chunks_upto(atomic_load(&s_ota.reported));
+    if (reached > acked)
+    {
+        acked = reached;
+        atomic_store_explicit(&s_ota.acked, acked, memory_order_release);
+        xSemaphoreGive(s_room);
+        s_tx.stalls = 0;
+        s_tx.deadline_us = now + OTA_TIMEOUT_US;
+    }
+    if (s_tx.sent < acked)
+        s_tx.sent = acked;
+
+    unsigned flags = atomic_exchange(&s_ota.flags, 0);
+    if (flags & OTA_FLAG_GAP)
+    {
+        s_tx.stats.gaps++;
+        s_tx.sent = acked;
+    }
+    if (flags & OTA_FLAG_BUSY)
+    {
+        s_tx.stats.busy++;
+        s_tx.sent = acked;
+        s_tx.hold_until_us = now + OTA_BUSY_US;
+    }
+    if (s_tx.sent > acked && now >= s_tx.deadline_us)
+    {
+        if (++s_tx.stalls > OTA_STREAM_MAX_STALLS)
+        {
+            AERA_DLOG(TX_OTA_STALLED, s_ota.first + acked * AERA_OTA_CHUNK);
+            fail();
+            return;
+        }
+        s_tx.stats.stalls++;
+        s_tx.sent = acked;
+    }
+    if (now < s_tx.hold_until_us || !bus_sched_open(s_ota.node, now))
+        return;
+
+    unsigned filled = atomic_load_explicit(&s_ota.filled, memory_order_acquire);
+    while (s_tx.sent != filled && s_tx.sent - acked < AERA_OTA_WINDOW_CHUNKS)
+    {
+        if (s_tx.sent == acked)
+            s_tx.deadline_us = now + OTA_TIMEOUT_US;
+        send_chunk(s_tx.sent++);
+    }
+}
+
+// When ota_stream_service() next has something to do on its own
+int64_t ota_stream_next_us(void)
+{
+    if (!atomic_load(&s_ota.open) || atomic_load(&s_ota.failed))
+        return INT64_MAX;
+    if (s_tx.hold_until_us > esp_timer_get_time())
+        return s_tx.hold_until_us;
+    unsigned acked = atomic_load_explicit(&s_ota.acked, memory_order_relaxed);
+    return s_tx.sent != acked ? s_tx.deadline_us : INT64_MAX;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "aera_ota.h"
+
+// --- OTA STREAM ---
+//
+// A bottom controller update (ota_relay.h) shares the link with commands.
+// The httpd side fills a ring of OTA_STREAM_RING chunks; between commands
+// the UART TX task sends them as OTA_DATA. The bottom controller's
+// OTA_STATUS frames free ring slots, and everything after what it has is
+// resent (go-back-N, aera_ota.h) on a gap, after OTA_STREAM_BUSY_MS when
+// it is busy, or after OTA_STREAM_TIMEOUT_MS without progress.
+// OTA_STREAM_MAX_STALLS timeouts in a row fail it.
+
+#define OTA_STREAM_RING         32  // Chunks, a power of two
+#define OTA_STREAM_TIMEOUT_MS   200
+#define OTA_STREAM_BUSY_MS      10
+#define OTA_STREAM_MAX_STALLS   25
+
+typedef struct
+{
+    uint32_t chunks;       // OTA_DATA frames written, resends included
+    uint32_t resent;       // Of those, chunks sent again
+    uint32_t gaps;         // Go-backs the bottom controller asked for
+    uint32_t busy;         // ... and pauses it asked for
+    uint32_t stalls;       // Timeouts without progress
+} ota_stream_stats_t;
+
+// One stream at a time, from one task. node is the bottom controller it is
+// for, offset the stream offset of the first byte written, total where the
+// stream ends.
+void ota_stream_open(uint8_t node, uint32_t offset, uint32_t total);
+
+// Waits while the ring is full. False once the stream has failed.
+bool ota_stream_write(const uint8_t *data, size_t len);
+
+// Waits until the bottom controller has the whole stream; false if it failed
+bool ota_stream_drain(void);
+
+void ota_stream_close(ota_stream_stats_t *out);
+
+// An OTA_STATUS answering OTA_DATA, from the UART RX task. Never blocks.
+void ota_stream_post_status(const aera_ota_status_t *status);
+
+// uart_tx.c only: init from uart_tx_start(), the rest on the TX task
+void ota_stream_init(void);
+bool ota_stream_active(void);
+void ota_stream_service(int64_t now);
+int64_t ota_stream_next_us(void);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// --- SIPHASH ---
+//
+// SipHash-2-4 (Aumasson and Bernstein): a 64-bit MAC, cheap enough for
+// every datagram (udp_ctrl.h). out is the hash little-endian, as the
+// reference implementation writes it.
+
+#define SIPHASH_KEY_LEN     16
+#define SIPHASH_OUT_LEN     8
+
+void siphash24(const uint8_t key[SIPHASH_KEY_LEN], const uint8_t *data, size_t len,
+               uint8_t out[SIPHASH_OUT_LEN]);
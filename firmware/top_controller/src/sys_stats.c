@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "ws_broadcast.h"
+#include "sys_stats.h"
+
+_Static_assert(sizeof(((aera_task_stats_t *)0)->name) > AERA_SYS_NAME_LEN, "SYS task names don't fit aera_task_stats_t");
+
+#define WAIT_US ((int64_t)SYS_STATS_BOTTOM_WAIT_MS * 1000)
+
+// Guarded by s_lock: filled on the UART RX task, answered from there or the
+// timer
+static SemaphoreHandle_t s_lock;
+static esp_timer_handle_t s_timer;
+static sys_stats_bottom_t s_bottom;
+static int s_expected = -1;     // Task frames still to come; -1 before a summary
+static uint8_t s_from;          // The bottom board asked
+static bool s_pending;          // A client is waiting for the reply
+static httpd_handle_t s_server; // Which one
+static int s_fd;
+static int64_t s_deadline_us;
+static char s_text[SYS_STATS_TEXT_MAX];    // This board's part, then the bottom's
+static int s_len;
+
+// The pending client gets its reply, with the bottom board's part or
+// b=none. Whichever of the last SYS frame, the timeout and a newer STATS
+// comes first sends it; the others find nothing pending.
+static void reply_locked(bool have)
+{
+    const size_t cap = sizeof(s_text);
+    int n = s_len;
+    if (!have)
+    {
+        if (n < (int)cap)
+            n += snprintf(s_text + n, cap - n, ",b=none");
+    }
+    else if (n < (int)cap)
+    {
+        const aera_sys_summary_t *b = &s_bottom.sys;
+        int tasks = s_bottom.task_count < AERA_STATS_MAX_TASKS ? s_bottom.task_count : AERA_STATS_MAX_TASKS;
+        n += snprintf(s_text + n, cap - n,
+                      ",b.heap=%lu/%lu/%lu,b.uart_in=%lu,b.uart_out=%lu,b.frames=%lu,"
+                      "b.unknown=%u,b.seq_gaps=%u,b.crc=%u,b.overflows=%u",
+                      (unsigned long)b->heap_free, (unsigned long)b->heap_min, (unsigned long)b->heap_largest,
+                      (unsigned long)b->uart_in, (unsigned long)b->uart_out, (unsigned long)b->frames_in,
+                      b->unknown, b->seq_gaps, b->crc_errors, b->overflows);
+        if (n < (int)cap)
+            n += sys_stats_format_tasks(s_text + n, cap - n, "b.", s_bottom.tasks, tasks);
+    }
+    s_pending = false;
+    ws_broadcast_reply_later(s_server, s_fd, s_text, n < (int)cap ? n : (int)cap - 1);
+}
+
+static void on_timeout(void *arg)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // Not a late expiry of a timer since restarted for a newer STATS
+    if (s_pending && esp_timer_get_time() >= s_deadline_us)
+        reply_locked(false);
+    xSemaphoreGive(s_lock);
+}
+
+void sys_stats_init(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    const esp_timer_create_args_t args = {.callback = on_timeout, .name = "sys_stats"};
+    esp_timer_create(&args, &s_timer);
+}
+
+void sys_stats_ingest(const aera_frame_t *frame)
+{
+    aera_sys_summary_t sum;
+    aera_sys_task_t task;
+    int kind = aera_sys_unpack(frame->payload, &sum, &task);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool complete = false;
+    if (frame->addr != s_from)
+        kind = -1;
+    if (kind == AERA_SYS_SUMMARY)
+    {
+        s_bottom.sys = sum;
+        s_bottom.task_count = 0;
+        s_expected = sum.tasks;
+        complete = s_expected == 0;
+    }
+    else if (kind == AERA_SYS_TASK && s_expected > 0 && task.index == s_bottom.task_count)
+    {
+        // In order or not at all: a frame lost on the way leaves the answer
+        // incomplete rather than wrong
+        if (s_bottom.task_count < AERA_STATS_MAX_TASKS)
+        {
+            aera_task_stats_t *t = &s_bottom.tasks[s_bottom.task_count];
+            memcpy(t->name, task.name, sizeof(task.name));
+            t->prio = task.prio;
+            t->cpu_permille = task.cpu_permille;
+            t->stack_free = task.stack_free;
+        }
+        s_bottom.task_count++;
+        complete = --s_expected == 0;
+    }
+    if (complete)
+    {
+        s_expected = -1;
+        if (s_pending)
+            reply_locked(true);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void sys_stats_expect(httpd_req_t *req, uint8_t unit, const char *top, size_t len)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_pending)
+        reply_locked(false);
+    if (len > sizeof(s_text) - 1)
+        len = sizeof(s_text) - 1;
+    memcpy(s_text, top, len);
+    s_len = (int)len;
+    s_pending = true;
+    s_server = req->handle;
+    s_fd = httpd_req_to_sockfd(req);
+    s_expected = -1;
+    s_from = unit;
+    s_deadline_us = esp_timer_get_time() + WAIT_US;
+    xSemaphoreGive(s_lock);
+
+    esp_timer_stop(s_timer);
+    esp_timer_start_once(s_timer, WAIT_US);
+}
+
+int sys_stats_format_tasks(char *buf, size_t cap, const char *prefix, const aera_task_stats_t *tasks, int n)
+{
+    int len = 0;
+    for (int i = 0; i < n && (size_t)len < cap; i++)
+    {
+        len += snprintf(buf + len, cap - len, ",%stask.%s=%u/%lu", prefix, tasks[i].name,
+                        tasks[i].cpu_permille, (unsigned long)tasks[i].stack_free);
+    }
+    return len < (int)cap ? len : (int)cap - 1;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_http_server.h"
+#include "aera_link.h"
+#include "aera_sys.h"
+#include "aera_stats.h"
+
+// --- SYSTEM STATS ---
+//
+// STATS reports both boards. This board's tasks and heap come from
+// aera_stats; the bottom controller's arrive as SYS frames (aera_sys.h)
+// after it ACKs the forwarded STATS. The handler formats this board's part
+// and hands it here; the bottom board's is appended once its last SYS frame
+// comes in, or b=none if it doesn't within SYS_STATS_BOTTOM_WAIT_MS or
+// another STATS comes first, and the reply is sent to the client that asked
+// (ws_broadcast_reply_later()), so httpd never waits on the link.
+//
+// Tasks go into the STATS reply as task.<name>=<CPU per mille>/<stack
+// bytes never used>, the bottom board's with a "b." in front.
+
+#define SYS_STATS_BOTTOM_WAIT_MS    250
+#define SYS_STATS_TEXT_MAX          2048
+
+typedef struct
+{
+    aera_sys_summary_t sys;
+    aera_task_stats_t tasks[AERA_STATS_MAX_TASKS];
+    int task_count;
+} sys_stats_bottom_t;
+
+void sys_stats_init(void);
+
+// Called from the UART RX task with a SYS frame
+void sys_stats_ingest(const aera_frame_t *frame);
+
+// Call before forwarding STATS to unit (aera_link.h), with this board's
+// part of the reply (copied): the whole reply goes to the WebSocket client
+// behind req, and SYS frames from any other unit are ignored. A client still
+// waiting on an earlier STATS is answered b=none now.
+void sys_stats_expect(httpd_req_t *req, uint8_t unit, const char *top, size_t len);
+
+// Writes ",<prefix>task.<name>=<cpu>/<stack>" per task into buf, stopping
+// once it is full. Returns the length written, at most cap - 1.
+int sys_stats_format_tasks(char *buf, size_t cap, const char *prefix, const aera_task_stats_t *tasks, int n);
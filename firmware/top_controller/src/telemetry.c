@@ -0,0 +1,192 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "aera_dlog.h"
+#include "ws_broadcast.h"
+#include "history.h"
+#include "telemetry.h"
+
+#define MAX_SUBS WS_BCAST_MAX_CLIENTS
+#define UNITS (AERA_BUS_MAX_NODES + 1) // By address; 0 is a point-to-point link
+
+_Static_assert(TELEM_WS_MAX_FRAME <= WS_BCAST_MAX_MSG, "A full batch must fit in one broadcast message");
+
+typedef struct
+{
+    int fd;                 // -1 when the slot is free
+    uint8_t unit;
+    uint16_t period;        // Source samples per output sample
+    uint16_t n;             // Samples in the current window
+    int32_t sum[AERA_TELEM_CHANNELS];
+} telem_sub_t;
+
+static const char *TAG = "TELEMETRY";
+
+// Guarded by s_lock: subscriptions change on the httpd task, batches come
+// in on the UART RX task
+static SemaphoreHandle_t s_lock;
+static telem_sub_t s_subs[MAX_SUBS];
+static telemetry_stats_t s_stats;
+static uint16_t s_next_index[UNITS];
+static bool s_have_index[UNITS];
+static uint8_t s_history_unit;
+
+static telem_sub_t *find_sub(int fd)
+{
+    for (int i = 0; i < MAX_SUBS; i++)
+    {
+        if (s_subs[i].fd == fd)
+            return &s_subs[i];
+    }
+    return NULL;
+}
+
+static void put_i16(uint8_t *p, int32_t v)
+{
+    p[0] = (uint8_t)((uint16_t)v >> 8);
+    p[1] = (uint8_t)((uint16_t)v & 0xFF);
+}
+
+void telemetry_init(uint8_t history_unit)
+{
+    s_history_unit = history_unit;
+    s_lock = xSemaphoreCreateMutex();
+    for (int i = 0; i < MAX_SUBS; i++)
+        s_subs[i].fd = -1;
+}
+
+void telemetry_ingest(const aera_frame_t *frame)
+{
+    aera_telem_sample_t samples[AERA_TELEM_BATCH];
+    uint16_t first;
+    uint8_t count = aera_telem_unpack(frame->payload, &first, samples);
+    uint8_t unit = frame->addr;
+    if (count == 0 || unit >= UNITS)
+    {
+        AERA_DLOG(TM_MALFORMED, frame->seq);
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.batches++;
+    s_stats.samples += count;
+
+    // A lost frame would merge two stretches of time into one window
+    bool gap = s_have_index[unit] && first != s_next_index[unit];
+    uint16_t lost = gap ? (uint16_t)(first - s_next_index[unit]) : 0;
+    s_stats.lost += lost;
+    s_next_index[unit] = (uint16_t)(first + count);
+    s_have_index[unit] = true;
+
+    for (int i = 0; i < MAX_SUBS; i++)
+    {
+        telem_sub_t *sub = &s_subs[i];
+        if (sub->fd < 0 || sub->unit != unit)
+            continue;
+        if (gap)
+        {
+            sub->n = 0;
+            memset(sub->sum, 0, sizeof(sub->sum));
+        }
+
+        uint8_t out[TELEM_WS_MAX_FRAME];
+        uint8_t n_out = 0;
+        uint16_t out_first = 0;
+
+        for (uint8_t k = 0; k < count; k++)
+        {
+            for (int c = 0; c < AERA_TELEM_CHANNELS; c++)
+                sub->sum[c] += samples[k].ch[c];
+            if (++sub->n < sub->period)
+                continue;
+
+            uint8_t *p = out + TELEM_WS_HEADER_LEN + n_out * TELEM_WS_SAMPLE_LEN;
+            for (int c = 0; c < AERA_TELEM_CHANNELS; c++)
+                put_i16(p + 2 * c, sub->sum[c] / (int32_t)sub->period);
+            if (n_out == 0)
+                out_first = (uint16_t)(first + k);
+            n_out++;
+
+            sub->n = 0;
+            memset(sub->sum, 0, sizeof(sub->sum));
+        }
+
+        if (n_out == 0)
+            continue;
+
+        uint16_t interval_ms = sub->period * AERA_TELEM_PERIOD_MS;
+        out[0] = TELEM_WS_MAGIC;
+        out[1] = n_out;
+        out[2] = (uint8_t)(interval_ms >> 8);
+        out[3] = (uint8_t)(interval_ms & 0xFF);
+        out[4] = (uint8_t)(out_first >> 8);
+        out[5] = (uint8_t)(out_first & 0xFF);
+        ws_broadcast_send_binary(sub->fd, WS_TOPIC_TELEMETRY, out,
+                                 TELEM_WS_HEADER_LEN + n_out * TELEM_WS_SAMPLE_LEN);
+        s_stats.frames++;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (unit == s_history_unit)
+        history_add(samples, count, lost);
+}
+
+uint32_t telemetry_subscribe(int sockfd, uint8_t unit, uint32_t hz)
+{
+    if (hz == 0)
+    {
+        telemetry_unsubscribe(sockfd);
+        return 0;
+    }
+
+    uint32_t period = (TELEM_SOURCE_HZ + hz / 2) / hz;
+    if (period == 0)
+        period = 1;
+    if (period > UINT16_MAX / AERA_TELEM_PERIOD_MS)
+        period = UINT16_MAX / AERA_TELEM_PERIOD_MS;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    telem_sub_t *sub = find_sub(sockfd);
+    if (sub == NULL)
+    {
+        sub = find_sub(-1);
+        if (sub != NULL)
+            s_stats.subscribers++;
+    }
+    if (sub != NULL)
+    {
+        sub->fd = sockfd;
+        sub->unit = unit;
+        sub->period = (uint16_t)period;
+        sub->n = 0;
+        memset(sub->sum, 0, sizeof(sub->sum));
+    }
+    xSemaphoreGive(s_lock);
+
+    if (sub == NULL)
+    {
+        ESP_LOGW(TAG, "No room to subscribe fd %d", sockfd);
+        return 0;
+    }
+    return period * AERA_TELEM_PERIOD_MS;
+}
+
+void telemetry_unsubscribe(int sockfd)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    telem_sub_t *sub = find_sub(sockfd);
+    if (sub != NULL)
+    {
+        sub->fd = -1;
+        s_stats.subscribers--;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void telemetry_get_stats(telemetry_stats_t *out)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_stats;
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include "aera_link.h"
+#include "aera_telem.h"
+#include "aera_bus.h"
+
+// --- TELEMETRY STREAM ---
+//
+// TELEMETRY batches from the bottom controller are unpacked, decimated to
+// each subscriber's rate and queued as one binary WebSocket frame per client
+// per batch. Decimation averages each window rather than picking a sample,
+// so a slow subscriber still sees a mean, not an alias. Every sample also
+// goes into the history tiers (history.h).
+//
+// With bottom controllers on a bus (aera_bus.h) each subscription is to
+// one unit, and only one unit's samples go into the history.
+//
+// WebSocket frame (big-endian, like the link):
+//
+//   ['T'][count][interval ms, u16][index of the first sample, u16]
+//   count x [one i16 per channel, aera_telem.h order and units]
+//
+// A sample's index is that of the last source sample in its window, so gaps
+// show up as jumps larger than the interval.
+
+#define TELEM_WS_MAGIC          'T'
+#define TELEM_WS_HEADER_LEN     6
+#define TELEM_WS_SAMPLE_LEN     (2 * AERA_TELEM_CHANNELS)
+#define TELEM_WS_MAX_FRAME      (TELEM_WS_HEADER_LEN + AERA_TELEM_BATCH * TELEM_WS_SAMPLE_LEN)
+#define TELEM_SOURCE_HZ         (1000 / AERA_TELEM_PERIOD_MS)
+
+typedef struct
+{
+    uint32_t batches;       // TELEMETRY frames taken in
+    uint32_t samples;
+    uint32_t lost;          // Samples missing between batches
+    uint32_t subscribers;
+    uint32_t frames;        // WebSocket frames queued
+} telemetry_stats_t;
+
+// history_unit: the bottom controller whose samples go into the history
+void telemetry_init(uint8_t history_unit);
+
+// Called from the UART RX task with a TELEMETRY frame
+void telemetry_ingest(const aera_frame_t *frame);
+
+// Subscribes a WebSocket session to unit's samples at about hz a second, or
+// unsubscribes it when hz is 0. The rate is rounded to a whole number of
+// source samples per window; returns the interval granted in ms, 0 if none.
+uint32_t telemetry_subscribe(int sockfd, uint8_t unit, uint32_t hz);
+void telemetry_unsubscribe(int sockfd);
+
+void telemetry_get_stats(telemetry_stats_t *out);
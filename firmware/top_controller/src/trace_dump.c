@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "ws_broadcast.h"
+#include "trace_dump.h"
+
+#define WAIT_US ((int64_t)TRACE_DUMP_BOTTOM_WAIT_MS * 1000)
+
+// Guarded by s_lock: filled on the UART RX task, answered from there or the
+// timer
+static SemaphoreHandle_t s_lock;
+static esp_timer_handle_t s_timer;
+static trace_dump_t s_bottom;
+static int s_next_part = -1;    // Part expected next; -1 before part 0
+static uint8_t s_from;          // The bottom board asked
+static bool s_pending;          // A client is waiting for the bottom reply
+static httpd_handle_t s_server; // Which one
+static int s_fd;
+static int64_t s_deadline_us;
+static char s_text[TRACE_DUMP_TEXT_MAX];
+
+// The pending client gets the bottom board's ring, or none. Whichever of
+// the ring, the timeout and a newer TRACE comes first answers it; the
+// others find nothing pending.
+static void reply_locked(bool have)
+{
+    int n = have ? trace_dump_format(s_text, sizeof(s_text), "bottom", &s_bottom)
+                 : snprintf(s_text, sizeof(s_text), "TRACE:bottom,none");
+    s_pending = false;
+    ws_broadcast_reply_later(s_server, s_fd, s_text, n);
+}
+
+static void on_timeout(void *arg)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // Not a late expiry of a timer since restarted for a newer TRACE
+    if (s_pending && esp_timer_get_time() >= s_deadline_us)
+        reply_locked(false);
+    xSemaphoreGive(s_lock);
+}
+
+void trace_dump_init(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    const esp_timer_create_args_t args = {.callback = on_timeout, .name = "trace_dump"};
+    esp_timer_create(&args, &s_timer);
+}
+
+void trace_dump_ingest(const aera_frame_t *frame)
+{
+    aera_trace_event_t events[AERA_TRACE_DUMP_EVENTS];
+    uint8_t part, parts;
+    uint32_t now;
+    int count = aera_trace_unpack_dump(frame->payload, &part, &parts, &now, events);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (frame->addr != s_from)
+        count = -1;
+    if (count >= 0 && part == 0)
+    {
+        s_bottom.now = now;
+        s_bottom.count = 0;
+        s_next_part = 0;
+    }
+    // In order or not at all, as with SYS: a lost frame leaves the dump
+    // incomplete rather than silently short
+    if (count >= 0 && part == s_next_part)
+    {
+        for (int i = 0; i < count && s_bottom.count < AERA_TRACE_LEN; i++)
+            s_bottom.events[s_bottom.count++] = events[i];
+        s_next_part++;
+        if (s_next_part == parts)
+        {
+            s_next_part = -1;
+            if (s_pending)
+                reply_locked(true);
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void trace_dump_expect(httpd_req_t *req, uint8_t unit)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_pending)
+        reply_locked(false);
+    s_pending = true;
+    s_server = req->handle;
+    s_fd = httpd_req_to_sockfd(req);
+    s_next_part = -1;
+    s_from = unit;
+    s_deadline_us = esp_timer_get_time() + WAIT_US;
+    xSemaphoreGive(s_lock);
+
+    esp_timer_stop(s_timer);
+    esp_timer_start_once(s_timer, WAIT_US);
+}
+
+int trace_dump_format(char *buf, size_t cap, const char *board, const trace_dump_t *dump)
+{
+    int n = snprintf(buf, cap, "TRACE:%s,now=%lu,n=%d,stages=", board, (unsigned long)dump->now, dump->count);
+    for (int s = 0; s < AERA_TRACE_STAGE_COUNT && n < (int)cap; s++)
+        n += snprintf(buf + n, cap - n, "%s%s", s ? "/" : "", aera_trace_stage_name(s));
+    for (int i = 0; i < dump->count && n < (int)cap; i++)
+    {
+        const aera_trace_event_t *e = &dump->events[i];
+        n += snprintf(buf + n, cap - n, ";%u,%u,%02x,%lu", e->stage, e->seq, e->opcode, (unsigned long)e->us);
+    }
+    return n < (int)cap ? n : (int)cap - 1;
+}
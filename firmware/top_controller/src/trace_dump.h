@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_http_server.h"
+#include "aera_link.h"
+#include "aera_trace.h"
+
+// --- TRACE DUMPS ---
+//
+// TRACE answers with two WebSocket replies, this board's ring and then the
+// bottom controller's, which arrives as TRACE_DUMP frames (aera_trace.h)
+// after it ACKs the forwarded TRACE. The handler sends the first and
+// returns; the second is collected here and sent to the client that asked
+// once complete (ws_broadcast_reply_later()), so httpd never waits on the
+// link. Each reply reads
+//
+//   TRACE:<board>,now=<us>,n=<events>,stages=<name>/<name>/...;<stage>,<seq>,<opcode hex>,<us>;...
+//
+// oldest first, stage being a position in the stages list and every time
+// the low 32 bits of that board's esp_timer. If the bottom board's ring
+// doesn't come within TRACE_DUMP_BOTTOM_WAIT_MS, or another TRACE comes
+// first, the second reply is TRACE:bottom,none. tools/trace_report.py reads
+// both.
+
+// A full ring is 32 frames, ~190 ms of wire at 115200 baud, and on a bus
+// comes in nine or so turns
+#define TRACE_DUMP_BOTTOM_WAIT_MS   1000
+#define TRACE_DUMP_TEXT_MAX         (160 + 22 * AERA_TRACE_LEN)
+
+typedef struct
+{
+    uint32_t now;
+    aera_trace_event_t events[AERA_TRACE_LEN];
+    int count;
+} trace_dump_t;
+
+void trace_dump_init(void);
+
+// Called from the UART RX task with a TRACE_DUMP frame
+void trace_dump_ingest(const aera_frame_t *frame);
+
+// Call before forwarding TRACE to unit (aera_link.h): the bottom reply goes
+// to the WebSocket client behind req, and TRACE_DUMP frames from any other
+// unit are ignored. A client still waiting on an earlier TRACE is answered
+// none now.
+void trace_dump_expect(httpd_req_t *req, uint8_t unit);
+
+// One reply as above. Returns its length, at most cap - 1.
+int trace_dump_format(char *buf, size_t cap, const char *board, const trace_dump_t *dump);
@@ -0,0 +1,86 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "aera_power.h"
+#include "aera_dlog.h"
+#include "uart_rx.h"
+
+_Static_assert(UART_RX_CHUNK_SIZE <= AERA_LINK_RX_MAX_PUSH, "RX chunk must fit in the reassembler");
+
+static uart_port_t s_port;
+static QueueHandle_t s_events;
+static uart_rx_frame_cb_t s_on_frame;
+static aera_link_rx_t s_link_rx;
+static uint32_t s_bytes;
+static uint32_t s_overflows;
+
+// --- TASK: UART RX ---
+static void uart_rx_task(void *arg)
+{
+    static uint8_t data[UART_RX_CHUNK_SIZE];
+    uart_event_t event;
+
+    aera_link_rx_init(&s_link_rx);
+
+    while (1)
+    {
+        if (xQueueReceive(s_events, &event, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        switch (event.type)
+        {
+        case UART_DATA:
+            break;
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            AERA_DLOG(RX_OVERFLOW, event.type);
+            s_overflows++;
+            uart_flush_input(s_port);
+            xQueueReset(s_events);
+            aera_link_rx_flush(&s_link_rx);
+            continue;
+        default:
+            continue;
+        }
+
+        // Everything buffered, not just what this event announced: with the
+        // event queue full the driver drops events, never the bytes, and a
+        // TRACE dump comes in faster than one event per read
+        aera_power_acquire(AERA_POWER_LINK);
+        size_t pending = event.size;
+        uart_get_buffered_data_len(s_port, &pending);
+        while (pending > 0)
+        {
+            int want = pending > UART_RX_CHUNK_SIZE ? UART_RX_CHUNK_SIZE : (int)pending;
+            int len = uart_read_bytes(s_port, data, want, 0);
+            if (len <= 0)
+                break;
+            pending -= len;
+            s_bytes += len;
+
+            aera_link_rx_push(&s_link_rx, data, len);
+
+            aera_frame_t frame;
+            while (aera_link_rx_next(&s_link_rx, &frame))
+                s_on_frame(&frame);
+        }
+        aera_power_release(AERA_POWER_LINK);
+    }
+}
+
+void uart_rx_start(uart_port_t port, QueueHandle_t events, uart_rx_frame_cb_t on_frame)
+{
+    s_port = port;
+    s_events = events;
+    s_on_frame = on_frame;
+    xTaskCreatePinnedToCore(uart_rx_task, "uart_rx_task", UART_RX_TASK_STACK, NULL,
+                            UART_RX_TASK_PRIO, NULL, UART_RX_TASK_CORE);
+}
+
+void uart_rx_get_stats(uart_rx_stats_t *out)
+{
+    out->bytes = s_bytes;
+    out->frames = s_link_rx.frames;
+    out->crc_errors = s_link_rx.crc_errors;
+    out->skipped = s_link_rx.skipped_bytes;
+    out->overflows = s_overflows;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+#include "aera_link.h"
+
+// --- UART RX ---
+//
+// Frames coming back from the bottom controller (ACKs and telemetry). Same shape as
+// the bottom controller's listener: sleep on the driver's event queue, feed
+// the reassembler, hand every complete frame to the callback.
+
+#define UART_RX_CHUNK_SIZE      128
+#define UART_RX_TASK_CORE       1
+#define UART_RX_TASK_PRIO       7
+#define UART_RX_TASK_STACK      3072
+
+typedef struct
+{
+    uint32_t bytes;         // Read from the UART
+    uint32_t frames;        // CRC-valid frames handed on
+    uint32_t crc_errors;
+    uint32_t skipped;       // Bytes dropped resyncing to a frame start
+    uint32_t overflows;     // Driver FIFO or buffer overflows, each flushed
+} uart_rx_stats_t;
+
+// Called from the RX task for every CRC-valid frame
+typedef void (*uart_rx_frame_cb_t)(const aera_frame_t *frame);
+
+void uart_rx_start(uart_port_t port, QueueHandle_t events, uart_rx_frame_cb_t on_frame);
+
+// Each field is consistent on its own
+void uart_rx_get_stats(uart_rx_stats_t *out);
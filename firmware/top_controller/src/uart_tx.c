@@ -0,0 +1,684 @@
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "aera_cmd.h"
+#include "aera_power.h"
+#include "aera_dlog.h"
+#include "ota_stream.h"
+#include "link_rate_tx.h"
+#include "bus_sched.h"
+#include "uart_tx.h"
+#include "uart_tx_priv.h"
+
+#define QUEUE_MASK (UART_TX_QUEUE_LEN - 1)
+#define ACK_TIMEOUT_US ((int64_t)UART_TX_ACK_TIMEOUT_MS * 1000)
+#define SYNC_IDLE_US ((int64_t)AERA_TRACE_SYNC_MS * 1000)
+#define COALESCE_US ((int64_t)UART_TX_COALESCE_MS * 1000)
+
+_Static_assert((UART_TX_QUEUE_LEN & QUEUE_MASK) == 0, "UART_TX_QUEUE_LEN must be a power of two");
+_Static_assert(UART_TX_BATCH_BYTES >= AERA_LINK_MAX_FRAME, "Batch must hold at least one full frame");
+_Static_assert(UART_TX_MAX_PAYLOAD >= AERA_OTA_BEGIN_PAYLOAD_LEN, "OTA_BEGIN goes through the command ring");
+_Static_assert(UART_TX_MAX_PAYLOAD >= AERA_BAUD_PAYLOAD_LEN, "LINK_BAUD is tracked like a command");
+
+typedef struct
+{
+    int64_t origin_us;      // WebSocket frame or datagram read; 0 if none
+    int64_t queued_us;
+    uint8_t node;
+    uint8_t opcode;
+    uint8_t len;
+    uint8_t payload[UART_TX_MAX_PAYLOAD];
+} uart_cmd_t;
+
+typedef struct
+{
+    uart_cmd_t cmd;
+    int64_t deadline_us;
+    uint8_t seq;
+    uint8_t tries;
+    bool used;
+    bool internal;          // Our own SYNC or LINK_BAUD: nobody to tell how it went
+} inflight_t;
+
+// An ACK, or with opcode AERA_OP_BUS_REPLY a BUS_REPLY. Both come through
+// the one queue so a turn's ACKs are always taken in before its end.
+typedef struct
+{
+    int64_t rx_us;
+    uint8_t addr;
+    uint8_t seq;
+    uint8_t opcode;
+    uint8_t state;
+    uint16_t gpio_us;
+    uint16_t ack_us;
+    aera_bus_reply_t reply;
+} ack_msg_t;
+
+static void coalesce_done(uint8_t node, uint8_t opcode, bool acked);
+
+// --- SPSC RING ---
+// head is only written by the producer, tail only by the consumer. Each
+// side publishes its index with release and reads the other with acquire,
+// which is all the ordering a single-producer/single-consumer ring needs.
+// The producers take turns being the producer under s_producer.
+static uart_cmd_t s_ring[UART_TX_QUEUE_LEN];
+static atomic_uint s_head;
+static atomic_uint s_tail;
+static SemaphoreHandle_t s_producer;
+
+static TaskHandle_t s_tx_task = NULL;
+static QueueHandle_t s_ack_queue;
+static uart_port_t s_port;
+static uart_tx_done_cb_t s_on_done;
+static uint8_t s_seq[UART_TX_NODES]; // Each node checks its own for gaps
+
+// Only the TX task touches these
+static inflight_t s_inflight[UART_TX_MAX_INFLIGHT];
+static uint8_t s_batch[UART_TX_BATCH_BYTES];
+static size_t s_batch_used;
+static uint32_t s_batch_frames;
+static uint8_t s_last_state[UART_TX_NODES]; // Actuator state in each node's latest ACK
+#if AERA_TRACE_ENABLED
+// Which frames the batch holds, for their uart_tx tracepoints
+static struct
+{
+    uint8_t seq;
+    uint8_t opcode;
+} s_batch_ids[UART_TX_BATCH_BYTES / AERA_LINK_OVERHEAD];
+static int64_t s_next_sync_us;
+#endif
+
+// Producer-side counters (under s_producer) and consumer-side counters (TX
+// task) are kept apart so neither side writes the other's cache line.
+static uint32_t s_enqueued, s_dropped, s_max_depth;
+static uint32_t s_batches, s_frames, s_bytes;
+static uint32_t s_acked, s_retries, s_failed, s_stray_acks, s_inflight_count, s_coalesced;
+static lat_hist_t s_hist_rtt, s_hist_gpio, s_hist_ack;
+
+uint8_t uart_tx_next_seq(uint8_t node)
+{
+    return s_seq[node]++;
+}
+
+void uart_tx_wake(void)
+{
+    if (s_tx_task)
+        xTaskNotifyGive(s_tx_task);
+}
+
+uint8_t uart_tx_default_node(void)
+{
+    return bus_sched_on() ? AERA_BUS_DEFAULT_NODE : AERA_LINK_ADDR_P2P;
+}
+
+uint8_t uart_tx_last_state(uint8_t node)
+{
+    // One byte, written by the TX task only
+    return node < UART_TX_NODES ? s_last_state[node] : 0;
+}
+
+bool uart_tx_enqueue(uint8_t node, uint8_t opcode, const uint8_t *payload, uint8_t len, int64_t origin_us)
+{
+    if (len > UART_TX_MAX_PAYLOAD || node >= UART_TX_NODES)
+        return false;
+
+    xSemaphoreTake(s_producer, portMAX_DELAY);
+    unsigned head = atomic_load_explicit(&s_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&s_tail, memory_order_acquire);
+    unsigned depth = head - tail;
+
+    if (depth >= UART_TX_QUEUE_LEN)
+    {
+        s_dropped++;
+        xSemaphoreGive(s_producer);
+        return false;
+    }
+
+    uart_cmd_t *slot = &s_ring[head & QUEUE_MASK];
+    slot->origin_us = origin_us;
+    slot->queued_us = esp_timer_get_time();
+    slot->node = node;
+    slot->opcode = opcode;
+    slot->len = len;
+    if (len > 0)
+        memcpy(slot->payload, payload, len);
+
+    atomic_store_explicit(&s_head, head + 1, memory_order_release);
+
+    s_enqueued++;
+    if (depth + 1 > s_max_depth)
+        s_max_depth = depth + 1;
+    xSemaphoreGive(s_producer);
+
+    if (s_tx_task)
+        xTaskNotifyGive(s_tx_task);
+    return true;
+}
+
+void uart_tx_post_ack(const aera_frame_t *ack)
+{
+    ack_msg_t msg = {
+        .rx_us = esp_timer_get_time(),
+        .addr = ack->addr,
+        .seq = ack->seq,
+        .opcode = ack->payload[0],
+        .state = ack->payload[1],
+        .gpio_us = (uint16_t)((ack->payload[2] << 8) | ack->payload[3]),
+        .ack_us = (uint16_t)((ack->payload[4] << 8) | ack->payload[5]),
+    };
+
+    if (xQueueSend(s_ack_queue, &msg, 0) != pdTRUE)
+        AERA_DLOG(TX_ACK_DROPPED, msg.seq);
+    else if (s_tx_task)
+        xTaskNotifyGive(s_tx_task);
+}
+
+void uart_tx_bus_post_reply(const aera_frame_t *reply)
+{
+    ack_msg_t msg = {
+        .rx_us = esp_timer_get_time(),
+        .addr = reply->addr,
+        .seq = reply->seq,
+        .opcode = AERA_OP_BUS_REPLY,
+    };
+    aera_bus_unpack_reply(reply->payload, &msg.reply);
+
+    // Lost, the turn times out and the node is polled again
+    if (xQueueSend(s_ack_queue, &msg, 0) == pdTRUE && s_tx_task)
+        xTaskNotifyGive(s_tx_task);
+}
+
+// --- BATCHING ---
+
+size_t uart_tx_batch_flush(void)
+{
+    size_t used = s_batch_used;
+    if (used == 0)
+        return 0;
+
+#if AERA_TRACE_ENABLED
+    // Stamped as the bytes start out; the write can return after the ACK is
+    // already on its way back
+    int64_t now = esp_timer_get_time();
+    for (uint32_t i = 0; i < s_batch_frames; i++)
+    {
+        // Bus polls would crowd everything else out of the ring
+        if (s_batch_ids[i].opcode != AERA_OP_BUS_POLL)
+            AERA_TRACE(UART_TX, s_batch_ids[i].seq, s_batch_ids[i].opcode, now);
+    }
+#endif
+    uart_write_bytes(s_port, s_batch, s_batch_used);
+    s_batches++;
+    s_frames += s_batch_frames;
+    s_bytes += s_batch_used;
+    bus_sched_on_sent(s_batch_used);
+    AERA_DLOG(TX_BATCH, s_batch_frames, s_batch_used);
+
+    s_batch_used = 0;
+    s_batch_frames = 0;
+    return used;
+}
+
+void uart_tx_batch_add(uint8_t node, uint8_t opcode, uint8_t seq, const uint8_t *payload, uint8_t len)
+{
+    if (UART_TX_BATCH_BYTES - s_batch_used < AERA_LINK_MAX_FRAME)
+        uart_tx_batch_flush();
+
+    s_batch_used += aera_link_encode(s_batch + s_batch_used, UART_TX_BATCH_BYTES - s_batch_used,
+                                     node, opcode, seq, payload, len);
+#if AERA_TRACE_ENABLED
+    s_batch_ids[s_batch_frames].seq = seq;
+    s_batch_ids[s_batch_frames].opcode = opcode;
+#endif
+    s_batch_frames++;
+}
+
+static void batch_add(const inflight_t *f)
+{
+    uart_tx_batch_add(f->cmd.node, f->cmd.opcode, f->seq, f->cmd.payload, f->cmd.len);
+}
+
+// --- IN-FLIGHT TRACKING ---
+
+static inflight_t *inflight_free_slot(void)
+{
+    for (int i = 0; i < UART_TX_MAX_INFLIGHT; i++)
+    {
+        if (!s_inflight[i].used)
+            return &s_inflight[i];
+    }
+    return NULL;
+}
+
+static void inflight_done(inflight_t *f, bool acked, uint8_t state)
+{
+    f->used = false;
+    s_inflight_count--;
+    if (f->internal)
+    {
+        if (f->cmd.opcode == AERA_OP_LINK_BAUD)
+            link_rate_tx_on_done(acked);
+    }
+    else
+    {
+        coalesce_done(f->cmd.node, f->cmd.opcode, acked);
+        if (s_on_done)
+            s_on_done(f->cmd.node, f->cmd.opcode, acked, state, f->cmd.origin_us);
+    }
+}
+
+bool uart_tx_send_own(int64_t now, uint8_t node, uint8_t opcode, const uint8_t *payload, uint8_t len, bool once)
+{
+    inflight_t *f = inflight_free_slot();
+    if (f == NULL)
+        return false;
+
+    f->cmd = (uart_cmd_t){.queued_us = now, .node = node, .opcode = opcode, .len = len};
+    if (len > 0)
+        memcpy(f->cmd.payload, payload, len);
+    f->seq = uart_tx_next_seq(node);
+    f->tries = once ? UART_TX_MAX_RETRIES + 1 : 1;
+    f->deadline_us = now + ACK_TIMEOUT_US;
+    f->used = true;
+    f->internal = true;
+    s_inflight_count++;
+    batch_add(f);
+    return true;
+}
+
+uint32_t uart_tx_inflight(void)
+{
+    return s_inflight_count;
+}
+
+void uart_tx_set_deadline(uint8_t node, int64_t deadline_us)
+{
+    for (int i = 0; i < UART_TX_MAX_INFLIGHT; i++)
+    {
+        inflight_t *f = &s_inflight[i];
+        if (f->used && f->cmd.node == node)
+            f->deadline_us = deadline_us;
+    }
+}
+
+static void handle_acks(void)
+{
+    ack_msg_t ack;
+    while (xQueueReceive(s_ack_queue, &ack, 0) == pdTRUE)
+    {
+        if (ack.opcode == AERA_OP_BUS_REPLY)
+        {
+            if (!bus_sched_on_reply(ack.addr, ack.seq, &ack.reply, ack.rx_us))
+                s_stray_acks++;
+            continue;
+        }
+
+        inflight_t *f = NULL;
+        for (int i = 0; i < UART_TX_MAX_INFLIGHT; i++)
+        {
+            if (s_inflight[i].used && s_inflight[i].seq == ack.seq && s_inflight[i].cmd.opcode == ack.opcode &&
+                s_inflight[i].cmd.node == ack.addr)
+            {
+                f = &s_inflight[i];
+                break;
+            }
+        }
+        if (f == NULL)
+        {
+            s_stray_acks++;
+            continue;
+        }
+
+        AERA_TRACE(ACK_RX, ack.seq, ack.opcode, ack.rx_us);
+        s_last_state[ack.addr] = ack.state;
+        lat_hist_add(&s_hist_rtt, (uint32_t)(ack.rx_us - f->cmd.queued_us));
+        if (!f->internal)
+            bus_sched_on_ack(ack.addr, (uint32_t)(ack.rx_us - f->cmd.queued_us));
+        lat_hist_add(&s_hist_gpio, ack.gpio_us);
+        lat_hist_add(&s_hist_ack, ack.ack_us);
+        s_acked++;
+        inflight_done(f, true, ack.state);
+    }
+}
+
+static void handle_timeouts(int64_t now)
+{
+    for (int i = 0; i < UART_TX_MAX_INFLIGHT; i++)
+    {
+        inflight_t *f = &s_inflight[i];
+        if (!f->used || now < f->deadline_us)
+            continue;
+        // Its node has the bus; the end of the turn decides (bus_sched.c)
+        if (bus_sched_turn() != 0 && f->cmd.node == bus_sched_turn())
+            continue;
+
+        if (f->tries > UART_TX_MAX_RETRIES)
+        {
+            s_failed++;
+            link_rate_tx_on_failed();
+            AERA_DLOG(TX_NO_ACK, f->cmd.opcode, f->seq, f->tries);
+            inflight_done(f, false, 0);
+            continue;
+        }
+        if (!bus_sched_open(f->cmd.node, now))
+            continue;
+
+        f->tries++;
+        f->deadline_us = now + ACK_TIMEOUT_US;
+        s_retries++;
+        batch_add(f);
+    }
+}
+
+// --- COALESCING ---
+// One entry per target a state-setting command sets (uart_tx.h)
+enum
+{
+    TARGET_RUN,
+    TARGET_DRY_TEMP,
+    TARGET_DRY_TIME,
+    TARGET_COUNT,
+};
+
+typedef struct
+{
+    uart_cmd_t pending;
+    uart_cmd_t last;            // Sent last, and ACKed unless still busy
+    int64_t sent_us;
+    bool has_pending;
+    bool has_last;
+    bool busy;                  // last is waiting for its ACK
+} coalesce_t;
+
+// TX task only; each node's targets are its own
+static coalesce_t s_targets[UART_TX_NODES][TARGET_COUNT];
+
+static int coalesce_target(uint8_t opcode)
+{
+    switch (opcode)
+    {
+    case AERA_OP_LED_ON:
+    case AERA_OP_LED_OFF:
+        return TARGET_RUN;
+    case AERA_OP_DRY_TEMP:
+        return TARGET_DRY_TEMP;
+    case AERA_OP_DRY_TIME:
+        return TARGET_DRY_TIME;
+    default:
+        return -1;
+    }
+}
+
+static bool same_cmd(const uart_cmd_t *a, const uart_cmd_t *b)
+{
+    return a->opcode == b->opcode && a->len == b->len && memcmp(a->payload, b->payload, a->len) == 0;
+}
+
+// True if cmd was taken to be sent later, or not at all
+static bool coalesce_hold(const uart_cmd_t *cmd, int64_t now)
+{
+    int t = coalesce_target(cmd->opcode);
+    if (t < 0)
+        return false;
+
+    coalesce_t *target = &s_targets[cmd->node][t];
+    if (!target->has_pending && !target->busy &&
+        (!target->has_last || now - target->sent_us >= COALESCE_US))
+        return false;
+    if (target->has_pending)
+        s_coalesced++;
+    target->pending = *cmd;
+    target->has_pending = true;
+    return true;
+}
+
+static void coalesce_sent(const uart_cmd_t *cmd, int64_t now)
+{
+    int t = coalesce_target(cmd->opcode);
+    if (t < 0)
+        return;
+    s_targets[cmd->node][t].last = *cmd;
+    s_targets[cmd->node][t].has_last = true;
+    s_targets[cmd->node][t].busy = true;
+    s_targets[cmd->node][t].sent_us = now;
+}
+
+static void coalesce_done(uint8_t node, uint8_t opcode, bool acked)
+{
+    int t = coalesce_target(opcode);
+    if (t < 0)
+        return;
+    s_targets[node][t].busy = false;
+    // Who knows what the bottom controller has now; send the next one
+    if (!acked)
+        s_targets[node][t].has_last = false;
+}
+
+// --- SENDING ---
+
+// Takes an in-flight slot and sends cmd; false if none is free
+static bool send_cmd(const uart_cmd_t *cmd, int64_t now)
+{
+    inflight_t *f = inflight_free_slot();
+    if (f == NULL)
+        return false;
+
+    f->cmd = *cmd;
+    f->seq = uart_tx_next_seq(cmd->node);
+    f->tries = 1;
+    f->deadline_us = now + ACK_TIMEOUT_US;
+    f->used = true;
+    f->internal = false;
+    s_inflight_count++;
+    coalesce_sent(cmd, now);
+
+    // Stamped now that the command has the sequence number the bottom
+    // board's stamps will carry
+    if (f->cmd.origin_us != 0)
+        AERA_TRACE(WS_RX, f->seq, f->cmd.opcode, f->cmd.origin_us);
+    AERA_TRACE(QUEUED, f->seq, f->cmd.opcode, f->cmd.queued_us);
+#if AERA_TRACE_ENABLED
+    s_next_sync_us = now + SYNC_IDLE_US;
+#endif
+
+    batch_add(f);
+    return true;
+}
+
+// The pending command of each target whose last one is done with
+static void coalesce_service(int64_t now)
+{
+    for (int node = 0; node < UART_TX_NODES; node++)
+    {
+        for (int t = 0; t < TARGET_COUNT; t++)
+        {
+            coalesce_t *target = &s_targets[node][t];
+            if (!target->has_pending || target->busy)
+                continue;
+
+            if (target->has_last && same_cmd(&target->pending, &target->last))
+            {
+                // Already there
+                target->has_pending = false;
+                s_coalesced++;
+                if (s_on_done)
+                    s_on_done((uint8_t)node, target->pending.opcode, true, s_last_state[node],
+                              target->pending.origin_us);
+                continue;
+            }
+            if (now - target->sent_us < COALESCE_US || !bus_sched_open((uint8_t)node, now))
+                continue;
+            if (!send_cmd(&target->pending, now))
+                return;
+            target->has_pending = false;
+        }
+    }
+}
+
+// When coalesce_service() next has something to do on its own
+static int64_t coalesce_next_us(void)
+{
+    int64_t next = INT64_MAX;
+    for (int node = 0; node < UART_TX_NODES; node++)
+    {
+        for (int t = 0; t < TARGET_COUNT; t++)
+        {
+            const coalesce_t *target = &s_targets[node][t];
+            if (target->has_pending && !target->busy && target->sent_us + COALESCE_US < next)
+                next = target->sent_us + COALESCE_US;
+        }
+    }
+    return next;
+}
+
+static void send_new(int64_t now)
+{
+    unsigned tail = atomic_load_explicit(&s_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&s_head, memory_order_acquire);
+
+    while (tail != head)
+    {
+        const uart_cmd_t *cmd = &s_ring[tail & QUEUE_MASK];
+        if (!coalesce_hold(cmd, now) && (!bus_sched_open(cmd->node, now) || !send_cmd(cmd, now)))
+            break; // Back-pressure: the rest waits in the ring for an ACK, or its node's turn
+        tail++;
+
+        // Hand slots back as we go; the producer can refill while we encode
+        atomic_store_explicit(&s_tail, tail, memory_order_release);
+        if (tail == head)
+            head = atomic_load_explicit(&s_head, memory_order_acquire);
+    }
+}
+
+// --- CLOCK SYNC ---
+// Any command gives the trace a clock-offset sample (aera_trace.h); after
+// AERA_TRACE_SYNC_MS without one we send a SYNC for the purpose.
+#if AERA_TRACE_ENABLED
+// On a bus, only the default node's clock is kept.
+static void send_sync(int64_t now)
+{
+    uint8_t node = uart_tx_default_node();
+    if (now < s_next_sync_us)
+        return;
+    if (!bus_sched_present(node))
+    {
+        s_next_sync_us = now + SYNC_IDLE_US;
+        return;
+    }
+    if (uart_tx_inflight() == UART_TX_MAX_INFLIGHT || !bus_sched_open(node, now))
+        return;
+
+    uart_tx_send_own(now, node, AERA_OP_SYNC, NULL, 0, false);
+    s_next_sync_us = now + SYNC_IDLE_US;
+}
+#endif
+
+static TickType_t next_wait(int64_t now)
+{
+    int64_t soonest = INT64_MAX;
+    for (int i = 0; i < UART_TX_MAX_INFLIGHT; i++)
+    {
+        if (s_inflight[i].used && s_inflight[i].deadline_us < soonest)
+            soonest = s_inflight[i].deadline_us;
+    }
+#if AERA_TRACE_ENABLED
+    if (s_next_sync_us < soonest)
+        soonest = s_next_sync_us;
+#endif
+    int64_t ota = ota_stream_next_us();
+    if (ota < soonest)
+        soonest = ota;
+    int64_t rate = link_rate_tx_next_us();
+    if (rate < soonest)
+        soonest = rate;
+    int64_t held = coalesce_next_us();
+    if (held < soonest)
+        soonest = held;
+    // While a node has the bus nothing else can go out; its reply wakes us
+    int64_t bus = bus_sched_next_us();
+    if (bus_sched_turn() != 0 || bus < soonest)
+        soonest = bus;
+    if (soonest == INT64_MAX)
+        return portMAX_DELAY;
+
+    int64_t wait_ms = (soonest - now + 999) / 1000;
+    TickType_t ticks = pdMS_TO_TICKS(wait_ms > 0 ? wait_ms : 0);
+    return ticks > 0 ? ticks : 1;
+}
+
+// --- TASK: UART TX ---
+static void uart_tx_task(void *arg)
+{
+    while (1)
+    {
+        // Sleep until the producer or an ACK pokes us, or a frame times out
+        ulTaskNotifyTake(pdTRUE, next_wait(esp_timer_get_time()));
+
+        aera_power_acquire(AERA_POWER_LINK);
+        int64_t now = esp_timer_get_time();
+        handle_acks();
+        bus_sched_check(now);
+        handle_timeouts(now);
+        link_rate_tx_service(now);
+        if (link_rate_tx_steady())
+        {
+            send_new(now);
+            coalesce_service(now);
+#if AERA_TRACE_ENABLED
+            send_sync(now);
+#endif
+            ota_stream_service(now);
+        }
+        bus_sched_service(now);
+        uart_tx_batch_flush();
+        aera_power_release(AERA_POWER_LINK);
+    }
+}
+
+void uart_tx_start(uart_port_t port, bool rts_cts, bool bus, uart_tx_done_cb_t on_done)
+{
+    s_port = port;
+    s_on_done = on_done;
+    link_rate_tx_init(port, rts_cts, bus);
+    bus_sched_init(bus);
+    ota_stream_init();
+    s_ack_queue = xQueueCreate(UART_TX_ACK_QUEUE_LEN, sizeof(ack_msg_t));
+    s_producer = xSemaphoreCreateMutex();
+#if AERA_TRACE_ENABLED
+    s_next_sync_us = esp_timer_get_time() + SYNC_IDLE_US;
+#endif
+    xTaskCreatePinnedToCore(uart_tx_task, "uart_tx_task", UART_TX_TASK_STACK, NULL,
+                            UART_TX_TASK_PRIO, &s_tx_task, UART_TX_TASK_CORE);
+}
+
+void uart_tx_get_stats(uart_tx_stats_t *out)
+{
+    unsigned head = atomic_load_explicit(&s_head, memory_order_acquire);
+    unsigned tail = atomic_load_explicit(&s_tail, memory_order_acquire);
+
+    out->enqueued = s_enqueued;
+    out->dropped = s_dropped;
+    out->batches = s_batches;
+    out->frames = s_frames;
+    out->bytes = s_bytes;
+    out->depth = head - tail;
+    out->max_depth = s_max_depth;
+    out->acked = s_acked;
+    out->retries = s_retries;
+    out->failed = s_failed;
+    out->stray_acks = s_stray_acks;
+    out->inflight = s_inflight_count;
+    out->coalesced = s_coalesced;
+}
+
+void uart_tx_get_latency(lat_hist_t *rtt, lat_hist_t *gpio, lat_hist_t *ack)
+{
+    // Plain copies; a sample landing mid-copy can only skew one bucket by one
+    *rtt = s_hist_rtt;
+    *gpio = s_hist_gpio;
+    *ack = s_hist_ack;
+}
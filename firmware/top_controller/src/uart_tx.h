@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/uart.h"
+#include "aera_link.h"
+#include "aera_bus.h"
+#include "lat_hist.h"
+
+// --- UART TX QUEUE ---
+//
+// WebSocket handlers and the UDP control task (udp_ctrl.h) never wait on
+// the wire: they drop commands into a bounded ring, under a mutex, and
+// return. A dedicated TX task drains it, encodes link frames and writes
+// each batch with one uart_write_bytes() call.
+//
+// Every frame stays in flight until its node ACKs the sequence number;
+// without an ACK in UART_TX_ACK_TIMEOUT_MS it is resent, up to
+// UART_TX_MAX_RETRIES times. Either way the done callback runs once, on
+// the TX task. While all UART_TX_MAX_INFLIGHT slots are busy, new commands
+// wait in the ring.
+//
+// Commands that set a state (ON/OFF, TEMP, DRYTIME) are coalesced per node
+// and target: the first goes out at once, and of those that come in while
+// it waits for its ACK or within UART_TX_COALESCE_MS of it, only the last
+// goes out after. If it would change nothing it doesn't go out at all, and
+// its done callback runs with the state from the last ACK.
+//
+// The TX task also writes this board's trace ring (aera_trace.h), with
+// SYNCs to keep its clock offset fresh, and runs the OTA stream
+// (ota_stream.h), the link rate (link_rate_tx.h) and the bus schedule
+// (bus_sched.h).
+
+#define UART_TX_QUEUE_LEN       32  // Must be a power of two
+#define UART_TX_MAX_PAYLOAD     16  // OTA_BEGIN; OTA_DATA has its own ring
+#define UART_TX_BATCH_BYTES     256
+#define UART_TX_MAX_INFLIGHT    AERA_LINK_MAX_INFLIGHT
+#define UART_TX_ACK_TIMEOUT_MS  50
+#define UART_TX_MAX_RETRIES     3
+#define UART_TX_COALESCE_MS     100 // 0: merge only while one is waiting for its ACK
+#define UART_TX_ACK_QUEUE_LEN   16
+#define UART_TX_TASK_CORE       1
+#define UART_TX_TASK_PRIO       6
+#define UART_TX_TASK_STACK      3072
+
+typedef struct
+{
+    uint32_t enqueued;
+    uint32_t dropped;      // Ring was full
+    uint32_t batches;      // uart_write_bytes() calls
+    uint32_t frames;       // Frames written, retries included
+    uint32_t bytes;        // Bytes written
+    uint32_t depth;        // Commands waiting right now
+    uint32_t max_depth;    // High-water mark
+    uint32_t acked;
+    uint32_t retries;
+    uint32_t failed;       // Gave up after UART_TX_MAX_RETRIES
+    uint32_t stray_acks;   // ACK for nothing in flight (late or duplicate)
+    uint32_t inflight;     // Waiting for an ACK right now
+    uint32_t coalesced;    // Never sent: a later one for the same target won
+} uart_tx_stats_t;
+
+// On the TX task, once per command sent, and for a coalesced one that
+// changed nothing. state is what node reported, meaningful only if acked.
+// origin_us is the command's as enqueued; if coalesced, the winner's.
+typedef void (*uart_tx_done_cb_t)(uint8_t node, uint8_t opcode, bool acked, uint8_t state, int64_t origin_us);
+
+// rts_cts: RTS and CTS are wired. bus: the bottom controllers are on a bus.
+void uart_tx_start(uart_port_t port, bool rts_cts, bool bus, uart_tx_done_cb_t on_done);
+
+// AERA_LINK_ADDR_P2P, or AERA_BUS_DEFAULT_NODE on a bus
+uint8_t uart_tx_default_node(void);
+
+// False (and counts a drop) if the ring is full. origin_us is when the
+// WebSocket frame or datagram was read, for the trace; 0 if none.
+bool uart_tx_enqueue(uint8_t node, uint8_t opcode, const uint8_t *payload, uint8_t len, int64_t origin_us);
+
+// The actuator state in node's latest ACK. Safe from any task.
+uint8_t uart_tx_last_state(uint8_t node);
+
+// An ACK or a BUS_REPLY, from the UART RX task. Never block.
+void uart_tx_post_ack(const aera_frame_t *ack);
+void uart_tx_bus_post_reply(const aera_frame_t *reply);
+
+void uart_tx_get_stats(uart_tx_stats_t *out);
+
+// Latency histograms, copied out:
+//   rtt   WebSocket command queued -> ACK received, on this board
+//   gpio  bottom board UART wake -> GPIO set
+//   ack   bottom board UART wake -> ACK written
+void uart_tx_get_latency(lat_hist_t *rtt, lat_hist_t *gpio, lat_hist_t *ack);
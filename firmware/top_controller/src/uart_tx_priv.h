@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "aera_bus.h"
+
+// --- UART TX: FOR ITS OWN MODULES ---
+//
+// What the parts of the TX task in their own files (ota_stream.c,
+// link_rate_tx.c, bus_sched.c) need from uart_tx.c. TX task only, but for
+// uart_tx_wake().
+
+#define UART_TX_NODES (AERA_BUS_MAX_NODES + 1) // Indexed by address; 0 is a point-to-point link
+
+// Safe from any task
+void uart_tx_wake(void);
+
+uint8_t uart_tx_next_seq(uint8_t node);
+
+// Flushes first if the batch is full. On a bus, only for the node
+// bus_sched_open() let through.
+void uart_tx_batch_add(uint8_t node, uint8_t opcode, uint8_t seq, const uint8_t *payload, uint8_t len);
+
+// Writes the batch out; returns how many bytes that was
+size_t uart_tx_batch_flush(void);
+
+// Tracks and sends one of our own frames, ACKed like a command but never
+// passed to the done callback. once: never resent. False while every
+// in-flight slot is busy.
+bool uart_tx_send_own(int64_t now, uint8_t node, uint8_t opcode, const uint8_t *payload, uint8_t len, bool once);
+
+// Frames waiting for an ACK right now
+uint32_t uart_tx_inflight(void);
+
+// Moves the ACK deadline of node's frames in flight
+void uart_tx_set_deadline(uint8_t node, int64_t deadline_us);
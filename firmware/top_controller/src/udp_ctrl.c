@@ -0,0 +1,448 @@
+#include <string.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "nvs.h"
+#include "lwip/sockets.h"
+#include "aera_cmd.h"
+#include "aera_power.h"
+#include "aera_dlog.h"
+#include "siphash.h"
+#include "uart_tx.h"
+#include "udp_ctrl.h"
+
+typedef struct
+{
+    bool used;
+    bool pending;           // Waiting for the outcome of seq
+    bool answered;          // reply holds the answer to seq
+    uint32_t client;
+    uint32_t seq;
+    uint8_t unit;
+    uint8_t opcode;
+    int64_t rx_us;          // seq's datagram read; its command's origin_us
+    int64_t seen_us;        // Last datagram from it, for eviction
+    struct sockaddr_in addr; // Where the last datagram came from
+    uint8_t reply[UDP_CTRL_REPLY_LEN];
+} udp_client_t;
+
+static const char *TAG = "UDP_CTRL";
+
+#define REPLY_US ((int64_t)UDP_CTRL_REPLY_MS * 1000)
+#define REQUEST_MAX (UDP_CTRL_HEADER_LEN + UDP_CTRL_MAX_PAYLOAD + UDP_CTRL_MAC_LEN)
+
+// Everything below is guarded by s_lock, which is never held across a
+// socket send or the command callback. The key and the socket are set
+// before the task starts and never change.
+static SemaphoreHandle_t s_lock;
+static udp_client_t s_clients[UDP_CTRL_MAX_CLIENTS];
+static udp_ctrl_stats_t s_stats;
+static uint32_t s_nonce;        // Never 0, which new clients send
+static uint8_t s_key[UDP_CTRL_KEY_LEN];
+static int s_sock = -1;
+static udp_ctrl_cmd_cb_t s_on_command;
+
+// --- MAC ---
+_Static_assert(UDP_CTRL_KEY_LEN == SIPHASH_KEY_LEN && UDP_CTRL_MAC_LEN == SIPHASH_OUT_LEN,
+               "the MAC is SipHash-2-4");
+
+static void mac(const uint8_t *data, size_t len, uint8_t out[UDP_CTRL_MAC_LEN])
+{
+    siphash24(s_key, data, len, out);
+}
+
+// Without an early exit, so the time taken says nothing about the MAC
+static bool mac_ok(const uint8_t *data, size_t len)
+{
+    uint8_t want[UDP_CTRL_MAC_LEN];
+    mac(data, len, want);
+    uint8_t diff = 0;
+    for (int i = 0; i < UDP_CTRL_MAC_LEN; i++)
+        diff |= want[i] ^ data[len + i];
+    return diff == 0;
+}
+
+// --- NONCE ---
+// Datagrams made for the one before are refused from now on
+static void nonce_draw(void)
+{
+    uint32_t old = s_nonce;
+    do
+        s_nonce = esp_random();
+    while (s_nonce == 0 || s_nonce == old);
+}
+
+// --- CLIENTS ---
+static uint32_t load_be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void store_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// The client's slot, or a free or the least recently heard from one
+// (pending ones last) made its; *fresh says which
+static udp_client_t *client_slot(uint32_t client, bool *fresh)
+{
+    udp_client_t *victim = NULL;
+    for (int i = 0; i < UDP_CTRL_MAX_CLIENTS; i++)
+    {
+        udp_client_t *c = &s_clients[i];
+        if (c->used && c->client == client)
+        {
+            *fresh = false;
+            return c;
+        }
+        if (victim == NULL || !c->used ||
+            (victim->used && (victim->pending > c->pending ||
+                              (victim->pending == c->pending && c->seen_us < victim->seen_us))))
+            victim = c;
+    }
+    // Its seq goes with it, so nothing it sent may be taken again
+    if (victim->used)
+    {
+        nonce_draw();
+        s_stats.renonces++;
+    }
+    memset(victim, 0, sizeof(*victim));
+    victim->used = true;
+    victim->client = client;
+    *fresh = true;
+    return victim;
+}
+
+static void reply_fill(uint8_t *r, uint32_t client, uint32_t seq, uint8_t unit, uint8_t opcode,
+                       udp_ctrl_status_t status, uint8_t state)
+{
+    r[0] = UDP_CTRL_MAGIC;
+    r[1] = UDP_CTRL_VERSION | UDP_CTRL_REPLY_FLAG;
+    store_be32(r + 2, s_nonce);
+    store_be32(r + 6, client);
+    store_be32(r + 10, seq);
+    r[14] = unit;
+    r[15] = opcode;
+    r[16] = (uint8_t)status;
+    r[17] = state;
+    mac(r, UDP_CTRL_REPLY_LEN - UDP_CTRL_MAC_LEN, r + UDP_CTRL_REPLY_LEN - UDP_CTRL_MAC_LEN);
+}
+
+// Fills in c->reply, the answer to c->seq, and settles it
+static void client_answer(udp_client_t *c, udp_ctrl_status_t status, uint8_t state)
+{
+    reply_fill(c->reply, c->client, c->seq, c->unit, c->opcode, status, state);
+    c->pending = false;
+    c->answered = true;
+    if (status == UDP_CTRL_TIMEOUT)
+        s_stats.timeouts++;
+}
+
+static void send_reply(const uint8_t *reply, const struct sockaddr_in *to)
+{
+    if (sendto(s_sock, reply, UDP_CTRL_REPLY_LEN, 0, (const struct sockaddr *)to, sizeof(*to)) ==
+        UDP_CTRL_REPLY_LEN)
+    {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_stats.replies++;
+        xSemaphoreGive(s_lock);
+    }
+}
+
+// ON and OFF set the same thing; the rest are targets of their own
+static bool same_target(uint8_t a, uint8_t b)
+{
+    bool a_run = a == AERA_OP_LED_ON || a == AERA_OP_LED_OFF;
+    bool b_run = b == AERA_OP_LED_ON || b == AERA_OP_LED_OFF;
+    return a == b || (a_run && b_run);
+}
+
+static bool udp_command(uint8_t opcode)
+{
+    switch (opcode)
+    {
+    case AERA_OP_LED_ON:
+    case AERA_OP_LED_OFF:
+    case AERA_OP_DRY_TEMP:
+    case AERA_OP_DRY_TIME:
+    case AERA_OP_PING:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// False for a unit that can't be there, as parse_ws_unit() in main.c
+static bool resolve_unit(uint8_t *unit)
+{
+    uint8_t fallback = uart_tx_default_node();
+    if (*unit == 0)
+    {
+        *unit = fallback;
+        return true;
+    }
+    return fallback != AERA_LINK_ADDR_P2P && *unit <= AERA_BUS_MAX_NODES;
+}
+
+// --- REQUESTS ---
+static void handle_datagram(const uint8_t *d, size_t n, const struct sockaddr_in *from, int64_t now)
+{
+    size_t body = n - UDP_CTRL_MAC_LEN;
+    if (n < UDP_CTRL_HEADER_LEN + UDP_CTRL_MAC_LEN || d[0] != UDP_CTRL_MAGIC || d[1] != UDP_CTRL_VERSION ||
+        d[16] > UDP_CTRL_MAX_PAYLOAD || body != (size_t)UDP_CTRL_HEADER_LEN + d[16] || !mac_ok(d, body))
+    {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_stats.bad++;
+        xSemaphoreGive(s_lock);
+        AERA_DLOG(UDP_BAD, (unsigned)n, (unsigned)ntohl(from->sin_addr.s_addr));
+        return;
+    }
+
+    uint32_t client = load_be32(d + 6);
+    uint32_t seq = load_be32(d + 10);
+    uint8_t unit = d[14];
+    aera_frame_t frame = {
+        .addr = 0,
+        .opcode = d[15],
+        .seq = 0,
+        .len = d[16],
+        .payload = d + UDP_CTRL_HEADER_LEN,
+    };
+    uint8_t reply[UDP_CTRL_REPLY_LEN];
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // From before a boot or a client pushed out: maybe a replay, and the
+    // table can't tell. Not taken; a real client sends it again.
+    if (load_be32(d + 2) != s_nonce)
+    {
+        s_stats.nonce++;
+        reply_fill(reply, client, seq, unit, frame.opcode, UDP_CTRL_NONCE, 0);
+        xSemaphoreGive(s_lock);
+        send_reply(reply, from);
+        return;
+    }
+    bool fresh;
+    udp_client_t *c = client_slot(client, &fresh);
+    c->seen_us = now;
+    int32_t age = (int32_t)(c->seq - seq);
+    if (!fresh && age > 0)
+    {
+        s_stats.stale++;
+        xSemaphoreGive(s_lock);
+        return;
+    }
+    c->addr = *from; // Answers follow the client if its address changed
+    if (!fresh && age == 0)
+    {
+        s_stats.dups++;
+        bool answered = c->answered;
+        memcpy(reply, c->reply, sizeof(reply));
+        xSemaphoreGive(s_lock);
+        if (answered)
+            send_reply(reply, from);
+        return;
+    }
+
+    // A new command; whatever this client had pending is forgotten
+    c->seq = seq;
+    c->opcode = frame.opcode;
+    c->unit = unit;
+    c->rx_us = now;
+    c->answered = false;
+    bool dispatch = false;
+    if (!udp_command(frame.opcode) || !resolve_unit(&c->unit))
+        client_answer(c, UDP_CTRL_REFUSED, 0);
+    else if (frame.opcode == AERA_OP_PING)
+        client_answer(c, UDP_CTRL_OK, uart_tx_last_state(c->unit));
+    else
+    {
+        // Pending before it is queued: its outcome can come back at once
+        c->pending = true;
+        dispatch = true;
+        s_stats.dispatched++;
+    }
+    unit = c->unit;
+    memcpy(reply, c->reply, sizeof(reply));
+    xSemaphoreGive(s_lock);
+
+    if (dispatch)
+    {
+        udp_ctrl_status_t status = s_on_command(unit, &frame, now);
+        if (status == UDP_CTRL_OK)
+            return;
+        // Only this task moves clients between slots, so c is still ours
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        bool pending = c->pending;
+        if (pending)
+        {
+            client_answer(c, status, 0);
+            memcpy(reply, c->reply, sizeof(reply));
+        }
+        xSemaphoreGive(s_lock);
+        if (!pending)
+            return;
+    }
+    send_reply(reply, from);
+}
+
+// Answers one pending command that has had no outcome for too long; the
+// time until the next one would be due, in ms, 0 if none is pending
+static int sweep_one(int64_t now, uint8_t *reply, struct sockaddr_in *to, bool *found)
+{
+    int64_t next_us = 0;
+    *found = false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < UDP_CTRL_MAX_CLIENTS; i++)
+    {
+        udp_client_t *c = &s_clients[i];
+        if (!c->used || !c->pending)
+            continue;
+        int64_t due = c->rx_us + REPLY_US;
+        if (due <= now && !*found)
+        {
+            client_answer(c, UDP_CTRL_TIMEOUT, uart_tx_last_state(c->unit));
+            memcpy(reply, c->reply, UDP_CTRL_REPLY_LEN);
+            *to = c->addr;
+            *found = true;
+        }
+        else if (due > now && (next_us == 0 || due - now < next_us))
+            next_us = due - now;
+    }
+    xSemaphoreGive(s_lock);
+    return (int)((next_us + 999) / 1000);
+}
+
+// --- TASK ---
+static void udp_ctrl_task(void *arg)
+{
+    // One byte over, so an oversized datagram shows as one
+    static uint8_t buf[REQUEST_MAX + 1];
+    uint8_t reply[UDP_CTRL_REPLY_LEN];
+    struct sockaddr_in to;
+
+    while (1)
+    {
+        // Blocks for good unless something is waiting to time out
+        bool found;
+        int wait_ms;
+        while ((wait_ms = sweep_one(esp_timer_get_time(), reply, &to, &found)), found)
+            send_reply(reply, &to);
+        struct timeval tv = {.tv_sec = wait_ms / 1000, .tv_usec = (wait_ms % 1000) * 1000};
+        setsockopt(s_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int n = recvfrom(s_sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+        if (n < 0)
+            continue;
+
+        aera_power_acquire(AERA_POWER_WS);
+        int64_t now = esp_timer_get_time();
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_stats.received++;
+        xSemaphoreGive(s_lock);
+        handle_datagram(buf, (size_t)n, &from, now);
+        aera_power_release(AERA_POWER_WS);
+    }
+}
+
+// --- START ---
+static bool key_load(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(UDP_CTRL_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+        return false;
+    size_t len = sizeof(s_key);
+    bool ok = nvs_get_blob(nvs, UDP_CTRL_NVS_KEY, s_key, &len) == ESP_OK && len == sizeof(s_key);
+    nvs_close(nvs);
+    return ok;
+}
+
+void udp_ctrl_start(uint16_t port, udp_ctrl_cmd_cb_t on_command)
+{
+    if (!key_load())
+    {
+        ESP_LOGW(TAG, "No key provisioned (NVS %s/%s), UDP port %u stays closed", UDP_CTRL_NVS_NAMESPACE,
+                 UDP_CTRL_NVS_KEY, port);
+        return;
+    }
+
+    s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s_sock < 0)
+    {
+        ESP_LOGE(TAG, "No socket");
+        return;
+    }
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(s_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        ESP_LOGE(TAG, "Can't bind UDP port %u", port);
+        close(s_sock);
+        s_sock = -1;
+        return;
+    }
+
+    s_on_command = on_command;
+    s_lock = xSemaphoreCreateMutex();
+    nonce_draw();
+    ESP_LOGI(TAG, "Taking commands on UDP port %u", port);
+    xTaskCreatePinnedToCore(udp_ctrl_task, "udp_ctrl_task", UDP_CTRL_TASK_STACK, NULL, UDP_CTRL_TASK_PRIO,
+                            NULL, UDP_CTRL_TASK_CORE);
+}
+
+void udp_ctrl_on_done(uint8_t node, uint8_t opcode, bool acked, uint8_t state, int64_t origin_us)
+{
+    if (s_lock == NULL)
+        return;
+
+    // One at a time, so the lock isn't held across the send
+    for (;;)
+    {
+        uint8_t reply[UDP_CTRL_REPLY_LEN];
+        struct sockaddr_in to;
+        bool found = false;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        for (int i = 0; i < UDP_CTRL_MAX_CLIENTS && !found; i++)
+        {
+            udp_client_t *c = &s_clients[i];
+            // Commands queued before this one aren't settled by it
+            if (!c->used || !c->pending || c->unit != node || !same_target(c->opcode, opcode) ||
+                origin_us < c->rx_us)
+                continue;
+            client_answer(c, acked ? UDP_CTRL_OK : UDP_CTRL_NO_ACK, acked ? state : 0);
+            memcpy(reply, c->reply, sizeof(reply));
+            to = c->addr;
+            found = true;
+        }
+        xSemaphoreGive(s_lock);
+
+        if (!found)
+            return;
+        send_reply(reply, &to);
+    }
+}
+
+void udp_ctrl_get_stats(udp_ctrl_stats_t *out)
+{
+    if (s_lock == NULL)
+    {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_stats;
+    xSemaphoreGive(s_lock);
+}
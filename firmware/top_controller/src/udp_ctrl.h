@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "aera_link.h"
+
+// --- UDP CONTROL ---
+//
+// An optional second way in for the commands a tap in the app sends (ON,
+// OFF, TEMP, DRYTIME) and PING, for clients that want them with less in the
+// way than a WebSocket: no connection to set up or keep alive, and a lost
+// packet holds up nothing behind it. A command is one datagram and so is
+// its answer, which comes once the bottom controller has ACKed it and
+// carries the state it reported.
+//
+//   request [0xAE][2][nonce:4][client:4][seq:4][unit][opcode][len][payload:len][mac:8]
+//   reply   [0xAE][0x82][nonce:4][client:4][seq:4][unit][opcode][status][state][mac:8]
+//
+// Numbers are big-endian. nonce is the server's, see below. client is
+// picked at random by the client when it starts and seq counts up from 1;
+// unit 0 is the default bottom controller.
+// opcode and payload are the registry's (aera_cmd.h), and the command goes
+// through the same dispatcher and UART TX queue as the WebSocket one.
+// mac is SipHash-2-4 of everything before it under the unit's key;
+// datagrams without the right one are dropped unanswered.
+//
+// The key is a 16-byte blob in NVS, UDP_CTRL_NVS_NAMESPACE/UDP_CTRL_NVS_KEY,
+// different on every unit and written when it is provisioned, e.g. with
+// IDF's nvs_partition_gen.py from a CSV:
+//
+//   udp_ctrl,namespace,,
+//   key,data,hex2bin,<32 hex digits>
+//
+// The app is given the same key when it is paired. Without one the socket
+// is never opened.
+//
+// Retries are safe: each client's last seq is kept, with its answer once
+// there is one. The same seq again gets that answer sent again (or nothing
+// more, while it is still pending) and is never dispatched twice; an older
+// one is dropped. One command per client is pending at a time; a newer one
+// takes its place. The answer is the one for whatever left the target in
+// its state: if a later command for the same target, from anyone, was
+// merged with this one (uart_tx.h), that one's outcome. Without an ACK
+// within UDP_CTRL_REPLY_MS the answer is UDP_CTRL_TIMEOUT.
+//
+// The table only holds UDP_CTRL_MAX_CLIENTS, the least recently heard from
+// leaving first, and starts empty at boot, so seq alone can't refuse an old
+// datagram replayed once its client is gone from it. Hence the nonce: a
+// random number drawn at boot, and again whenever a client is pushed out of
+// the table, that every request has to carry. One with any other is not
+// dispatched or remembered but answered UDP_CTRL_NONCE, that reply carrying
+// the current nonce; the client sends the command again with it. A new
+// client starts with nonce 0, which is never the current one, and so learns
+// it from its first command's answer.
+
+#define UDP_CTRL_NVS_NAMESPACE  "udp_ctrl"
+#define UDP_CTRL_NVS_KEY        "key"
+#define UDP_CTRL_MAGIC          0xAE
+#define UDP_CTRL_VERSION        2
+#define UDP_CTRL_REPLY_FLAG     0x80
+#define UDP_CTRL_KEY_LEN        16
+#define UDP_CTRL_MAC_LEN        8
+#define UDP_CTRL_HEADER_LEN     17  // Up to and including len
+#define UDP_CTRL_MAX_PAYLOAD    4
+#define UDP_CTRL_REPLY_LEN      (18 + UDP_CTRL_MAC_LEN)
+
+#define UDP_CTRL_MAX_CLIENTS    8
+#define UDP_CTRL_REPLY_MS       1000
+#define UDP_CTRL_TASK_CORE      0
+#define UDP_CTRL_TASK_PRIO      5
+#define UDP_CTRL_TASK_STACK     3072
+
+typedef enum
+{
+    UDP_CTRL_OK = 0,        // ACKed; state is the bottom controller's
+    UDP_CTRL_NO_ACK,        // Sent, but never ACKed
+    UDP_CTRL_TIMEOUT,       // No outcome within UDP_CTRL_REPLY_MS
+    UDP_CTRL_BUSY,          // TX queue full; try again
+    UDP_CTRL_REFUSED,       // Not a UDP command, bad arguments or no such unit
+    UDP_CTRL_NONCE,         // Not the current nonce, which the reply carries; not run
+} udp_ctrl_status_t;
+
+typedef struct
+{
+    uint32_t received;      // Datagrams read
+    uint32_t bad;           // Dropped: malformed or wrong MAC
+    uint32_t dups;          // Retries of one already taken
+    uint32_t stale;         // Older than the client's last, dropped
+    uint32_t nonce;         // Answered UDP_CTRL_NONCE
+    uint32_t renonces;      // Nonces drawn again, a client pushed out
+    uint32_t dispatched;    // Commands handed to the dispatcher
+    uint32_t replies;       // Answers sent, resent ones included
+    uint32_t timeouts;      // Answered UDP_CTRL_TIMEOUT
+} udp_ctrl_stats_t;
+
+// Runs on the UDP task for each new command, with the unit resolved.
+// rx_us is when the datagram was read; it must reach uart_tx_enqueue() as
+// origin_us, which is how udp_ctrl_on_done() tells this command's outcome
+// from an earlier one's. UDP_CTRL_OK if it was queued.
+typedef udp_ctrl_status_t (*udp_ctrl_cmd_cb_t)(uint8_t unit, const aera_frame_t *frame, int64_t rx_us);
+
+// Call once, after nvs_flash_init(). Does nothing but log why if the unit
+// has no key.
+void udp_ctrl_start(uint16_t port, udp_ctrl_cmd_cb_t on_command);
+
+// Pass on every call of the UART TX done callback (uart_tx.h). Answers
+// the commands it settles, from the TX task. Does nothing if not started.
+void udp_ctrl_on_done(uint8_t node, uint8_t opcode, bool acked, uint8_t state, int64_t origin_us);
+
+void udp_ctrl_get_stats(udp_ctrl_stats_t *out);
@@ -0,0 +1,258 @@
+#include <string.h>
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "wifi_conn.h"
+
+#define CACHE_KEY "ap"
+
+// The backoff timer fires on the esp_timer task; it only posts this so the
+// retry runs on the event loop with everything else
+ESP_EVENT_DEFINE_BASE(WIFI_CONN_EVENT);
+enum
+{
+    WIFI_CONN_EVENT_RETRY,
+};
+
+typedef struct
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+} ap_cache_t;
+
+static const char *TAG = "WIFI";
+
+static wifi_conn_config_t s_cfg;
+static wifi_config_t s_base_config;
+static esp_timer_handle_t s_retry_timer;
+
+// Only touched on the event loop
+static ap_cache_t s_cache;
+static bool s_have_cache;
+static bool s_up;
+static bool s_direct;           // The attempt in flight skips the scan
+static int64_t s_down_us;       // Link lost, or the station started
+static uint32_t s_tries;        // Attempts since then
+static uint32_t s_fails;        // Failed attempts in a row
+static uint32_t s_direct_fails;
+static wifi_conn_stats_t s_stats;
+
+// --- AP CACHE ---
+
+static void cache_load(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_CONN_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+        return;
+    size_t len = sizeof(s_cache);
+    s_have_cache = nvs_get_blob(nvs, CACHE_KEY, &s_cache, &len) == ESP_OK && len == sizeof(s_cache);
+    nvs_close(nvs);
+
+    if (s_have_cache)
+    {
+        ESP_LOGI(TAG, "Cached AP %02x:%02x:%02x:%02x:%02x:%02x on channel %u", s_cache.bssid[0],
+                 s_cache.bssid[1], s_cache.bssid[2], s_cache.bssid[3], s_cache.bssid[4], s_cache.bssid[5],
+                 s_cache.channel);
+    }
+}
+
+// Only writes when the AP changed, so a stable network never wears the flash
+static void cache_store(const uint8_t *bssid, uint8_t channel)
+{
+    if (s_have_cache && s_cache.channel == channel && memcmp(s_cache.bssid, bssid, 6) == 0)
+        return;
+
+    memcpy(s_cache.bssid, bssid, 6);
+    s_cache.channel = channel;
+    s_have_cache = true;
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(WIFI_CONN_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK)
+    {
+        err = nvs_set_blob(nvs, CACHE_KEY, &s_cache, sizeof(s_cache));
+        if (err == ESP_OK)
+            err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK)
+        ESP_LOGW(TAG, "Can't cache the AP: %s", esp_err_to_name(err));
+    else
+        ESP_LOGI(TAG, "Cached AP is now on channel %u", channel);
+}
+
+// --- CONNECT ---
+
+static void connect_now(void)
+{
+    wifi_config_t wc = s_base_config;
+    s_direct = s_have_cache && s_direct_fails < WIFI_CONN_DIRECT_TRIES;
+    if (s_direct)
+    {
+        wc.sta.channel = s_cache.channel;
+        wc.sta.bssid_set = 1;
+        memcpy(wc.sta.bssid, s_cache.bssid, 6);
+        wc.sta.scan_method = WIFI_FAST_SCAN;
+    }
+    else
+    {
+        // Every channel, then the strongest AP with our SSID
+        wc.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        wc.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+        s_stats.scans++;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &wc);
+
+    s_tries++;
+    s_stats.attempts++;
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK)
+        ESP_LOGW(TAG, "esp_wifi_connect: %s", esp_err_to_name(err));
+}
+
+static void retry_later(void)
+{
+    uint32_t shift = s_fails - 1 < 16 ? s_fails - 1 : 16;
+    uint32_t delay_ms = WIFI_CONN_BACKOFF_MIN_MS << shift;
+    if (delay_ms > WIFI_CONN_BACKOFF_MAX_MS)
+        delay_ms = WIFI_CONN_BACKOFF_MAX_MS;
+
+    ESP_LOGI(TAG, "Attempt %lu failed, retrying in %lu ms", (unsigned long)s_tries, (unsigned long)delay_ms);
+    esp_timer_stop(s_retry_timer);
+    esp_timer_start_once(s_retry_timer, (uint64_t)delay_ms * 1000);
+}
+
+static void on_retry_timer(void *arg)
+{
+    esp_event_post(WIFI_CONN_EVENT, WIFI_CONN_EVENT_RETRY, NULL, 0, 0);
+}
+
+// --- EVENT HANDLER ---
+
+static void on_disconnected(const wifi_event_sta_disconnected_t *ev)
+{
+    if (s_up)
+    {
+        // A working link just went away: try again straight away
+        ESP_LOGW(TAG, "Link lost (reason %u), reconnecting", ev->reason);
+        s_up = false;
+        s_down_us = esp_timer_get_time();
+        s_tries = 0;
+        s_fails = 0;
+        s_direct_fails = 0;
+        if (s_cfg.on_change)
+            s_cfg.on_change(false);
+        connect_now();
+        return;
+    }
+
+    s_fails++;
+    if (s_direct && ++s_direct_fails == WIFI_CONN_DIRECT_TRIES)
+        ESP_LOGW(TAG, "Cached AP not answering (reason %u), scanning instead", ev->reason);
+    else if (!s_direct)
+        s_direct_fails = 0; // Not found by a scan either: the AP is away, not moved
+    retry_later();
+}
+
+static void on_got_ip(const ip_event_got_ip_t *ev)
+{
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - s_down_us) / 1000);
+    s_stats.connects++;
+    s_stats.last_ms = ms;
+    if (ms > s_stats.max_ms)
+        s_stats.max_ms = ms;
+
+    ESP_LOGI(TAG, "Up as " IPSTR " in %lu ms (%lu attempt%s, %s)", IP2STR(&ev->ip_info.ip),
+             (unsigned long)ms, (unsigned long)s_tries, s_tries == 1 ? "" : "s",
+             s_direct ? "cached AP" : "full scan");
+    s_up = true;
+    s_fails = 0;
+    s_direct_fails = 0;
+    if (s_cfg.on_change)
+        s_cfg.on_change(true);
+}
+
+static void event_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_START)
+    {
+        connect_now();
+    }
+    else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_CONNECTED)
+    {
+        const wifi_event_sta_connected_t *ev = data;
+        cache_store(ev->bssid, ev->channel);
+    }
+    else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        on_disconnected(data);
+    }
+    else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP)
+    {
+        on_got_ip(data);
+    }
+    else if (base == WIFI_CONN_EVENT && id == WIFI_CONN_EVENT_RETRY)
+    {
+        connect_now();
+    }
+}
+
+// --- START ---
+
+void wifi_conn_start(const wifi_conn_config_t *cfg)
+{
+    s_cfg = *cfg;
+    s_down_us = esp_timer_get_time();
+
+    esp_netif_t *sta = esp_netif_create_default_wifi_sta();
+
+    // Static IP: no DHCP round trip on every reconnect
+    ESP_ERROR_CHECK(esp_netif_dhcpc_stop(sta));
+    esp_netif_ip_info_t ip_info;
+    esp_netif_str_to_ip4(cfg->ip, &ip_info.ip);
+    esp_netif_str_to_ip4(cfg->gw, &ip_info.gw);
+    esp_netif_str_to_ip4(cfg->netmask, &ip_info.netmask);
+    ESP_ERROR_CHECK(esp_netif_set_ip_info(sta, &ip_info));
+
+    esp_netif_dns_info_t dns_info;
+    esp_netif_str_to_ip4(cfg->dns, &dns_info.ip.u_addr.ip4);
+    ESP_ERROR_CHECK(esp_netif_set_dns_info(sta, ESP_NETIF_DNS_MAIN, &dns_info));
+
+    wifi_init_config_t init = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&init));
+    // We rewrite the config before every attempt; keep the driver from
+    // saving each one to flash
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    // Set it either way: the driver defaults to modem sleep
+    ESP_ERROR_CHECK(esp_wifi_set_ps(cfg->listen_interval == 0   ? WIFI_PS_NONE
+                                    : cfg->listen_interval == 1 ? WIFI_PS_MIN_MODEM
+                                                                : WIFI_PS_MAX_MODEM));
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_CONN_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, NULL));
+
+    const esp_timer_create_args_t retry = {
+        .callback = on_retry_timer,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry, &s_retry_timer));
+
+    // Neither field needs a terminator when it is full
+    memcpy(s_base_config.sta.ssid, cfg->ssid, strnlen(cfg->ssid, sizeof(s_base_config.sta.ssid)));
+    memcpy(s_base_config.sta.password, cfg->password, strnlen(cfg->password, sizeof(s_base_config.sta.password)));
+    s_base_config.sta.listen_interval = cfg->listen_interval;
+    cache_load();
+
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_base_config));
+    ESP_ERROR_CHECK(esp_wifi_start());
+}
+
+void wifi_conn_get_stats(wifi_conn_stats_t *out)
+{
+    *out = s_stats;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// --- WI-FI STATION ---
+//
+// Brings the station up with a static IP and keeps it up. The channel and
+// BSSID of the last AP that gave us a link are cached in NVS, and every
+// connect (at boot too) first goes straight to that AP on that channel: one
+// probe instead of a scan of every channel, which is most of a reconnect
+// next to a busy AP. After WIFI_CONN_DIRECT_TRIES failed direct attempts the
+// cache is ignored and we fall back to a full scan, picking the strongest AP
+// with our SSID. If the scan finds nothing either, the AP is down rather than
+// moved, and the next attempts go direct again.
+//
+// The first retry after losing a working link goes out at once; failed
+// attempts after that back off exponentially, WIFI_CONN_BACKOFF_MIN_MS
+// doubling up to WIFI_CONN_BACKOFF_MAX_MS. Every time the link comes up we
+// log how long it was down and how many attempts it took.
+//
+// Modem sleep: with a listen interval set, the radio sleeps between the
+// AP's beacons and traffic for us waits at the AP until the next wake-up.
+// Every command from the app can pick up to one wake period of delay (half
+// on average), in exchange for the radio being off most of the time. 1
+// wakes for every DTIM beacon (102.4 ms times the router's DTIM, usually
+// 1-3), N > 1 every N beacons, 0 keeps the radio on.
+//
+// All of this runs on the default event loop; on_change is called from it.
+
+#define WIFI_CONN_NVS_NAMESPACE     "wifi"
+#define WIFI_CONN_DIRECT_TRIES      2
+#define WIFI_CONN_BACKOFF_MIN_MS    250
+#define WIFI_CONN_BACKOFF_MAX_MS    30000
+
+typedef struct
+{
+    const char *ssid;
+    const char *password;
+    const char *ip;         // Static address, gateway, netmask and DNS
+    const char *gw;
+    const char *netmask;
+    const char *dns;
+    uint16_t listen_interval;   // Modem sleep, see above
+    void (*on_change)(bool up);
+} wifi_conn_config_t;
+
+typedef struct
+{
+    uint32_t connects;      // Times the link came up
+    uint32_t attempts;      // Connect attempts, good or bad
+    uint32_t scans;         // Of those, full scans
+    uint32_t last_ms;       // Down -> IP for the last connect
+    uint32_t max_ms;
+} wifi_conn_stats_t;
+
+// Call once, after nvs_flash_init(), esp_netif_init() and
+// esp_event_loop_create_default()
+void wifi_conn_start(const wifi_conn_config_t *cfg);
+
+// Counters are updated on the event loop without a lock; each field is
+// consistent on its own
+void wifi_conn_get_stats(wifi_conn_stats_t *out);
@@ -0,0 +1,457 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "aera_power.h"
+#include "aera_dlog.h"
+#include "ws_broadcast.h"
+
+typedef struct
+{
+    int64_t queued_us;
+    uint8_t topic;
+    uint8_t len;
+    bool binary;
+    char text[WS_BCAST_MAX_MSG];
+} bcast_msg_t;
+
+_Static_assert(WS_BCAST_MAX_MSG <= UINT8_MAX, "len is one byte");
+
+typedef struct
+{
+    int fd;                 // -1 when the slot is free
+    uint8_t head;           // Oldest pending message
+    uint8_t count;
+    bool closing;           // Reaped, waiting for httpd to close it
+    bool ping_due;          // Keepalive PING to send
+    int64_t seen_us;        // Last frame from it
+    int64_t pinged_us;      // Last keepalive PING to it
+    bcast_msg_t queue[WS_BCAST_CLIENT_QUEUE];
+} bcast_client_t;
+
+static const char *TAG = "WS_BCAST";
+
+#define PING_US         ((int64_t)WS_BCAST_PING_MS * 1000)
+#define IDLE_TIMEOUT_US ((int64_t)WS_BCAST_IDLE_TIMEOUT_MS * 1000)
+
+// Everything below is guarded by s_lock. The lock is only ever held for
+// queue bookkeeping, never across a socket send.
+static SemaphoreHandle_t s_lock;
+static bcast_client_t s_clients[WS_BCAST_MAX_CLIENTS];
+static httpd_handle_t s_server = NULL;
+static TaskHandle_t s_task = NULL;
+static atomic_bool s_send_queued; // send_work() is waiting in httpd's queue
+
+static ws_broadcast_stats_t s_stats = {.latency_min_us = UINT32_MAX};
+static uint64_t s_latency_total_us;
+static uint32_t s_late_replies;     // In sent, not in the latency figures
+
+static bcast_client_t *find_client(int fd)
+{
+    for (int i = 0; i < WS_BCAST_MAX_CLIENTS; i++)
+    {
+        if (s_clients[i].fd == fd)
+            return &s_clients[i];
+    }
+    return NULL;
+}
+
+static void client_push(bcast_client_t *c, const bcast_msg_t *msg)
+{
+    // Newest state on a topic wins over one the client hasn't been sent yet
+    for (uint8_t i = 0; i < c->count; i++)
+    {
+        bcast_msg_t *pending = &c->queue[(c->head + i) % WS_BCAST_CLIENT_QUEUE];
+        if (pending->topic == msg->topic)
+        {
+            *pending = *msg;
+            s_stats.coalesced++;
+            return;
+        }
+    }
+
+    if (c->count == WS_BCAST_CLIENT_QUEUE)
+    {
+        c->head = (c->head + 1) % WS_BCAST_CLIENT_QUEUE;
+        c->count--;
+        s_stats.dropped++;
+    }
+    c->queue[(c->head + c->count) % WS_BCAST_CLIENT_QUEUE] = *msg;
+    c->count++;
+}
+
+void ws_broadcast_set_server(httpd_handle_t server)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_server = server;
+    xSemaphoreGive(s_lock);
+}
+
+void ws_broadcast_add_client(int sockfd)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (find_client(sockfd) == NULL)
+    {
+        bcast_client_t *c = find_client(-1);
+        if (c != NULL)
+        {
+            c->fd = sockfd;
+            c->head = 0;
+            c->count = 0;
+            c->closing = false;
+            c->ping_due = false;
+            c->seen_us = esp_timer_get_time();
+            c->pinged_us = c->seen_us;
+            s_stats.clients++;
+        }
+        else
+        {
+            ESP_LOGW(TAG, "No room to track fd %d", sockfd);
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    // Sends to it give up quickly instead of holding up httpd
+    struct timeval tv = {.tv_sec = WS_BCAST_SEND_TIMEOUT_MS / 1000,
+                         .tv_usec = (WS_BCAST_SEND_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    // Its keepalive starts now
+    if (s_task)
+        xTaskNotifyGive(s_task);
+}
+
+void ws_broadcast_remove_client(int sockfd)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bcast_client_t *c = find_client(sockfd);
+    if (c != NULL)
+    {
+        c->fd = -1;
+        s_stats.clients--;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void ws_broadcast_client_seen(int sockfd)
+{
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bcast_client_t *c = find_client(sockfd);
+    if (c != NULL)
+        c->seen_us = now;
+    xSemaphoreGive(s_lock);
+}
+
+void ws_broadcast_publish(ws_topic_t topic, const char *text)
+{
+    bcast_msg_t msg;
+    size_t len = strlen(text);
+    if (len > WS_BCAST_MAX_MSG)
+        len = WS_BCAST_MAX_MSG;
+
+    msg.queued_us = esp_timer_get_time();
+    msg.topic = (uint8_t)topic;
+    msg.len = (uint8_t)len;
+    msg.binary = false;
+    memcpy(msg.text, text, len);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.published++;
+    for (int i = 0; i < WS_BCAST_MAX_CLIENTS; i++)
+    {
+        if (s_clients[i].fd >= 0 && !s_clients[i].closing)
+            client_push(&s_clients[i], &msg);
+    }
+    xSemaphoreGive(s_lock);
+
+    if (s_task)
+        xTaskNotifyGive(s_task);
+}
+
+void ws_broadcast_send_binary(int sockfd, ws_topic_t topic, const uint8_t *data, size_t len)
+{
+    bcast_msg_t msg;
+    if (len > WS_BCAST_MAX_MSG)
+        len = WS_BCAST_MAX_MSG;
+
+    msg.queued_us = esp_timer_get_time();
+    msg.topic = (uint8_t)topic;
+    msg.len = (uint8_t)len;
+    msg.binary = true;
+    memcpy(msg.text, data, len);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bcast_client_t *c = find_client(sockfd);
+    if (c != NULL && c->closing)
+        c = NULL;
+    if (c != NULL)
+    {
+        s_stats.published++;
+        client_push(c, &msg);
+    }
+    xSemaphoreGive(s_lock);
+
+    if (c != NULL && s_task)
+        xTaskNotifyGive(s_task);
+}
+
+// --- KEEPALIVE ---
+// Marks the clients due a PING for send_work() and has httpd close the
+// ones gone silent. Returns how long until the next one is due either;
+// forever with no clients, until one is added.
+static TickType_t keepalive_service(void)
+{
+    int reap_fds[WS_BCAST_MAX_CLIENTS];
+    uint32_t reap_idle_s[WS_BCAST_MAX_CLIENTS];
+    int reaps = 0;
+    int64_t now = esp_timer_get_time();
+    int64_t next = INT64_MAX;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    httpd_handle_t server = s_server;
+    for (int i = 0; i < WS_BCAST_MAX_CLIENTS; i++)
+    {
+        bcast_client_t *c = &s_clients[i];
+        if (c->fd < 0 || c->closing)
+            continue;
+
+        int64_t idle_us = now - c->seen_us;
+        if (idle_us >= IDLE_TIMEOUT_US)
+        {
+            c->closing = true;
+            reap_fds[reaps] = c->fd;
+            reap_idle_s[reaps++] = (uint32_t)(idle_us / 1000000);
+            s_stats.reaped++;
+            continue;
+        }
+
+        // Once per PING_US of silence; any frame from it starts over
+        int64_t ping_us = (c->pinged_us > c->seen_us ? c->pinged_us : c->seen_us) + PING_US;
+        if (now >= ping_us)
+        {
+            c->pinged_us = now;
+            ping_us = now + PING_US;
+            c->ping_due = true;
+            s_stats.pings++;
+        }
+        if (ping_us < next)
+            next = ping_us;
+        if (c->seen_us + IDLE_TIMEOUT_US < next)
+            next = c->seen_us + IDLE_TIMEOUT_US;
+    }
+    xSemaphoreGive(s_lock);
+
+    for (int i = 0; server != NULL && i < reaps; i++)
+    {
+        AERA_DLOG(BCAST_REAPED, reap_fds[i], reap_idle_s[i]);
+        httpd_sess_trigger_close(server, reap_fds[i]);
+    }
+    if (next == INT64_MAX)
+        return portMAX_DELAY;
+    return pdMS_TO_TICKS((next - now) / 1000) + 1;
+}
+
+// --- SENDING ---
+// On the httpd task, as work it was handed (httpd_queue_work()), so a frame
+// never goes out in the middle of a reply httpd is writing to the same
+// socket. Round-robin, one frame per client per pass, then the PINGs due.
+// A client whose socket won't take a frame holds the others up once, for
+// WS_BCAST_SEND_TIMEOUT_MS, and then has its session closed.
+static void send_work(void *arg)
+{
+    // Anything published from here on gets another pass
+    atomic_store(&s_send_queued, false);
+    aera_power_acquire(AERA_POWER_WS);
+
+    bool more = true;
+    while (more)
+    {
+        more = false;
+        for (int i = 0; i < WS_BCAST_MAX_CLIENTS; i++)
+        {
+            bcast_msg_t msg;
+            httpd_handle_t server;
+            int fd;
+
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            bcast_client_t *c = &s_clients[i];
+            fd = c->fd;
+            server = s_server;
+            bool have = fd >= 0 && !c->closing && c->count > 0;
+            if (have)
+            {
+                msg = c->queue[c->head];
+                c->head = (c->head + 1) % WS_BCAST_CLIENT_QUEUE;
+                c->count--;
+                more |= c->count > 0;
+            }
+            xSemaphoreGive(s_lock);
+
+            if (!have || server == NULL)
+                continue;
+
+            esp_err_t err = ESP_FAIL;
+            if (httpd_ws_get_fd_info(server, fd) == HTTPD_WS_CLIENT_WEBSOCKET)
+            {
+                httpd_ws_frame_t pkt;
+                memset(&pkt, 0, sizeof(httpd_ws_frame_t));
+                pkt.payload = (uint8_t *)msg.text;
+                pkt.len = msg.len;
+                pkt.type = msg.binary ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT;
+                err = httpd_ws_send_frame_async(server, fd, &pkt);
+            }
+
+            uint32_t dt = (uint32_t)(esp_timer_get_time() - msg.queued_us);
+
+            bool close_it = false;
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            if (err == ESP_OK)
+            {
+                s_stats.sent++;
+                s_latency_total_us += dt;
+                if (dt < s_stats.latency_min_us)
+                    s_stats.latency_min_us = dt;
+                if (dt > s_stats.latency_max_us)
+                    s_stats.latency_max_us = dt;
+            }
+            else if (c->fd == fd && !c->closing)
+            {
+                // Gone, broken or not reading; the close callback
+                // removes it, nothing more is queued for it until then
+                c->closing = true;
+                c->count = 0;
+                s_stats.send_errors++;
+                close_it = true;
+            }
+            xSemaphoreGive(s_lock);
+
+            if (close_it)
+            {
+                AERA_DLOG(BCAST_FAILED, fd, err);
+                httpd_sess_trigger_close(server, fd);
+            }
+        }
+    }
+
+    // A failed PING needs nothing here: the client stays silent and is
+    // reaped in time
+    for (int i = 0; i < WS_BCAST_MAX_CLIENTS; i++)
+    {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        bcast_client_t *c = &s_clients[i];
+        int fd = c->fd;
+        httpd_handle_t server = s_server;
+        bool ping = fd >= 0 && !c->closing && c->ping_due;
+        c->ping_due = false;
+        xSemaphoreGive(s_lock);
+
+        if (ping && server != NULL)
+        {
+            httpd_ws_frame_t pkt;
+            memset(&pkt, 0, sizeof(httpd_ws_frame_t));
+            pkt.type = HTTPD_WS_TYPE_PING;
+            httpd_ws_send_frame_async(server, fd, &pkt);
+        }
+    }
+    aera_power_release(AERA_POWER_WS);
+}
+
+// --- TASK: BROADCAST ---
+// Hands the sending to httpd whenever there may be something to send, one
+// send_work() in its queue at a time, and sleeps until the next keepalive
+// is due. If httpd's queue is full it tries again in WS_BCAST_RETRY_MS.
+static void ws_broadcast_task(void *arg)
+{
+    TickType_t wait = portMAX_DELAY;
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, wait);
+        wait = keepalive_service();
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        httpd_handle_t server = s_server;
+        xSemaphoreGive(s_lock);
+        if (server == NULL || atomic_exchange(&s_send_queued, true))
+            continue;
+        if (httpd_queue_work(server, send_work, NULL) != ESP_OK)
+        {
+            atomic_store(&s_send_queued, false);
+            if (wait > pdMS_TO_TICKS(WS_BCAST_RETRY_MS) + 1)
+                wait = pdMS_TO_TICKS(WS_BCAST_RETRY_MS) + 1;
+        }
+    }
+}
+
+void ws_broadcast_start(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    for (int i = 0; i < WS_BCAST_MAX_CLIENTS; i++)
+        s_clients[i].fd = -1;
+
+    xTaskCreatePinnedToCore(ws_broadcast_task, "ws_bcast_task", WS_BCAST_TASK_STACK, NULL,
+                            WS_BCAST_TASK_PRIO, &s_task, WS_BCAST_TASK_CORE);
+}
+
+// --- LATE REPLIES ---
+typedef struct
+{
+    httpd_handle_t server;
+    int fd;
+    size_t len;
+    char text[];
+} late_reply_t;
+
+static void send_late_reply(void *arg)
+{
+    late_reply_t *r = arg;
+    if (httpd_ws_get_fd_info(r->server, r->fd) == HTTPD_WS_CLIENT_WEBSOCKET)
+    {
+        httpd_ws_frame_t pkt;
+        memset(&pkt, 0, sizeof(httpd_ws_frame_t));
+        pkt.payload = (uint8_t *)r->text;
+        pkt.len = r->len;
+        pkt.type = HTTPD_WS_TYPE_TEXT;
+        if (httpd_ws_send_frame_async(r->server, r->fd, &pkt) == ESP_OK)
+        {
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            s_stats.sent++;
+            s_late_replies++;
+            xSemaphoreGive(s_lock);
+        }
+    }
+    free(r);
+}
+
+bool ws_broadcast_reply_later(httpd_handle_t server, int fd, const char *text, size_t len)
+{
+    late_reply_t *r = malloc(sizeof(late_reply_t) + len);
+    if (r == NULL)
+        return false;
+    r->server = server;
+    r->fd = fd;
+    r->len = len;
+    memcpy(r->text, text, len);
+    if (httpd_queue_work(server, send_late_reply, r) != ESP_OK)
+    {
+        free(r);
+        return false;
+    }
+    return true;
+}
+
+void ws_broadcast_get_stats(ws_broadcast_stats_t *out)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_stats;
+    uint32_t timed = s_stats.sent - s_late_replies;
+    out->latency_avg_us = timed ? (uint32_t)(s_latency_total_us / timed) : 0;
+    if (timed == 0)
+        out->latency_min_us = 0;
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_http_server.h"
+
+// --- WEBSOCKET BROADCAST ---
+//
+// State changes go to every open WebSocket session, not just the one that
+// asked. Publishers drop a message into each client's small outbound queue
+// and return; a broadcast task has httpd send them on its own task
+// (httpd_queue_work()), so they never interleave on a socket with the
+// replies httpd writes there.
+//
+// Messages carry a topic. A client that hasn't been sent its last message on
+// a topic yet has it overwritten rather than queueing another one, so a slow
+// phone skips straight to the newest state instead of replaying the history
+// and holding everyone else up. If a queue is full of distinct topics the
+// oldest entry is dropped.
+//
+// Besides broadcasts, a module can queue a binary frame for one client
+// (the telemetry stream); it goes through the same queue and rules.
+//
+// A client's socket only waits WS_BCAST_SEND_TIMEOUT_MS for room to take a
+// frame, not httpd's send_wait_timeout, so one that has stopped reading
+// can't hold httpd, or the other clients, up for long. If that, or any
+// send, fails, httpd is asked to close the session.
+//
+// --- KEEPALIVE ---
+// The task also keeps track of whether each client is still there, so
+// clients don't have to poll for it. One that has sent nothing for
+// WS_BCAST_PING_MS is sent a WebSocket PING; every frame from it, its PONG
+// included, counts (ws_broadcast_client_seen()). One silent for
+// WS_BCAST_IDLE_TIMEOUT_MS has httpd close its session, which removes it
+// here through the server's close callback like any other close.
+
+#define WS_BCAST_MAX_CLIENTS    12
+#define WS_BCAST_CLIENT_QUEUE   4
+#define WS_BCAST_MAX_MSG        96
+#define WS_BCAST_TASK_CORE      0
+#define WS_BCAST_TASK_PRIO      5
+#define WS_BCAST_TASK_STACK     3072
+#define WS_BCAST_SEND_TIMEOUT_MS 100
+#define WS_BCAST_RETRY_MS       10  // httpd's work queue was full
+#define WS_BCAST_PING_MS        15000
+#define WS_BCAST_IDLE_TIMEOUT_MS (3 * WS_BCAST_PING_MS)
+
+typedef enum
+{
+    WS_TOPIC_STATUS = 0,    // STATUS:ON / STATUS:OFF
+    WS_TOPIC_ERROR,         // ERROR:<reason>
+    WS_TOPIC_TELEMETRY,     // Binary sensor samples, see telemetry.h
+    WS_TOPIC_UNIT_STATUS,   // + unit: STATUS:ON@<unit> on a bus, one topic each
+} ws_topic_t;
+
+typedef struct
+{
+    uint32_t clients;       // Sessions tracked right now
+    uint32_t published;     // ws_broadcast_publish() calls
+    uint32_t sent;          // Frames handed to the socket, late replies too
+    uint32_t coalesced;     // Replaced by a newer message on the same topic
+    uint32_t dropped;       // Pushed out of a full queue
+    uint32_t send_errors;   // Send failed or timed out, session closed
+    uint32_t pings;         // Keepalive PINGs sent
+    uint32_t reaped;        // Sessions closed for going silent
+    uint32_t latency_min_us; // Publish -> sent, over all sent frames
+    uint32_t latency_avg_us;
+    uint32_t latency_max_us;
+} ws_broadcast_stats_t;
+
+void ws_broadcast_start(void);
+
+// The server the sessions belong to. Set whenever httpd is (re)started.
+void ws_broadcast_set_server(httpd_handle_t server);
+
+void ws_broadcast_add_client(int sockfd);
+void ws_broadcast_remove_client(int sockfd);
+
+// The client sent a frame, of any kind; it is alive.
+void ws_broadcast_client_seen(int sockfd);
+
+// Queues text for every client. Never blocks on the network.
+void ws_broadcast_publish(ws_topic_t topic, const char *text);
+
+// Queues a binary frame for one client. Dropped if the client isn't tracked.
+void ws_broadcast_send_binary(int sockfd, ws_topic_t topic, const uint8_t *data, size_t len);
+
+// Answers one client from any task, for a reply that comes after its
+// request's handler has returned: sent on the httpd task like the rest, and
+// not queued behind the broadcasts or coalesced. Takes a copy of text. False
+// if it couldn't be queued; a client gone by the time it's sent is skipped.
+bool ws_broadcast_reply_later(httpd_handle_t server, int fd, const char *text, size_t len);
+
+void ws_broadcast_get_stats(ws_broadcast_stats_t *out);
@@ -0,0 +1,58 @@
+#include <stdatomic.h>
+#include "ws_rx_pool.h"
+
+#define SLAB_SIZE   (WS_RX_MAX_FRAME + 1)
+#define ALL_FREE    ((uint32_t)((1ULL << WS_RX_POOL_SLABS) - 1))
+
+_Static_assert(WS_RX_POOL_SLABS > 0 && WS_RX_POOL_SLABS <= 32, "WS_RX_POOL_SLABS must be 1..32");
+
+// One bit per slab, set while the slab is free. Claiming a slab is a single
+// compare-and-swap, so the pool stays safe if more than one httpd worker ever
+// receives at the same time.
+static uint8_t s_slabs[WS_RX_POOL_SLABS][SLAB_SIZE];
+static atomic_uint s_free = ALL_FREE;
+
+static atomic_uint s_hits, s_misses, s_rejected;
+
+uint8_t *ws_rx_pool_take(size_t frame_len)
+{
+    if (frame_len > WS_RX_MAX_FRAME)
+    {
+        atomic_fetch_add_explicit(&s_rejected, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    unsigned free_mask = atomic_load_explicit(&s_free, memory_order_relaxed);
+    while (free_mask != 0)
+    {
+        unsigned idx = (unsigned)__builtin_ctz(free_mask);
+        if (atomic_compare_exchange_weak_explicit(&s_free, &free_mask, free_mask & ~(1u << idx),
+                                                  memory_order_acquire, memory_order_relaxed))
+        {
+            atomic_fetch_add_explicit(&s_hits, 1, memory_order_relaxed);
+            return s_slabs[idx];
+        }
+    }
+
+    atomic_fetch_add_explicit(&s_misses, 1, memory_order_relaxed);
+    return NULL;
+}
+
+void ws_rx_pool_give(uint8_t *slab)
+{
+    if (slab == NULL)
+        return;
+
+    unsigned idx = (unsigned)((slab - &s_slabs[0][0]) / SLAB_SIZE);
+    atomic_fetch_or_explicit(&s_free, 1u << idx, memory_order_release);
+}
+
+void ws_rx_pool_get_stats(ws_rx_pool_stats_t *out)
+{
+    unsigned free_mask = atomic_load_explicit(&s_free, memory_order_relaxed);
+
+    out->hits = atomic_load_explicit(&s_hits, memory_order_relaxed);
+    out->misses = atomic_load_explicit(&s_misses, memory_order_relaxed);
+    out->rejected = atomic_load_explicit(&s_rejected, memory_order_relaxed);
+    out->in_use = WS_RX_POOL_SLABS - (uint32_t)__builtin_popcount(free_mask);
+}
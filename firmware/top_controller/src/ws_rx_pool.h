@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// --- WEBSOCKET RX POOL ---
+//
+// Fixed receive slabs for incoming WebSocket frames, carved out once at boot.
+// ws_handler() takes a slab, reads the frame into it and hands it back, so
+// the steady-state receive path never touches the heap.
+//
+// Frames longer than WS_RX_MAX_FRAME are rejected before anything is taken
+// from the pool. Every slab has one spare byte so text frames can be
+// NUL-terminated in place.
+
+#define WS_RX_MAX_FRAME     128 // Longest payload we accept, in bytes
+#define WS_RX_POOL_SLABS    4   // At most 32
+
+typedef struct
+{
+    uint32_t hits;       // Slab handed out
+    uint32_t misses;     // Pool empty, frame dropped
+    uint32_t rejected;   // Frame longer than WS_RX_MAX_FRAME
+    uint32_t in_use;     // Slabs out right now
+} ws_rx_pool_stats_t;
+
+// Returns a slab of WS_RX_MAX_FRAME + 1 bytes, or NULL if the frame is too
+// long (counted as rejected) or the pool is empty (counted as a miss).
+uint8_t *ws_rx_pool_take(size_t frame_len);
+void ws_rx_pool_give(uint8_t *slab);
+
+void ws_rx_pool_get_stats(ws_rx_pool_stats_t *out);